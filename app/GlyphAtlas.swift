@@ -49,7 +49,12 @@ final class GlyphAtlas {
     }
 
     func entry(for glyph: CGGlyph, font: CTFont) -> GlyphEntry? {
-        let fontName = CTFontCopyPostScriptName(font) as String
+        entry(for: glyph, font: font, named: CTFontCopyPostScriptName(font) as String)
+    }
+
+    /// As entry(for:font:), with the font's PostScript name looked up once
+    /// by the caller rather than per glyph
+    func entry(for glyph: CGGlyph, font: CTFont, named fontName: String) -> GlyphEntry? {
         let fontSize = CTFontGetSize(font)
         let key = GlyphKey(fontName: fontName, fontSize: fontSize, glyphID: glyph)
 
@@ -117,6 +117,7 @@ extension MetalView {
         }
 
         // Draw text content using glyph atlas
+        ensureVisibleText()
         if let atlas = glyphAtlas, let textBuffer = textVertexBuffer, textVertexCount > 0 {
             sceneEncoder.setRenderPipelineState(glyphPipelineState)
             sceneEncoder.setVertexBuffer(textBuffer, offset: 0, index: 0)
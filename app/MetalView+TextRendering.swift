@@ -2,7 +2,7 @@
 // vulpes-browser
 //
 // Text layout and vertex generation for Metal rendering.
-// Handles font setup, glyph preparation, word wrapping, and special formatting.
+// Sets up fonts, hands layout to the engine and turns its glyph runs into quads.
 
 import AppKit
 import CoreText
@@ -19,98 +19,264 @@ struct ImagePlacement {
     var height: Float
 }
 
+// MARK: - Kept Layout
+
+/// What a kept text layout was built from. A change to any of these needs
+/// a new layout; a new width only needs a resize.
+struct TextLayoutKey: Equatable {
+    let text: String
+    let scale: CGFloat
+    let optimalBreaking: Bool
+    let hyphenate: Bool
+    let images: [Float]  // width and aspect ratio of each image hint
+}
+
 // MARK: - Text Rendering Extension
 
 extension MetalView {
 
-    /// Update the text vertex buffer with current displayedText
+    /// One font per vulpes_font_t style, at the layer's scale
+    private func textFonts(scale: CGFloat) -> [CTFont] {
+        let fontSize: CGFloat = 16.0 * scale
+        return ([1.0, 1.0] + Self.headingScales).enumerated().map { style, fontScale in
+            Self.textFont(style: style, size: fontSize * fontScale)
+        }
+    }
+
+    private static let headingScales: [CGFloat] = [1.8, 1.5, 1.3, 1.15]
+
+    /// The face of a vulpes_font_t style at an em size
+    private static func textFont(style: Int, size: CGFloat) -> CTFont {
+        let name = style == Int(VULPES_FONT_MONO.rawValue) ? "SF Mono" : "SF Pro Text"
+        return CTFontCreateWithName(name as CFString, size, nil)
+    }
+
+    /// The engine's cache of shaped words, made on first use and kept for
+    /// the life of the view, so every page measures and draws from it
+    private func textShapeCache() -> VulpesBridge.ShapeCache? {
+        if let shapeCache { return shapeCache }
+        shapeCache = VulpesBridge.ShapeCache { style, size, utf8 in
+            Self.shape(utf8, font: Self.textFont(style: style, size: CGFloat(size)))
+        }
+        return shapeCache
+    }
+
+    /// Glyph ids and advances of UTF-8 text: a base glyph per grapheme
+    /// cluster, then its combining marks. CoreText maps each UTF-16 unit
+    /// to a glyph of its own, so an emoji sequence or an accented letter
+    /// would take a glyph per unit; the engine's cluster boundaries keep
+    /// each one character wide. Spaces and tabs get glyph 0, which is
+    /// advanced over but not drawn.
+    private static func shape(_ utf8: UnsafeBufferPointer<UInt8>, font: CTFont) -> (glyphs: [UInt16], advances: [Float]) {
+        let bytes = Array(utf8)
+        let chars = Array(String(decoding: bytes, as: UTF8.self).utf16)
+        var glyphs = [CGGlyph](repeating: 0, count: chars.count)
+        _ = CTFontGetGlyphsForCharacters(font, chars, &glyphs, chars.count)
+        var advances = [CGSize](repeating: .zero, count: chars.count)
+        _ = CTFontGetAdvancesForGlyphs(font, .default, glyphs, &advances, chars.count)
+
+        var shaped: (glyphs: [UInt16], advances: [Float]) = ([], [])
+        var offset = 0
+        var unit = 0
+        while offset < bytes.count, unit < chars.count {
+            let end = VulpesBridge.nextGrapheme(bytes, from: offset)
+            // One UTF-16 unit per code point, two past the BMP
+            let units = bytes[offset..<end].reduce(0) { count, byte in
+                byte & 0xC0 == 0x80 ? count : count + (byte >= 0xF0 ? 2 : 1)
+            }
+            let unitEnd = min(unit + max(units, 1), chars.count)
+            let blank = chars[unit] == 0x0020 || chars[unit] == 0x0009
+            shaped.glyphs.append(blank ? 0 : glyphs[unit])
+            shaped.advances.append(Float(advances[unit].width))
+            // Zero-advance glyphs are combining marks and go over the
+            // base; the rest of an emoji sequence would need shaping to
+            // join, so the cluster shows its first glyph
+            for mark in (unit + 1)..<unitEnd where glyphs[mark] != 0 && advances[mark].width == 0 {
+                shaped.glyphs.append(glyphs[mark])
+                shaped.advances.append(0)
+            }
+            offset = end
+            unit = unitEnd
+        }
+        return shaped
+    }
+
+    /// Lay out displayedText, then rebuild link hit boxes, image placements
+    /// and the vertices of the visible text
     func updateTextDisplay() {
         guard let atlas = glyphAtlas else { return }
 
         let scale = CGFloat(metalLayer.contentsScale)
         let fontSize: CGFloat = 16.0 * scale
-        let font = CTFontCreateWithName("SF Pro Text" as CFString, fontSize, nil)
-        let lineHeight: Float = Float(fontSize * 1.4)
 
         let text = displayedText
-        let chars = Array(text.utf16)
-        guard !chars.isEmpty else {
+        guard !text.isEmpty else {
+            textLayout = nil
+            textLayoutKey = nil
+            textVertexBand = nil
             textVertexCount = 0
             return
         }
 
-        // Prepare fonts for different styles
-        let monoFont = CTFontCreateWithName("SF Mono" as CFString, fontSize, nil)
-        let h1Scale: CGFloat = 1.8
-        let h2Scale: CGFloat = 1.5
-        let h3Scale: CGFloat = 1.3
-        let h4Scale: CGFloat = 1.15
-        let h1Font = CTFontCreateWithName("SF Pro Text" as CFString, fontSize * h1Scale, nil)
-        let h2Font = CTFontCreateWithName("SF Pro Text" as CFString, fontSize * h2Scale, nil)
-        let h3Font = CTFontCreateWithName("SF Pro Text" as CFString, fontSize * h3Scale, nil)
-        let h4Font = CTFontCreateWithName("SF Pro Text" as CFString, fontSize * h4Scale, nil)
-
-        // Pre-compute glyphs for all characters with each font
-        var glyphsNormal = [CGGlyph](repeating: 0, count: chars.count)
-        var glyphsMono = [CGGlyph](repeating: 0, count: chars.count)
-        var glyphsH1 = [CGGlyph](repeating: 0, count: chars.count)
-        var glyphsH2 = [CGGlyph](repeating: 0, count: chars.count)
-        var glyphsH3 = [CGGlyph](repeating: 0, count: chars.count)
-        var glyphsH4 = [CGGlyph](repeating: 0, count: chars.count)
-        _ = CTFontGetGlyphsForCharacters(font, chars, &glyphsNormal, chars.count)
-        _ = CTFontGetGlyphsForCharacters(monoFont, chars, &glyphsMono, chars.count)
-        _ = CTFontGetGlyphsForCharacters(h1Font, chars, &glyphsH1, chars.count)
-        _ = CTFontGetGlyphsForCharacters(h2Font, chars, &glyphsH2, chars.count)
-        _ = CTFontGetGlyphsForCharacters(h3Font, chars, &glyphsH3, chars.count)
-        _ = CTFontGetGlyphsForCharacters(h4Font, chars, &glyphsH4, chars.count)
-
-        // Pre-compute space glyphs
-        let spaceChar: [UniChar] = [0x0020]
-        var normalSpaceGlyph: CGGlyph = 0
-        var monoSpaceGlyph: CGGlyph = 0
-        var h1SpaceGlyph: CGGlyph = 0
-        var h2SpaceGlyph: CGGlyph = 0
-        var h3SpaceGlyph: CGGlyph = 0
-        var h4SpaceGlyph: CGGlyph = 0
-        _ = CTFontGetGlyphsForCharacters(font, spaceChar, &normalSpaceGlyph, 1)
-        _ = CTFontGetGlyphsForCharacters(monoFont, spaceChar, &monoSpaceGlyph, 1)
-        _ = CTFontGetGlyphsForCharacters(h1Font, spaceChar, &h1SpaceGlyph, 1)
-        _ = CTFontGetGlyphsForCharacters(h2Font, spaceChar, &h2SpaceGlyph, 1)
-        _ = CTFontGetGlyphsForCharacters(h3Font, spaceChar, &h3SpaceGlyph, 1)
-        _ = CTFontGetGlyphsForCharacters(h4Font, spaceChar, &h4SpaceGlyph, 1)
-
-        var vertices: [Vertex] = []
-        vertices.reserveCapacity(chars.count * 6)
+        let fonts = textFonts(scale: scale)
+        let fontScales: [CGFloat] = [1.0, 1.0] + Self.headingScales
+
+        let metrics: [vulpes_font_metrics_t] = fonts.enumerated().map { index, font in
+            var glyph: CGGlyph = 0
+            _ = CTFontGetGlyphsForCharacters(font, [0x0020], &glyph, 1)
+            return vulpes_font_metrics_t(
+                size: Float(CTFontGetSize(font)),
+                ascent: Float(CTFontGetAscent(font)),
+                descent: Float(CTFontGetDescent(font)),
+                line_height: Float(fontSize * 1.4 * fontScales[index]),
+                space: Float(atlas.entry(for: glyph, font: font)?.advance ?? 0)
+            )
+        }
 
         // Layout configuration
-        let margin: Float = Float(20.0 * scale)
-        let quoteIndent: Float = Float(24.0 * scale)
-        let viewportWidth: Float = Float(bounds.width * scale) - margin * 2
         let targetLineWidth = VulpesConfig.shared.readableLineWidth
-        let contentWidth: Float
-        if targetLineWidth <= 0 {
-            contentWidth = viewportWidth
-        } else if let spaceEntry = atlas.entry(for: normalSpaceGlyph, font: font) {
-            let readableWidth = Float(spaceEntry.advance) * max(20.0, targetLineWidth)
-            contentWidth = min(viewportWidth, readableWidth)
+        let maxLineWidth = targetLineWidth <= 0 ? 0 : metrics[0].space * max(20.0, targetLineWidth)
+
+        // Images reserve their declared size, or the cached image's shape
+        let images: [vulpes_layout_image_t] = extractedImages.enumerated().map { index, imageURL in
+            let intrinsic: VulpesBridge.ImageInfo? = index < extractedImageInfo.count ? extractedImageInfo[index] : nil
+            var hint = vulpes_layout_image_t(width: 0, aspect_ratio: 0)
+            if let intrinsic, intrinsic.width > 0 {
+                // Don't upscale small images past their declared size
+                hint.width = Float(intrinsic.width) * Float(scale)
+            }
+            if let intrinsic, intrinsic.aspectRatio > 0 {
+                hint.aspect_ratio = intrinsic.aspectRatio
+            } else if let entry = imageAtlas?.entry(for: imageURL) {
+                hint.aspect_ratio = Float(entry.size.width / entry.size.height)
+            }
+            return hint
+        }
+
+        let options = VulpesBridge.TextLayout.Options(
+            width: Float(bounds.width * scale),
+            margin: Float(20.0 * scale),
+            quoteIndent: Float(24.0 * scale),
+            maxLineWidth: maxLineWidth,
+            maxImageWidth: Float(400.0 * scale),
+            optimalBreaking: VulpesConfig.shared.optimalLineBreaking,
+            hyphenate: VulpesConfig.shared.hyphenate,
+            fonts: metrics,
+            images: images
+        )
+        // A kept layout only needs its lines re-broken for a new width; the
+        // engine copies every paragraph whose breaks don't move
+        let key = TextLayoutKey(
+            text: text,
+            scale: scale,
+            optimalBreaking: options.optimalBreaking,
+            hyphenate: options.hyphenate,
+            images: images.flatMap { [$0.width, $0.aspect_ratio] }
+        )
+        let layout: VulpesBridge.TextLayout
+        if let kept = textLayout, textLayoutKey == key,
+           kept.resize(width: options.width, maxLineWidth: options.maxLineWidth) {
+            layout = kept
         } else {
-            contentWidth = viewportWidth
+            // Measured through the shaped words the glyphs are drawn from,
+            // kept from earlier pages, so mostly without CoreText
+            guard let shapes = textShapeCache(),
+                  let built = VulpesBridge.TextLayout(text: text, options: options, shapes: shapes) else {
+                textLayout = nil
+                textLayoutKey = nil
+                textVertexBand = nil
+                textVertexCount = 0
+                return
+            }
+            layout = built
+            textLayout = built
+            textLayoutKey = key
         }
 
-        // Layout state
-        var quoteDepth: Int = 0
-        var penX: Float = margin
-        var penY: Float = margin + Float(fontSize)
-        let baseLineHeight: Float = lineHeight
-        let h1LineHeight: Float = lineHeight * Float(h1Scale)
-        let h2LineHeight: Float = lineHeight * Float(h2Scale)
-        let h3LineHeight: Float = lineHeight * Float(h3Scale)
-        let h4LineHeight: Float = lineHeight * Float(h4Scale)
-        var currentLineHeight: Float = baseLineHeight
-        var extraSpacingAfterHeading: Float = 0
-
-        // Note: Scroll offset is now applied in the vertex shader via uniforms
-        // This allows smooth scrolling without rebuilding all vertices
+        // Link hit boxes: the union of each link's runs, in view points
+        var hitBoxes: [Int: LinkHitBox] = [:]
+        var linkCount = 0
+
+        let runs = layout.runs
+        for line in layout.lines {
+            for run in runs[Int(line.first_run)..<Int(line.first_run + line.run_count)] {
+                guard run.flags & UInt8(VULPES_RUN_LINK) != 0 else { continue }
+                let linkIndex = Int(run.link)
+                linkCount = max(linkCount, linkIndex + 1)
+                var hitBox = hitBoxes[linkIndex] ?? LinkHitBox(
+                    linkIndex: linkIndex,
+                    minX: Float.greatestFiniteMagnitude,
+                    minY: Float.greatestFiniteMagnitude,
+                    maxX: -Float.greatestFiniteMagnitude,
+                    maxY: -Float.greatestFiniteMagnitude
+                )
+                hitBox.minX = min(hitBox.minX, run.x / Float(scale))
+                hitBox.minY = min(hitBox.minY, line.y / Float(scale))
+                hitBox.maxX = max(hitBox.maxX, (run.x + run.width) / Float(scale))
+                hitBox.maxY = max(hitBox.maxY, (line.y + line.height) / Float(scale))
+                hitBoxes[linkIndex] = hitBox
+            }
+        }
+
+        // One hit box per link, so link numbers index the array
+        linkHitBoxes = (0..<linkCount).map { index in
+            hitBoxes[index] ?? LinkHitBox(
+                linkIndex: index,
+                minX: Float.greatestFiniteMagnitude,
+                minY: Float.greatestFiniteMagnitude,
+                maxX: -Float.greatestFiniteMagnitude,
+                maxY: -Float.greatestFiniteMagnitude
+            )
+        }
+
+        imagePlacements = layout.images.map { box in
+            ImagePlacement(
+                imageIndex: Int(box.image),
+                x: box.x / Float(scale),
+                y: box.y / Float(scale),
+                width: box.width / Float(scale),
+                height: box.height / Float(scale)
+            )
+        }
+
+        // Track content height for scroll bounds
+        contentHeight = layout.height / Float(scale)
+        let maxScroll = max(0, contentHeight - Float(bounds.height) + 40)
+        if scrollOffset > maxScroll {
+            scrollOffset = maxScroll
+        }
+
+        updateVisibleText()
+    }
+
+    /// Rebuild the text vertices if scrolling has left the band they cover.
+    /// Called before each frame is drawn.
+    func ensureVisibleText() {
+        guard textLayout != nil else { return }
+        if let band = textVertexBand,
+           band.lowerBound <= scrollOffset,
+           scrollOffset + Float(bounds.height) <= band.upperBound {
+            return
+        }
+        updateVisibleText()
+    }
+
+    /// Build vertices for the runs within a screen of the viewport only, so
+    /// the work per rebuild and the upload stay the same on any page length.
+    /// Scroll offset is applied in the vertex shader, so scrolling inside
+    /// the band needs no rebuild.
+    func updateVisibleText() {
+        guard let atlas = glyphAtlas, let layout = textLayout, let shapes = shapeCache else { return }
+
+        let scale = Float(metalLayer.contentsScale)
+        let fonts = textFonts(scale: CGFloat(scale))
+        let fontNames = fonts.map { CTFontCopyPostScriptName($0) as String }
+
+        let viewHeight = Float(bounds.height)
+        let overscan = viewHeight
+        let top = scrollOffset * scale
+        let range = layout.visible(top: top, bottom: top + viewHeight * scale, overscan: overscan * scale)
+        textVertexBand = (scrollOffset - overscan)...(scrollOffset + viewHeight + overscan)
 
         // Colors - use CSS page style if available, otherwise defaults
         let config = VulpesConfig.shared
@@ -136,95 +302,17 @@ extension MetalView {
         }
 
         let focusedLinkColor = SIMD4<Float>(1.0, 0.8, 0.2, 1.0)
-        var currentColor = normalColor
-        var currentLinkIndex = -1
-
-        // Link hit boxes
-        linkHitBoxes = []
-        var currentLinkHitBox: LinkHitBox? = nil
-
-        // Control character codes
-        let linkStart: UInt16 = 0x0001
-        let linkEnd: UInt16 = 0x0002
-        let preStart: UInt16 = 0x0003
-        let preEnd: UInt16 = 0x0004
-        let emphStart: UInt16 = 0x0011
-        let emphEnd: UInt16 = 0x0012
-        let strongStart: UInt16 = 0x0013
-        let strongEnd: UInt16 = 0x0014
-        let codeStart: UInt16 = 0x0015
-        let codeEnd: UInt16 = 0x0016
-        let quoteStart: UInt16 = 0x0017
-        let quoteEnd: UInt16 = 0x0018
-        let h1Start: UInt16 = 0x0019
-        let h2Start: UInt16 = 0x001A
-        let h3Start: UInt16 = 0x001B
-        let h4Start: UInt16 = 0x001C
-        let headingEnd: UInt16 = 0x001D
-        let imageMarker: UInt16 = 0x001E
-
-        // Formatting state
-        var inPre = false
-        var inLink = false
-        var inEmphasis = false
-        var inStrong = false
-        var inCode = false
-        var headingLevel: Int = 0
-        var pendingEntries: [GlyphAtlas.GlyphEntry] = []
-        pendingEntries.reserveCapacity(32)
-        var pendingWidth: Float = 0
-
-        // Image state
-        imagePlacements = []
-        var inImageMarker = false
-        var imageNumberBuffer: [UniChar] = []
-
-        // Helper functions
-        func lineStartX() -> Float {
-            margin + quoteIndent * Float(quoteDepth)
-        }
 
-        func lineMaxX() -> Float {
-            let maxX = margin + contentWidth
-            return max(maxX, lineStartX() + 1.0)
-        }
-
-        func headingFont(for level: Int) -> CTFont {
-            switch level {
-            case 1: return h1Font
-            case 2: return h2Font
-            case 3: return h3Font
-            default: return h4Font
-            }
-        }
-
-        func headingGlyph(for level: Int, index: Int) -> CGGlyph {
-            switch level {
-            case 1: return glyphsH1[index]
-            case 2: return glyphsH2[index]
-            case 3: return glyphsH3[index]
-            default: return glyphsH4[index]
-            }
-        }
-
-        func headingSpaceGlyph(for level: Int) -> CGGlyph {
-            switch level {
-            case 1: return h1SpaceGlyph
-            case 2: return h2SpaceGlyph
-            case 3: return h3SpaceGlyph
-            default: return h4SpaceGlyph
-            }
-        }
-
-        func updateCurrentColor() {
-            var base = inLink ? linkColor : normalColor
-            if inLink && currentLinkIndex == focusedLinkIndex {
+        func color(for run: vulpes_glyph_run_t) -> SIMD4<Float> {
+            let isLink = run.flags & UInt8(VULPES_RUN_LINK) != 0
+            var base = isLink ? linkColor : normalColor
+            if isLink && Int(run.link) == focusedLinkIndex {
                 base = focusedLinkColor
             }
-            if headingLevel > 0 && !inLink {
+            if run.font >= UInt8(VULPES_FONT_H1.rawValue) && !isLink {
                 base = SIMD4<Float>(1.0, 1.0, 1.0, base.w)
             }
-            if inStrong {
+            if run.flags & UInt8(VULPES_RUN_STRONG) != 0 {
                 base = SIMD4<Float>(
                     min(base.x * 1.15, 1.0),
                     min(base.y * 1.15, 1.0),
@@ -232,16 +320,19 @@ extension MetalView {
                     base.w
                 )
             }
-            if inEmphasis {
+            if run.flags & UInt8(VULPES_RUN_EMPHASIS) != 0 {
                 base = SIMD4<Float>(base.x * 0.9, base.y * 0.9, base.z * 0.9, base.w)
             }
-            if inCode {
+            if run.flags & UInt8(VULPES_RUN_CODE) != 0 {
                 base = SIMD4<Float>(base.x * 0.95, base.y * 0.95, base.z * 0.95, base.w)
             }
-            currentColor = base
+            return base
         }
 
-        func appendGlyph(_ entry: GlyphAtlas.GlyphEntry, color: SIMD4<Float>) {
+        var vertices: [Vertex] = []
+        vertices.reserveCapacity(Int(range.run_count) * 32)
+
+        func appendGlyph(_ entry: GlyphAtlas.GlyphEntry, penX: Float, penY: Float, color: SIMD4<Float>) {
             let x1 = penX + Float(entry.bearing.x)
             let y1 = penY - Float(entry.bearing.y) - Float(entry.size.height)
             let x2 = x1 + Float(entry.size.width)
@@ -258,225 +349,41 @@ extension MetalView {
             vertices.append(Vertex(position: SIMD2<Float>(x2, y1), texCoord: SIMD2<Float>(u1, v0), color: color))
             vertices.append(Vertex(position: SIMD2<Float>(x2, y2), texCoord: SIMD2<Float>(u1, v1), color: color))
             vertices.append(Vertex(position: SIMD2<Float>(x1, y2), texCoord: SIMD2<Float>(u0, v1), color: color))
-
-            // Expand link hit box if we're in a link
-            if currentLinkHitBox != nil {
-                let hitX1 = penX + Float(entry.bearing.x)
-                let hitY1 = penY - Float(entry.bearing.y) - Float(entry.size.height)
-                let hitX2 = hitX1 + Float(entry.size.width)
-                let hitY2 = penY - Float(entry.bearing.y)
-
-                currentLinkHitBox!.minX = min(currentLinkHitBox!.minX, hitX1)
-                currentLinkHitBox!.minY = min(currentLinkHitBox!.minY, hitY1)
-                currentLinkHitBox!.maxX = max(currentLinkHitBox!.maxX, hitX2)
-                currentLinkHitBox!.maxY = max(currentLinkHitBox!.maxY, hitY2)
-            }
-
-            penX += Float(entry.advance)
         }
 
-        func flushPendingWord() {
-            guard pendingWidth > 0 else { return }
-
-            if penX + pendingWidth > lineMaxX() && penX > lineStartX() {
-                penX = lineStartX()
-                penY += currentLineHeight
-            }
-
-            for entry in pendingEntries {
-                appendGlyph(entry, color: currentColor)
-            }
-
-            pendingEntries.removeAll(keepingCapacity: true)
-            pendingWidth = 0
-        }
-
-        // Main character processing loop
-        for i in 0..<chars.count {
-            let char = chars[i]
-
-            // Handle control characters
-            if char == linkStart {
-                flushPendingWord()
-                currentLinkIndex += 1
-                inLink = true
-                updateCurrentColor()
-                currentLinkHitBox = LinkHitBox(
-                    linkIndex: currentLinkIndex,
-                    minX: Float.greatestFiniteMagnitude,
-                    minY: Float.greatestFiniteMagnitude,
-                    maxX: -Float.greatestFiniteMagnitude,
-                    maxY: -Float.greatestFiniteMagnitude
-                )
-                continue
-            }
-            if char == linkEnd {
-                flushPendingWord()
-                inLink = false
-                updateCurrentColor()
-                if var hitBox = currentLinkHitBox {
-                    hitBox.minX /= Float(scale)
-                    hitBox.minY /= Float(scale)
-                    hitBox.maxX /= Float(scale)
-                    hitBox.maxY /= Float(scale)
-                    linkHitBoxes.append(hitBox)
-                }
-                currentLinkHitBox = nil
-                continue
-            }
-            if char == preStart { flushPendingWord(); inPre = true; continue }
-            if char == preEnd { flushPendingWord(); inPre = false; continue }
-
-            // Image marker handling
-            if char == imageMarker {
-                if !inImageMarker {
-                    flushPendingWord()
-                    inImageMarker = true
-                    imageNumberBuffer = []
-                } else {
-                    inImageMarker = false
-                    if let numStr = String(utf16CodeUnits: imageNumberBuffer, count: imageNumberBuffer.count) as String?,
-                       let imageNum = Int(numStr), imageNum > 0, imageNum <= extractedImages.count {
-                        let imageIndex = imageNum - 1
-                        let maxImageWidth = lineMaxX() - lineStartX()
-                        let desiredWidth: Float = min(400.0 * Float(scale), maxImageWidth)
-
-                        if penX != lineStartX() {
-                            penX = lineStartX()
-                            penY += currentLineHeight
-                        }
-
-                        // Check if image is cached to get real dimensions
-                        let imageURL = extractedImages[imageIndex]
-                        let aspectRatio: Float
-                        if let entry = imageAtlas?.entry(for: imageURL) {
-                            // Use real aspect ratio from cached image
-                            aspectRatio = Float(entry.size.width / entry.size.height)
-                        } else {
-                            // Estimate 4:3 landscape until image loads
-                            aspectRatio = 4.0 / 3.0
-                        }
-
-                        let imageHeight = desiredWidth / aspectRatio
-
-                        let placement = ImagePlacement(
-                            imageIndex: imageIndex,
-                            x: penX / Float(scale),
-                            y: penY / Float(scale),
-                            width: desiredWidth / Float(scale),
-                            height: imageHeight / Float(scale)
-                        )
-                        imagePlacements.append(placement)
-
-                        penY += imageHeight
-                        penY += currentLineHeight * 0.5
-                        penX = lineStartX()
-                    }
-                }
-                continue
-            }
-            if inImageMarker { imageNumberBuffer.append(char); continue }
-
-            // Heading markers
-            if char == h1Start { flushPendingWord(); headingLevel = 1; currentLineHeight = h1LineHeight; updateCurrentColor(); continue }
-            if char == h2Start { flushPendingWord(); headingLevel = 2; currentLineHeight = h2LineHeight; updateCurrentColor(); continue }
-            if char == h3Start { flushPendingWord(); headingLevel = 3; currentLineHeight = h3LineHeight; updateCurrentColor(); continue }
-            if char == h4Start { flushPendingWord(); headingLevel = 4; currentLineHeight = h4LineHeight; updateCurrentColor(); continue }
-            if char == headingEnd {
-                flushPendingWord()
-                headingLevel = 0
-                currentLineHeight = baseLineHeight
-                extraSpacingAfterHeading = baseLineHeight * 0.25
-                updateCurrentColor()
-                continue
-            }
-
-            // Text formatting markers
-            if char == emphStart { flushPendingWord(); inEmphasis = true; updateCurrentColor(); continue }
-            if char == emphEnd { flushPendingWord(); inEmphasis = false; updateCurrentColor(); continue }
-            if char == strongStart { flushPendingWord(); inStrong = true; updateCurrentColor(); continue }
-            if char == strongEnd { flushPendingWord(); inStrong = false; updateCurrentColor(); continue }
-            if char == codeStart { flushPendingWord(); inCode = true; updateCurrentColor(); continue }
-            if char == codeEnd { flushPendingWord(); inCode = false; updateCurrentColor(); continue }
-
-            // Quote markers
-            if char == quoteStart {
-                flushPendingWord()
-                if penX != lineStartX() { penX = lineStartX(); penY += currentLineHeight }
-                quoteDepth += 1
-                penX = lineStartX()
-                continue
-            }
-            if char == quoteEnd {
-                flushPendingWord()
-                quoteDepth = max(0, quoteDepth - 1)
-                penX = lineStartX()
-                continue
-            }
-
-            // Newlines
-            if char == 0x000A {
-                flushPendingWord()
-                penX = lineStartX()
-                penY += currentLineHeight + extraSpacingAfterHeading
-                extraSpacingAfterHeading = 0
-                continue
-            }
-
-            // Regular character rendering
-            let useMono = inPre || inCode
-            let isHeading = headingLevel > 0 && !useMono
-            let glyph = useMono ? glyphsMono[i] : (isHeading ? headingGlyph(for: headingLevel, index: i) : glyphsNormal[i])
-            let activeFont = useMono ? monoFont : (isHeading ? headingFont(for: headingLevel) : font)
-
-            // Pre-formatted text (no word wrapping)
-            if inPre {
-                if char == 0x0009 { // tab
-                    if let spaceEntry = atlas.entry(for: monoSpaceGlyph, font: monoFont) {
-                        penX += Float(spaceEntry.advance) * 4
+        let bytes = layout.utf8
+        let lines = layout.lines
+        let runs = layout.runs
+        for line in lines[Int(range.first_line)..<Int(range.first_line + range.line_count)] {
+            for run in runs[Int(line.first_run)..<Int(line.first_run + line.run_count)] {
+                let runColor = color(for: run)
+                let start = Int(run.start)
+                let font = Int(run.font)
+                let size = Float(CTFontGetSize(fonts[font]))
+                // The word as layout measured it, so a cache hit. Marks
+                // have no advance of their own and are drawn to the left
+                // of where their base ends.
+                var penX = run.x
+                let word = shapes.word(bytes[start..<(start + Int(run.len))], font: font, size: size)
+                for (glyph, advance) in zip(word.glyphs, word.advances) {
+                    if glyph != 0, let entry = atlas.entry(for: glyph, font: fonts[font], named: fontNames[font]) {
+                        appendGlyph(entry, penX: penX, penY: line.baseline, color: runColor)
                     }
-                    continue
+                    penX += advance
                 }
-                if char == 0x0020 { // space
-                    if let spaceEntry = atlas.entry(for: monoSpaceGlyph, font: monoFont) {
-                        penX += Float(spaceEntry.advance)
-                    }
-                    continue
+                // A word broken across lines: the engine left room for the
+                // hyphen the text doesn't have
+                if run.flags & UInt8(VULPES_RUN_HYPHEN) != 0,
+                   let glyph = shapes.word(ArraySlice("-".utf8), font: font, size: size).glyphs.first, glyph != 0,
+                   let entry = atlas.entry(for: glyph, font: fonts[font], named: fontNames[font]) {
+                    appendGlyph(entry, penX: penX, penY: line.baseline, color: runColor)
                 }
-                guard let entry = atlas.entry(for: glyph, font: activeFont) else { continue }
-                appendGlyph(entry, color: currentColor)
-                continue
             }
-
-            // Whitespace handling with word wrapping
-            if char == 0x0020 || char == 0x0009 {
-                flushPendingWord()
-                if penX > lineStartX() {
-                    let spaceGlyph = useMono ? monoSpaceGlyph : (isHeading ? headingSpaceGlyph(for: headingLevel) : normalSpaceGlyph)
-                    if let spaceEntry = atlas.entry(for: spaceGlyph, font: activeFont) {
-                        penX += Float(spaceEntry.advance)
-                    }
-                }
-                continue
-            }
-
-            // Accumulate word
-            guard let entry = atlas.entry(for: glyph, font: activeFont) else { continue }
-            pendingEntries.append(entry)
-            pendingWidth += Float(entry.advance)
-        }
-
-        flushPendingWord()
-
-        // Track content height for scroll bounds
-        contentHeight = penY / Float(scale)
-        let maxScroll = max(0, contentHeight - Float(bounds.height) + 40)
-        if scrollOffset > maxScroll {
-            scrollOffset = maxScroll
         }
 
         guard !vertices.isEmpty else {
             textVertexCount = 0
+            needsDisplay = true
             return
         }
 
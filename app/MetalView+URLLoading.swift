@@ -13,12 +13,15 @@ extension MetalView {
     /// - Parameters:
     ///   - url: The URL to load
     ///   - addToHistory: Whether to add this URL to navigation history (default: true)
-    func loadURL(_ url: String, addToHistory: Bool = true) {
+    ///   - isReload: Update the current page in place, keeping scroll position
+    func loadURL(_ url: String, addToHistory: Bool = true, isReload: Bool = false) {
         // Clear any previous error state
         clearErrorState()
 
         // Trigger transition effect
-        triggerPageTransition()
+        if !isReload {
+            triggerPageTransition()
+        }
 
         let normalizedURL = normalizeURLStringForLoad(url)
 
@@ -29,13 +32,16 @@ extension MetalView {
 
         currentURL = normalizedURL
         baseURLForCurrentPage = URL(string: normalizedURL)
-        scrollOffset = 0  // Reset scroll position for new page
-        scrollVelocity = 0
-        stopScrollAnimator()
-        focusedLinkIndex = -1  // Reset link focus
-        pageStyle = .default  // Reset page style
-        displayedText = "Loading \(normalizedURL)..."
-        updateTextDisplay()
+        if !isReload {
+            scrollOffset = 0  // Reset scroll position for new page
+            scrollVelocity = 0
+            stopScrollAnimator()
+            focusedLinkIndex = -1  // Reset link focus
+            searchIndex = nil
+            pageStyle = .default  // Reset page style
+            displayedText = "Loading \(normalizedURL)..."
+            updateTextDisplay()
+        }
 
         // Notify URL bar
         onURLChange?(normalizedURL)
@@ -52,6 +58,10 @@ extension MetalView {
             return
         }
 
+        // Capture viewport on the main thread so srcset picks fit this window
+        let viewportWidth = bounds.width
+        let deviceScale = metalLayer.contentsScale
+
         // Fetch in background
         DispatchQueue.global(qos: .userInitiated).async { [weak self] in
             let startTime = CFAbsoluteTimeGetCurrent()
@@ -62,6 +72,8 @@ extension MetalView {
             case .success(let result):
                 fetchResult = result
             case .failure(let failure):
+                // The failure replaces the page, so the next good load must redraw
+                VulpesBridge.shared.forgetReload(url: normalizedURL)
                 DispatchQueue.main.async {
                     self?.displayedText = "Failed to load\n\n\(normalizedURL)\n\(failure.message) (error \(failure.code))"
                     self?.updateTextDisplay()
@@ -71,28 +83,53 @@ extension MetalView {
 
             // Extract text from HTML
             let text: String
+            let extraction = VulpesBridge.shared.extract(
+                from: fetchResult.body,
+                viewportWidth: viewportWidth,
+                deviceScale: deviceScale,
+                buildSearchIndex: true
+            )
             if fetchResult.status != 200 {
                 // Handle non-200 responses
-                if let extractedText = VulpesBridge.shared.extractText(from: fetchResult.body), !extractedText.isEmpty {
+                if let extractedText = extraction?.text, !extractedText.isEmpty {
                     text = "HTTP \(fetchResult.status)\n\n\(extractedText)"
                 } else {
                     text = "HTTP \(fetchResult.status)"
                 }
             } else {
-                text = VulpesBridge.shared.extractText(from: fetchResult.body) ?? "Failed to extract text"
+                text = extraction?.text ?? "Failed to extract text"
             }
+            let imageInfo = extraction?.images ?? []
+            let tables = extraction?.tables ?? []
+            // Offsets are into the extracted text, which the error banner would shift
+            let searchIndex = fetchResult.status == 200 ? extraction?.searchIndex : nil
 
-            // Extract page style from CSS (only for successful responses)
-            var extractedPageStyle: VulpesBridge.PageStyle = .default
-            if fetchResult.status == 200, let baseURL = URL(string: normalizedURL) {
-                extractedPageStyle = VulpesBridge.shared.extractPageStyle(from: fetchResult.body, baseURL: baseURL)
-            }
+            // Page colors came out of the same extraction pass (successful responses only)
+            let extractedPageStyle = fetchResult.status == 200 ? extraction?.pageStyle ?? .default : .default
             let resolvedBaseURL = self?.computeBaseURL(from: fetchResult.body, pageURLString: normalizedURL)
 
+            // Diff against what is on screen: record every good load, and
+            // forget the last one once an error page replaces it
+            let reloadDiff: VulpesBridge.ReloadDiff?
+            if fetchResult.status == 200 {
+                reloadDiff = VulpesBridge.shared.diffReload(url: normalizedURL, text: text)
+            } else {
+                VulpesBridge.shared.forgetReload(url: normalizedURL)
+                reloadDiff = nil
+            }
+
             let elapsed = (CFAbsoluteTimeGetCurrent() - startTime) * 1000
             print("MetalView: Loaded \(normalizedURL) in \(Int(elapsed))ms - \(text.count) chars")
 
             DispatchQueue.main.async {
+                if isReload, let reloadDiff, reloadDiff.hadPrevious {
+                    if reloadDiff.isUnchanged {
+                        print("MetalView: Reload of \(normalizedURL) unchanged")
+                        return
+                    }
+                    print("MetalView: Reload of \(normalizedURL) changed \(reloadDiff.hunks.count) regions")
+                }
+
                 // Check if this is an HTTP error response
                 if text.hasPrefix("HTTP ") {
                     // Parse error code from "HTTP 404" or "HTTP 500"
@@ -107,13 +144,27 @@ extension MetalView {
                     self?.baseURLForCurrentPage = resolvedBaseURL
                 }
                 self?.displayedText = text
+                self?.extractedImageInfo = imageInfo
+                self?.extractedTables = tables
+                self?.searchIndex = searchIndex
                 self?.parseLinks(from: text)
                 self?.updateTextDisplay()
+                if isReload, let self {
+                    // Stay where the reader was, unless the page got shorter
+                    let maxScroll = max(0, self.contentHeight - Float(self.bounds.height) + 40)
+                    self.scrollOffset = min(self.scrollOffset, maxScroll)
+                }
                 self?.onContentLoaded?(normalizedURL, text)
             }
         }
     }
 
+    /// Reload the current page in place
+    func reload() {
+        guard !currentURL.isEmpty else { return }
+        loadURL(currentURL, addToHistory: false, isReload: true)
+    }
+
     /// Snapshot current state for tab switching
     func snapshotState() -> (url: String, text: String, scrollOffset: Float) {
         return (currentURL, displayedText, scrollOffset)
@@ -124,6 +175,9 @@ extension MetalView {
         currentURL = url
         baseURLForCurrentPage = URL(string: url)
         displayedText = text
+        extractedImageInfo = []
+        extractedTables = []
+        searchIndex = nil
         self.scrollOffset = scrollOffset
         scrollVelocity = 0
         stopScrollAnimator()
@@ -152,6 +206,15 @@ extension MetalView {
         loadURL(url, addToHistory: false)
     }
 
+    /// Ranges of every match of `query` in displayedText, in document order.
+    /// Uses the index built during extraction, or builds one for restored tabs.
+    func findInPage(_ query: String) -> [Range<String.Index>] {
+        if searchIndex == nil {
+            searchIndex = VulpesBridge.SearchIndex(text: displayedText)
+        }
+        return searchIndex?.find(query) ?? []
+    }
+
     /// Parse links and images from the extracted text sections
     func parseLinks(from text: String) {
         extractedLinks = []
@@ -125,9 +125,31 @@ class MetalView: NSView {
     // Extracted images for rendering
     var extractedImages: [String] = []
 
+    // Intrinsic image sizes from the engine (parallel to extractedImages)
+    var extractedImageInfo: [VulpesBridge.ImageInfo] = []
+
+    // Table column layouts from the engine, in table marker order
+    var extractedTables: [VulpesBridge.TableInfo] = []
+
+    // Find-in-page index over displayedText, built on demand if missing
+    var searchIndex: VulpesBridge.SearchIndex?
+
     // CSS-extracted page style (colors)
     var pageStyle: VulpesBridge.PageStyle = .default
 
+    // Engine layout of displayedText, kept so a resize only re-breaks lines
+    // TextLayoutKey struct is defined in MetalView+TextRendering.swift
+    var textLayout: VulpesBridge.TextLayout?
+    var textLayoutKey: TextLayoutKey?
+
+    // Shaped words of every page shown, kept by the engine: layout measures
+    // through it and drawing reads glyph ids from it
+    var shapeCache: VulpesBridge.ShapeCache?
+
+    // Content-space band (points) the text vertices cover; scrolling past
+    // it rebuilds them from the layout
+    var textVertexBand: ClosedRange<Float>?
+
     // Image placement data (position and size for each image)
     // ImagePlacement struct is defined in MetalView+TextRendering.swift
     var imagePlacements: [ImagePlacement] = []
@@ -489,6 +511,10 @@ class MetalView: NSView {
             // Go back in history
             goBack()
             lastKeyChar = ""
+        case "r":
+            // Reload, updating the page in place
+            reload()
+            lastKeyChar = ""
         case "f":
             // Enter hint mode (Vimium-style)
             enterHintMode()
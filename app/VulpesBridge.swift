@@ -93,21 +93,93 @@ class VulpesBridge {
 
     // MARK: - Text Extraction
 
+    /// Intrinsic size hints for one image, in image marker order
+    struct ImageInfo {
+        let width: Int          // width attribute in CSS px, 0 if unknown
+        let height: Int         // height attribute in CSS px, 0 if unknown
+        let aspectRatio: Float  // width / height, 0 if unknown
+    }
+
+    /// Column layout for one table block, in table marker order
+    struct TableInfo {
+        let rows: Int
+        let columnWidths: [Int]  // widest cell per column, in characters
+    }
+
+    /// Colors the page declares for itself; nil where the viewer default applies
+    struct PageStyle {
+        typealias Color = (r: Float, g: Float, b: Float)
+
+        var textColor: Color?
+        var linkColor: Color?
+        var backgroundColor: Color?
+
+        static let `default` = PageStyle()
+
+        fileprivate init() {}
+
+        fileprivate init(_ style: vulpes_page_style_t) {
+            textColor = Self.color(style.text)
+            linkColor = Self.color(style.link)
+            backgroundColor = Self.color(style.background)
+        }
+
+        private static func color(_ c: vulpes_color_t) -> Color? {
+            guard c.is_set else { return nil }
+            return (Float(c.r) / 255, Float(c.g) / 255, Float(c.b) / 255)
+        }
+    }
+
+    /// Extracted text plus the engine's side tables
+    struct Extraction {
+        let text: String
+        let images: [ImageInfo]
+        let tables: [TableInfo]
+        var searchIndex: SearchIndex? = nil
+        var pageStyle: PageStyle = .default
+    }
+
     /// Extract visible text from HTML content.
-    /// - Parameter html: Raw HTML data
+    /// - Parameters:
+    ///   - html: Raw HTML data
+    ///   - viewportWidth: Viewport width in points (0 = engine default)
+    ///   - deviceScale: Backing scale factor used to pick srcset candidates
     /// - Returns: Extracted text string, or nil on failure
-    func extractText(from html: Data) -> String? {
+    func extractText(from html: Data, viewportWidth: CGFloat = 0, deviceScale: CGFloat = 1) -> String? {
+        extract(from: html, viewportWidth: viewportWidth, deviceScale: deviceScale)?.text
+    }
+
+    /// Extract visible text, the image table and table layouts from HTML content.
+    /// - Parameters:
+    ///   - html: Raw HTML data
+    ///   - viewportWidth: Viewport width in points (0 = engine default)
+    ///   - deviceScale: Backing scale factor used to pick srcset candidates
+    ///   - buildSearchIndex: Also build a find-in-page index over the text
+    /// - Returns: Extraction, or nil on failure
+    func extract(
+        from html: Data,
+        viewportWidth: CGFloat = 0,
+        deviceScale: CGFloat = 1,
+        buildSearchIndex: Bool = false
+    ) -> Extraction? {
         NSLog("VulpesBridge: extracting text from \(html.count) bytes")
 
-        return html.withUnsafeBytes { ptr -> String? in
+        var options = vulpes_extract_options_t(
+            viewport_width: UInt32(max(0, viewportWidth)),
+            device_scale: Float(deviceScale),
+            build_search_index: buildSearchIndex
+        )
+
+        return html.withUnsafeBytes { ptr -> Extraction? in
             guard let baseAddress = ptr.baseAddress else {
                 NSLog("VulpesBridge: extractText - no base address")
                 return nil
             }
 
-            guard let result = vulpes_extract_text(
+            guard let result = vulpes_extract_text_with_options(
                 baseAddress.assumingMemoryBound(to: UInt8.self),
-                html.count
+                html.count,
+                &options
             ) else {
                 NSLog("VulpesBridge: extractText returned nil")
                 return nil
@@ -121,7 +193,7 @@ class VulpesBridge {
 
             guard let textPtr = result.pointee.text else {
                 NSLog("VulpesBridge: extractText returned empty")
-                return ""
+                return Extraction(text: "", images: [], tables: [])
             }
 
             NSLog("VulpesBridge: extractText success - \(result.pointee.text_len) bytes")
@@ -129,10 +201,354 @@ class VulpesBridge {
             // Create string from UTF-8 bytes (using decoding which handles invalid sequences)
             let buffer = UnsafeBufferPointer(start: textPtr, count: result.pointee.text_len)
             let text = String(decoding: buffer, as: UTF8.self)
-            return text
+
+            var images: [ImageInfo] = []
+            if let table = result.pointee.images {
+                images.reserveCapacity(result.pointee.image_count)
+                for i in 0..<result.pointee.image_count {
+                    let entry = table[i]
+                    images.append(ImageInfo(
+                        width: Int(entry.width),
+                        height: Int(entry.height),
+                        aspectRatio: entry.aspect_ratio
+                    ))
+                }
+            }
+
+            var tables: [TableInfo] = []
+            if let layouts = result.pointee.tables {
+                tables.reserveCapacity(result.pointee.table_count)
+                for i in 0..<result.pointee.table_count {
+                    let entry = layouts[i]
+                    var widths: [Int] = []
+                    if let columnWidths = entry.column_widths {
+                        widths = (0..<Int(entry.columns)).map { Int(columnWidths[$0]) }
+                    }
+                    tables.append(TableInfo(rows: Int(entry.rows), columnWidths: widths))
+                }
+            }
+
+            // Take ownership of the index before the result is freed
+            var searchIndex: SearchIndex?
+            if let handle = result.pointee.search_index {
+                result.pointee.search_index = nil
+                searchIndex = SearchIndex(taking: handle, text: text)
+            }
+
+            return Extraction(
+                text: text,
+                images: images,
+                tables: tables,
+                searchIndex: searchIndex,
+                pageStyle: PageStyle(result.pointee.page_style)
+            )
+        }
+    }
+
+    /// Convert HTML content to CommonMark (for copy/export).
+    /// - Parameter html: Raw HTML data
+    /// - Returns: Markdown string, or nil on failure
+    func extractMarkdown(from html: Data) -> String? {
+        html.withUnsafeBytes { ptr -> String? in
+            guard let baseAddress = ptr.baseAddress,
+                  let result = vulpes_extract_markdown(baseAddress.assumingMemoryBound(to: UInt8.self), html.count) else {
+                return nil
+            }
+            defer { vulpes_text_free(result) }
+
+            guard result.pointee.error_code == 0 else { return nil }
+            guard let textPtr = result.pointee.text else { return "" }
+            return String(decoding: UnsafeBufferPointer(start: textPtr, count: result.pointee.text_len), as: UTF8.self)
         }
     }
 
+    // MARK: - Find in Page
+
+    /// Suffix-array index over one page's extracted text. Queries are
+    /// sublinear in the text size, so find-as-you-type stays responsive
+    /// on very long documents.
+    final class SearchIndex {
+        private let handle: OpaquePointer
+        private let text: String
+
+        /// Index text as returned by extract (Links/Images trailer ignored)
+        convenience init?(text: String) {
+            guard !text.isEmpty else { return nil }
+            var text = text
+            let handle = text.withUTF8 { vulpes_index_create($0.baseAddress!, $0.count) }
+            guard let handle else { return nil }
+            self.init(taking: handle, text: text)
+        }
+
+        fileprivate init(taking handle: OpaquePointer, text: String) {
+            self.handle = handle
+            self.text = text
+        }
+
+        deinit {
+            vulpes_index_destroy(handle)
+        }
+
+        /// Every match of `query` in document order. Matching ignores ASCII
+        /// case; ranges include any style markers inside the match.
+        func find(_ query: String) -> [Range<String.Index>] {
+            var query = query
+            guard !query.isEmpty else { return [] }
+            let result = query.withUTF8 { vulpes_find(handle, $0.baseAddress!, $0.count) }
+            guard let result else { return [] }
+            defer { vulpes_find_free(result) }
+
+            guard result.pointee.error_code == 0, let matches = result.pointee.matches else { return [] }
+            let utf8 = text.utf8
+            return (0..<result.pointee.match_count).map { i in
+                let start = utf8.index(utf8.startIndex, offsetBy: matches[i].start)
+                let end = utf8.index(utf8.startIndex, offsetBy: matches[i].end)
+                return start..<end
+            }
+        }
+    }
+
+    // MARK: - Shape Cache
+
+    /// Glyph ids and advances of words, kept by the engine across layouts.
+    /// A word is shaped through `shape` the first time it is measured in a
+    /// style and size; drawing it later is a lookup. Main thread only.
+    final class ShapeCache {
+        /// Glyph ids and advances of UTF-8 text in a vulpes_font_t style at
+        /// an em size; glyph 0 is advanced over but not drawn
+        typealias Shape = (_ font: Int, _ size: Float, _ text: UnsafeBufferPointer<UInt8>) -> (glyphs: [UInt16], advances: [Float])
+
+        struct Word {
+            let glyphs: [UInt16]
+            let advances: [Float]
+        }
+
+        fileprivate let handle: OpaquePointer
+        private let box: ShapeBox
+
+        init?(shape: @escaping Shape) {
+            let box = ShapeBox(shape)
+            let handle = vulpes_shape_cache_create({ context, font, size, bytes, len, glyphs, advances, capacity in
+                guard let context, let bytes, let glyphs, let advances else { return 0 }
+                let box = Unmanaged<ShapeBox>.fromOpaque(context).takeUnretainedValue()
+                let word = box.shape(Int(font), size, UnsafeBufferPointer(start: bytes, count: len))
+                let count = min(word.glyphs.count, word.advances.count)
+                for i in 0..<min(count, capacity) {
+                    glyphs[i] = word.glyphs[i]
+                    advances[i] = word.advances[i]
+                }
+                return count
+            }, Unmanaged.passUnretained(box).toOpaque())
+            guard let handle else { return nil }
+            self.handle = handle
+            self.box = box
+        }
+
+        deinit {
+            vulpes_shape_cache_destroy(handle)
+        }
+
+        /// The word as shaped in a style at an em size, shaping it on a miss
+        func word(_ utf8: ArraySlice<UInt8>, font: Int, size: Float) -> Word {
+            utf8.withUnsafeBufferPointer { buffer in
+                guard let baseAddress = buffer.baseAddress else { return Word(glyphs: [], advances: []) }
+                let shaped = vulpes_shape_cache_lookup(handle, UInt8(font), size, baseAddress, buffer.count)
+                guard shaped.count > 0, let glyphs = shaped.glyphs, let advances = shaped.advances else {
+                    return Word(glyphs: [], advances: [])
+                }
+                return Word(
+                    glyphs: Array(UnsafeBufferPointer(start: glyphs, count: shaped.count)),
+                    advances: Array(UnsafeBufferPointer(start: advances, count: shaped.count))
+                )
+            }
+        }
+    }
+
+    // MARK: - Text Layout
+
+    /// Line boxes, glyph runs and image boxes for one page's extracted text.
+    /// Every span is measured once, through the shape cache, while the
+    /// layout is built; resize only breaks lines again.
+    final class TextLayout {
+        struct Options {
+            var width: Float
+            var margin: Float
+            var quoteIndent: Float
+            var maxLineWidth: Float  // 0 for the whole viewport
+            var maxImageWidth: Float
+            var optimalBreaking: Bool  // total fit rather than greedy
+            var hyphenate: Bool  // break long English words at hyphenation points
+            var fonts: [vulpes_font_metrics_t]  // vulpes_font_t order
+            var images: [vulpes_layout_image_t]  // one per image table entry
+        }
+
+        private let handle: OpaquePointer
+
+        /// The laid-out text; runs are byte ranges into it
+        let utf8: [UInt8]
+
+        /// Lay out text as returned by extract (Links/Images trailer ignored)
+        init?(text: String, options: Options, shapes: ShapeCache) {
+            guard options.fonts.count == Int(VULPES_FONT_COUNT.rawValue) else { return nil }
+            let f = options.fonts
+            var text = text
+
+            let handle = options.images.withUnsafeBufferPointer { imageBuffer in
+                var cOptions = vulpes_layout_options_t(
+                    width: options.width,
+                    margin: options.margin,
+                    quote_indent: options.quoteIndent,
+                    max_line_width: options.maxLineWidth,
+                    max_image_width: options.maxImageWidth,
+                    line_breaking: UInt8((options.optimalBreaking ? VULPES_BREAK_OPTIMAL : VULPES_BREAK_GREEDY).rawValue),
+                    hyphenate: options.hyphenate ? 1 : 0,
+                    fonts: (f[0], f[1], f[2], f[3], f[4], f[5]),
+                    measure: nil,
+                    measure_context: nil,
+                    shape_cache: shapes.handle,
+                    images: imageBuffer.baseAddress,
+                    image_count: imageBuffer.count
+                )
+                return text.withUTF8 { buffer -> OpaquePointer? in
+                    guard let baseAddress = buffer.baseAddress else { return nil }
+                    return withExtendedLifetime(shapes) { vulpes_layout(baseAddress, buffer.count, &cOptions) }
+                }
+            }
+            guard let handle else { return nil }
+            self.handle = handle
+            self.utf8 = Array(text.utf8)
+        }
+
+        deinit {
+            vulpes_layout_destroy(handle)
+        }
+
+        /// Break lines again for a new viewport width or readable-width cap
+        @discardableResult
+        func resize(width: Float, maxLineWidth: Float) -> Bool {
+            vulpes_layout_resize(handle, width, maxLineWidth) == 0
+        }
+
+        /// Current boxes; the buffers are valid until the next resize
+        var boxes: vulpes_layout_boxes_t { vulpes_layout_boxes(handle) }
+
+        var lines: UnsafeBufferPointer<vulpes_line_box_t> {
+            let b = boxes
+            return UnsafeBufferPointer(start: b.lines, count: b.line_count)
+        }
+
+        var runs: UnsafeBufferPointer<vulpes_glyph_run_t> {
+            let b = boxes
+            return UnsafeBufferPointer(start: b.runs, count: b.run_count)
+        }
+
+        var images: UnsafeBufferPointer<vulpes_image_box_t> {
+            let b = boxes
+            return UnsafeBufferPointer(start: b.images, count: b.image_count)
+        }
+
+        var height: Float { boxes.height }
+
+        /// Boxes meeting [top - overscan, bottom + overscan), as index ranges
+        func visible(top: Float, bottom: Float, overscan: Float) -> vulpes_layout_range_t {
+            vulpes_layout_visible(handle, top, bottom, overscan)
+        }
+    }
+
+    // MARK: - Text Segmentation
+
+    /// End of the grapheme cluster starting at a UTF-8 offset: the next
+    /// place a cursor may stop, or bytes.count at the end
+    static func nextGrapheme(_ bytes: [UInt8], from offset: Int) -> Int {
+        bytes.withUnsafeBufferPointer { buffer in
+            guard let baseAddress = buffer.baseAddress else { return 0 }
+            return Int(vulpes_next_grapheme(baseAddress, buffer.count, offset))
+        }
+    }
+
+    /// The grapheme cluster containing a UTF-8 offset of text
+    static func graphemeRange(in text: String, at offset: Int) -> Range<String.Index>? {
+        span(in: text, at: offset, vulpes_grapheme_at)
+    }
+
+    /// The word containing a UTF-8 offset of text, or the run of spaces or
+    /// punctuation there: what a double click selects
+    static func wordRange(in text: String, at offset: Int) -> Range<String.Index>? {
+        span(in: text, at: offset, vulpes_word_at)
+    }
+
+    private static func span(
+        in text: String, at offset: Int,
+        _ find: (UnsafePointer<UInt8>, Int, Int) -> vulpes_span_t
+    ) -> Range<String.Index>? {
+        var text = text
+        let span = text.withUTF8 { buffer -> vulpes_span_t? in
+            guard let baseAddress = buffer.baseAddress else { return nil }
+            return find(baseAddress, buffer.count, offset)
+        }
+        guard let span, span.start < span.end else { return nil }
+        let utf8 = text.utf8
+        let start = utf8.index(utf8.startIndex, offsetBy: Int(span.start))
+        let end = utf8.index(utf8.startIndex, offsetBy: Int(span.end))
+        return start..<end
+    }
+
+    // MARK: - Reload Diff
+
+    /// Lines that changed between two loads of the same URL
+    struct ReloadHunk {
+        let oldLines: Range<Int>
+        let newLines: Range<Int>
+        let newBytes: Range<Int>  // UTF-8 offsets into the new text
+    }
+
+    /// A load compared with the previous load of the same URL
+    struct ReloadDiff {
+        let hadPrevious: Bool
+        let hunks: [ReloadHunk]
+
+        var isUnchanged: Bool { hadPrevious && hunks.isEmpty }
+    }
+
+    /// Record extracted text for a URL and diff it against the last load.
+    /// - Parameters:
+    ///   - url: Page URL (the engine keeps one entry per URL)
+    ///   - text: Extracted text, as returned by extract
+    /// - Returns: Changed line ranges, or nil on failure
+    func diffReload(url: String, text: String) -> ReloadDiff? {
+        var text = text
+        let result = text.withUTF8 { buffer -> UnsafeMutablePointer<vulpes_diff_result_t>? in
+            guard let baseAddress = buffer.baseAddress else { return nil }
+            return vulpes_diff_update(url, baseAddress, buffer.count)
+        }
+        guard let result else { return nil }
+        defer { vulpes_diff_free(result) }
+
+        guard result.pointee.error_code == 0 else {
+            NSLog("VulpesBridge: diffReload error: \(result.pointee.error_code)")
+            return nil
+        }
+
+        var hunks: [ReloadHunk] = []
+        if let entries = result.pointee.hunks {
+            hunks = (0..<result.pointee.hunk_count).map { i in
+                let hunk = entries[i]
+                return ReloadHunk(
+                    oldLines: Int(hunk.old_start)..<Int(hunk.old_start + hunk.old_count),
+                    newLines: Int(hunk.new_start)..<Int(hunk.new_start + hunk.new_count),
+                    newBytes: Int(hunk.new_byte_start)..<Int(hunk.new_byte_end)
+                )
+            }
+        }
+        return ReloadDiff(hadPrevious: result.pointee.had_previous, hunks: hunks)
+    }
+
+    /// Drop the text recorded for a URL, so its next load is not a reload
+    /// of it: for when something else, like an error page, is shown instead
+    func forgetReload(url: String) {
+        vulpes_diff_forget(url)
+    }
+
     // MARK: - Combined Fetch + Extract
 
     /// Fetch a URL and extract visible text from the HTML response.
@@ -159,6 +575,64 @@ class VulpesBridge {
         return text
     }
 
+    // MARK: - Feeds
+
+    /// One RSS/Atom entry
+    struct FeedEntry {
+        let title: String
+        let link: String
+        let date: Date?
+        let summary: String  // extracted text, same format as extractText
+    }
+
+    /// Parse an RSS/Atom document. The engine streams entries in fixed memory;
+    /// data is pushed in chunks so large feeds are never copied whole.
+    /// - Parameter data: Raw feed bytes
+    /// - Returns: Entries in document order
+    func parseFeed(from data: Data) -> [FeedEntry] {
+        let collector = FeedCollector()
+        let context = Unmanaged.passUnretained(collector).toOpaque()
+
+        guard let parser = vulpes_feed_create({ entryPtr, context in
+            guard let context else { return }
+            let collector = Unmanaged<FeedCollector>.fromOpaque(context).takeUnretainedValue()
+            let entry = entryPtr.pointee
+
+            func string(_ ptr: UnsafePointer<UInt8>?, _ len: Int) -> String {
+                guard let ptr else { return "" }
+                return String(decoding: UnsafeBufferPointer(start: ptr, count: len), as: UTF8.self)
+            }
+
+            collector.entries.append(FeedEntry(
+                title: string(entry.title, entry.title_len),
+                link: string(entry.link, entry.link_len),
+                date: entry.has_timestamp ? Date(timeIntervalSince1970: TimeInterval(entry.timestamp)) : nil,
+                summary: string(entry.summary, entry.summary_len)
+            ))
+        }, context) else {
+            NSLog("VulpesBridge: parseFeed - parser allocation failed")
+            return []
+        }
+        defer { vulpes_feed_destroy(parser) }
+
+        let chunkSize = 64 * 1024
+        data.withUnsafeBytes { ptr in
+            guard let base = ptr.baseAddress?.assumingMemoryBound(to: UInt8.self) else { return }
+            var offset = 0
+            while offset < data.count {
+                let len = min(chunkSize, data.count - offset)
+                if vulpes_feed_push(parser, base + offset, len) != 0 {
+                    NSLog("VulpesBridge: parseFeed - push failed at \(offset)")
+                    return
+                }
+                offset += len
+            }
+        }
+        _ = vulpes_feed_finish(parser)
+
+        return collector.entries
+    }
+
     /// Get human-readable HTTP status message
     private func httpStatusMessage(_ status: Int) -> String {
         switch status {
@@ -185,3 +659,17 @@ class VulpesBridge {
         }
     }
 }
+
+/// Accumulates entries delivered through the C feed callback
+private final class FeedCollector {
+    var entries: [VulpesBridge.FeedEntry] = []
+}
+
+/// Carries the shaping closure through the C shape cache callback
+private final class ShapeBox {
+    let shape: VulpesBridge.ShapeCache.Shape
+
+    init(_ shape: @escaping VulpesBridge.ShapeCache.Shape) {
+        self.shape = shape
+    }
+}
@@ -24,6 +24,8 @@ class VulpesConfig {
     var linkColor: (r: Float, g: Float, b: Float) = (0.4, 0.6, 1.0)
     var fontSize: Float = 16.0
     var readableLineWidth: Float = 82.0
+    var optimalLineBreaking: Bool = false
+    var hyphenate: Bool = false
 
     // Shader settings
     var shaderPath: String? = nil  // Path to custom GLSL post-process shader
@@ -105,6 +107,12 @@ class VulpesConfig {
         # Target readable line width (approx characters)
         # Set to 0 to disable and use full window width
         readable_line_width = 82
+        # Break paragraphs for the most even lines (Knuth-Plass) rather than
+        # filling each line in turn; evens out ragged narrow columns
+        # optimal_line_breaking = false
+        # Break long words at their hyphenation points (English), so narrow
+        # columns leave less room at line ends
+        # hyphenate = false
 
         # OpenRouter (one-word tab titles)
         # openrouter_enabled = false
@@ -199,6 +207,12 @@ class VulpesConfig {
         case "readable_line_width":
             readableLineWidth = Float(value) ?? readableLineWidth
 
+        case "optimal_line_breaking":
+            optimalLineBreaking = parseBool(value)
+
+        case "hyphenate":
+            hyphenate = parseBool(value)
+
         case "text_color":
             if let color = parseColor(value) {
                 textColor = color
@@ -9,6 +9,8 @@
 //! Usage:
 //!   zig build              # Build the library
 //!   zig build -Doptimize=ReleaseSafe  # Build optimized
+//!   zig build bench        # Extraction throughput benchmarks
+//!   zig build run -Dinstrument=true -- URL  # Per-stage extraction counters
 //!
 //! Note: This uses Zig 0.15+ build API with addLibrary() instead of
 //! the deprecated addStaticLibrary().
@@ -28,6 +30,12 @@ pub fn build(b: *std.Build) void {
 
     const optimize = b.standardOptimizeOption(.{});
 
+    // Per-stage extraction counters (src/html/stats.zig). Off by default;
+    // when off the counters compile to nothing.
+    const instrument = b.option(bool, "instrument", "Count extraction work per stage") orelse false;
+    const build_options = b.addOptions();
+    build_options.addOption(bool, "instrument", instrument);
+
     // =========================================================================
     // Static Library: libvulpes
     // =========================================================================
@@ -47,6 +55,7 @@ pub fn build(b: *std.Build) void {
             .link_libc = true,
         }),
     });
+    lib.root_module.addOptions("build_options", build_options);
 
     // =========================================================================
     // macOS Framework Linking
@@ -85,6 +94,7 @@ pub fn build(b: *std.Build) void {
             .optimize = optimize,
         }),
     });
+    exe.root_module.addOptions("build_options", build_options);
 
     b.installArtifact(exe);
 
@@ -109,8 +119,28 @@ pub fn build(b: *std.Build) void {
             .optimize = optimize,
         }),
     });
+    lib_unit_tests.root_module.addOptions("build_options", build_options);
 
     const run_lib_unit_tests = b.addRunArtifact(lib_unit_tests);
     const test_step = b.step("test", "Run unit tests");
     test_step.dependOn(&run_lib_unit_tests.step);
+
+    // =========================================================================
+    // Benchmarks
+    // =========================================================================
+    // Run with: zig build bench
+    // Defaults to ReleaseFast; pass -Doptimize to measure another mode.
+    const bench = b.addExecutable(.{
+        .name = "vulpes-bench",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("src/bench.zig"),
+            .target = target,
+            .optimize = if (optimize == .Debug) .ReleaseFast else optimize,
+        }),
+    });
+    bench.root_module.addOptions("build_options", build_options);
+
+    const run_bench = b.addRunArtifact(bench);
+    const bench_step = b.step("bench", "Run extraction benchmarks");
+    bench_step.dependOn(&run_bench.step);
 }
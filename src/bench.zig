@@ -0,0 +1,745 @@
+//! Vulpes Browser - Extraction Benchmarks
+//!
+//! Throughput of the HTML extraction pipeline and the CSS parser over
+//! synthetic corpora, and per-element cost of matching and the cascade
+//! with its style-sharing hit rate, and line breaking, segmentation,
+//! hyphenation and layout of the extracted text, greedy and total-fit,
+//! measured directly or through the shaped-word cache.
+//! Pages are generated in memory so runs are repeatable without network.
+//! Usage: zig build bench            (builds ReleaseFast by default)
+
+const std = @import("std");
+const text_extractor = @import("html/text_extractor.zig");
+const markdown = @import("html/markdown.zig");
+const feed = @import("feed/feed.zig");
+const search = @import("search/index.zig");
+const css = @import("css/parser.zig");
+const matcher = @import("css/matcher.zig");
+const cascade = @import("css/cascade.zig");
+const sheet_cache = @import("css/sheet_cache.zig");
+const media = @import("css/media.zig");
+const dom = @import("html/dom.zig");
+const layout = @import("layout/layout.zig");
+const metrics = @import("layout/metrics.zig");
+const linebreak = @import("layout/linebreak.zig");
+const segment = @import("layout/segment.zig");
+const hyphenation = @import("layout/hyphenation.zig");
+const shape_cache = @import("layout/shape_cache.zig");
+
+/// Target corpus size per case
+const CORPUS_BYTES = 4 * 1024 * 1024;
+
+/// Timed passes per case; the fastest is reported
+const ITERATIONS = 10;
+
+/// Network-sized chunks for the streaming feed parser
+const FEED_CHUNK = 16 * 1024;
+
+/// Text laid out for the window-drag benchmark, and the width change
+/// per resize
+const DRAG_BYTES = 1024 * 1024;
+const DRAG_STEP = 4;
+
+/// Readable-width cap for the raggedness comparison: about 40 characters
+const NARROW_MEASURE = 320;
+
+/// Screens looked up per pass of the visible-range benchmark
+const VISIBLE_QUERIES = 1000;
+
+/// Mixed-script paragraph repeated for the line-breaking benchmark:
+/// ideographs, kana, Hangul, a URL and a hyphenated word
+const MIXED_TEXT = "日本語のテキストは、単語の間に空白がありません。" ++
+    "See https://example.com/docs/line-breaking for a well-known case. " ++
+    "한국어 문장은 띄어쓰기를 합니다. ";
+
+const Case = struct {
+    name: []const u8,
+    html: []const u8,
+};
+
+/// An output mode under test
+const Output = enum {
+    text,
+    markdown,
+
+    fn run(self: Output, allocator: std.mem.Allocator, html: []const u8) !void {
+        switch (self) {
+            .text => {
+                const extraction = try text_extractor.extract(allocator, html, .{});
+                extraction.deinit(allocator);
+            },
+            .markdown => allocator.free(try markdown.extractMarkdown(allocator, html)),
+        }
+    }
+};
+
+pub fn main() !void {
+    const allocator = std.heap.page_allocator;
+
+    const prose = try buildCorpus(allocator, proseChunk);
+    defer allocator.free(prose);
+    const tables = try buildCorpus(allocator, tableChunk);
+    defer allocator.free(tables);
+    const spacey = try buildCorpus(allocator, whitespaceChunk);
+    defer allocator.free(spacey);
+    const minified = try buildCorpus(allocator, minifiedChunk);
+    defer allocator.free(minified);
+    const pretty = try buildCorpus(allocator, prettyChunk);
+    defer allocator.free(pretty);
+    const commented = try buildCorpus(allocator, commentChunk);
+    defer allocator.free(commented);
+    const broken = try buildCorpus(allocator, brokenCommentChunk);
+    defer allocator.free(broken);
+
+    const cases = [_]Case{
+        .{ .name = "prose", .html = prose },
+        .{ .name = "table-heavy", .html = tables },
+        .{ .name = "whitespace", .html = spacey },
+        .{ .name = "minified", .html = minified },
+        .{ .name = "pretty-printed", .html = pretty },
+        .{ .name = "comment-heavy", .html = commented },
+        .{ .name = "broken-comment", .html = broken },
+    };
+
+    std.debug.print("{s:<16} {s:<10} {s:>10} {s:>10} {s:>10}\n", .{ "case", "output", "bytes", "best ms", "MB/s" });
+    for (cases) |case| {
+        for ([_]Output{ .text, .markdown }) |output| {
+            report(case.name, @tagName(output), case.html.len, try timeRun(allocator, output, case.html));
+        }
+    }
+
+    // Find-in-page over the prose page's extracted text
+    const page = try text_extractor.extractText(allocator, prose);
+    defer allocator.free(page);
+    const body = page[0..text_extractor.bodyLength(page)];
+    report("search", "index", body.len, try timeIndex(allocator, body));
+    const index = try search.Index.build(allocator, body);
+    defer index.deinit(allocator);
+    report("search", "find", body.len, try timeFind(allocator, index, "lazy dog"));
+
+    // Break opportunities alone: ASCII through the fast path, then mixed
+    // scripts through the two-stage tables
+    report("linebreak", "ascii", body.len, try timeLineBreak(body));
+    const mixed = try buildMixedText(allocator);
+    defer allocator.free(mixed);
+    report("linebreak", "mixed", mixed.len, try timeLineBreak(mixed));
+    report("segment", "ascii", body.len, try timeSegment(body));
+    report("segment", "mixed", mixed.len, try timeSegment(mixed));
+
+    // Hyphenating every word: the patterns each time, then through the
+    // per-word cache
+    report("hyphenate", "patterns", body.len, try timeHyphenate(allocator, body, false));
+    report("hyphenate", "cached", body.len, try timeHyphenate(allocator, body, true));
+
+    // Line layout of the same text: measuring and breaking, then breaking alone
+    report("layout", "build", body.len, try timeLayout(allocator, body));
+    var text_layout = try layout.Layout.init(allocator, body, &metrics.synthetic, .{});
+    defer text_layout.deinit();
+    report("layout", "reflow", body.len, try timeReflow(&text_layout));
+
+    // The same layout measured through the shaped-word cache: a new cache
+    // each pass, then one kept across passes as the app keeps it
+    report("layout", "shape cold", body.len, (try timeShapedLayout(allocator, body, false))[0]);
+    const warm_ns, const hit_rate = try timeShapedLayout(allocator, body, true);
+    report("layout", "shape warm", body.len, warm_ns);
+    std.debug.print("{s:<16} {s:<10} {d:>10.1} % of words found in the cache\n", .{ "layout", "shape", hit_rate * 100 });
+
+    // Total-fit breaking of the same text, and how ragged each leaves a
+    // narrow readable column, also with hyphenation
+    var optimal = try layout.Layout.init(allocator, body, &metrics.synthetic, .{ .breaking = .optimal });
+    defer optimal.deinit();
+    report("layout", "reflow opt", body.len, try timeReflow(&optimal));
+    var hyphenated = try layout.Layout.init(allocator, body, &metrics.synthetic, .{ .breaking = .optimal, .hyphenate = true });
+    defer hyphenated.deinit();
+    for ([_]*layout.Layout{ &text_layout, &optimal, &hyphenated }, [_][]const u8{ "greedy", "optimal", "opt hyph" }) |measured, name| {
+        try measured.resize(1024, NARROW_MEASURE);
+        std.debug.print("{s:<16} {s:<10} {d:>10.1} rms room at line ends\n", .{ "layout", name, raggedness(measured) });
+    }
+
+    // Dragging the window edge over a 1 MB page: one resize per step
+    var dragged = try layout.Layout.init(allocator, body[0..@min(body.len, DRAG_BYTES)], &metrics.synthetic, .{});
+    defer dragged.deinit();
+    const drag_ns, const reflowed = try timeDrag(&dragged);
+    report("layout", "drag step", @min(body.len, DRAG_BYTES), drag_ns);
+    std.debug.print("{s:<16} {s:<10} {d:>10.1} % of {d} blocks re-broken per step\n", .{ "layout", "drag", reflowed * 100, dragged.blocks.items.len });
+    reportPerElement("layout", "visible", VISIBLE_QUERIES, try timeVisible(&dragged));
+
+    const rss = try buildFeed(allocator);
+    defer allocator.free(rss);
+    report("rss", "entries", rss.len, try timeFeed(allocator, rss));
+
+    const stylesheet = try buildStylesheet(allocator);
+    defer allocator.free(stylesheet);
+    report("framework-css", "rules", stylesheet.len, try timeStylesheet(allocator, stylesheet));
+
+    const utilities = try buildUtilityStylesheet(allocator);
+    defer allocator.free(utilities);
+    report("utility-css", "rules", utilities.len, try timeStylesheet(allocator, utilities));
+
+    // Selector matching, per element, against each stylesheet
+    const components = try buildCorpus(allocator, componentChunk);
+    defer allocator.free(components);
+    const doc = try dom.parse(allocator, components);
+    defer doc.deinit();
+
+    var user_agent = try cascade.UserAgent.init(allocator);
+    defer user_agent.deinit();
+    const style_cases = [_]Case{
+        .{ .name = "framework-css", .html = stylesheet },
+        .{ .name = "utility-css", .html = utilities },
+    };
+    var style_stats: [style_cases.len]cascade.Stats = undefined;
+
+    std.debug.print("\n{s:<16} {s:<10} {s:>10} {s:>10} {s:>10}\n", .{ "stylesheet", "stage", "elements", "best ms", "ns/elem" });
+    for (style_cases, 0..) |case, case_index| {
+        const sheet = try css.parse(allocator, case.html);
+        defer sheet.deinit();
+        var timer = try std.time.Timer.start();
+        var index = try matcher.RuleIndex.build(allocator, &sheet);
+        defer index.deinit();
+        reportPerElement(case.name, "index", sheet.rules.len, timer.read());
+        const image = try sheet_cache.compile(allocator, sheet_cache.Key.of(case.name, case.html), case.html);
+        defer allocator.free(image);
+        reportPerElement(case.name, "adopt", sheet.rules.len, try timeAdopt(allocator, image));
+        var view = try media.ViewportIndex.init(allocator, &sheet, &index, .{});
+        defer view.deinit();
+        reportPerElement(case.name, "breakpoint", sheet.rules.len, try timeBreakpoint(&view));
+        reportPerElement(case.name, "match", doc.elements.len, try timeMatch(allocator, &view.index, &doc));
+
+        const sheets = [_]cascade.Sheet{ user_agent.sheet(), view.sheet() };
+        const styled_ns, const sharing = try timeCascade(allocator, &doc, &sheets);
+        reportPerElement(case.name, "cascade", doc.elements.len, styled_ns);
+        style_stats[case_index] = sharing;
+    }
+
+    // Style sharing: how many elements skipped matching, and what
+    // interning saved over a style per element
+    std.debug.print("\n{s:<16} {s:>10} {s:>10} {s:>10} {s:>10} {s:>12}\n", .{ "stylesheet", "siblings", "cousins", "hit %", "styles", "bytes saved" });
+    for (style_cases, style_stats) |case, sharing| {
+        std.debug.print("{s:<16} {d:>10} {d:>10} {d:>10.1} {d:>10} {d:>12}\n", .{
+            case.name,
+            sharing.sibling_hits,
+            sharing.cousin_hits,
+            sharing.hitRate() * 100,
+            sharing.unique_styles,
+            sharing.bytesSaved(),
+        });
+    }
+}
+
+fn reportPerElement(case: []const u8, stage: []const u8, count: usize, best_ns: u64) void {
+    std.debug.print("{s:<16} {s:<10} {d:>10} {d:>10.2} {d:>10.1}\n", .{
+        case,
+        stage,
+        count,
+        @as(f64, @floatFromInt(best_ns)) / std.time.ns_per_ms,
+        @as(f64, @floatFromInt(best_ns)) / @as(f64, @floatFromInt(@max(count, 1))),
+    });
+}
+
+fn report(case: []const u8, output: []const u8, bytes: usize, best_ns: u64) void {
+    const seconds = @as(f64, @floatFromInt(best_ns)) / std.time.ns_per_s;
+    const mb = @as(f64, @floatFromInt(bytes)) / (1024.0 * 1024.0);
+    std.debug.print("{s:<16} {s:<10} {d:>10} {d:>10.2} {d:>10.1}\n", .{
+        case,
+        output,
+        bytes,
+        @as(f64, @floatFromInt(best_ns)) / std.time.ns_per_ms,
+        mb / seconds,
+    });
+}
+
+/// Fastest of ITERATIONS full runs, in nanoseconds. Includes freeing the
+/// output, which is part of the cost a caller pays.
+fn timeRun(allocator: std.mem.Allocator, output: Output, html: []const u8) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        try output.run(allocator, html);
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS index builds over extracted text.
+fn timeIndex(allocator: std.mem.Allocator, text: []const u8) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        const index = try search.Index.build(allocator, text);
+        index.deinit(allocator);
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS finds, each returning every match in order.
+/// MB/s here is the scan rate the index replaces.
+fn timeFind(allocator: std.mem.Allocator, index: search.Index, query: []const u8) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        allocator.free(try index.find(allocator, query));
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS layouts from scratch, with synthetic metrics.
+fn timeLayout(allocator: std.mem.Allocator, text: []const u8) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        var text_layout = try layout.Layout.init(allocator, text, &metrics.synthetic, .{});
+        text_layout.deinit();
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS layouts measured through a shape cache, new for
+/// each pass or kept across them, and the share of lookups it answered.
+fn timeShapedLayout(allocator: std.mem.Allocator, text: []const u8, keep: bool) !struct { u64, f64 } {
+    var cache = shape_cache.ShapeCache.init(allocator, shapeSynthetic, null);
+    defer cache.deinit();
+    const measurer: shape_cache.Measurer = .{ .cache = &cache, .fonts = metrics.synthetic.fonts };
+    const cached = measurer.asMetrics();
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        if (!keep) cache.clear();
+        var timer = try std.time.Timer.start();
+        var text_layout = try layout.Layout.init(allocator, text, &cached, .{});
+        text_layout.deinit();
+        best = @min(best, timer.read());
+    }
+    const lookups = cache.stats.hits + cache.stats.misses;
+    return .{ best, @as(f64, @floatFromInt(cache.stats.hits)) / @as(f64, @floatFromInt(@max(lookups, 1))) };
+}
+
+/// A glyph per code point, half an em wide, as the synthetic metrics
+fn shapeSynthetic(_: ?*anyopaque, _: metrics.Font, size: f32, text: []const u8, glyphs: []u16, advances: []f32) usize {
+    var count: usize = 0;
+    var i: usize = 0;
+    while (i < text.len) : (count += 1) {
+        if (count < glyphs.len) {
+            glyphs[count] = text[i];
+            advances[count] = size / 2;
+        }
+        i += std.unicode.utf8ByteSequenceLength(text[i]) catch 1;
+    }
+    return count;
+}
+
+/// Fastest of ITERATIONS reflows, alternating between two widths so each
+/// one moves every line break.
+fn timeReflow(text_layout: *layout.Layout) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |i| {
+        const width: f32 = if (i % 2 == 0) 800 else 1024;
+        var timer = try std.time.Timer.start();
+        try text_layout.resize(width, 0);
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Root mean square of the room left at the right of each paragraph line
+/// but the last: what total-fit breaking minimises.
+fn raggedness(text_layout: *const layout.Layout) f64 {
+    const right = text_layout.options.margin + text_layout.options.max_line_width;
+    const lines = text_layout.lines.items;
+    const runs = text_layout.runs.items;
+    var sum: f64 = 0;
+    var count: usize = 0;
+    for (text_layout.blocks.items) |block| {
+        if (block.kind != .text or block.depth > 0 or block.line_count < 2) continue;
+        for (lines[block.first_line..][0 .. block.line_count - 1]) |line| {
+            if (line.run_count == 0) continue;
+            const last = runs[line.first_run + line.run_count - 1];
+            var room: f64 = right - (last.x + last.width);
+            if (last.flags.hyphen) room -= metrics.synthetic.measure(last.font, "-");
+            sum += room * room;
+            count += 1;
+        }
+    }
+    return @sqrt(sum / @as(f64, @floatFromInt(@max(count, 1))));
+}
+
+/// Fastest of ITERATIONS passes finding every break opportunity.
+fn timeLineBreak(text: []const u8) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    var count: usize = 0;
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        var iterator = linebreak.Iterator.init(text);
+        while (iterator.next()) |_| count += 1;
+        best = @min(best, timer.read());
+    }
+    std.mem.doNotOptimizeAway(count);
+    return best;
+}
+
+/// Fastest of ITERATIONS passes finding every cluster and word boundary.
+fn timeSegment(text: []const u8) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    var words: usize = 0;
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        var segmenter = segment.Segmenter.init(text);
+        while (segmenter.next()) |boundary| {
+            if (boundary.word) words += 1;
+        }
+        best = @min(best, timer.read());
+    }
+    std.mem.doNotOptimizeAway(words);
+    return best;
+}
+
+/// Fastest of ITERATIONS passes hyphenating every word of ASCII letters,
+/// through a Hyphenator kept across passes or by the patterns alone.
+fn timeHyphenate(allocator: std.mem.Allocator, text: []const u8, cached: bool) !u64 {
+    var hyphenator = hyphenation.Hyphenator.init(allocator);
+    defer hyphenator.deinit();
+    var best: u64 = std.math.maxInt(u64);
+    var points: usize = 0;
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        var i: usize = 0;
+        while (i < text.len) {
+            if (!std.ascii.isLower(text[i])) {
+                i += 1;
+                continue;
+            }
+            const start = i;
+            while (i < text.len and std.ascii.isLower(text[i])) i += 1;
+            const found = if (cached) try hyphenator.hyphenate(text[start..i]) else hyphenation.breakPoints(text[start..i]);
+            points += @popCount(found);
+        }
+        best = @min(best, timer.read());
+    }
+    std.mem.doNotOptimizeAway(points);
+    return best;
+}
+
+/// MIXED_TEXT repeated to CORPUS_BYTES / 4
+fn buildMixedText(allocator: std.mem.Allocator) ![]u8 {
+    var out: std.ArrayListUnmanaged(u8) = .empty;
+    errdefer out.deinit(allocator);
+    while (out.items.len < CORPUS_BYTES / 4) try out.appendSlice(allocator, MIXED_TEXT);
+    return out.toOwnedSlice(allocator);
+}
+
+/// Mean resize of the fastest of ITERATIONS drags from 1024 units down
+/// to 640 and back in DRAG_STEP steps, and the share of blocks each step
+/// broke again.
+fn timeDrag(text_layout: *layout.Layout) !struct { u64, f64 } {
+    const steps = 2 * (1024 - 640) / DRAG_STEP;
+    var best: u64 = std.math.maxInt(u64);
+    var reflowed: usize = 0;
+    for (0..ITERATIONS) |_| {
+        reflowed = 0;
+        var timer = try std.time.Timer.start();
+        for (0..steps) |step| {
+            const offset: f32 = @floatFromInt(@min(step, steps - step) * DRAG_STEP);
+            try text_layout.resize(1024 - offset, 0);
+            reflowed += text_layout.reflowed;
+        }
+        best = @min(best, timer.read() / steps);
+    }
+    const blocks: f64 = @floatFromInt(@max(text_layout.blocks.items.len, 1));
+    return .{ best, @as(f64, @floatFromInt(reflowed)) / steps / blocks };
+}
+
+/// Fastest of ITERATIONS passes of VISIBLE_QUERIES screen lookups spread
+/// down the page, as the view does when it scrolls out of its band.
+fn timeVisible(text_layout: *const layout.Layout) !u64 {
+    const screen: f32 = 800;
+    const stride = text_layout.height / VISIBLE_QUERIES;
+    var best: u64 = std.math.maxInt(u64);
+    var runs: usize = 0;
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        for (0..VISIBLE_QUERIES) |i| {
+            const top = stride * @as(f32, @floatFromInt(i));
+            runs += text_layout.visible(top, top + screen, screen).run_count;
+        }
+        best = @min(best, timer.read());
+    }
+    std.mem.doNotOptimizeAway(runs);
+    return best;
+}
+
+/// Fastest of ITERATIONS streaming parses, pushed in FEED_CHUNK pieces.
+fn timeFeed(allocator: std.mem.Allocator, rss: []const u8) !u64 {
+    const discard = struct {
+        fn onEntry(_: *const feed.Entry, _: ?*anyopaque) void {}
+    };
+
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        var parser = try feed.Parser.init(allocator, discard.onEntry, null);
+        defer parser.deinit();
+        var offset: usize = 0;
+        while (offset < rss.len) : (offset += FEED_CHUNK) {
+            try parser.push(rss[offset..@min(offset + FEED_CHUNK, rss.len)]);
+        }
+        try parser.finish();
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS stylesheet parses, arena release included.
+fn timeStylesheet(allocator: std.mem.Allocator, stylesheet: []const u8) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        const sheet = try css.parse(allocator, stylesheet);
+        sheet.deinit();
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS full-document matches: every element in order,
+/// as the cascade walks them.
+fn timeMatch(allocator: std.mem.Allocator, index: *const matcher.RuleIndex, doc: *const dom.Document) !u64 {
+    var matched: std.ArrayListUnmanaged(matcher.Match) = .empty;
+    defer matched.deinit(allocator);
+
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        var filter: matcher.AncestorFilter = .{};
+        defer filter.deinit(allocator);
+        for (0..doc.elements.len) |i| {
+            const element: dom.NodeId = @intCast(i);
+            try filter.enter(allocator, doc, element);
+            matched.clearRetainingCapacity();
+            try index.match(allocator, doc, &filter, element, &matched);
+        }
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS loads of a cached stylesheet image: what a page
+/// pays for a sheet it would otherwise parse and index.
+fn timeAdopt(allocator: std.mem.Allocator, image: []const u8) !u64 {
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        var loaded = try sheet_cache.load(allocator, image);
+        loaded.deinit();
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS window resizes across the common 768px and
+/// 1024px breakpoints, each re-filtering the index without a reparse.
+fn timeBreakpoint(view: *media.ViewportIndex) !u64 {
+    const restore = view.viewport;
+    defer _ = view.setViewport(restore) catch {};
+
+    var best: u64 = std.math.maxInt(u64);
+    for (0..ITERATIONS) |i| {
+        var timer = try std.time.Timer.start();
+        _ = try view.setViewport(.{ .width = if (i % 2 == 0) 700 else 1300 });
+        best = @min(best, timer.read());
+    }
+    return best;
+}
+
+/// Fastest of ITERATIONS full cascades with style sharing, and the
+/// sharing counters of the last run.
+fn timeCascade(allocator: std.mem.Allocator, doc: *const dom.Document, sheets: []const cascade.Sheet) !struct { u64, cascade.Stats } {
+    var best: u64 = std.math.maxInt(u64);
+    var sharing: cascade.Stats = .{};
+    for (0..ITERATIONS) |_| {
+        var timer = try std.time.Timer.start();
+        var styled = try cascade.cascade(allocator, doc, sheets);
+        best = @min(best, timer.read());
+        sharing = styled.stats;
+        styled.deinit(allocator);
+    }
+    return .{ best, sharing };
+}
+
+/// Tailwind-style stylesheet: thousands of single-class utilities with
+/// responsive, hover and group variants.
+fn buildUtilityStylesheet(allocator: std.mem.Allocator) ![]u8 {
+    var sheet: std.ArrayListUnmanaged(u8) = .empty;
+    errdefer sheet.deinit(allocator);
+
+    try sheet.appendSlice(allocator, "*,::before,::after{box-sizing:border-box;border:0 solid #e5e7eb}\n");
+    var n: usize = 0;
+    while (sheet.items.len < CORPUS_BYTES) : (n += 1) {
+        try sheet.print(allocator,
+            \\.mt-{d}{{margin-top:{d}px}}.px-{d}{{padding-left:{d}px;padding-right:{d}px}}.text-c{d}{{--tw-text-opacity:1;color:rgb({d} 64 175/var(--tw-text-opacity))}}
+            \\.hover\:text-c{d}:hover{{color:#1e40af}}.group:hover .group-hover\:c{d}{{opacity:.75}}.space-y-{d}>:not([hidden])~:not([hidden]){{margin-top:{d}px}}
+            \\@media (min-width:768px){{.md\:w-{d}{{width:{d}%}}}}
+            \\
+        , .{ n, n, n, n, n, n, n % 256, n, n, n, n, n, n % 100 });
+    }
+    return sheet.toOwnedSlice(allocator);
+}
+
+/// Component markup using classes from both generated stylesheets.
+fn componentChunk(html: *std.ArrayListUnmanaged(u8), allocator: std.mem.Allocator, n: usize) anyerror!void {
+    try html.print(allocator,
+        \\<div class="card-{d} mt-{d} px-4"><ul class="list-group"><li class="list-group-item">
+        \\<a class="btn-{d} text-c{d}" href="/c/{d}">Item</a></li><li class="list-group-item group">
+        \\<span class="group-hover:c{d}">Detail</span></li></ul><p class="col-md-{d} md:w-{d}">Text</p></div>
+        \\
+    , .{ n % 500, n % 64, n % 500, n % 64, n, n % 64, n % 500, n % 100 });
+}
+
+/// Bootstrap-style stylesheet: utility and component rules, responsive
+/// @media variants, and the @font-face/@keyframes/@supports blocks the
+/// parser skips.
+fn buildStylesheet(allocator: std.mem.Allocator) ![]u8 {
+    var sheet: std.ArrayListUnmanaged(u8) = .empty;
+    errdefer sheet.deinit(allocator);
+
+    try sheet.appendSlice(allocator,
+        \\@charset "UTF-8";
+        \\/*! Framework v5 | MIT License */
+        \\:root{--bs-blue:#0d6efd;--bs-font-sans-serif:system-ui,-apple-system,"Segoe UI",Roboto,sans-serif}
+        \\@font-face{font-family:"Icons";src:url("icons.woff2?v=1") format("woff2"),url(icons.woff) format("woff")}
+        \\
+    );
+    var n: usize = 0;
+    while (sheet.items.len < CORPUS_BYTES) : (n += 1) {
+        try sheet.print(allocator,
+            \\.btn-{d}{{display:inline-block;padding:.375rem .75rem;font-size:1rem;line-height:1.5;color:#212529;border:1px solid transparent;border-radius:.25rem;transition:color .15s ease-in-out,background-color .15s ease-in-out}}
+            \\.btn-{d}:hover,.btn-{d}:focus-visible{{color:#fff;background-color:var(--bs-blue);box-shadow:0 0 0 .25rem rgba(13,110,253,.5)!important}}
+            \\.card-{d} > .list-group:first-child .list-group-item:first-child{{border-top-left-radius:calc(.25rem - 1px)}}
+            \\/* responsive variants */
+            \\@media (min-width:768px){{.col-md-{d}{{flex:0 0 auto;width:{d}%}}.d-md-{d}{{display:none!important}}}}
+            \\@keyframes spin-{d}{{from{{transform:rotate(0)}}to{{transform:rotate(360deg)}}}}
+            \\@supports (position:sticky){{.sticky-{d}{{position:sticky;top:0;z-index:1020}}}}
+            \\
+        , .{ n, n, n, n, n, n % 100, n, n, n });
+    }
+    return sheet.toOwnedSlice(allocator);
+}
+
+/// RSS 2.0 document with escaped-HTML descriptions, as blogs publish.
+fn buildFeed(allocator: std.mem.Allocator) ![]u8 {
+    var rss: std.ArrayListUnmanaged(u8) = .empty;
+    errdefer rss.deinit(allocator);
+
+    try rss.appendSlice(allocator, "<?xml version=\"1.0\"?>\n<rss version=\"2.0\"><channel><title>Bench</title>\n");
+    var n: usize = 0;
+    while (rss.items.len < CORPUS_BYTES) : (n += 1) {
+        try rss.print(allocator,
+            \\<item><title>Post {d} &amp; notes</title><link>https://example.com/{d}</link>
+            \\<pubDate>Tue, 05 Mar 2024 14:30:00 GMT</pubDate>
+            \\<description>&lt;p&gt;The quick brown fox &lt;em&gt;jumps&lt;/em&gt; over the
+            \\lazy dog, &lt;a href="/x/{d}"&gt;read more&lt;/a&gt;.&lt;/p&gt;</description></item>
+            \\
+        , .{ n, n, n });
+    }
+    try rss.appendSlice(allocator, "</channel></rss>\n");
+    return rss.toOwnedSlice(allocator);
+}
+
+/// Repeat a generated chunk until the corpus reaches CORPUS_BYTES.
+fn buildCorpus(allocator: std.mem.Allocator, comptime chunk: fn (*std.ArrayListUnmanaged(u8), std.mem.Allocator, usize) anyerror!void) ![]u8 {
+    var html: std.ArrayListUnmanaged(u8) = .empty;
+    errdefer html.deinit(allocator);
+
+    try html.appendSlice(allocator, "<!DOCTYPE html><html><head><title>Bench</title></head><body>\n");
+    var n: usize = 0;
+    while (html.items.len < CORPUS_BYTES) : (n += 1) {
+        try chunk(&html, allocator, n);
+    }
+    try html.appendSlice(allocator, "</body></html>\n");
+    return html.toOwnedSlice(allocator);
+}
+
+/// Article-style markup: headings, paragraphs with inline formatting and links.
+fn proseChunk(html: *std.ArrayListUnmanaged(u8), allocator: std.mem.Allocator, n: usize) anyerror!void {
+    try html.print(allocator,
+        \\<h2>Section {d}</h2>
+        \\<p>The quick brown fox jumps over the lazy dog. <em>Pack my box</em> with five dozen
+        \\liquor jugs &amp; <a href="/page/{d}">how vexingly quick</a> daft zebras jump.
+        \\<strong>Sphinx of black quartz</strong>, judge my vow.</p>
+        \\<ul><li>First point</li><li>Second point with <code>code</code></li></ul>
+        \\
+    , .{ n, n });
+}
+
+/// Docs/stats-style markup: a header row and numeric cells, as on data pages.
+fn tableChunk(html: *std.ArrayListUnmanaged(u8), allocator: std.mem.Allocator, n: usize) anyerror!void {
+    try html.print(allocator, "<h3>Table {d}</h3>\n<table><caption>Results {d}</caption>\n", .{ n, n });
+    try html.appendSlice(allocator, "<tr><th>Name</th><th>Type</th><th>Default</th><th>Description</th></tr>\n");
+    for (0..20) |row| {
+        try html.print(allocator,
+            \\<tr><td><code>option_{d}</code></td><td>u32</td><td>{d}</td><td><p>Controls item {d} of the
+            \\configuration &mdash; see <a href="#opt{d}">details</a>.</p></td></tr>
+            \\
+        , .{ row, row * 64, row, row });
+    }
+    try html.appendSlice(allocator, "</table>\n");
+}
+
+/// Template output with blank lines and ragged spacing inside text runs.
+fn whitespaceChunk(html: *std.ArrayListUnmanaged(u8), allocator: std.mem.Allocator, n: usize) anyerror!void {
+    try html.print(allocator, "<p>\n\n        Item   {d}   of   the   list,\n\n" ++
+        "\t   rendered \r\n  by   a   template   that   keeps\n" ++
+        "        every      line   break   and   tab\t \tit   was   given.\n\n</p>\n", .{n});
+}
+
+/// Minifier output: no whitespace between tags, long unbroken text runs.
+fn minifiedChunk(html: *std.ArrayListUnmanaged(u8), allocator: std.mem.Allocator, n: usize) anyerror!void {
+    try html.print(allocator, "<div class=\"c{d}\"><h3>Card {d}</h3><p>Thequickbrownfoxjumpsoverthelazydog,packmyboxwithfivedozenliquorjugs.<span>Sphinx of black quartz, judge my vow.</span><a href=\"/c/{d}\">More</a></p></div>", .{ n, n, n });
+}
+
+/// Framework-style output: one tag per line, indented by nesting depth.
+fn prettyChunk(html: *std.ArrayListUnmanaged(u8), allocator: std.mem.Allocator, n: usize) anyerror!void {
+    try html.print(allocator,
+        \\    <div class="section">
+        \\        <div class="row">
+        \\            <div class="column">
+        \\                <h3>
+        \\                    Heading {d}
+        \\                </h3>
+        \\                <p>
+        \\                    The quick brown fox jumps over the lazy dog.
+        \\                    <a href="/p/{d}">
+        \\                        Read more
+        \\                    </a>
+        \\                </p>
+        \\            </div>
+        \\        </div>
+        \\    </div>
+        \\
+    , .{ n, n });
+}
+
+/// CMS output: commented-out blocks full of '>' around a little live text.
+fn commentChunk(html: *std.ArrayListUnmanaged(u8), allocator: std.mem.Allocator, n: usize) anyerror!void {
+    try html.print(allocator,
+        \\<!-- ===== widget {d} ===== -->
+        \\<!--
+        \\<div class="sidebar"><ul><li><a href="/old/{d}">Archived</a></li><li>a -> b</li></ul></div>
+        \\<div class="sidebar"><ul><li><a href="/old/{d}">Archived</a></li><li>a -> b</li></ul></div>
+        \\<div class="sidebar"><ul><li><a href="/old/{d}">Archived</a></li><li>a -> b</li></ul></div>
+        \\-->
+        \\<p>Live paragraph {d}.</p><!--[if IE]><p>Upgrade</p><![endif]-->
+        \\
+    , .{ n, n, n, n, n });
+}
+
+/// Comments and CDATA sections that are never closed: each opener ends at
+/// the next '>', and no "-->" or "]]>" follows anywhere in the page.
+fn brokenCommentChunk(html: *std.ArrayListUnmanaged(u8), allocator: std.mem.Allocator, n: usize) anyerror!void {
+    try html.print(allocator,
+        \\<p>Entry {d}</p><!-- TODO: restore <div class="old">{d}</div>
+        \\<![CDATA[ a > b ]] <p>Still visible {d}.</p>
+        \\
+    , .{ n, n, n });
+}
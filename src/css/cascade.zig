@@ -0,0 +1,540 @@
+//! Vulpes Browser - Cascade and Style Sharing
+//!
+//! Computes the style of every element from the user-agent sheet, the
+//! page's sheets and style="" attributes, walking the element tree in
+//! document order so parents are styled before their children.
+//!
+//! Lists, tables and card grids repeat the same element thousands of
+//! times, so before matching an element the cascade looks through the
+//! last few styled elements for one whose style it can reuse outright.
+//! A candidate qualifies when:
+//!   - it has the same tag and classes, and neither has an id or a
+//!     style attribute;
+//!   - it is a sibling, or a cousin whose parent's style was itself
+//!     reused from this element's parent (so all ancestors agree on
+//!     tags, classes and ids);
+//!   - both match the same revalidation selectors of every sheet (see
+//!     RuleIndex.revalidate), which covers everything else a selector
+//!     can look at.
+//! A shared element skips rule matching and the cascade entirely.
+//!
+//! Computed styles are interned (see StyleStore), so each element holds
+//! a StyleId and a page of identical list items stores one style.
+//!
+//! Custom properties are resolved as part of each element's cascade into
+//! a variables.Scope shared with its parent unless it declares its own;
+//! var() in other declarations is substituted before they are applied.
+//!
+//! A sheet whose index was filtered for a viewport (RuleIndex.forMedia,
+//! as a media.ViewportIndex does) applies the @media rules it kept; any
+//! other sheet applies none.
+//!
+
+const std = @import("std");
+const dom = @import("../html/dom.zig");
+const parser = @import("parser.zig");
+const matcher = @import("matcher.zig");
+const style = @import("style.zig");
+const media = @import("media.zig");
+const variables = @import("variables.zig");
+
+const ComputedStyle = style.ComputedStyle;
+const StyleId = style.StyleId;
+
+/// Recently styled elements kept as sharing candidates
+const CACHE_SIZE = 16;
+
+/// Separates the revalidation results of consecutive sheets
+const SHEET_BREAK = std.math.maxInt(u32);
+
+/// A parsed stylesheet and its rule index, in cascade order
+pub const Sheet = struct {
+    stylesheet: *const parser.Stylesheet,
+    index: *const matcher.RuleIndex,
+};
+
+pub const user_agent_css =
+    \\html, body, div, p, ul, ol, dl, dt, dd, h1, h2, h3, h4, h5, h6, pre, blockquote,
+    \\address, article, aside, details, figure, figcaption, footer, form, header, hr,
+    \\main, nav, section, summary, table, tr, caption, fieldset, center { display: block }
+    \\td, th { display: table-cell }
+    \\li { display: list-item }
+    \\head, script, style, title, meta, link, template, noscript { display: none }
+    \\h1 { font-size: 2em; font-weight: bold }
+    \\h2 { font-size: 1.5em; font-weight: bold }
+    \\h3 { font-size: 1.17em; font-weight: bold }
+    \\h4 { font-weight: bold }
+    \\h5 { font-size: 0.83em; font-weight: bold }
+    \\h6 { font-size: 0.67em; font-weight: bold }
+    \\a:link { color: #0066cc; text-decoration: underline }
+    \\b, strong, th { font-weight: bold }
+    \\i, em, cite, var, dfn { font-style: italic }
+    \\u, ins { text-decoration: underline }
+    \\s, strike, del { text-decoration: line-through }
+    \\code, kbd, samp, tt, pre { font-family: monospace }
+    \\pre { white-space: pre }
+    \\th, center { text-align: center }
+    \\small { font-size: smaller }
+    \\big { font-size: larger }
+;
+
+/// The built-in sheet, parsed and indexed once
+pub const UserAgent = struct {
+    stylesheet: parser.Stylesheet,
+    index: matcher.RuleIndex,
+
+    pub fn init(allocator: std.mem.Allocator) !UserAgent {
+        const stylesheet = try parser.parse(allocator, user_agent_css);
+        errdefer stylesheet.deinit();
+        return .{ .stylesheet = stylesheet, .index = try matcher.RuleIndex.build(allocator, &stylesheet) };
+    }
+
+    pub fn deinit(self: *UserAgent) void {
+        self.index.deinit();
+        self.stylesheet.deinit();
+    }
+
+    pub fn sheet(self: *const UserAgent) Sheet {
+        return .{ .stylesheet = &self.stylesheet, .index = &self.index };
+    }
+};
+
+pub const Stats = struct {
+    elements: u64 = 0,
+    /// Styles reused from a sibling
+    sibling_hits: u64 = 0,
+    /// Styles reused from a cousin
+    cousin_hits: u64 = 0,
+    /// Elements that went through matching and the cascade
+    misses: u64 = 0,
+    /// Candidates whose revalidation results had to be compared
+    revalidations: u64 = 0,
+    /// Distinct computed styles of elements, not counting the root's
+    /// defaults unless an element has them too
+    unique_styles: u64 = 0,
+    /// Distinct custom property scopes
+    variable_scopes: u64 = 0,
+
+    pub fn hits(self: Stats) u64 {
+        return self.sibling_hits + self.cousin_hits;
+    }
+
+    /// Share of elements that skipped the cascade, 0 to 1
+    pub fn hitRate(self: Stats) f64 {
+        if (self.elements == 0) return 0;
+        return @as(f64, @floatFromInt(self.hits())) / @as(f64, @floatFromInt(self.elements));
+    }
+
+    /// Memory interning saves over storing a style per element
+    pub fn bytesSaved(self: Stats) u64 {
+        return (self.elements -| self.unique_styles) * @sizeOf(ComputedStyle);
+    }
+};
+
+pub const StyledDocument = struct {
+    /// Style of each element, by NodeId
+    styles: []const StyleId,
+    store: style.StyleStore,
+    variables: variables.Scopes,
+    stats: Stats,
+
+    pub fn deinit(self: *StyledDocument, allocator: std.mem.Allocator) void {
+        allocator.free(self.styles);
+        self.store.deinit(allocator);
+        self.variables.deinit(allocator);
+    }
+
+    pub fn styleOf(self: *const StyledDocument, element: dom.NodeId) *const ComputedStyle {
+        return self.store.get(self.styles[element]);
+    }
+
+    /// Computed value of custom property `name` on `element`
+    pub fn variable(self: *const StyledDocument, element: dom.NodeId, name: []const u8) ?[]const u8 {
+        return self.variables.lookup(self.styleOf(element).variables, name);
+    }
+};
+
+/// Style every element of `doc`. `sheets` are in cascade order,
+/// user-agent sheet first; later sheets win ties.
+pub fn cascade(allocator: std.mem.Allocator, doc: *const dom.Document, sheets: []const Sheet) !StyledDocument {
+    const count = doc.elements.len;
+    const styles = try allocator.alloc(StyleId, count);
+    errdefer allocator.free(styles);
+    const shared_from = try allocator.alloc(dom.NodeId, count);
+    defer allocator.free(shared_from);
+
+    var styler: Styler = .{ .allocator = allocator, .doc = doc, .sheets = sheets, .shared_from = shared_from };
+    defer styler.deinit();
+    errdefer styler.store.deinit(allocator);
+    errdefer styler.variables.deinit(allocator);
+
+    const root_style = try styler.store.intern(allocator, .{});
+    for (0..count) |i| {
+        const element: dom.NodeId = @intCast(i);
+        const parent = doc.elements[element].parent;
+        const parent_style = if (parent != dom.NONE) styles[parent] else root_style;
+        // The filter must follow every element, shared or not
+        try styler.filter.enter(allocator, doc, element);
+        styles[element] = try styler.styleElement(element, parent_style);
+    }
+
+    // The root's defaults are interned for every document, used or not
+    const root_used = std.mem.indexOfScalar(StyleId, styles, root_style) != null;
+    styler.stats.elements = count;
+    styler.stats.unique_styles = styler.store.count() - @intFromBool(!root_used);
+    styler.stats.variable_scopes = styler.variables.count();
+    return .{ .styles = styles, .store = styler.store, .variables = styler.variables, .stats = styler.stats };
+}
+
+const Candidate = struct {
+    element: dom.NodeId = dom.NONE,
+    style: StyleId = 0,
+    /// Matched revalidation entries, filled the first time it is compared
+    revalidation: std.ArrayListUnmanaged(u32) = .empty,
+    revalidated: bool = false,
+};
+
+const Styler = struct {
+    allocator: std.mem.Allocator,
+    doc: *const dom.Document,
+    sheets: []const Sheet,
+    /// Per element: the element its style was reused from, or NONE
+    shared_from: []dom.NodeId,
+    store: style.StyleStore = .{},
+    variables: variables.Scopes = .{},
+    stats: Stats = .{},
+    filter: matcher.AncestorFilter = .{},
+    /// Ring of sharing candidates; `next` is the oldest slot
+    cache: [CACHE_SIZE]Candidate = @splat(.{}),
+    next: usize = 0,
+    matched: std.ArrayListUnmanaged(matcher.Match) = .empty,
+    /// Matched rules of all sheets, as sheet index and rule
+    applied: std.ArrayListUnmanaged(struct { u32, u32 }) = .empty,
+    inline_declarations: std.ArrayListUnmanaged(parser.Declaration) = .empty,
+    /// The element's declarations in cascade order, last wins
+    ordered: std.ArrayListUnmanaged(parser.Declaration) = .empty,
+    resolver: variables.Resolver = .{},
+    substituted: std.ArrayListUnmanaged(u8) = .empty,
+    revalidation: std.ArrayListUnmanaged(u32) = .empty,
+
+    fn deinit(self: *Styler) void {
+        for (&self.cache) |*candidate| candidate.revalidation.deinit(self.allocator);
+        self.filter.deinit(self.allocator);
+        self.matched.deinit(self.allocator);
+        self.applied.deinit(self.allocator);
+        self.inline_declarations.deinit(self.allocator);
+        self.ordered.deinit(self.allocator);
+        self.resolver.deinit(self.allocator);
+        self.substituted.deinit(self.allocator);
+        self.revalidation.deinit(self.allocator);
+    }
+
+    fn styleElement(self: *Styler, element: dom.NodeId, parent_style: StyleId) !StyleId {
+        self.shared_from[element] = dom.NONE;
+        const e = self.doc.elements[element];
+        const shareable = e.id == null and e.attribute("style") == null;
+
+        if (shareable) {
+            if (try self.findShared(element)) |candidate| {
+                self.shared_from[element] = candidate.element;
+                if (self.doc.elements[candidate.element].parent == e.parent) {
+                    self.stats.sibling_hits += 1;
+                } else {
+                    self.stats.cousin_hits += 1;
+                }
+                return candidate.style;
+            }
+        }
+
+        self.stats.misses += 1;
+        const id = try self.store.intern(self.allocator, try self.compute(element, self.store.get(parent_style).*));
+        if (shareable) self.remember(element, id);
+        return id;
+    }
+
+    /// Most recent candidate whose style `element` can take
+    fn findShared(self: *Styler, element: dom.NodeId) !?*const Candidate {
+        const elements = self.doc.elements;
+        const e = elements[element];
+        var own_revalidated = false;
+
+        for (0..CACHE_SIZE) |age| {
+            const candidate = &self.cache[(self.next + CACHE_SIZE - 1 - age) % CACHE_SIZE];
+            if (candidate.element == dom.NONE) break;
+            const c = elements[candidate.element];
+            if (!self.sameParentStyle(e.parent, c.parent)) continue;
+            if (!std.mem.eql(u8, e.tag, c.tag) or !sameClasses(e.classes, c.classes)) continue;
+
+            self.stats.revalidations += 1;
+            if (!candidate.revalidated) {
+                try self.revalidate(candidate.element, &candidate.revalidation);
+                candidate.revalidated = true;
+            }
+            if (!own_revalidated) {
+                self.revalidation.clearRetainingCapacity();
+                try self.revalidate(element, &self.revalidation);
+                own_revalidated = true;
+            }
+            if (std.mem.eql(u32, candidate.revalidation.items, self.revalidation.items)) return candidate;
+        }
+        return null;
+    }
+
+    /// Parents are the same element, or `parent`'s style was reused
+    /// from `candidate_parent`
+    fn sameParentStyle(self: *const Styler, parent: dom.NodeId, candidate_parent: dom.NodeId) bool {
+        if (parent == candidate_parent) return true;
+        return parent != dom.NONE and candidate_parent != dom.NONE and self.shared_from[parent] == candidate_parent;
+    }
+
+    fn revalidate(self: *Styler, element: dom.NodeId, out: *std.ArrayListUnmanaged(u32)) !void {
+        for (self.sheets) |sheet| {
+            try sheet.index.revalidate(self.allocator, self.doc, element, out);
+            try out.append(self.allocator, SHEET_BREAK);
+        }
+    }
+
+    fn remember(self: *Styler, element: dom.NodeId, id: StyleId) void {
+        const slot = &self.cache[self.next];
+        slot.element = element;
+        slot.style = id;
+        slot.revalidation.clearRetainingCapacity();
+        slot.revalidated = false;
+        self.next = (self.next + 1) % CACHE_SIZE;
+    }
+
+    /// Match and cascade: normal declarations in sheet then specificity
+    /// order, the style attribute, then !important declarations in the
+    /// same order and the style attribute's. Custom properties are
+    /// resolved first so the rest can refer to them.
+    fn compute(self: *Styler, element: dom.NodeId, parent: ComputedStyle) !ComputedStyle {
+        self.applied.clearRetainingCapacity();
+        for (self.sheets, 0..) |sheet, sheet_index| {
+            self.matched.clearRetainingCapacity();
+            try sheet.index.match(self.allocator, self.doc, &self.filter, element, &self.matched);
+            for (self.matched.items) |match| {
+                // An index not filtered for a viewport applies no @media rules
+                if (!sheet.index.media_filtered and sheet.stylesheet.rules[match.rule].media != parser.ALL_MEDIA) continue;
+                try self.applied.append(self.allocator, .{ @intCast(sheet_index), match.rule });
+            }
+        }
+
+        self.inline_declarations.clearRetainingCapacity();
+        if (self.doc.elements[element].attribute("style")) |text| {
+            try parser.parseInline(self.allocator, text, &self.inline_declarations);
+        }
+
+        self.ordered.clearRetainingCapacity();
+        for ([_]bool{ false, true }) |important| {
+            for (self.applied.items) |entry| {
+                const sheet_index, const rule_index = entry;
+                const stylesheet = self.sheets[sheet_index].stylesheet;
+                for (stylesheet.declarationsOf(stylesheet.rules[rule_index])) |declaration| {
+                    if (declaration.important == important) try self.ordered.append(self.allocator, declaration);
+                }
+            }
+            for (self.inline_declarations.items) |declaration| {
+                if (declaration.important == important) try self.ordered.append(self.allocator, declaration);
+            }
+        }
+
+        var computed = ComputedStyle.inheritFrom(&parent);
+        self.resolver.begin(parent.variables);
+        for (self.ordered.items) |declaration| {
+            if (variables.isCustom(declaration.name)) try self.resolver.declare(self.allocator, declaration.name, declaration.value);
+        }
+        computed.variables = try self.resolver.finish(self.allocator, &self.variables);
+
+        for (self.ordered.items) |declaration| {
+            if (variables.isCustom(declaration.name)) continue;
+            var value = declaration.value;
+            if (variables.hasReference(value)) {
+                // Invalid at computed-value time: as if the value were unset
+                value = try variables.resolveValue(self.allocator, &self.variables, computed.variables, value, &self.substituted) orelse "unset";
+            }
+            style.apply(&computed, &parent, declaration.name, value);
+        }
+        return computed;
+    }
+};
+
+fn sameClasses(a: []const []const u8, b: []const []const u8) bool {
+    if (a.len != b.len) return false;
+    for (a, b) |x, y| {
+        if (!std.mem.eql(u8, x, y)) return false;
+    }
+    return true;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+/// Heap-allocated, as the viewport index points at the sheet and index
+const Fixture = struct {
+    user_agent: UserAgent,
+    author: parser.Stylesheet,
+    author_index: matcher.RuleIndex,
+    view: media.ViewportIndex,
+    doc: dom.Document,
+
+    fn create(css: []const u8, html: []const u8) !*Fixture {
+        const allocator = std.testing.allocator;
+        const self = try allocator.create(Fixture);
+        errdefer allocator.destroy(self);
+        self.user_agent = try UserAgent.init(allocator);
+        errdefer self.user_agent.deinit();
+        self.author = try parser.parse(allocator, css);
+        errdefer self.author.deinit();
+        self.author_index = try matcher.RuleIndex.build(allocator, &self.author);
+        errdefer self.author_index.deinit();
+        self.view = try media.ViewportIndex.init(allocator, &self.author, &self.author_index, .{});
+        errdefer self.view.deinit();
+        self.doc = try dom.parse(allocator, html);
+        return self;
+    }
+
+    fn destroy(self: *Fixture) void {
+        self.doc.deinit();
+        self.view.deinit();
+        self.author_index.deinit();
+        self.author.deinit();
+        self.user_agent.deinit();
+        std.testing.allocator.destroy(self);
+    }
+
+    fn run(self: *const Fixture) !StyledDocument {
+        const sheets = [_]Sheet{ self.user_agent.sheet(), self.view.sheet() };
+        return cascade(std.testing.allocator, &self.doc, &sheets);
+    }
+};
+
+test "cascade order and inheritance" {
+    const fixture = try Fixture.create(
+        \\p { color: gray; font-size: 20px }
+        \\.lead { color: navy !important }
+        \\#intro { color: red }
+        \\@media print { p { color: black } }
+    ,
+        \\<body><p id="intro" class="lead">a <em>b</em></p>
+        \\<p style="color: green; font-size: 1.5em">c</p><h1>d</h1></body>
+    );
+    defer fixture.destroy();
+    var styled = try fixture.run();
+    defer styled.deinit(std.testing.allocator);
+
+    const intro = styled.styleOf(1);
+    try std.testing.expectEqual(style.Display.block, intro.display);
+    try std.testing.expectEqual(@as(u8, 128), intro.color.?.b);
+    try std.testing.expectEqual(@as(f32, 20), intro.font_size);
+
+    const em = styled.styleOf(2);
+    try std.testing.expect(em.italic);
+    try std.testing.expectEqual(@as(u8, 128), em.color.?.b);
+
+    const inline_styled = styled.styleOf(3);
+    try std.testing.expectEqual(@as(u8, 128), inline_styled.color.?.g);
+    try std.testing.expectEqual(@as(f32, 24), inline_styled.font_size);
+
+    const heading = styled.styleOf(4);
+    try std.testing.expectEqual(@as(f32, 32), heading.font_size);
+    try std.testing.expectEqual(@as(u16, 700), heading.font_weight);
+}
+
+test "siblings and cousins share styles" {
+    const fixture = try Fixture.create(
+        \\.row td { color: gray }
+        \\td:first-child { font-weight: bold }
+        \\td[data-warn] { color: red }
+    ,
+        \\<table><tr class="row"><td>a</td><td>b</td><td>c</td></tr>
+        \\<tr class="row"><td>d</td><td>e</td><td data-warn>f</td></tr>
+        \\<tr class="row" id="last"><td>g</td><td>h</td></tr></table>
+    );
+    defer fixture.destroy();
+    var styled = try fixture.run();
+    defer styled.deinit(std.testing.allocator);
+
+    // Shared results are the ones a full cascade would give
+    const e = fixture.doc.elements;
+    for (0..e.len) |i| {
+        const element: dom.NodeId = @intCast(i);
+        const bold = e[element].prev_sibling == dom.NONE and std.mem.eql(u8, e[element].tag, "td");
+        try std.testing.expectEqual(@as(u16, if (bold) 700 else 400), styled.styleOf(element).font_weight);
+    }
+    try std.testing.expectEqual(@as(u8, 255), styled.styleOf(8).color.?.r);
+    try std.testing.expectEqual(@as(u8, 128), styled.styleOf(10).color.?.r);
+
+    // c shares with b and the second row with the first; d and e share
+    // with their cousins a and b. f has an attribute the others lack, the
+    // last row has an id, and h differs from g, its only candidate.
+    const stats = styled.stats;
+    try std.testing.expectEqual(@as(u64, e.len), stats.elements);
+    try std.testing.expectEqual(@as(u64, 2), stats.sibling_hits);
+    try std.testing.expectEqual(@as(u64, 2), stats.cousin_hits);
+    try std.testing.expect(stats.unique_styles < stats.elements);
+    try std.testing.expectEqual((stats.elements - stats.unique_styles) * @sizeOf(ComputedStyle), stats.bytesSaved());
+}
+
+test "unfiltered indexes skip @media rules" {
+    const fixture = try Fixture.create(
+        \\p { color: gray }
+        \\@media print { p { color: black } }
+        \\@media (min-width: 1px) { p { font-size: 20px } }
+    , "<p>x</p>");
+    defer fixture.destroy();
+
+    const unfiltered = [_]Sheet{ fixture.user_agent.sheet(), .{ .stylesheet = &fixture.author, .index = &fixture.author_index } };
+    var plain = try cascade(std.testing.allocator, &fixture.doc, &unfiltered);
+    defer plain.deinit(std.testing.allocator);
+    try std.testing.expectEqual(@as(u8, 128), plain.styleOf(0).color.?.r);
+    try std.testing.expectEqual(@as(f32, 16), plain.styleOf(0).font_size);
+
+    var viewed = try fixture.run();
+    defer viewed.deinit(std.testing.allocator);
+    try std.testing.expectEqual(@as(u8, 128), viewed.styleOf(0).color.?.r);
+    try std.testing.expectEqual(@as(f32, 20), viewed.styleOf(0).font_size);
+}
+
+test "a one-element document saves nothing" {
+    const fixture = try Fixture.create("p { color: red }", "<p>x</p>");
+    defer fixture.destroy();
+    var styled = try fixture.run();
+    defer styled.deinit(std.testing.allocator);
+
+    try std.testing.expectEqual(@as(u64, 1), styled.stats.elements);
+    try std.testing.expectEqual(@as(u64, 1), styled.stats.unique_styles);
+    try std.testing.expectEqual(@as(u64, 0), styled.stats.bytesSaved());
+}
+
+test "custom properties" {
+    const fixture = try Fixture.create(
+        \\:root { --brand: #0066cc; --text: var(--brand) }
+        \\p { color: var(--text); font-size: var(--size, 20px) }
+        \\.warn { --brand: red }
+        \\.loop { --a: var(--b); --b: var(--a); color: var(--a, green) }
+        \\.broken { font-size: var(--missing) }
+    ,
+        \\<body><p>a</p><p class="warn">b</p><p class="loop">c</p>
+        \\<p style="--text: navy">d</p><p class="broken">e</p></body>
+    );
+    defer fixture.destroy();
+    var styled = try fixture.run();
+    defer styled.deinit(std.testing.allocator);
+
+    try std.testing.expectEqual(@as(u8, 0xcc), styled.styleOf(1).color.?.b);
+    try std.testing.expectEqual(@as(f32, 20), styled.styleOf(1).font_size);
+    // --text was computed on the root, before .warn changed --brand
+    try std.testing.expectEqualStrings("red", styled.variable(2, "--brand").?);
+    try std.testing.expectEqual(@as(u8, 0xcc), styled.styleOf(2).color.?.b);
+    try std.testing.expect(styled.variable(3, "--a") == null);
+    try std.testing.expectEqual(@as(u8, 128), styled.styleOf(3).color.?.g);
+    try std.testing.expectEqual(@as(u8, 128), styled.styleOf(4).color.?.b);
+    // A missing reference leaves font-size unset, so inherited
+    try std.testing.expectEqual(@as(f32, 16), styled.styleOf(5).font_size);
+
+    // The root's scope, .warn's and the style attribute's; the cycle
+    // hides nothing inherited, so .loop keeps its parent's
+    try std.testing.expectEqual(@as(u64, 4), styled.stats.variable_scopes);
+    try std.testing.expectEqual(styled.styleOf(0).variables, styled.styleOf(3).variables);
+}
@@ -0,0 +1,555 @@
+//! Vulpes Browser - Rule Index and Selector Matching
+//!
+//! Finds the style rules that apply to each element without testing
+//! every selector against every element.
+//!
+//! Each selector is filed under one key of its subject compound, in
+//! order of selectivity: its id, else its first class, else its tag,
+//! else the universal list. An element only looks at the buckets for
+//! its own id, classes and tag plus the universal list.
+//!
+//! Candidates are then screened with an ancestor Bloom filter: every
+//! selector carries hashes of up to four ids, classes and tags that its
+//! ancestor compounds require, and the filter holds the same hashes for
+//! the element's actual ancestors. A selector with a hash missing from
+//! the filter cannot match, so most descendant selectors are rejected
+//! without walking the tree. Survivors are matched right to left.
+//!
+//! The filter is built incrementally for elements visited in document
+//! order (see AncestorFilter.enter), which is how the cascade walks.
+//!
+//! Selectors that look at more than tags, classes and ids - attribute
+//! selectors, structural pseudo-classes, :link, :not()/:is()/:where()
+//! and sibling combinators - are flagged for revalidation: before the
+//! cascade lets an element reuse a similar element's style, it checks
+//! that the two agree on these.
+//!
+
+const std = @import("std");
+const dom = @import("../html/dom.zig");
+const parser = @import("parser.zig");
+const selector = @import("selector.zig");
+
+/// Ancestor hashes kept per selector
+const BLOOM_HASHES = 4;
+
+/// Counting Bloom filter size, as a power of two
+const FILTER_BITS = 12;
+const FILTER_MASK = (1 << FILTER_BITS) - 1;
+
+pub const Entry = struct {
+    selector: selector.Selector,
+    /// Index into Stylesheet.rules
+    rule: u32,
+    /// Required ancestor keys; 0 marks an unused slot
+    ancestor_hashes: [BLOOM_HASHES]u32,
+    /// Can tell apart elements with equal tags, classes and ancestors
+    revalidate: bool,
+};
+
+/// One matched rule, in cascade order once sorted
+pub const Match = struct {
+    specificity: u32,
+    rule: u32,
+
+    pub fn lessThan(_: void, a: Match, b: Match) bool {
+        if (a.specificity != b.specificity) return a.specificity < b.specificity;
+        return a.rule < b.rule;
+    }
+};
+
+/// Range of RuleIndex.entries
+pub const Span = struct {
+    start: u32,
+    len: u32,
+};
+
+/// Which key a selector is filed under
+const KeyKind = enum(u8) { id, class, tag, universal };
+
+pub const RuleIndex = struct {
+    arena: std.heap.ArenaAllocator,
+    /// Selectors grouped by bucket, in source order within a bucket
+    entries: []const Entry,
+    ids: std.StringHashMapUnmanaged(Span),
+    classes: std.StringHashMapUnmanaged(Span),
+    tags: std.StringHashMapUnmanaged(Span),
+    universal: Span,
+    /// Made by forMedia: the entries left are exactly the rules that
+    /// apply. Otherwise the index holds every rule and the cascade skips
+    /// those inside @media.
+    media_filtered: bool = false,
+
+    pub fn deinit(self: *RuleIndex) void {
+        self.arena.deinit();
+    }
+
+    /// Index every selector of every rule in `sheet`. The sheet (and its
+    /// source text) must outlive the index.
+    pub fn build(allocator: std.mem.Allocator, sheet: *const parser.Stylesheet) !RuleIndex {
+        var arena = std.heap.ArenaAllocator.init(allocator);
+        errdefer arena.deinit();
+        const owned = arena.allocator();
+
+        const Keyed = struct {
+            kind: KeyKind,
+            key: []const u8,
+            entry: Entry,
+
+            fn lessThan(_: void, a: @This(), b: @This()) bool {
+                if (a.kind != b.kind) return @intFromEnum(a.kind) < @intFromEnum(b.kind);
+                return std.mem.order(u8, a.key, b.key) == .lt;
+            }
+        };
+        var keyed: std.ArrayListUnmanaged(Keyed) = .empty;
+        defer keyed.deinit(allocator);
+
+        for (sheet.rules, 0..) |rule, rule_index| {
+            const selectors = try selector.parseList(owned, allocator, rule.selectors);
+            for (selectors) |sel| {
+                const kind, const key = bucketKey(sel.subject());
+                try keyed.append(allocator, .{
+                    .kind = kind,
+                    .key = key,
+                    .entry = .{
+                        .selector = sel,
+                        .rule = @intCast(rule_index),
+                        .ancestor_hashes = ancestorHashes(sel),
+                        .revalidate = needsRevalidation(sel),
+                    },
+                });
+            }
+        }
+
+        // Stable, so source order survives within each bucket
+        std.mem.sort(Keyed, keyed.items, {}, Keyed.lessThan);
+
+        var index: RuleIndex = .{
+            .arena = undefined,
+            .entries = &.{},
+            .ids = .empty,
+            .classes = .empty,
+            .tags = .empty,
+            .universal = .{ .start = 0, .len = 0 },
+        };
+        const entries = try owned.alloc(Entry, keyed.items.len);
+        var start: usize = 0;
+        while (start < keyed.items.len) {
+            const first = keyed.items[start];
+            var end = start;
+            while (end < keyed.items.len and keyed.items[end].kind == first.kind and
+                std.mem.eql(u8, keyed.items[end].key, first.key)) : (end += 1)
+            {
+                entries[end] = keyed.items[end].entry;
+            }
+            const span: Span = .{ .start = @intCast(start), .len = @intCast(end - start) };
+            switch (first.kind) {
+                .id => try index.ids.put(owned, first.key, span),
+                .class => try index.classes.put(owned, first.key, span),
+                .tag => try index.tags.put(owned, first.key, span),
+                .universal => index.universal = span,
+            }
+            start = end;
+        }
+
+        index.entries = entries;
+        index.arena = arena;
+        return index;
+    }
+
+    /// A copy holding only the entries whose rule is outside @media or in
+    /// an @media block marked in `active` (indexed like sheet.media).
+    /// Buckets keep their order, so nothing is parsed or sorted again.
+    /// Selectors and keys still point into this index, which must outlive
+    /// the copy.
+    pub fn forMedia(
+        self: *const RuleIndex,
+        allocator: std.mem.Allocator,
+        sheet: *const parser.Stylesheet,
+        active: []const bool,
+    ) !RuleIndex {
+        var arena = std.heap.ArenaAllocator.init(allocator);
+        errdefer arena.deinit();
+        const owned = arena.allocator();
+
+        var index: RuleIndex = .{
+            .arena = undefined,
+            .entries = &.{},
+            .ids = .empty,
+            .classes = .empty,
+            .tags = .empty,
+            .universal = .{ .start = 0, .len = 0 },
+        };
+        var entries: std.ArrayListUnmanaged(Entry) = .empty;
+        const Filter = struct {
+            fn span(
+                from: []const Entry,
+                into: *std.ArrayListUnmanaged(Entry),
+                arena_allocator: std.mem.Allocator,
+                rules: []const parser.Rule,
+                media: []const bool,
+            ) !Span {
+                const start = into.items.len;
+                for (from) |entry| {
+                    if (media[rules[entry.rule].media]) try into.append(arena_allocator, entry);
+                }
+                return .{ .start = @intCast(start), .len = @intCast(into.items.len - start) };
+            }
+        };
+
+        const maps = [_]struct { *const std.StringHashMapUnmanaged(Span), *std.StringHashMapUnmanaged(Span) }{
+            .{ &self.ids, &index.ids },
+            .{ &self.classes, &index.classes },
+            .{ &self.tags, &index.tags },
+        };
+        for (maps) |pair| {
+            const from, const into = pair;
+            var it = from.iterator();
+            while (it.next()) |bucket| {
+                const span = bucket.value_ptr.*;
+                const kept = try Filter.span(self.entries[span.start..][0..span.len], &entries, owned, sheet.rules, active);
+                if (kept.len > 0) try into.put(owned, bucket.key_ptr.*, kept);
+            }
+        }
+        index.universal = try Filter.span(self.entries[self.universal.start..][0..self.universal.len], &entries, owned, sheet.rules, active);
+
+        index.entries = entries.items;
+        index.media_filtered = true;
+        index.arena = arena;
+        return index;
+    }
+
+    /// Append every rule matching `element` to `out`, sorted into cascade
+    /// order (specificity, then source order). `filter` must have been
+    /// entered at `element`.
+    pub fn match(
+        self: *const RuleIndex,
+        allocator: std.mem.Allocator,
+        doc: *const dom.Document,
+        filter: *const AncestorFilter,
+        element: dom.NodeId,
+        out: *std.ArrayListUnmanaged(Match),
+    ) !void {
+        const start = out.items.len;
+        const e = doc.elements[element];
+
+        if (e.id) |id| {
+            if (self.ids.get(id)) |span| try self.matchSpan(allocator, doc, filter, element, span, out);
+        }
+        for (e.classes, 0..) |class, i| {
+            // class="a a" must not match .a twice
+            if (isRepeat(e.classes[0..i], class)) continue;
+            if (self.classes.get(class)) |span| try self.matchSpan(allocator, doc, filter, element, span, out);
+        }
+        if (self.tags.get(e.tag)) |span| try self.matchSpan(allocator, doc, filter, element, span, out);
+        try self.matchSpan(allocator, doc, filter, element, self.universal, out);
+
+        std.mem.sort(Match, out.items[start..], {}, Match.lessThan);
+    }
+
+    /// Append the entry index of every revalidation selector matching
+    /// `element`, from the buckets of its tag and classes. Elements with
+    /// the same tag and classes and no id visit the same entries in the
+    /// same order, so their lists can be compared directly.
+    pub fn revalidate(
+        self: *const RuleIndex,
+        allocator: std.mem.Allocator,
+        doc: *const dom.Document,
+        element: dom.NodeId,
+        out: *std.ArrayListUnmanaged(u32),
+    ) !void {
+        const e = doc.elements[element];
+        for (e.classes, 0..) |class, i| {
+            if (isRepeat(e.classes[0..i], class)) continue;
+            if (self.classes.get(class)) |span| try self.revalidateSpan(allocator, doc, element, span, out);
+        }
+        if (self.tags.get(e.tag)) |span| try self.revalidateSpan(allocator, doc, element, span, out);
+        try self.revalidateSpan(allocator, doc, element, self.universal, out);
+    }
+
+    fn revalidateSpan(
+        self: *const RuleIndex,
+        allocator: std.mem.Allocator,
+        doc: *const dom.Document,
+        element: dom.NodeId,
+        span: Span,
+        out: *std.ArrayListUnmanaged(u32),
+    ) !void {
+        for (self.entries[span.start..][0..span.len], span.start..) |entry, index| {
+            if (!entry.revalidate or !selector.matches(doc, entry.selector, element)) continue;
+            try out.append(allocator, @intCast(index));
+        }
+    }
+
+    fn matchSpan(
+        self: *const RuleIndex,
+        allocator: std.mem.Allocator,
+        doc: *const dom.Document,
+        filter: *const AncestorFilter,
+        element: dom.NodeId,
+        span: Span,
+        out: *std.ArrayListUnmanaged(Match),
+    ) !void {
+        for (self.entries[span.start..][0..span.len]) |entry| {
+            if (!filter.mayMatch(entry.ancestor_hashes)) continue;
+            if (!selector.matches(doc, entry.selector, element)) continue;
+            try out.append(allocator, .{ .specificity = entry.selector.specificity, .rule = entry.rule });
+        }
+    }
+};
+
+fn isRepeat(earlier: []const []const u8, class: []const u8) bool {
+    for (earlier) |seen| {
+        if (std.mem.eql(u8, seen, class)) return true;
+    }
+    return false;
+}
+
+/// The most selective key of a subject compound
+fn bucketKey(subject: selector.Compound) struct { KeyKind, []const u8 } {
+    var class: ?[]const u8 = null;
+    var tag: ?[]const u8 = null;
+    for (subject.simples) |simple| switch (simple) {
+        .id => |id| return .{ .id, id },
+        .class => |name| class = class orelse name,
+        .tag => |name| tag = name,
+        else => {},
+    };
+    if (class) |name| return .{ .class, name };
+    if (tag) |name| return .{ .tag, name };
+    return .{ .universal, "" };
+}
+
+fn keyHash(kind: KeyKind, name: []const u8) u32 {
+    // Never 0, which marks an unused slot
+    return @as(u32, @truncate(std.hash.Wyhash.hash(@intFromEnum(kind), name))) | 1;
+}
+
+fn needsRevalidation(sel: selector.Selector) bool {
+    for (sel.compounds, 0..) |compound, i| {
+        // The leftmost compound's combinator is unused
+        if (i + 1 < sel.compounds.len and
+            (compound.combinator == .next_sibling or compound.combinator == .subsequent_sibling)) return true;
+        for (compound.simples) |simple| switch (simple) {
+            .attribute, .pseudo, .nth, .not, .is, .where => return true,
+            .tag, .id, .class, .never => {},
+        };
+    }
+    return false;
+}
+
+/// Keys that ancestors of a matching element must carry. A compound is
+/// an ancestor of the subject when the combinator on its right is a
+/// child or descendant one.
+fn ancestorHashes(sel: selector.Selector) [BLOOM_HASHES]u32 {
+    var hashes: [BLOOM_HASHES]u32 = @splat(0);
+    var count: usize = 0;
+    const compounds = sel.compounds;
+    for (compounds[0 .. compounds.len -| 1], compounds[1..]) |right, compound| {
+        if (right.combinator != .child and right.combinator != .descendant) continue;
+        for (compound.simples) |simple| {
+            const hash = switch (simple) {
+                .id => |name| keyHash(.id, name),
+                .class => |name| keyHash(.class, name),
+                .tag => |name| keyHash(.tag, name),
+                else => continue,
+            };
+            hashes[count] = hash;
+            count += 1;
+            if (count == BLOOM_HASHES) return hashes;
+        }
+    }
+    return hashes;
+}
+
+/// Counting Bloom filter over the ids, classes and tags of the current
+/// element's ancestors.
+pub const AncestorFilter = struct {
+    counters: [1 << FILTER_BITS]u8 = @splat(0),
+    /// Hashes added per ancestor on the stack, for removal
+    hashes: std.ArrayListUnmanaged(u32) = .empty,
+    stack: std.ArrayListUnmanaged(Frame) = .empty,
+    /// Last entered element, added once the next element is entered
+    pending: dom.NodeId = dom.NONE,
+
+    const Frame = struct {
+        element: dom.NodeId,
+        hash_count: u32,
+    };
+
+    pub fn deinit(self: *AncestorFilter, allocator: std.mem.Allocator) void {
+        self.hashes.deinit(allocator);
+        self.stack.deinit(allocator);
+    }
+
+    /// Make the filter describe `element`'s ancestors. Elements must be
+    /// entered in document order, starting from a fresh filter.
+    pub fn enter(self: *AncestorFilter, allocator: std.mem.Allocator, doc: *const dom.Document, element: dom.NodeId) !void {
+        if (self.pending != dom.NONE) try self.push(allocator, doc, self.pending);
+        self.pending = element;
+
+        const parent = doc.elements[element].parent;
+        while (self.stack.items.len > 0 and self.stack.items[self.stack.items.len - 1].element != parent) {
+            self.pop();
+        }
+    }
+
+    /// Could an element with these ancestors match a selector needing `required`?
+    pub fn mayMatch(self: *const AncestorFilter, required: [BLOOM_HASHES]u32) bool {
+        for (required) |hash| {
+            if (hash == 0) return true;
+            if (!self.contains(hash)) return false;
+        }
+        return true;
+    }
+
+    fn contains(self: *const AncestorFilter, hash: u32) bool {
+        return self.counters[hash & FILTER_MASK] != 0 and self.counters[(hash >> FILTER_BITS) & FILTER_MASK] != 0;
+    }
+
+    fn push(self: *AncestorFilter, allocator: std.mem.Allocator, doc: *const dom.Document, element: dom.NodeId) !void {
+        const e = doc.elements[element];
+        const first = self.hashes.items.len;
+        try self.hashes.append(allocator, keyHash(.tag, e.tag));
+        if (e.id) |id| try self.hashes.append(allocator, keyHash(.id, id));
+        for (e.classes) |class| try self.hashes.append(allocator, keyHash(.class, class));
+        try self.stack.append(allocator, .{ .element = element, .hash_count = @intCast(self.hashes.items.len - first) });
+
+        for (self.hashes.items[first..]) |hash| {
+            self.bump(hash & FILTER_MASK, 1);
+            self.bump((hash >> FILTER_BITS) & FILTER_MASK, 1);
+        }
+    }
+
+    fn pop(self: *AncestorFilter) void {
+        const frame = self.stack.pop().?;
+        const first = self.hashes.items.len - frame.hash_count;
+        for (self.hashes.items[first..]) |hash| {
+            self.bump(hash & FILTER_MASK, -1);
+            self.bump((hash >> FILTER_BITS) & FILTER_MASK, -1);
+        }
+        self.hashes.shrinkRetainingCapacity(first);
+    }
+
+    /// A saturated counter stays saturated: the filter may then report
+    /// false positives, never false negatives.
+    fn bump(self: *AncestorFilter, slot: u32, delta: i2) void {
+        const counter = &self.counters[slot];
+        if (counter.* == std.math.maxInt(u8)) return;
+        counter.* = if (delta > 0) counter.* + 1 else counter.* - 1;
+    }
+};
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "bucketed matching agrees with brute force" {
+    const allocator = std.testing.allocator;
+    const sheet = try parser.parse(allocator,
+        \\* { margin: 0 }
+        \\p { color: black }
+        \\.note, #intro { color: gray }
+        \\article p.note { color: blue }
+        \\nav a { color: red }
+        \\section > p:first-child { font-weight: bold }
+        \\h2 + p { margin-top: 0 }
+        \\.missing .note { color: green }
+    );
+    defer sheet.deinit();
+    var index = try RuleIndex.build(allocator, &sheet);
+    defer index.deinit();
+
+    const doc = try dom.parse(allocator,
+        \\<body><nav><a href="/">home</a></nav><article><section><p id="intro">a</p>
+        \\<h2>t</h2><p class="note note">b</p></section></article><p class="note">c</p></body>
+    );
+    defer doc.deinit();
+
+    var scratch = std.heap.ArenaAllocator.init(allocator);
+    defer scratch.deinit();
+
+    var filter: AncestorFilter = .{};
+    defer filter.deinit(allocator);
+    var matched: std.ArrayListUnmanaged(Match) = .empty;
+    defer matched.deinit(allocator);
+    var expected: std.ArrayListUnmanaged(Match) = .empty;
+    defer expected.deinit(allocator);
+
+    for (0..doc.elements.len) |i| {
+        const element: dom.NodeId = @intCast(i);
+        try filter.enter(allocator, &doc, element);
+        matched.clearRetainingCapacity();
+        try index.match(allocator, &doc, &filter, element, &matched);
+
+        expected.clearRetainingCapacity();
+        for (sheet.rules, 0..) |rule, rule_index| {
+            for (try selector.parseList(scratch.allocator(), allocator, rule.selectors)) |sel| {
+                if (selector.matches(&doc, sel, element)) {
+                    try expected.append(allocator, .{ .specificity = sel.specificity, .rule = @intCast(rule_index) });
+                }
+            }
+        }
+        std.mem.sort(Match, expected.items, {}, Match.lessThan);
+        try std.testing.expectEqualSlices(Match, expected.items, matched.items);
+    }
+
+    // The last element walked is the top-level p.note: *, p, then .note
+    try std.testing.expectEqual(@as(usize, 3), matched.items.len);
+    try std.testing.expectEqual(@as(u32, 2), matched.items[2].rule);
+}
+
+test "revalidation selectors" {
+    const allocator = std.testing.allocator;
+    const sheet = try parser.parse(allocator,
+        \\li { color: black }
+        \\.menu li { color: gray }
+        \\li:first-child { font-weight: bold }
+        \\li + li { margin-top: 4px }
+        \\a[href$=".pdf"] { color: red }
+    );
+    defer sheet.deinit();
+    var index = try RuleIndex.build(allocator, &sheet);
+    defer index.deinit();
+
+    var flagged: usize = 0;
+    for (index.entries) |entry| flagged += @intFromBool(entry.revalidate);
+    try std.testing.expectEqual(@as(usize, 3), flagged);
+
+    const doc = try dom.parse(allocator, "<ul class=menu><li>a<li>b<li>c</ul>");
+    defer doc.deinit();
+    var first: std.ArrayListUnmanaged(u32) = .empty;
+    defer first.deinit(allocator);
+    var second: std.ArrayListUnmanaged(u32) = .empty;
+    defer second.deinit(allocator);
+    var third: std.ArrayListUnmanaged(u32) = .empty;
+    defer third.deinit(allocator);
+    try index.revalidate(allocator, &doc, 1, &first);
+    try index.revalidate(allocator, &doc, 2, &second);
+    try index.revalidate(allocator, &doc, 3, &third);
+
+    // The first item differs from the rest; the second and third agree
+    try std.testing.expectEqual(@as(usize, 1), first.items.len);
+    try std.testing.expect(!std.mem.eql(u32, first.items, second.items));
+    try std.testing.expectEqualSlices(u32, second.items, third.items);
+}
+
+test "ancestor filter rejects missing ancestors" {
+    const allocator = std.testing.allocator;
+    const doc = try dom.parse(allocator, "<div class=\"a\"><span id=\"s\"><b>x</b></span></div><i>y</i>");
+    defer doc.deinit();
+
+    var filter: AncestorFilter = .{};
+    defer filter.deinit(allocator);
+
+    try filter.enter(allocator, &doc, 0);
+    try filter.enter(allocator, &doc, 1);
+    try filter.enter(allocator, &doc, 2);
+    try std.testing.expect(filter.mayMatch(.{ keyHash(.class, "a"), keyHash(.id, "s"), keyHash(.tag, "div"), 0 }));
+    try std.testing.expect(!filter.mayMatch(.{ keyHash(.tag, "b"), 0, 0, 0 }));
+
+    // <i> is back at the top level
+    try filter.enter(allocator, &doc, 3);
+    try std.testing.expect(!filter.mayMatch(.{ keyHash(.class, "a"), 0, 0, 0 }));
+    try std.testing.expect(filter.mayMatch(.{ 0, 0, 0, 0 }));
+}
@@ -0,0 +1,535 @@
+//! Vulpes Browser - Media Queries
+//!
+//! Evaluates @media queries against the reading viewport and keeps a rule
+//! index holding only the rules whose @media blocks apply.
+//!
+//! Queries follow Media Queries Level 4: comma-separated lists, media
+//! types with "not"/"only", "and"/"or"/"not" conditions, feature values
+//! in min-/max- and range form ((400px <= width < 900px)). Supported
+//! features: width, height, aspect-ratio, orientation, resolution (and
+//! -webkit-device-pixel-ratio), color, monochrome, prefers-color-scheme,
+//! prefers-reduced-motion, prefers-contrast, hover, pointer and their
+//! any- forms, scripting, forced-colors and inverted-colors. A query that
+//! is malformed or uses anything else is false, as the spec's "not all".
+//!
+//! ViewportIndex evaluates each query once per viewport. Moving to a new
+//! viewport only rebuilds the index when some query changes its answer,
+//! i.e. when the window crosses a breakpoint, and then by filtering the
+//! sheet's full index rather than parsing anything.
+//!
+
+const std = @import("std");
+const parser = @import("parser.zig");
+const matcher = @import("matcher.zig");
+const cascade = @import("cascade.zig");
+const tokenizer = @import("tokenizer.zig");
+const Tokenizer = tokenizer.Tokenizer;
+const Token = tokenizer.Token;
+
+/// Font size em and rem units in queries resolve against, in px
+const QUERY_FONT_SIZE: f32 = 16;
+
+pub const MediaType = enum { screen, print };
+pub const ColorScheme = enum { light, dark };
+
+pub const Viewport = struct {
+    /// CSS px
+    width: f32 = 800,
+    height: f32 = 600,
+    /// Device pixels per CSS px
+    scale: f32 = 2,
+    media_type: MediaType = .screen,
+    color_scheme: ColorScheme = .light,
+    reduced_motion: bool = false,
+    /// A mouse or trackpad: can hover, fine pointer
+    hover: bool = true,
+};
+
+/// Does the media query list `text` apply to `viewport`? An empty list
+/// applies everywhere.
+pub fn matches(text: []const u8, viewport: Viewport) bool {
+    if (std.mem.trim(u8, text, " \t\n\r\x0c").len == 0) return true;
+    var start: usize = 0;
+    var depth: usize = 0;
+    for (text, 0..) |c, i| {
+        switch (c) {
+            '(' => depth += 1,
+            ')' => depth -|= 1,
+            ',' => if (depth == 0) {
+                if (matchesQuery(text[start..i], viewport)) return true;
+                start = i + 1;
+            },
+            else => {},
+        }
+    }
+    return matchesQuery(text[start..], viewport);
+}
+
+fn matchesQuery(text: []const u8, viewport: Viewport) bool {
+    var evaluator: Evaluator = .{ .tokens = .init(text), .viewport = viewport };
+    const result = evaluator.query() catch return false;
+    if (evaluator.next() != null) return false;
+    return result;
+}
+
+const Error = error{InvalidQuery};
+
+const Evaluator = struct {
+    tokens: Tokenizer,
+    viewport: Viewport,
+
+    /// Next token other than whitespace
+    fn next(self: *Evaluator) ?Token {
+        while (self.tokens.next()) |token| {
+            if (token != .whitespace) return token;
+        }
+        return null;
+    }
+
+    fn peek(self: *Evaluator) ?Token {
+        const saved = self.tokens.pos;
+        defer self.tokens.pos = saved;
+        return self.next();
+    }
+
+    fn peekKeyword(self: *Evaluator, keyword: []const u8) bool {
+        const token = self.peek() orelse return false;
+        return token == .ident and std.ascii.eqlIgnoreCase(token.ident, keyword);
+    }
+
+    fn expect(self: *Evaluator, comptime tag: std.meta.Tag(Token)) Error!void {
+        const token = self.next() orelse return error.InvalidQuery;
+        if (token != tag) return error.InvalidQuery;
+    }
+
+    /// [not | only] media-type [and condition] | condition
+    fn query(self: *Evaluator) Error!bool {
+        const first = self.peek() orelse return error.InvalidQuery;
+        if (first != .ident) return self.condition(false);
+
+        var negate = false;
+        if (self.peekKeyword("not") or self.peekKeyword("only")) {
+            const keyword = self.next().?.ident;
+            const after = self.peek() orelse return error.InvalidQuery;
+            // "not (color)" negates a condition, not a media type
+            if (after != .ident) {
+                if (std.ascii.eqlIgnoreCase(keyword, "only")) return error.InvalidQuery;
+                return !(try self.inParens());
+            }
+            negate = std.ascii.eqlIgnoreCase(keyword, "not");
+        }
+
+        const media_type = self.next().?.ident;
+        var result = self.typeMatches(media_type) orelse return error.InvalidQuery;
+        if (self.peekKeyword("and")) {
+            _ = self.next();
+            // Mixing "or" into a typed query needs parentheses
+            const rest = try self.condition(true);
+            result = result and rest;
+        }
+        return if (negate) !result else result;
+    }
+
+    fn typeMatches(self: *const Evaluator, name: []const u8) ?bool {
+        if (std.ascii.eqlIgnoreCase(name, "all")) return true;
+        if (std.ascii.eqlIgnoreCase(name, "screen")) return self.viewport.media_type == .screen;
+        if (std.ascii.eqlIgnoreCase(name, "print")) return self.viewport.media_type == .print;
+        // Deprecated types match nothing; keywords are not types
+        for ([_][]const u8{ "and", "or", "not", "only", "layer" }) |reserved| {
+            if (std.ascii.eqlIgnoreCase(name, reserved)) return null;
+        }
+        return false;
+    }
+
+    /// not <in-parens> | <in-parens> [and <in-parens>]* | <in-parens> [or <in-parens>]*
+    fn condition(self: *Evaluator, without_or: bool) Error!bool {
+        if (self.peekKeyword("not")) {
+            _ = self.next();
+            return !(try self.inParens());
+        }
+        var result = try self.inParens();
+        var joiner: ?bool = null; // true for and, false for or
+        while (true) {
+            const is_and = self.peekKeyword("and");
+            if (!is_and and !self.peekKeyword("or")) break;
+            if (!is_and and without_or) return error.InvalidQuery;
+            // "a and b or c" is invalid without parentheses
+            if (joiner != null and joiner.? != is_and) return error.InvalidQuery;
+            joiner = is_and;
+            _ = self.next();
+            const rhs = try self.inParens();
+            result = if (is_and) result and rhs else result or rhs;
+        }
+        return result;
+    }
+
+    /// ( condition ) | ( feature )
+    fn inParens(self: *Evaluator) Error!bool {
+        try self.expect(.open_paren);
+        const inner = self.peek() orelse return error.InvalidQuery;
+        const result = if (inner == .open_paren or self.peekKeyword("not"))
+            try self.condition(false)
+        else
+            try self.feature();
+        try self.expect(.close_paren);
+        return result;
+    }
+
+    /// name | name: value | name op value | value op name [op value]
+    fn feature(self: *Evaluator) Error!bool {
+        const first = self.next() orelse return error.InvalidQuery;
+        if (first == .ident) {
+            const name = first.ident;
+            const after = self.peek() orelse return error.InvalidQuery;
+            switch (after) {
+                .close_paren => return self.boolean(name),
+                .colon => {
+                    _ = self.next();
+                    return self.plain(name, try self.value());
+                },
+                .delim => {
+                    const op = try self.comparison();
+                    return self.compare(name, op, try self.value());
+                },
+                else => return error.InvalidQuery,
+            }
+        }
+
+        // value op name [op value]
+        const low = try self.valueFrom(first);
+        const low_op = try self.comparison();
+        const name_token = self.next() orelse return error.InvalidQuery;
+        if (name_token != .ident) return error.InvalidQuery;
+        const name = name_token.ident;
+        // "600px < width" reads as "width > 600px"
+        var result = try self.compare(name, low_op.flipped(), low);
+        if ((self.peek() orelse return error.InvalidQuery) == .delim) {
+            const high_op = try self.comparison();
+            // Both ends must point the same way
+            if (high_op.isLess() != low_op.isLess()) return error.InvalidQuery;
+            const high = try self.value();
+            result = result and try self.compare(name, high_op, high);
+        }
+        return result;
+    }
+
+    fn comparison(self: *Evaluator) Error!Op {
+        const first = self.next() orelse return error.InvalidQuery;
+        if (first != .delim) return error.InvalidQuery;
+        // "<=" arrives as two delims with nothing between them
+        const has_equals = self.tokens.pos < self.tokens.css.len and self.tokens.css[self.tokens.pos] == '=';
+        if (has_equals and first.delim != '=') _ = self.tokens.next();
+        return switch (first.delim) {
+            '<' => if (has_equals) .le else .lt,
+            '>' => if (has_equals) .ge else .gt,
+            '=' => .eq,
+            else => error.InvalidQuery,
+        };
+    }
+
+    fn value(self: *Evaluator) Error!Value {
+        return self.valueFrom(self.next() orelse return error.InvalidQuery);
+    }
+
+    fn valueFrom(self: *Evaluator, token: Token) Error!Value {
+        switch (token) {
+            .ident => |name| return .{ .keyword = name },
+            .dimension => |dimension| return .{ .dimension = .{ .amount = dimension.number.value(), .unit = dimension.unit } },
+            .number => |number| {
+                // A ratio: 16/9
+                const saved = self.tokens.pos;
+                if (self.next()) |slash| {
+                    if (slash == .delim and slash.delim == '/') {
+                        const denominator = self.next() orelse return error.InvalidQuery;
+                        if (denominator != .number or denominator.number.value() == 0) return error.InvalidQuery;
+                        return .{ .number = number.value() / denominator.number.value() };
+                    }
+                }
+                self.tokens.pos = saved;
+                return .{ .number = number.value() };
+            },
+            else => return error.InvalidQuery,
+        }
+    }
+
+    /// (name) is true when the feature is not zero or "none"
+    fn boolean(self: *const Evaluator, name: []const u8) Error!bool {
+        if (self.rangeFeature(name)) |current| return current != 0;
+        const current = self.discreteFeature(name) orelse return error.InvalidQuery;
+        return !std.mem.eql(u8, current, "none") and !std.mem.eql(u8, current, "no-preference");
+    }
+
+    /// name: value, including min- and max- prefixes
+    fn plain(self: *const Evaluator, name: []const u8, wanted: Value) Error!bool {
+        if (std.ascii.startsWithIgnoreCase(name, "min-")) return self.compare(name[4..], .ge, wanted);
+        if (std.ascii.startsWithIgnoreCase(name, "max-")) return self.compare(name[4..], .le, wanted);
+        if (std.ascii.startsWithIgnoreCase(name, "-webkit-min-")) return self.compare(name[12..], .ge, wanted);
+        if (std.ascii.startsWithIgnoreCase(name, "-webkit-max-")) return self.compare(name[12..], .le, wanted);
+        if (self.rangeFeature(name) != null) return self.compare(name, .eq, wanted);
+
+        const current = self.discreteFeature(name) orelse return error.InvalidQuery;
+        if (wanted != .keyword) return error.InvalidQuery;
+        // A wide-gamut display also covers the narrower gamuts
+        if (std.ascii.eqlIgnoreCase(name, "color-gamut")) {
+            return std.ascii.eqlIgnoreCase(wanted.keyword, "srgb") or std.ascii.eqlIgnoreCase(wanted.keyword, "p3");
+        }
+        return std.ascii.eqlIgnoreCase(current, wanted.keyword);
+    }
+
+    fn compare(self: *const Evaluator, name: []const u8, op: Op, wanted: Value) Error!bool {
+        const current = self.rangeFeature(name) orelse return error.InvalidQuery;
+        const target = convert(name, wanted) orelse return error.InvalidQuery;
+        return switch (op) {
+            .lt => current < target,
+            .le => current <= target,
+            .gt => current > target,
+            .ge => current >= target,
+            .eq => current == target,
+        };
+    }
+
+    /// The viewport's value for a range feature, in the unit `convert`
+    /// produces
+    fn rangeFeature(self: *const Evaluator, name: []const u8) ?f32 {
+        const v = self.viewport;
+        const features = .{
+            .{ "width", v.width },                   .{ "height", v.height },
+            .{ "device-width", v.width },            .{ "device-height", v.height },
+            .{ "aspect-ratio", v.width / v.height }, .{ "resolution", v.scale },
+            .{ "device-pixel-ratio", v.scale },      .{ "color", @as(f32, 8) },
+            .{ "monochrome", @as(f32, 0) },
+        };
+        inline for (features) |entry| {
+            if (std.ascii.eqlIgnoreCase(name, entry[0])) return entry[1];
+        }
+        return null;
+    }
+
+    fn discreteFeature(self: *const Evaluator, name: []const u8) ?[]const u8 {
+        const v = self.viewport;
+        const pointer: []const u8 = if (v.hover) "fine" else "coarse";
+        const hover: []const u8 = if (v.hover) "hover" else "none";
+        const features = .{
+            .{ "orientation", if (v.height >= v.width) "portrait" else "landscape" },
+            .{ "prefers-color-scheme", @tagName(v.color_scheme) },
+            .{ "prefers-reduced-motion", if (v.reduced_motion) "reduce" else "no-preference" },
+            .{ "prefers-contrast", "no-preference" },
+            .{ "hover", hover },
+            .{ "any-hover", hover },
+            .{ "pointer", pointer },
+            .{ "any-pointer", pointer },
+            // The engine runs no scripts
+            .{ "scripting", "none" },
+            .{ "forced-colors", "none" },
+            .{ "inverted-colors", "none" },
+            .{ "color-gamut", "p3" },
+        };
+        inline for (features) |entry| {
+            if (std.ascii.eqlIgnoreCase(name, entry[0])) return entry[1];
+        }
+        return null;
+    }
+};
+
+const Op = enum {
+    lt,
+    le,
+    gt,
+    ge,
+    eq,
+
+    fn flipped(self: Op) Op {
+        return switch (self) {
+            .lt => .gt,
+            .le => .ge,
+            .gt => .lt,
+            .ge => .le,
+            .eq => .eq,
+        };
+    }
+
+    fn isLess(self: Op) bool {
+        return self == .lt or self == .le;
+    }
+};
+
+const Value = union(enum) {
+    keyword: []const u8,
+    number: f32,
+    dimension: struct { amount: f32, unit: []const u8 },
+};
+
+/// A query value in the unit of feature `name`: px for lengths, dppx
+/// for resolution, plain numbers otherwise
+fn convert(name: []const u8, wanted: Value) ?f32 {
+    const is_length = std.ascii.endsWithIgnoreCase(name, "width") or std.ascii.endsWithIgnoreCase(name, "height");
+    switch (wanted) {
+        .keyword => return null,
+        .number => |number| {
+            // Unitless lengths are only valid as 0
+            if (is_length and number != 0) return null;
+            return number;
+        },
+        .dimension => |dimension| {
+            const unit = dimension.unit;
+            if (is_length) {
+                if (std.ascii.eqlIgnoreCase(unit, "px")) return dimension.amount;
+                if (std.ascii.eqlIgnoreCase(unit, "em") or std.ascii.eqlIgnoreCase(unit, "rem")) return dimension.amount * QUERY_FONT_SIZE;
+                return null;
+            }
+            if (std.ascii.eqlIgnoreCase(name, "resolution")) {
+                if (std.ascii.eqlIgnoreCase(unit, "dppx") or std.ascii.eqlIgnoreCase(unit, "x")) return dimension.amount;
+                if (std.ascii.eqlIgnoreCase(unit, "dpi")) return dimension.amount / 96;
+                if (std.ascii.eqlIgnoreCase(unit, "dpcm")) return dimension.amount * 2.54 / 96;
+            }
+            return null;
+        },
+    }
+}
+
+// =============================================================================
+// Viewport-filtered rule index
+// =============================================================================
+
+/// The rule index of one stylesheet as seen from the current viewport
+pub const ViewportIndex = struct {
+    allocator: std.mem.Allocator,
+    stylesheet: *const parser.Stylesheet,
+    /// Every rule of the sheet; must outlive this
+    full: *const matcher.RuleIndex,
+    viewport: Viewport,
+    /// Per entry of stylesheet.media: does the query apply?
+    active: []bool,
+    /// Rules outside @media plus those in active blocks
+    index: matcher.RuleIndex,
+    /// Times the index was rebuilt after a breakpoint
+    rebuilds: u32 = 0,
+
+    pub fn init(
+        allocator: std.mem.Allocator,
+        stylesheet: *const parser.Stylesheet,
+        full: *const matcher.RuleIndex,
+        viewport: Viewport,
+    ) !ViewportIndex {
+        const active = try allocator.alloc(bool, stylesheet.media.len);
+        errdefer allocator.free(active);
+        evaluateAll(stylesheet, viewport, active);
+        return .{
+            .allocator = allocator,
+            .stylesheet = stylesheet,
+            .full = full,
+            .viewport = viewport,
+            .active = active,
+            .index = try full.forMedia(allocator, stylesheet, active),
+        };
+    }
+
+    pub fn deinit(self: *ViewportIndex) void {
+        self.index.deinit();
+        self.allocator.free(self.active);
+    }
+
+    /// Move to `viewport`. Returns whether any @media block changed its
+    /// answer, in which case the index was rebuilt.
+    pub fn setViewport(self: *ViewportIndex, viewport: Viewport) !bool {
+        if (std.meta.eql(viewport, self.viewport)) return false;
+
+        const previous = try self.allocator.dupe(bool, self.active);
+        defer self.allocator.free(previous);
+        evaluateAll(self.stylesheet, viewport, self.active);
+        if (std.mem.eql(bool, previous, self.active)) {
+            self.viewport = viewport;
+            return false;
+        }
+
+        // On failure keep the old viewport too, so a retry rebuilds
+        const rebuilt = self.full.forMedia(self.allocator, self.stylesheet, self.active) catch |err| {
+            @memcpy(self.active, previous);
+            return err;
+        };
+        self.viewport = viewport;
+        self.index.deinit();
+        self.index = rebuilt;
+        self.rebuilds += 1;
+        return true;
+    }
+
+    pub fn sheet(self: *const ViewportIndex) cascade.Sheet {
+        return .{ .stylesheet = self.stylesheet, .index = &self.index };
+    }
+};
+
+fn evaluateAll(stylesheet: *const parser.Stylesheet, viewport: Viewport, active: []bool) void {
+    for (stylesheet.media, active, 0..) |query, *flag, i| {
+        flag.* = i == parser.ALL_MEDIA or matches(query, viewport);
+    }
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "media types and features" {
+    const desktop: Viewport = .{ .width = 1024, .height = 768 };
+    try std.testing.expect(matches("", desktop));
+    try std.testing.expect(matches("screen", desktop));
+    try std.testing.expect(matches("all and (min-width: 768px)", desktop));
+    try std.testing.expect(!matches("print", desktop));
+    try std.testing.expect(matches("not print", desktop));
+    try std.testing.expect(matches("only screen and (max-width: 64em)", desktop));
+    try std.testing.expect(!matches("(max-width: 767.98px)", desktop));
+    try std.testing.expect(matches("print, (orientation: landscape)", desktop));
+    try std.testing.expect(!matches("(prefers-color-scheme: dark)", desktop));
+    try std.testing.expect(matches("(prefers-color-scheme: dark)", .{ .color_scheme = .dark }));
+    try std.testing.expect(matches("(-webkit-min-device-pixel-ratio: 2), (min-resolution: 192dpi)", desktop));
+    try std.testing.expect(matches("(hover: hover) and (pointer: fine)", desktop));
+    try std.testing.expect(!matches("(prefers-reduced-motion)", desktop));
+    try std.testing.expect(matches("(min-aspect-ratio: 4/3)", desktop));
+    try std.testing.expect(matches("(color)", desktop));
+}
+
+test "range syntax and boolean logic" {
+    const tablet: Viewport = .{ .width = 800, .height = 1000 };
+    try std.testing.expect(matches("(width >= 600px)", tablet));
+    try std.testing.expect(matches("(600px <= width < 900px)", tablet));
+    try std.testing.expect(!matches("(900px < width)", tablet));
+    try std.testing.expect(matches("(400px < width <= 800px)", tablet));
+    try std.testing.expect(matches("not all and (orientation: landscape)", tablet));
+    try std.testing.expect(matches("(not (hover: none)) and ((width > 1000px) or (orientation: portrait))", tablet));
+    try std.testing.expect(matches("not (min-width: 1200px)", tablet));
+
+    // Malformed or unknown: false
+    try std.testing.expect(!matches("(min-width: 600px) and (max-width: 1000px) or (color)", tablet));
+    try std.testing.expect(!matches("(600px < width > 900px)", tablet));
+    try std.testing.expect(!matches("(min-width: 600)", tablet));
+    try std.testing.expect(!matches("(display-mode: standalone)", tablet));
+    try std.testing.expect(!matches("screen and", tablet));
+    try std.testing.expect(!matches("only (color)", tablet));
+}
+
+test "viewport index rebuilds only across breakpoints" {
+    const allocator = std.testing.allocator;
+    const sheet = try parser.parse(allocator,
+        \\.a { color: red }
+        \\@media (min-width: 768px) { .a { color: blue } .b { color: blue } }
+        \\@media print { .a { color: black } }
+        \\@media (prefers-color-scheme: dark) { .a { color: white } }
+    );
+    defer sheet.deinit();
+    var full = try matcher.RuleIndex.build(allocator, &sheet);
+    defer full.deinit();
+
+    var view = try ViewportIndex.init(allocator, &sheet, &full, .{ .width = 500 });
+    defer view.deinit();
+    try std.testing.expectEqual(@as(usize, 1), view.index.entries.len);
+    try std.testing.expect(view.index.classes.get("b") == null);
+
+    // Still below the breakpoint: nothing to do
+    try std.testing.expect(!try view.setViewport(.{ .width = 700 }));
+    try std.testing.expect(try view.setViewport(.{ .width = 1000 }));
+    try std.testing.expectEqual(@as(usize, 3), view.index.entries.len);
+    try std.testing.expectEqual(@as(u32, 2), view.index.classes.get("a").?.len);
+    try std.testing.expect(!try view.setViewport(.{ .width = 1400, .height = 900 }));
+    try std.testing.expect(try view.setViewport(.{ .width = 1400, .height = 900, .color_scheme = .dark }));
+    try std.testing.expectEqual(@as(u32, 2), view.rebuilds);
+}
@@ -0,0 +1,393 @@
+//! Vulpes Browser - CSS Rule Parser
+//!
+//! Turns a stylesheet into a flat list of style rules and their
+//! declarations, following the rule and declaration consumption of CSS
+//! Syntax Level 3. Selectors and values stay slices of the source text;
+//! the stylesheet must outlive the parsed result.
+//!
+//! Rules inside @media blocks are kept and tagged with their query.
+//! Every other at-rule (@font-face, @keyframes, @supports, @import, ...)
+//! is skipped by scanning bytes for its ';' or balanced block rather than
+//! tokenizing it.
+//!
+//! The result lives in one arena sized to fit: rules and declarations are
+//! built in growable lists and copied over once parsing finishes.
+//!
+
+const std = @import("std");
+const tokenizer = @import("tokenizer.zig");
+const Tokenizer = tokenizer.Tokenizer;
+
+pub const Declaration = struct {
+    /// Property name as written
+    name: []const u8,
+    /// Value text, trimmed, without "!important"
+    value: []const u8,
+    important: bool,
+};
+
+pub const Rule = struct {
+    /// Selector list as written, trimmed
+    selectors: []const u8,
+    /// Range in Stylesheet.declarations
+    first_declaration: u32,
+    declaration_count: u32,
+    /// Index into Stylesheet.media; ALL_MEDIA outside any @media block
+    media: u32,
+};
+
+/// Media index of rules that apply everywhere
+pub const ALL_MEDIA: u32 = 0;
+
+pub const Stylesheet = struct {
+    arena: std.heap.ArenaAllocator,
+    /// Style rules in source order
+    rules: []const Rule,
+    declarations: []const Declaration,
+    /// @media queries as written; entry ALL_MEDIA is empty
+    media: []const []const u8,
+
+    pub fn deinit(self: Stylesheet) void {
+        self.arena.deinit();
+    }
+
+    pub fn declarationsOf(self: *const Stylesheet, rule: Rule) []const Declaration {
+        return self.declarations[rule.first_declaration..][0..rule.declaration_count];
+    }
+};
+
+/// Parse a stylesheet. Malformed rules and declarations are dropped, as
+/// the spec's error recovery prescribes; only allocation can fail.
+pub fn parse(allocator: std.mem.Allocator, css: []const u8) !Stylesheet {
+    var parser: Parser = .{ .allocator = allocator, .tokens = .init(css) };
+    defer parser.deinit();
+
+    try parser.media.append(allocator, "");
+    try parser.parseRules(false, ALL_MEDIA);
+
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    errdefer arena.deinit();
+    const owned = arena.allocator();
+    const rules = try owned.dupe(Rule, parser.rules.items);
+    const declarations = try owned.dupe(Declaration, parser.declarations.items);
+    const media = try owned.dupe([]const u8, parser.media.items);
+
+    return .{
+        .arena = arena,
+        .rules = rules,
+        .declarations = declarations,
+        .media = media,
+    };
+}
+
+/// Parse the declaration list of a style="" attribute, appending to
+/// `out`. Values are slices of `text`.
+pub fn parseInline(allocator: std.mem.Allocator, text: []const u8, out: *std.ArrayListUnmanaged(Declaration)) !void {
+    var parser: Parser = .{ .allocator = allocator, .tokens = .init(text) };
+    defer parser.deinit();
+    try parser.parseDeclarations();
+    try out.appendSlice(allocator, parser.declarations.items);
+}
+
+const Parser = struct {
+    allocator: std.mem.Allocator,
+    tokens: Tokenizer,
+    rules: std.ArrayListUnmanaged(Rule) = .empty,
+    declarations: std.ArrayListUnmanaged(Declaration) = .empty,
+    media: std.ArrayListUnmanaged([]const u8) = .empty,
+
+    fn deinit(self: *Parser) void {
+        self.rules.deinit(self.allocator);
+        self.declarations.deinit(self.allocator);
+        self.media.deinit(self.allocator);
+    }
+
+    /// Rules up to the end of input or, when `nested`, the '}' closing
+    /// the enclosing @media block.
+    fn parseRules(self: *Parser, nested: bool, media: u32) std.mem.Allocator.Error!void {
+        while (true) {
+            const start = self.tokens.pos;
+            const token = self.tokens.next() orelse return;
+            switch (token) {
+                .whitespace, .cdo, .cdc => {},
+                .close_brace => {
+                    if (nested) return;
+                    // At the top level a stray '}' starts a rule's prelude
+                    self.tokens.pos = start;
+                    try self.parseStyleRule(nested, media);
+                },
+                .at_keyword => |name| try self.parseAtRule(name, nested),
+                else => {
+                    // Rewind so the prelude includes the token just read
+                    self.tokens.pos = start;
+                    try self.parseStyleRule(nested, media);
+                },
+            }
+        }
+    }
+
+    fn parseAtRule(self: *Parser, name: []const u8, nested: bool) !void {
+        // Nested @media would need its queries combined; treat it as unsupported
+        if (!nested and std.ascii.eqlIgnoreCase(name, "media")) {
+            const start = self.tokens.pos;
+            const prelude = self.consumePrelude(nested, true) orelse return;
+            if (!prelude.valid) {
+                // No query matches, so none of the block's rules apply
+                self.tokens.pos = skipAtRule(self.tokens.css, prelude.end, nested);
+                return;
+            }
+            try self.media.append(self.allocator, trim(self.tokens.css[start..prelude.end]));
+            try self.parseRules(true, @intCast(self.media.items.len - 1));
+            return;
+        }
+        self.tokens.pos = skipAtRule(self.tokens.css, self.tokens.pos, nested);
+    }
+
+    fn parseStyleRule(self: *Parser, nested: bool, media: u32) !void {
+        const start = self.tokens.pos;
+        const prelude = self.consumePrelude(nested, false) orelse return;
+        const selectors = trim(self.tokens.css[start..prelude.end]);
+
+        const first = self.declarations.items.len;
+        try self.parseDeclarations();
+        if (selectors.len == 0 or !prelude.valid) {
+            self.declarations.shrinkRetainingCapacity(first);
+            return;
+        }
+        try self.rules.append(self.allocator, .{
+            .selectors = selectors,
+            .first_declaration = @intCast(first),
+            .declaration_count = @intCast(self.declarations.items.len - first),
+            .media = media,
+        });
+    }
+
+    const Prelude = struct {
+        /// Where the prelude ends, at its block's '{'
+        end: usize,
+        /// False once a '}' is part of it: no selector or media query
+        /// can hold one
+        valid: bool,
+    };
+
+    /// Consume a prelude and the '{' after it. Null when no block follows:
+    /// input ran out, an at-rule ended at ';', or a '}' closed the
+    /// enclosing block (left for the caller). Outside any block a '}' has
+    /// nothing to close and becomes part of the prelude.
+    fn consumePrelude(self: *Parser, nested: bool, at_rule: bool) ?Prelude {
+        var valid = true;
+        while (true) {
+            const end = self.tokens.pos;
+            const token = self.tokens.next() orelse return null;
+            switch (token) {
+                .open_brace => return .{ .end = end, .valid = valid },
+                .semicolon => if (at_rule) return null,
+                .close_brace => {
+                    if (nested) {
+                        self.tokens.pos = end;
+                        return null;
+                    }
+                    valid = false;
+                },
+                else => {},
+            }
+        }
+    }
+
+    /// Declarations up to and including the block's closing '}'.
+    fn parseDeclarations(self: *Parser) !void {
+        const css = self.tokens.css;
+        while (true) {
+            const start = self.tokens.pos;
+            const token = self.tokens.next() orelse return;
+            switch (token) {
+                .whitespace, .semicolon => {},
+                .close_brace => return,
+                .ident => |name| {
+                    var colon = self.tokens.next();
+                    if (colon != null and colon.? == .whitespace) colon = self.tokens.next();
+                    if (colon == null or colon.? != .colon) {
+                        self.tokens.pos = skipAtRule(css, start, true);
+                        continue;
+                    }
+
+                    const value_start = self.tokens.pos;
+                    const value, const important = splitImportant(trim(css[value_start..self.consumeValue()]));
+                    try self.declarations.append(self.allocator, .{
+                        .name = name,
+                        .value = value,
+                        .important = important,
+                    });
+                },
+                // Nested at-rules and nested style rules are not supported
+                else => self.tokens.pos = skipAtRule(css, start, true),
+            }
+        }
+    }
+
+    /// Consume a value up to ';' or the block's closing '}', returning
+    /// where it ends. The ';' is consumed; the '}' is left for the caller.
+    fn consumeValue(self: *Parser) usize {
+        var depth: usize = 0;
+        while (true) {
+            const end = self.tokens.pos;
+            const token = self.tokens.next() orelse return end;
+            switch (token) {
+                .open_paren, .open_bracket, .open_brace, .function => depth += 1,
+                .close_paren, .close_bracket => depth -|= 1,
+                .close_brace => {
+                    if (depth == 0) {
+                        self.tokens.pos = end;
+                        return end;
+                    }
+                    depth -= 1;
+                },
+                .semicolon => if (depth == 0) return end,
+                else => {},
+            }
+        }
+    }
+};
+
+/// Position after the at-rule or stray construct starting at `pos`: past
+/// its ';' or its balanced block, or, when `nested`, at the '}' of the
+/// enclosing block. Outside any block a stray '}' is skipped over.
+/// Only braces, semicolons, strings and comments are looked at.
+fn skipAtRule(css: []const u8, pos: usize, nested: bool) usize {
+    var depth: usize = 0;
+    var i = pos;
+    while (std.mem.indexOfAnyPos(u8, css, i, "{};\"'/\\")) |stop| {
+        i = stop + 1;
+        switch (css[stop]) {
+            '{' => depth += 1,
+            '}' => {
+                if (depth == 0) {
+                    if (nested) return stop;
+                    continue;
+                }
+                depth -= 1;
+                if (depth == 0) return i;
+            },
+            ';' => if (depth == 0) return i,
+            '"', '\'' => {
+                var string: Tokenizer = .{ .css = css, .pos = stop };
+                _ = string.next();
+                i = string.pos;
+            },
+            '/' => if (i < css.len and css[i] == '*') {
+                i = tokenizer.commentEnd(css, i + 1);
+            },
+            // Escaped byte
+            else => i = @min(i + 1, css.len),
+        }
+    }
+    return css.len;
+}
+
+const whitespace = " \t\n\r\x0c";
+
+fn trim(text: []const u8) []const u8 {
+    return std.mem.trim(u8, text, whitespace);
+}
+
+/// Split a trailing "!important" off a trimmed value.
+fn splitImportant(value: []const u8) struct { []const u8, bool } {
+    const keyword = "important";
+    if (!std.ascii.endsWithIgnoreCase(value, keyword)) return .{ value, false };
+    const rest = trim(value[0 .. value.len - keyword.len]);
+    if (rest.len == 0 or rest[rest.len - 1] != '!') return .{ value, false };
+    return .{ trim(rest[0 .. rest.len - 1]), true };
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "style rules and declarations" {
+    const sheet = try parse(std.testing.allocator,
+        \\/* reset */
+        \\h1, h2 { margin: 0 0 .5em; font-weight: bold !important }
+        \\a:hover{color:rgb(0, 0, 255);background:url("x;y.png")}
+        \\
+    );
+    defer sheet.deinit();
+
+    try std.testing.expectEqual(@as(usize, 2), sheet.rules.len);
+    try std.testing.expectEqualStrings("h1, h2", sheet.rules[0].selectors);
+
+    const heading = sheet.declarationsOf(sheet.rules[0]);
+    try std.testing.expectEqual(@as(usize, 2), heading.len);
+    try std.testing.expectEqualStrings("margin", heading[0].name);
+    try std.testing.expectEqualStrings("0 0 .5em", heading[0].value);
+    try std.testing.expect(!heading[0].important);
+    try std.testing.expectEqualStrings("bold", heading[1].value);
+    try std.testing.expect(heading[1].important);
+
+    const link = sheet.declarationsOf(sheet.rules[1]);
+    try std.testing.expectEqualStrings("a:hover", sheet.rules[1].selectors);
+    try std.testing.expectEqualStrings("rgb(0, 0, 255)", link[0].value);
+    try std.testing.expectEqualStrings("url(\"x;y.png\")", link[1].value);
+}
+
+test "media blocks are kept, other at-rules skipped" {
+    const sheet = try parse(std.testing.allocator,
+        \\@charset "utf-8";
+        \\@import url(theme.css) screen;
+        \\@font-face { font-family: "X}"; src: url(x.woff2) }
+        \\@keyframes spin { from { transform: rotate(0) } to { transform: rotate(360deg) } }
+        \\p { color: black }
+        \\@media (min-width: 768px) {
+        \\  .col { width: 50% }
+        \\  @supports (display: grid) { .col { display: grid } }
+        \\  .row { display: flex }
+        \\}
+        \\@supports (gap: 1px) { .gap { gap: 1px } }
+        \\em { font-style: italic }
+    );
+    defer sheet.deinit();
+
+    try std.testing.expectEqual(@as(usize, 4), sheet.rules.len);
+    try std.testing.expectEqualStrings("p", sheet.rules[0].selectors);
+    try std.testing.expectEqual(ALL_MEDIA, sheet.rules[0].media);
+    try std.testing.expectEqualStrings(".col", sheet.rules[1].selectors);
+    try std.testing.expectEqualStrings("(min-width: 768px)", sheet.media[sheet.rules[1].media]);
+    try std.testing.expectEqualStrings(".row", sheet.rules[2].selectors);
+    try std.testing.expectEqual(sheet.rules[1].media, sheet.rules[2].media);
+    try std.testing.expectEqualStrings("em", sheet.rules[3].selectors);
+    try std.testing.expectEqual(ALL_MEDIA, sheet.rules[3].media);
+}
+
+test "error recovery drops only the broken part" {
+    const sheet = try parse(std.testing.allocator,
+        \\a { color red; width: 1px; &:hover { color: blue } height: 2px }
+        \\{ orphan: 1 }
+        \\} b { top: 0 }
+        \\@media } print { d { top: 0 } }
+        \\@import } x; e { top: 0 }
+        \\c { unterminated: "x
+    );
+    defer sheet.deinit();
+
+    // A stray '}' is part of the prelude "} b", so that rule is dropped
+    // whole, as is the @media block whose query holds one; @import still
+    // ends at its ';'
+    try std.testing.expectEqual(@as(usize, 3), sheet.rules.len);
+    const a = sheet.declarationsOf(sheet.rules[0]);
+    try std.testing.expectEqual(@as(usize, 2), a.len);
+    try std.testing.expectEqualStrings("width", a[0].name);
+    try std.testing.expectEqualStrings("height", a[1].name);
+    try std.testing.expectEqualStrings("e", sheet.rules[1].selectors);
+    try std.testing.expectEqualStrings("c", sheet.rules[2].selectors);
+    try std.testing.expectEqual(@as(usize, 1), sheet.media.len);
+}
+
+test "inline declarations" {
+    var declarations: std.ArrayListUnmanaged(Declaration) = .empty;
+    defer declarations.deinit(std.testing.allocator);
+    try parseInline(std.testing.allocator, "color: red;; font-weight : bold !important; width", &declarations);
+
+    try std.testing.expectEqual(@as(usize, 2), declarations.items.len);
+    try std.testing.expectEqualStrings("red", declarations.items[0].value);
+    try std.testing.expectEqualStrings("font-weight", declarations.items[1].name);
+    try std.testing.expect(declarations.items[1].important);
+}
@@ -0,0 +1,734 @@
+//! Vulpes Browser - CSS Selectors
+//!
+//! Parses selector lists (Selectors Level 3 plus the common Level 4
+//! attribute flag) and matches one selector against an element of the
+//! html/dom.zig tree.
+//!
+//! Compound selectors are stored right to left: compounds[0] is the
+//! subject, and each compound records how it relates to the compound on
+//! its left. Matching starts at the subject and walks outwards, so most
+//! candidates are rejected on their own tag or class before any ancestor
+//! is visited.
+//!
+//! Only static state is modelled. Dynamic pseudo-classes (:hover,
+//! :focus, :visited, ...) and pseudo-elements never match, and an
+//! unknown pseudo-class makes its selector never match rather than
+//! invalidating the whole list.
+//!
+//! :not(), :is() and :where() take a list of simple selectors, and the
+//! :nth-child() family takes An+B. Anything more in their arguments (a
+//! compound, a combinator, a nested :not(), "of S") invalidates the list,
+//! so the rule is dropped instead of silently matching the wrong
+//! elements. Other functional pseudo-classes (:has(), :lang(), ...) never
+//! match.
+//!
+
+const std = @import("std");
+const dom = @import("../html/dom.zig");
+const tokenizer = @import("tokenizer.zig");
+const Tokenizer = tokenizer.Tokenizer;
+
+pub const Combinator = enum {
+    descendant,
+    child,
+    next_sibling,
+    subsequent_sibling,
+};
+
+pub const Attribute = struct {
+    pub const Op = enum {
+        /// [name]
+        exists,
+        /// [name=value]
+        equals,
+        /// [name~=value]
+        includes,
+        /// [name|=value]
+        dash,
+        /// [name^=value]
+        prefix,
+        /// [name$=value]
+        suffix,
+        /// [name*=value]
+        substring,
+    };
+
+    name: []const u8,
+    op: Op,
+    value: []const u8,
+    ignore_case: bool,
+};
+
+pub const Pseudo = enum {
+    root,
+    first_child,
+    last_child,
+    only_child,
+    link,
+};
+
+/// :nth-child(An+B) and friends: the element's 1-based position among
+/// its siblings is A*n + B for some n >= 0
+pub const Nth = struct {
+    pub const Kind = enum {
+        child,
+        last_child,
+        of_type,
+        last_of_type,
+    };
+
+    kind: Kind,
+    a: i32,
+    b: i32,
+};
+
+pub const Simple = union(enum) {
+    /// Lowercase tag name
+    tag: []const u8,
+    id: []const u8,
+    class: []const u8,
+    attribute: Attribute,
+    pseudo: Pseudo,
+    /// A state or pseudo-element this engine never has
+    never,
+    nth: Nth,
+    /// :not(): none of the arguments match
+    not: []const Simple,
+    /// :is(): one of the arguments matches
+    is: []const Simple,
+    /// :where(): as :is(), but adds no specificity
+    where: []const Simple,
+};
+
+pub const Compound = struct {
+    /// Empty for a lone '*'
+    simples: []const Simple,
+    /// Relation to the compound on the left (unused on the leftmost)
+    combinator: Combinator,
+};
+
+pub const Selector = struct {
+    /// Right to left; compounds[0] is the subject
+    compounds: []const Compound,
+    /// ids << 16 | classes << 8 | tags, each saturating at 255
+    specificity: u32,
+
+    pub fn subject(self: Selector) Compound {
+        return self.compounds[0];
+    }
+};
+
+/// Parse a selector list. An invalid list yields no selectors, as the
+/// spec drops the whole rule. Results are allocated from `arena`;
+/// `scratch` is used only while parsing.
+pub fn parseList(arena: std.mem.Allocator, scratch: std.mem.Allocator, text: []const u8) ![]const Selector {
+    var parser: ListParser = .{ .arena = arena, .scratch = scratch };
+    defer parser.deinit();
+    return parser.parse(text) catch |err| switch (err) {
+        error.InvalidSelector => &.{},
+        error.OutOfMemory => error.OutOfMemory,
+    };
+}
+
+const ListParser = struct {
+    const Error = error{ InvalidSelector, OutOfMemory };
+
+    arena: std.mem.Allocator,
+    scratch: std.mem.Allocator,
+    selectors: std.ArrayListUnmanaged(Selector) = .empty,
+    /// Compounds of the selector being parsed, left to right
+    compounds: std.ArrayListUnmanaged(Compound) = .empty,
+    simples: std.ArrayListUnmanaged(Simple) = .empty,
+    /// The current compound has content (a simple selector or '*')
+    started: bool = false,
+    /// Whitespace followed the current compound
+    space: bool = false,
+    /// Explicit combinator after the current compound
+    combinator: ?Combinator = null,
+    /// Relation of the current compound to the previous one
+    left: Combinator = .descendant,
+
+    fn deinit(self: *ListParser) void {
+        self.selectors.deinit(self.scratch);
+        self.compounds.deinit(self.scratch);
+        self.simples.deinit(self.scratch);
+    }
+
+    fn parse(self: *ListParser, text: []const u8) ![]const Selector {
+        var tokens = Tokenizer.init(text);
+        while (true) {
+            const token = tokens.next() orelse {
+                try self.endSelector();
+                break;
+            };
+            switch (token) {
+                .whitespace => self.space = self.started,
+                .comma => try self.endSelector(),
+                .delim => |c| switch (c) {
+                    '>', '+', '~' => {
+                        if (!self.started or self.combinator != null) return error.InvalidSelector;
+                        self.combinator = switch (c) {
+                            '>' => .child,
+                            '+' => .next_sibling,
+                            else => .subsequent_sibling,
+                        };
+                    },
+                    '*' => try self.beginSimple(true),
+                    '.' => try self.addSimple(try self.parseSimple(&tokens, token, false)),
+                    else => return error.InvalidSelector,
+                },
+                .ident => {
+                    try self.beginSimple(true);
+                    try self.simples.append(self.scratch, try self.parseSimple(&tokens, token, false));
+                },
+                .hash, .open_bracket, .colon => try self.addSimple(try self.parseSimple(&tokens, token, false)),
+                else => return error.InvalidSelector,
+            }
+        }
+        return self.arena.dupe(Selector, self.selectors.items);
+    }
+
+    /// One simple selector other than '*', starting with `token`. Inside
+    /// the arguments of :not(), :is() or :where(), those three are not
+    /// allowed again.
+    fn parseSimple(self: *ListParser, tokens: *Tokenizer, token: tokenizer.Token, in_arguments: bool) Error!Simple {
+        switch (token) {
+            .ident => |name| return .{ .tag = try lowerName(self.arena, try tokenizer.unescape(self.arena, name)) },
+            .delim => |c| {
+                if (c != '.') return error.InvalidSelector;
+                const name = tokens.next() orelse return error.InvalidSelector;
+                if (name != .ident) return error.InvalidSelector;
+                return .{ .class = try tokenizer.unescape(self.arena, name.ident) };
+            },
+            .hash => |hash| {
+                if (!hash.is_id) return error.InvalidSelector;
+                return .{ .id = try tokenizer.unescape(self.arena, hash.value) };
+            },
+            .open_bracket => {
+                var attribute = try parseAttribute(tokens);
+                attribute.name = try tokenizer.unescape(self.arena, attribute.name);
+                attribute.value = try tokenizer.unescape(self.arena, attribute.value);
+                return .{ .attribute = attribute };
+            },
+            .colon => return self.parsePseudo(tokens, in_arguments),
+            else => return error.InvalidSelector,
+        }
+    }
+
+    /// Pseudo-class or pseudo-element after its ':'
+    fn parsePseudo(self: *ListParser, tokens: *Tokenizer, in_arguments: bool) Error!Simple {
+        const token = tokens.next() orelse return error.InvalidSelector;
+        switch (token) {
+            .ident => |name| {
+                const pseudos = [_]struct { []const u8, Pseudo }{
+                    .{ "root", .root },
+                    .{ "first-child", .first_child },
+                    .{ "last-child", .last_child },
+                    .{ "only-child", .only_child },
+                    .{ "link", .link },
+                    .{ "any-link", .link },
+                };
+                for (pseudos) |entry| {
+                    if (std.ascii.eqlIgnoreCase(name, entry[0])) return .{ .pseudo = entry[1] };
+                }
+                return .never;
+            },
+            .colon => {
+                // ::before and friends
+                const name = tokens.next() orelse return error.InvalidSelector;
+                if (name == .function) try skipArguments(tokens) else if (name != .ident) return error.InvalidSelector;
+                return .never;
+            },
+            .function => |name| {
+                const nths = [_]struct { []const u8, Nth.Kind }{
+                    .{ "nth-child", .child },
+                    .{ "nth-last-child", .last_child },
+                    .{ "nth-of-type", .of_type },
+                    .{ "nth-last-of-type", .last_of_type },
+                };
+                for (nths) |entry| {
+                    if (std.ascii.eqlIgnoreCase(name, entry[0])) return .{ .nth = try parseNth(tokens, entry[1]) };
+                }
+
+                const is_not = std.ascii.eqlIgnoreCase(name, "not");
+                const is_is = std.ascii.eqlIgnoreCase(name, "is") or std.ascii.eqlIgnoreCase(name, "matches");
+                const is_where = std.ascii.eqlIgnoreCase(name, "where");
+                if (is_not or is_is or is_where) {
+                    if (in_arguments) return error.InvalidSelector;
+                    const arguments = try self.parseArguments(tokens);
+                    if (is_not) return .{ .not = arguments };
+                    if (is_is) return .{ .is = arguments };
+                    return .{ .where = arguments };
+                }
+
+                // :has(), :lang(), ... are not evaluated
+                try skipArguments(tokens);
+                return .never;
+            },
+            else => return error.InvalidSelector,
+        }
+    }
+
+    /// Arguments of :not(), :is() or :where() after the function token:
+    /// simple selectors separated by commas
+    fn parseArguments(self: *ListParser, tokens: *Tokenizer) Error![]const Simple {
+        var arguments: std.ArrayListUnmanaged(Simple) = .empty;
+        defer arguments.deinit(self.scratch);
+        while (true) {
+            const token = nextSignificant(tokens) orelse return error.InvalidSelector;
+            try arguments.append(self.scratch, try self.parseSimple(tokens, token, true));
+            const after = nextSignificant(tokens) orelse return error.InvalidSelector;
+            switch (after) {
+                .comma => {},
+                .close_paren => break,
+                else => return error.InvalidSelector,
+            }
+        }
+        return self.arena.dupe(Simple, arguments.items);
+    }
+
+    fn addSimple(self: *ListParser, simple: Simple) !void {
+        try self.beginSimple(false);
+        try self.simples.append(self.scratch, simple);
+    }
+
+    /// Start a simple selector, closing the current compound first when a
+    /// combinator separates them. Type selectors must lead a compound.
+    fn beginSimple(self: *ListParser, is_type: bool) !void {
+        if (self.started and (self.space or self.combinator != null)) {
+            try self.endCompound();
+            self.left = self.combinator orelse .descendant;
+            self.combinator = null;
+        } else if (is_type and self.started) {
+            return error.InvalidSelector;
+        }
+        self.started = true;
+        self.space = false;
+    }
+
+    fn endCompound(self: *ListParser) !void {
+        try self.compounds.append(self.scratch, .{
+            .simples = try self.arena.dupe(Simple, self.simples.items),
+            .combinator = self.left,
+        });
+        self.simples.clearRetainingCapacity();
+        self.started = false;
+    }
+
+    fn endSelector(self: *ListParser) !void {
+        if (!self.started or self.combinator != null) return error.InvalidSelector;
+        try self.endCompound();
+
+        // Store right to left: each compound keeps its relation leftwards
+        const compounds = try self.arena.alloc(Compound, self.compounds.items.len);
+        for (compounds, 0..) |*compound, i| {
+            compound.* = self.compounds.items[self.compounds.items.len - 1 - i];
+        }
+        try self.selectors.append(self.scratch, .{
+            .compounds = compounds,
+            .specificity = specificity(compounds),
+        });
+
+        self.compounds.clearRetainingCapacity();
+        self.space = false;
+        self.left = .descendant;
+    }
+};
+
+fn lowerName(arena: std.mem.Allocator, name: []const u8) ![]const u8 {
+    for (name) |c| {
+        if (std.ascii.isUpper(c)) return std.ascii.allocLowerString(arena, name);
+    }
+    return name;
+}
+
+/// Attribute selector after its '['
+fn parseAttribute(tokens: *Tokenizer) !Attribute {
+    var token = nextSignificant(tokens) orelse return error.InvalidSelector;
+    if (token != .ident) return error.InvalidSelector;
+    var attribute: Attribute = .{ .name = token.ident, .op = .exists, .value = "", .ignore_case = false };
+
+    token = nextSignificant(tokens) orelse return error.InvalidSelector;
+    if (token == .close_bracket) return attribute;
+    if (token != .delim) return error.InvalidSelector;
+    attribute.op = switch (token.delim) {
+        '=' => .equals,
+        '~' => .includes,
+        '|' => .dash,
+        '^' => .prefix,
+        '$' => .suffix,
+        '*' => .substring,
+        else => return error.InvalidSelector,
+    };
+    if (attribute.op != .equals) {
+        const equals = tokens.next() orelse return error.InvalidSelector;
+        if (equals != .delim or equals.delim != '=') return error.InvalidSelector;
+    }
+
+    token = nextSignificant(tokens) orelse return error.InvalidSelector;
+    attribute.value = switch (token) {
+        .ident => |value| value,
+        .string => |value| value,
+        else => return error.InvalidSelector,
+    };
+
+    token = nextSignificant(tokens) orelse return error.InvalidSelector;
+    if (token == .ident and std.ascii.eqlIgnoreCase(token.ident, "i")) {
+        attribute.ignore_case = true;
+        token = nextSignificant(tokens) orelse return error.InvalidSelector;
+    } else if (token == .ident and std.ascii.eqlIgnoreCase(token.ident, "s")) {
+        token = nextSignificant(tokens) orelse return error.InvalidSelector;
+    }
+    if (token != .close_bracket) return error.InvalidSelector;
+    return attribute;
+}
+
+/// An+B argument of an :nth-*() pseudo-class, after its function token:
+/// "odd", "even", "3", "2n+1", "-n + 3", ...
+fn parseNth(tokens: *Tokenizer, kind: Nth.Kind) !Nth {
+    const start = tokens.pos;
+    try skipArguments(tokens);
+    var compact: [32]u8 = undefined;
+    var len: usize = 0;
+    for (tokens.css[start .. tokens.pos - 1]) |c| {
+        if (std.ascii.isWhitespace(c)) continue;
+        if (len == compact.len) return error.InvalidSelector;
+        compact[len] = std.ascii.toLower(c);
+        len += 1;
+    }
+    const argument = compact[0..len];
+
+    if (std.mem.eql(u8, argument, "odd")) return .{ .kind = kind, .a = 2, .b = 1 };
+    if (std.mem.eql(u8, argument, "even")) return .{ .kind = kind, .a = 2, .b = 0 };
+    const n = std.mem.indexOfScalar(u8, argument, 'n') orelse {
+        return .{ .kind = kind, .a = 0, .b = try parseInteger(argument) };
+    };
+    const coefficient = argument[0..n];
+    const a: i32 = if (coefficient.len == 0 or std.mem.eql(u8, coefficient, "+"))
+        1
+    else if (std.mem.eql(u8, coefficient, "-"))
+        -1
+    else
+        try parseInteger(coefficient);
+    const offset = argument[n + 1 ..];
+    if (offset.len == 0) return .{ .kind = kind, .a = a, .b = 0 };
+    if (offset[0] != '+' and offset[0] != '-') return error.InvalidSelector;
+    return .{ .kind = kind, .a = a, .b = try parseInteger(offset) };
+}
+
+fn parseInteger(text: []const u8) !i32 {
+    for (text, 0..) |c, i| {
+        if (!std.ascii.isDigit(c) and !(i == 0 and (c == '+' or c == '-'))) return error.InvalidSelector;
+    }
+    return std.fmt.parseInt(i32, text, 10) catch error.InvalidSelector;
+}
+
+/// Skip to the ')' closing a function token just read
+fn skipArguments(tokens: *Tokenizer) !void {
+    var depth: usize = 1;
+    while (tokens.next()) |token| switch (token) {
+        .function, .open_paren => depth += 1,
+        .close_paren => {
+            depth -= 1;
+            if (depth == 0) return;
+        },
+        else => {},
+    };
+    return error.InvalidSelector;
+}
+
+fn nextSignificant(tokens: *Tokenizer) ?tokenizer.Token {
+    while (tokens.next()) |token| {
+        if (token != .whitespace) return token;
+    }
+    return null;
+}
+
+fn specificity(compounds: []const Compound) u32 {
+    var ids: u32 = 0;
+    var classes: u32 = 0;
+    var tags: u32 = 0;
+    for (compounds) |compound| {
+        for (compound.simples) |simple| switch (weight(simple)) {
+            .id => ids += 1,
+            .class => classes += 1,
+            .tag => tags += 1,
+            .none => {},
+        };
+    }
+    const saturate = struct {
+        fn f(n: u32) u32 {
+            return @min(n, 255);
+        }
+    }.f;
+    return saturate(ids) << 16 | saturate(classes) << 8 | saturate(tags);
+}
+
+/// Which specificity count a simple selector adds to, in increasing order
+const Weight = enum { none, tag, class, id };
+
+fn weight(simple: Simple) Weight {
+    return switch (simple) {
+        .id => .id,
+        .class, .attribute, .pseudo, .never, .nth => .class,
+        .tag => .tag,
+        // The most specific argument counts
+        .not, .is => |arguments| blk: {
+            var heaviest: Weight = .none;
+            for (arguments) |argument| {
+                heaviest = @enumFromInt(@max(@intFromEnum(heaviest), @intFromEnum(weight(argument))));
+            }
+            break :blk heaviest;
+        },
+        .where => .none,
+    };
+}
+
+// =============================================================================
+// Matching
+// =============================================================================
+
+/// Does `selector` match `element`?
+pub fn matches(doc: *const dom.Document, selector: Selector, element: dom.NodeId) bool {
+    return matchFrom(doc, selector.compounds, 0, element);
+}
+
+fn matchFrom(doc: *const dom.Document, compounds: []const Compound, index: usize, element: dom.NodeId) bool {
+    const elements = doc.elements;
+    if (!matchesCompound(doc, compounds[index], element)) return false;
+    if (index + 1 == compounds.len) return true;
+
+    const next = index + 1;
+    switch (compounds[index].combinator) {
+        .child => {
+            const parent = elements[element].parent;
+            return parent != dom.NONE and matchFrom(doc, compounds, next, parent);
+        },
+        .descendant => {
+            var ancestor = elements[element].parent;
+            while (ancestor != dom.NONE) : (ancestor = elements[ancestor].parent) {
+                if (matchFrom(doc, compounds, next, ancestor)) return true;
+            }
+            return false;
+        },
+        .next_sibling => {
+            const prev = elements[element].prev_sibling;
+            return prev != dom.NONE and matchFrom(doc, compounds, next, prev);
+        },
+        .subsequent_sibling => {
+            var sibling = elements[element].prev_sibling;
+            while (sibling != dom.NONE) : (sibling = elements[sibling].prev_sibling) {
+                if (matchFrom(doc, compounds, next, sibling)) return true;
+            }
+            return false;
+        },
+    }
+}
+
+pub fn matchesCompound(doc: *const dom.Document, compound: Compound, element: dom.NodeId) bool {
+    for (compound.simples) |simple| {
+        if (!matchesSimple(doc, simple, element)) return false;
+    }
+    return true;
+}
+
+fn matchesSimple(doc: *const dom.Document, simple: Simple, element: dom.NodeId) bool {
+    const e = doc.elements[element];
+    return switch (simple) {
+        .tag => |tag| std.mem.eql(u8, e.tag, tag),
+        .id => |id| if (e.id) |own| std.mem.eql(u8, own, id) else false,
+        .class => |class| hasClass(e, class),
+        .attribute => |attribute| matchesAttribute(e, attribute),
+        .pseudo => |pseudo| switch (pseudo) {
+            .root => e.parent == dom.NONE,
+            .first_child => e.prev_sibling == dom.NONE and e.parent != dom.NONE,
+            .last_child => e.next_sibling == dom.NONE and e.parent != dom.NONE,
+            .only_child => e.prev_sibling == dom.NONE and e.next_sibling == dom.NONE and e.parent != dom.NONE,
+            .link => (std.mem.eql(u8, e.tag, "a") or std.mem.eql(u8, e.tag, "area")) and e.attribute("href") != null,
+        },
+        .never => false,
+        .nth => |nth| matchesNth(doc, nth, element),
+        .not => |arguments| !matchesAny(doc, arguments, element),
+        .is, .where => |arguments| matchesAny(doc, arguments, element),
+    };
+}
+
+fn matchesAny(doc: *const dom.Document, simples: []const Simple, element: dom.NodeId) bool {
+    for (simples) |simple| {
+        if (matchesSimple(doc, simple, element)) return true;
+    }
+    return false;
+}
+
+fn matchesNth(doc: *const dom.Document, nth: Nth, element: dom.NodeId) bool {
+    const elements = doc.elements;
+    const e = elements[element];
+    if (e.parent == dom.NONE) return false;
+
+    const backwards = nth.kind == .last_child or nth.kind == .last_of_type;
+    const of_type = nth.kind == .of_type or nth.kind == .last_of_type;
+    var position: i64 = 1;
+    var sibling = if (backwards) e.next_sibling else e.prev_sibling;
+    while (sibling != dom.NONE) {
+        const other = elements[sibling];
+        if (!of_type or std.mem.eql(u8, other.tag, e.tag)) position += 1;
+        sibling = if (backwards) other.next_sibling else other.prev_sibling;
+    }
+
+    const step: i64 = nth.a;
+    const offset = position - nth.b;
+    if (step == 0) return offset == 0;
+    return @rem(offset, step) == 0 and @divTrunc(offset, step) >= 0;
+}
+
+pub fn hasClass(e: dom.Element, class: []const u8) bool {
+    for (e.classes) |own| {
+        if (std.mem.eql(u8, own, class)) return true;
+    }
+    return false;
+}
+
+fn matchesAttribute(e: dom.Element, attribute: Attribute) bool {
+    const value = e.attribute(attribute.name) orelse return false;
+    const want = attribute.value;
+    const eql = if (attribute.ignore_case) &std.ascii.eqlIgnoreCase else &eqlBytes;
+    return switch (attribute.op) {
+        .exists => true,
+        .equals => eql(value, want),
+        .includes => blk: {
+            if (want.len == 0) break :blk false;
+            var words = std.mem.tokenizeAny(u8, value, " \t\n\r\x0c");
+            while (words.next()) |word| {
+                if (eql(word, want)) break :blk true;
+            }
+            break :blk false;
+        },
+        .dash => eql(value, want) or (value.len > want.len and value[want.len] == '-' and eql(value[0..want.len], want)),
+        .prefix => want.len > 0 and value.len >= want.len and eql(value[0..want.len], want),
+        .suffix => want.len > 0 and value.len >= want.len and eql(value[value.len - want.len ..], want),
+        .substring => want.len > 0 and containsWith(value, want, attribute.ignore_case),
+    };
+}
+
+fn eqlBytes(a: []const u8, b: []const u8) bool {
+    return std.mem.eql(u8, a, b);
+}
+
+fn containsWith(haystack: []const u8, needle: []const u8, ignore_case: bool) bool {
+    if (ignore_case) return std.ascii.indexOfIgnoreCase(haystack, needle) != null;
+    return std.mem.indexOf(u8, haystack, needle) != null;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+fn parseOne(arena: std.mem.Allocator, text: []const u8) !Selector {
+    const list = try parseList(arena, std.testing.allocator, text);
+    try std.testing.expectEqual(@as(usize, 1), list.len);
+    return list[0];
+}
+
+test "parse compounds right to left" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+
+    const selector = try parseOne(arena.allocator(), "UL#nav > li.item  a[href^='http' i]:first-child");
+    try std.testing.expectEqual(@as(usize, 3), selector.compounds.len);
+
+    const subject = selector.subject();
+    try std.testing.expectEqualStrings("a", subject.simples[0].tag);
+    try std.testing.expect(subject.simples[1].attribute.ignore_case);
+    try std.testing.expectEqual(Attribute.Op.prefix, subject.simples[1].attribute.op);
+    try std.testing.expectEqual(Pseudo.first_child, subject.simples[2].pseudo);
+    try std.testing.expectEqual(Combinator.descendant, subject.combinator);
+
+    try std.testing.expectEqualStrings("item", selector.compounds[1].simples[1].class);
+    try std.testing.expectEqual(Combinator.child, selector.compounds[1].combinator);
+    try std.testing.expectEqualStrings("ul", selector.compounds[2].simples[0].tag);
+    try std.testing.expectEqual(@as(u32, 1 << 16 | 3 << 8 | 3), selector.specificity);
+}
+
+test "lists, invalid lists and unsupported pseudo-classes" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const a = arena.allocator();
+
+    try std.testing.expectEqual(@as(usize, 3), (try parseList(a, std.testing.allocator, "h1, .x ~ *, a:hover")).len);
+    try std.testing.expectEqual(@as(usize, 0), (try parseList(a, std.testing.allocator, "h1, > p")).len);
+    try std.testing.expectEqual(@as(usize, 0), (try parseList(a, std.testing.allocator, "a >")).len);
+    try std.testing.expectEqual(@as(usize, 1), (try parseList(a, std.testing.allocator, ".a p.b div")).len);
+
+    const hover = try parseOne(a, "a:hover:has(b)::before");
+    try std.testing.expect(hover.subject().simples[1] == .never);
+    try std.testing.expect(hover.subject().simples[2] == .never);
+    try std.testing.expect(hover.subject().simples[3] == .never);
+}
+
+test "functional pseudo-classes take simple arguments or drop the list" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const a = arena.allocator();
+
+    const negated = try parseOne(a, "li:not(.x, [hidden]):nth-last-of-type( -n + 3 )");
+    try std.testing.expectEqual(@as(usize, 2), negated.subject().simples[1].not.len);
+    const nth = negated.subject().simples[2].nth;
+    try std.testing.expectEqual(Nth.Kind.last_of_type, nth.kind);
+    try std.testing.expectEqual(@as(i32, -1), nth.a);
+    try std.testing.expectEqual(@as(i32, 3), nth.b);
+
+    // Specificity: the most specific argument of :not() and :is(), nothing for :where()
+    try std.testing.expectEqual(@as(u32, 1 << 8 | 1), (try parseOne(a, "li:not(.x, p)")).specificity);
+    try std.testing.expectEqual(@as(u32, 1 << 16 | 1), (try parseOne(a, ":is(#nav, p) li")).specificity);
+    try std.testing.expectEqual(@as(u32, 1), (try parseOne(a, ":where(#nav) li")).specificity);
+    try std.testing.expectEqual(@as(u32, 1 << 8 | 1), (try parseOne(a, "tr:nth-child(even)")).specificity);
+
+    const invalid = [_][]const u8{
+        "h1, li:not(a b)",
+        "li:not(a.b)",
+        "li:not(:is(a))",
+        "li:is()",
+        "li:nth-child(2n+)",
+        "li:nth-child(n of .x)",
+        "li:nth-child(1.5)",
+    };
+    for (invalid) |text| {
+        try std.testing.expectEqual(@as(usize, 0), (try parseList(a, std.testing.allocator, text)).len);
+    }
+}
+
+test "match against a document" {
+    const doc = try dom.parse(std.testing.allocator,
+        \\<html><body><ul id="nav"><li class="item"><a href="http://x">x</a></li>
+        \\<li class="item last"><span>y</span></li></ul><p lang="en-US">z</p></body></html>
+    );
+    defer doc.deinit();
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const a = arena.allocator();
+
+    // html body ul li a li span p
+    const link: dom.NodeId = 4;
+    const span: dom.NodeId = 6;
+    const p: dom.NodeId = 7;
+
+    try std.testing.expect(matches(&doc, try parseOne(a, "#nav > .item a:link"), link));
+    try std.testing.expect(matches(&doc, try parseOne(a, "body li:first-child > a[href^=HTTP i]"), link));
+    try std.testing.expect(!matches(&doc, try parseOne(a, "li:last-child a"), link));
+    try std.testing.expect(matches(&doc, try parseOne(a, ".item + .last span:only-child"), span));
+    try std.testing.expect(matches(&doc, try parseOne(a, "ul ~ p[lang|=en]"), p));
+    try std.testing.expect(!matches(&doc, try parseOne(a, "li p"), p));
+    try std.testing.expect(matches(&doc, try parseOne(a, ":root > body > *"), p));
+    try std.testing.expect(matches(&doc, try parseOne(a, "[class~=last] > span"), span));
+    try std.testing.expect(matches(&doc, try parseOne(a, "#n\\61v .l\\61st > span"), span));
+
+    try std.testing.expect(matches(&doc, try parseOne(a, "li:not(.last) > a"), link));
+    try std.testing.expect(!matches(&doc, try parseOne(a, "li:not(.item) span"), span));
+    try std.testing.expect(matches(&doc, try parseOne(a, ":is(ol, ul) > :where(.x, li):nth-child(2) span"), span));
+    try std.testing.expect(matches(&doc, try parseOne(a, "li:nth-child(odd) > a"), link));
+    try std.testing.expect(!matches(&doc, try parseOne(a, "li:nth-child(2n) > a"), link));
+    try std.testing.expect(matches(&doc, try parseOne(a, "li:nth-last-child(1) span"), span));
+    try std.testing.expect(matches(&doc, try parseOne(a, "p:nth-of-type(1):nth-last-of-type(-n+1)"), p));
+    try std.testing.expect(!matches(&doc, try parseOne(a, "p:nth-child(1)"), p));
+    try std.testing.expect(!matches(&doc, try parseOne(a, ":nth-child(n)"), 0));
+}
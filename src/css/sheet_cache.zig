@@ -0,0 +1,837 @@
+//! Vulpes Browser - Parsed Stylesheet Cache
+//!
+//! Sites link the same stylesheets from every page. This cache keeps them
+//! parsed and indexed, keyed by URL and a hash of the body, so a later
+//! page adopts the sheet instead of parsing it again.
+//!
+//! A cached sheet lives in an "image": a header, tables of fixed-size
+//! records, and a string pool holding the CSS source plus any selector
+//! names the parser had to copy (lowercased or unescaped). Records refer
+//! to strings and to each other by offset and index, never by pointer,
+//! so an image can be written to disk and mapped back at any address.
+//! Loading an image checks its bounds and walks the tables once, turning
+//! offsets into slices of the image; no CSS is tokenized and no selector
+//! is parsed. Images are host-endian and versioned; one that does not
+//! check out is ignored and rebuilt.
+//!
+//! With a directory set, images are persisted there as
+//! <url hash>-<body hash>.vcss and memory-mapped on a later miss.
+//!
+
+const std = @import("std");
+const dom = @import("../html/dom.zig");
+const parser = @import("parser.zig");
+const matcher = @import("matcher.zig");
+const selector = @import("selector.zig");
+const cascade = @import("cascade.zig");
+
+const MAGIC = "VCSS".*;
+const VERSION: u32 = 2;
+
+/// Sheets kept in memory
+const MAX_SHEETS = 64;
+
+/// Larger files in the cache directory are not mapped
+const MAX_IMAGE_BYTES = 256 * 1024 * 1024;
+
+pub const Key = struct {
+    url_hash: u64,
+    body_hash: u64,
+
+    pub fn of(url: []const u8, body: []const u8) Key {
+        return .{ .url_hash = std.hash.Wyhash.hash(0, url), .body_hash = std.hash.Wyhash.hash(0, body) };
+    }
+};
+
+// =============================================================================
+// Image format
+// =============================================================================
+
+/// Offset and length in the string pool
+const Str = extern struct {
+    offset: u32,
+    len: u32,
+};
+
+const RuleRecord = extern struct {
+    selectors: Str,
+    first_declaration: u32,
+    declaration_count: u32,
+    media: u32,
+};
+
+const DeclarationRecord = extern struct {
+    name: Str,
+    value: Str,
+    important: u32,
+};
+
+const EntryRecord = extern struct {
+    first_compound: u32,
+    compound_count: u32,
+    specificity: u32,
+    rule: u32,
+    ancestor_hashes: [4]u32,
+    revalidate: u32,
+};
+
+const CompoundRecord = extern struct {
+    first_simple: u32,
+    simple_count: u32,
+    combinator: u32,
+};
+
+/// :nth-*() keeps its kind in `detail` and A and B in `name`. :not(),
+/// :is() and :where() keep the first index and count of their argument
+/// records in `name`; a compound's arguments follow its own simples.
+const SimpleRecord = extern struct {
+    kind: u8,
+    /// Attribute operator, pseudo-class or :nth-*() kind
+    detail: u8,
+    ignore_case: u8,
+    padding: u8 = 0,
+    name: Str,
+    value: Str,
+};
+
+const BucketRecord = extern struct {
+    /// 0 id, 1 class, 2 tag
+    kind: u32,
+    key: Str,
+    start: u32,
+    len: u32,
+};
+
+/// Tables in image order
+const Table = enum { rules, declarations, media, entries, compounds, simples, buckets };
+const table_count = std.meta.fields(Table).len;
+
+fn Record(comptime table: Table) type {
+    return switch (table) {
+        .rules => RuleRecord,
+        .declarations => DeclarationRecord,
+        .media => Str,
+        .entries => EntryRecord,
+        .compounds => CompoundRecord,
+        .simples => SimpleRecord,
+        .buckets => BucketRecord,
+    };
+}
+
+const Header = extern struct {
+    magic: [4]u8,
+    version: u32,
+    url_hash: u64,
+    body_hash: u64,
+    /// Records per table
+    counts: [table_count]u32,
+    universal_start: u32,
+    universal_len: u32,
+    pool_len: u32,
+};
+
+/// Byte offsets of the tables and the string pool
+const Layout = struct {
+    tables: [table_count]usize,
+    pool: usize,
+
+    fn of(header: Header) Layout {
+        var layout: Layout = undefined;
+        var offset: usize = @sizeOf(Header);
+        inline for (comptime std.enums.values(Table)) |table| {
+            layout.tables[@intFromEnum(table)] = offset;
+            offset += @as(usize, header.counts[@intFromEnum(table)]) * @sizeOf(Record(table));
+        }
+        layout.pool = offset;
+        return layout;
+    }
+};
+
+/// The key an image was built for, if it looks like an image at all
+pub fn imageKey(image: []const u8) ?Key {
+    if (image.len < @sizeOf(Header)) return null;
+    const header = std.mem.bytesToValue(Header, image[0..@sizeOf(Header)]);
+    if (!std.mem.eql(u8, &header.magic, &MAGIC) or header.version != VERSION) return null;
+    return .{ .url_hash = header.url_hash, .body_hash = header.body_hash };
+}
+
+/// Parse and index `css`, returning its image. Caller owns the bytes.
+pub fn compile(allocator: std.mem.Allocator, key: Key, css: []const u8) ![]u8 {
+    const sheet = try parser.parse(allocator, css);
+    defer sheet.deinit();
+    var index = try matcher.RuleIndex.build(allocator, &sheet);
+    defer index.deinit();
+    return serialize(allocator, key, css, &sheet, &index);
+}
+
+/// Write `sheet` and `index`, both built from `source`, as an image.
+pub fn serialize(
+    allocator: std.mem.Allocator,
+    key: Key,
+    source: []const u8,
+    sheet: *const parser.Stylesheet,
+    index: *const matcher.RuleIndex,
+) ![]u8 {
+    if (source.len > std.math.maxInt(u32)) return error.StylesheetTooLarge;
+    var writer: Writer = .{ .allocator = allocator, .source = source };
+    defer writer.deinit();
+
+    for (sheet.rules) |rule| {
+        try writer.rules.append(allocator, .{
+            .selectors = try writer.str(rule.selectors),
+            .first_declaration = rule.first_declaration,
+            .declaration_count = rule.declaration_count,
+            .media = rule.media,
+        });
+    }
+    for (sheet.declarations) |declaration| {
+        try writer.declarations.append(allocator, .{
+            .name = try writer.str(declaration.name),
+            .value = try writer.str(declaration.value),
+            .important = @intFromBool(declaration.important),
+        });
+    }
+    for (sheet.media) |query| try writer.media.append(allocator, try writer.str(query));
+    for (index.entries) |entry| try writer.addEntry(entry);
+
+    const maps = [_]*const std.StringHashMapUnmanaged(matcher.Span){ &index.ids, &index.classes, &index.tags };
+    for (maps, 0..) |map, kind| {
+        var it = map.iterator();
+        while (it.next()) |bucket| {
+            try writer.buckets.append(allocator, .{
+                .kind = @intCast(kind),
+                .key = try writer.str(bucket.key_ptr.*),
+                .start = bucket.value_ptr.start,
+                .len = bucket.value_ptr.len,
+            });
+        }
+    }
+
+    const pool_len = source.len + writer.extra.items.len;
+    if (pool_len > std.math.maxInt(u32)) return error.StylesheetTooLarge;
+    const header: Header = .{
+        .magic = MAGIC,
+        .version = VERSION,
+        .url_hash = key.url_hash,
+        .body_hash = key.body_hash,
+        .counts = .{
+            @intCast(writer.rules.items.len),
+            @intCast(writer.declarations.items.len),
+            @intCast(writer.media.items.len),
+            @intCast(writer.entries.items.len),
+            @intCast(writer.compounds.items.len),
+            @intCast(writer.simples.items.len),
+            @intCast(writer.buckets.items.len),
+        },
+        .universal_start = index.universal.start,
+        .universal_len = index.universal.len,
+        .pool_len = @intCast(pool_len),
+    };
+
+    var image: std.ArrayListUnmanaged(u8) = .empty;
+    errdefer image.deinit(allocator);
+    try image.ensureTotalCapacity(allocator, Layout.of(header).pool + pool_len);
+    image.appendSliceAssumeCapacity(std.mem.asBytes(&header));
+    image.appendSliceAssumeCapacity(std.mem.sliceAsBytes(writer.rules.items));
+    image.appendSliceAssumeCapacity(std.mem.sliceAsBytes(writer.declarations.items));
+    image.appendSliceAssumeCapacity(std.mem.sliceAsBytes(writer.media.items));
+    image.appendSliceAssumeCapacity(std.mem.sliceAsBytes(writer.entries.items));
+    image.appendSliceAssumeCapacity(std.mem.sliceAsBytes(writer.compounds.items));
+    image.appendSliceAssumeCapacity(std.mem.sliceAsBytes(writer.simples.items));
+    image.appendSliceAssumeCapacity(std.mem.sliceAsBytes(writer.buckets.items));
+    image.appendSliceAssumeCapacity(source);
+    image.appendSliceAssumeCapacity(writer.extra.items);
+    return image.toOwnedSlice(allocator);
+}
+
+const Writer = struct {
+    allocator: std.mem.Allocator,
+    source: []const u8,
+    /// Strings that are not slices of the source, pooled after it
+    extra: std.ArrayListUnmanaged(u8) = .empty,
+    rules: std.ArrayListUnmanaged(RuleRecord) = .empty,
+    declarations: std.ArrayListUnmanaged(DeclarationRecord) = .empty,
+    media: std.ArrayListUnmanaged(Str) = .empty,
+    entries: std.ArrayListUnmanaged(EntryRecord) = .empty,
+    compounds: std.ArrayListUnmanaged(CompoundRecord) = .empty,
+    simples: std.ArrayListUnmanaged(SimpleRecord) = .empty,
+    buckets: std.ArrayListUnmanaged(BucketRecord) = .empty,
+
+    fn deinit(self: *Writer) void {
+        self.extra.deinit(self.allocator);
+        self.rules.deinit(self.allocator);
+        self.declarations.deinit(self.allocator);
+        self.media.deinit(self.allocator);
+        self.entries.deinit(self.allocator);
+        self.compounds.deinit(self.allocator);
+        self.simples.deinit(self.allocator);
+        self.buckets.deinit(self.allocator);
+    }
+
+    fn str(self: *Writer, text: []const u8) !Str {
+        if (text.len == 0) return .{ .offset = 0, .len = 0 };
+        const base = @intFromPtr(self.source.ptr);
+        const at = @intFromPtr(text.ptr);
+        if (at >= base and at + text.len <= base + self.source.len) {
+            return .{ .offset = @intCast(at - base), .len = @intCast(text.len) };
+        }
+        const offset = self.source.len + self.extra.items.len;
+        try self.extra.appendSlice(self.allocator, text);
+        return .{ .offset = @intCast(offset), .len = @intCast(text.len) };
+    }
+
+    fn addEntry(self: *Writer, entry: matcher.Entry) !void {
+        try self.entries.append(self.allocator, .{
+            .first_compound = @intCast(self.compounds.items.len),
+            .compound_count = @intCast(entry.selector.compounds.len),
+            .specificity = entry.selector.specificity,
+            .rule = entry.rule,
+            .ancestor_hashes = entry.ancestor_hashes,
+            .revalidate = @intFromBool(entry.revalidate),
+        });
+        for (entry.selector.compounds) |compound| {
+            try self.compounds.append(self.allocator, .{
+                .first_simple = @intCast(self.simples.items.len),
+                .simple_count = @intCast(compound.simples.len),
+                .combinator = @intFromEnum(compound.combinator),
+            });
+            const first = self.simples.items.len;
+            for (compound.simples) |simple| try self.simples.append(self.allocator, try self.simpleRecord(simple));
+            for (compound.simples, first..) |simple, at| {
+                const arguments = switch (simple) {
+                    .not, .is, .where => |arguments| arguments,
+                    else => continue,
+                };
+                self.simples.items[at].name = .{ .offset = @intCast(self.simples.items.len), .len = @intCast(arguments.len) };
+                for (arguments) |argument| try self.simples.append(self.allocator, try self.simpleRecord(argument));
+            }
+        }
+    }
+
+    /// Arguments of :not(), :is() and :where() are left for addEntry
+    fn simpleRecord(self: *Writer, simple: selector.Simple) !SimpleRecord {
+        const none: Str = .{ .offset = 0, .len = 0 };
+        return switch (simple) {
+            .tag, .id, .class => |name| .{ .kind = @intFromEnum(simple), .detail = 0, .ignore_case = 0, .name = try self.str(name), .value = none },
+            .attribute => |attribute| .{
+                .kind = @intFromEnum(simple),
+                .detail = @intFromEnum(attribute.op),
+                .ignore_case = @intFromBool(attribute.ignore_case),
+                .name = try self.str(attribute.name),
+                .value = try self.str(attribute.value),
+            },
+            .pseudo => |pseudo| .{ .kind = @intFromEnum(simple), .detail = @intFromEnum(pseudo), .ignore_case = 0, .name = none, .value = none },
+            .nth => |nth| .{
+                .kind = @intFromEnum(simple),
+                .detail = @intFromEnum(nth.kind),
+                .ignore_case = 0,
+                .name = .{ .offset = @bitCast(nth.a), .len = @bitCast(nth.b) },
+                .value = none,
+            },
+            .never, .not, .is, .where => .{ .kind = @intFromEnum(simple), .detail = 0, .ignore_case = 0, .name = none, .value = none },
+        };
+    }
+};
+
+/// A stylesheet and rule index whose strings point into an image
+pub const Loaded = struct {
+    stylesheet: parser.Stylesheet,
+    index: matcher.RuleIndex,
+
+    pub fn deinit(self: *Loaded) void {
+        self.index.deinit();
+        self.stylesheet.deinit();
+    }
+
+    pub fn sheet(self: *const Loaded) cascade.Sheet {
+        return .{ .stylesheet = &self.stylesheet, .index = &self.index };
+    }
+};
+
+/// Rebuild the stylesheet and index from `image`, which must outlive
+/// the result. Fails with InvalidImage on anything out of bounds.
+pub fn load(allocator: std.mem.Allocator, image: []const u8) !Loaded {
+    if (imageKey(image) == null) return error.InvalidImage;
+    const header = std.mem.bytesToValue(Header, image[0..@sizeOf(Header)]);
+    const layout = Layout.of(header);
+    if (layout.pool + header.pool_len != image.len) return error.InvalidImage;
+    const reader: Reader = .{ .image = image, .layout = layout, .header = header };
+
+    var sheet_arena = std.heap.ArenaAllocator.init(allocator);
+    errdefer sheet_arena.deinit();
+    const sheet_owned = sheet_arena.allocator();
+
+    const declaration_records = reader.table(.declarations);
+    const declarations = try sheet_owned.alloc(parser.Declaration, declaration_records.len);
+    for (declaration_records, declarations) |record, *declaration| {
+        declaration.* = .{
+            .name = try reader.string(record.name),
+            .value = try reader.string(record.value),
+            .important = record.important != 0,
+        };
+    }
+    const media_records = reader.table(.media);
+    if (media_records.len == 0) return error.InvalidImage;
+    const media = try sheet_owned.alloc([]const u8, media_records.len);
+    for (media_records, media) |record, *query| query.* = try reader.string(record);
+
+    const rule_records = reader.table(.rules);
+    const rules = try sheet_owned.alloc(parser.Rule, rule_records.len);
+    for (rule_records, rules) |record, *rule| {
+        try checkRange(record.first_declaration, record.declaration_count, declarations.len);
+        if (record.media >= media.len) return error.InvalidImage;
+        rule.* = .{
+            .selectors = try reader.string(record.selectors),
+            .first_declaration = record.first_declaration,
+            .declaration_count = record.declaration_count,
+            .media = record.media,
+        };
+    }
+
+    var index_arena = std.heap.ArenaAllocator.init(allocator);
+    errdefer index_arena.deinit();
+    const index_owned = index_arena.allocator();
+
+    const simple_records = reader.table(.simples);
+    const simples = try index_owned.alloc(selector.Simple, simple_records.len);
+    for (simple_records, simples) |record, *simple| simple.* = try reader.simple(record, simple_records, simples);
+
+    const compound_records = reader.table(.compounds);
+    const compounds = try index_owned.alloc(selector.Compound, compound_records.len);
+    for (compound_records, compounds) |record, *compound| {
+        try checkRange(record.first_simple, record.simple_count, simples.len);
+        compound.* = .{
+            .simples = simples[record.first_simple..][0..record.simple_count],
+            .combinator = std.meta.intToEnum(selector.Combinator, record.combinator) catch return error.InvalidImage,
+        };
+    }
+
+    const entry_records = reader.table(.entries);
+    const entries = try index_owned.alloc(matcher.Entry, entry_records.len);
+    for (entry_records, entries) |record, *entry| {
+        // Every selector has a subject compound
+        if (record.compound_count == 0) return error.InvalidImage;
+        try checkRange(record.first_compound, record.compound_count, compounds.len);
+        if (record.rule >= rules.len) return error.InvalidImage;
+        entry.* = .{
+            .selector = .{
+                .compounds = compounds[record.first_compound..][0..record.compound_count],
+                .specificity = record.specificity,
+            },
+            .rule = record.rule,
+            .ancestor_hashes = record.ancestor_hashes,
+            .revalidate = record.revalidate != 0,
+        };
+    }
+
+    var index: matcher.RuleIndex = .{
+        .arena = undefined,
+        .entries = entries,
+        .ids = .empty,
+        .classes = .empty,
+        .tags = .empty,
+        .universal = .{ .start = header.universal_start, .len = header.universal_len },
+    };
+    try checkRange(header.universal_start, header.universal_len, entries.len);
+    for (reader.table(.buckets)) |record| {
+        try checkRange(record.start, record.len, entries.len);
+        const map = switch (record.kind) {
+            0 => &index.ids,
+            1 => &index.classes,
+            2 => &index.tags,
+            else => return error.InvalidImage,
+        };
+        try map.put(index_owned, try reader.string(record.key), .{ .start = record.start, .len = record.len });
+    }
+
+    index.arena = index_arena;
+    return .{
+        .stylesheet = .{ .arena = sheet_arena, .rules = rules, .declarations = declarations, .media = media },
+        .index = index,
+    };
+}
+
+fn checkRange(start: u32, len: u32, limit: usize) !void {
+    if (@as(u64, start) + len > limit) return error.InvalidImage;
+}
+
+const Reader = struct {
+    image: []const u8,
+    layout: Layout,
+    header: Header,
+
+    fn table(self: Reader, comptime which: Table) []align(1) const Record(which) {
+        const start = self.layout.tables[@intFromEnum(which)];
+        const len = @as(usize, self.header.counts[@intFromEnum(which)]) * @sizeOf(Record(which));
+        return std.mem.bytesAsSlice(Record(which), self.image[start..][0..len]);
+    }
+
+    fn string(self: Reader, at: Str) ![]const u8 {
+        try checkRange(at.offset, at.len, self.header.pool_len);
+        return self.image[self.layout.pool + at.offset ..][0..at.len];
+    }
+
+    /// `simples` is filled in table order; arguments are sliced from it
+    /// before they are decoded
+    fn simple(self: Reader, record: SimpleRecord, records: []align(1) const SimpleRecord, simples: []const selector.Simple) !selector.Simple {
+        const Kind = std.meta.Tag(selector.Simple);
+        const kind = std.meta.intToEnum(Kind, record.kind) catch return error.InvalidImage;
+        var arguments: []const selector.Simple = &.{};
+        if (kind == .not or kind == .is or kind == .where) {
+            try checkRange(record.name.offset, record.name.len, simples.len);
+            // Arguments never nest, so a damaged image cannot form a cycle
+            for (records[record.name.offset..][0..record.name.len]) |argument| {
+                const argument_kind = std.meta.intToEnum(Kind, argument.kind) catch return error.InvalidImage;
+                if (argument_kind == .not or argument_kind == .is or argument_kind == .where) return error.InvalidImage;
+            }
+            arguments = simples[record.name.offset..][0..record.name.len];
+        }
+        return switch (kind) {
+            .tag => .{ .tag = try self.string(record.name) },
+            .id => .{ .id = try self.string(record.name) },
+            .class => .{ .class = try self.string(record.name) },
+            .attribute => .{ .attribute = .{
+                .name = try self.string(record.name),
+                .op = std.meta.intToEnum(selector.Attribute.Op, record.detail) catch return error.InvalidImage,
+                .value = try self.string(record.value),
+                .ignore_case = record.ignore_case != 0,
+            } },
+            .pseudo => .{ .pseudo = std.meta.intToEnum(selector.Pseudo, record.detail) catch return error.InvalidImage },
+            .never => .never,
+            .nth => .{ .nth = .{
+                .kind = std.meta.intToEnum(selector.Nth.Kind, record.detail) catch return error.InvalidImage,
+                .a = @bitCast(record.name.offset),
+                .b = @bitCast(record.name.len),
+            } },
+            .not => .{ .not = arguments },
+            .is => .{ .is = arguments },
+            .where => .{ .where = arguments },
+        };
+    }
+};
+
+// =============================================================================
+// Cache
+// =============================================================================
+
+pub const Stats = struct {
+    /// Adopted from a sheet already in memory
+    memory_hits: u64 = 0,
+    /// Mapped back from the cache directory
+    disk_hits: u64 = 0,
+    /// Parsed and indexed
+    parses: u64 = 0,
+};
+
+/// A cached sheet, shared by every page that uses it. Hold it between
+/// Cache.acquire and Cache.release.
+pub const CachedSheet = struct {
+    key: Key,
+    loaded: Loaded,
+    image: Image,
+    /// Holders, including the cache while the sheet is in it
+    refs: u32,
+    last_used: u64,
+
+    pub fn sheet(self: *const CachedSheet) cascade.Sheet {
+        return self.loaded.sheet();
+    }
+};
+
+const Image = union(enum) {
+    owned: []u8,
+    mapped: []align(std.heap.page_size_min) const u8,
+
+    fn bytes(self: Image) []const u8 {
+        return switch (self) {
+            .owned => |image| image,
+            .mapped => |image| image,
+        };
+    }
+
+    fn release(self: Image, allocator: std.mem.Allocator) void {
+        switch (self) {
+            .owned => |image| allocator.free(image),
+            .mapped => |image| std.posix.munmap(image),
+        }
+    }
+};
+
+pub const Cache = struct {
+    mutex: std.Thread.Mutex = .{},
+    /// Where images are persisted; null keeps them in memory only
+    directory: ?std.fs.Dir = null,
+    /// By URL hash; a changed body replaces the entry
+    sheets: std.AutoHashMapUnmanaged(u64, *CachedSheet) = .empty,
+    clock: u64 = 0,
+    stats: Stats = .{},
+
+    pub fn deinit(self: *Cache, allocator: std.mem.Allocator) void {
+        var it = self.sheets.valueIterator();
+        while (it.next()) |cached| unref(allocator, cached.*);
+        self.sheets.deinit(allocator);
+    }
+
+    /// The parsed sheet for `css` as fetched from `url`: adopted from
+    /// memory or the cache directory when the body is unchanged, parsed
+    /// otherwise. Release it when the page is done with it.
+    pub fn acquire(self: *Cache, allocator: std.mem.Allocator, url: []const u8, css: []const u8) !*CachedSheet {
+        const key = Key.of(url, css);
+        if (self.lookup(key)) |cached| return cached;
+
+        // Map or parse outside the lock; a racing load of the same sheet
+        // is resolved on insert
+        var from_disk = true;
+        const image = (if (self.directory) |dir| mapImage(dir, key) else null) orelse blk: {
+            from_disk = false;
+            break :blk Image{ .owned = try compile(allocator, key, css) };
+        };
+        var loaded = load(allocator, image.bytes()) catch |err| {
+            image.release(allocator);
+            // A damaged file is rebuilt from the body
+            if (err == error.InvalidImage and from_disk) return self.rebuild(allocator, key, css);
+            return err;
+        };
+        errdefer image.release(allocator);
+        errdefer loaded.deinit();
+        if (!from_disk) {
+            if (self.directory) |dir| persist(dir, key, image.bytes()) catch {};
+        }
+
+        const cached = try allocator.create(CachedSheet);
+        errdefer allocator.destroy(cached);
+        cached.* = .{ .key = key, .loaded = loaded, .image = image, .refs = 1, .last_used = 0 };
+        return self.insert(allocator, cached, from_disk);
+    }
+
+    /// Drop a holder's reference from acquire
+    pub fn release(self: *Cache, allocator: std.mem.Allocator, cached: *CachedSheet) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        unref(allocator, cached);
+    }
+
+    fn lookup(self: *Cache, key: Key) ?*CachedSheet {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        const cached = self.sheets.get(key.url_hash) orelse return null;
+        if (cached.key.body_hash != key.body_hash) return null;
+        self.clock += 1;
+        cached.last_used = self.clock;
+        cached.refs += 1;
+        self.stats.memory_hits += 1;
+        return cached;
+    }
+
+    /// Parse `css` after its mapped image failed to load
+    fn rebuild(self: *Cache, allocator: std.mem.Allocator, key: Key, css: []const u8) !*CachedSheet {
+        const owned = try compile(allocator, key, css);
+        errdefer allocator.free(owned);
+        var loaded = try load(allocator, owned);
+        errdefer loaded.deinit();
+        if (self.directory) |dir| persist(dir, key, owned) catch {};
+
+        const cached = try allocator.create(CachedSheet);
+        errdefer allocator.destroy(cached);
+        cached.* = .{ .key = key, .loaded = loaded, .image = .{ .owned = owned }, .refs = 1, .last_used = 0 };
+        return self.insert(allocator, cached, false);
+    }
+
+    /// Add a freshly loaded sheet holding one reference for the caller,
+    /// unless another thread got there first
+    fn insert(self: *Cache, allocator: std.mem.Allocator, cached: *CachedSheet, from_disk: bool) !*CachedSheet {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.clock += 1;
+
+        if (self.sheets.get(cached.key.url_hash)) |existing| {
+            if (existing.key.body_hash == cached.key.body_hash) {
+                unref(allocator, cached);
+                existing.refs += 1;
+                existing.last_used = self.clock;
+                self.stats.memory_hits += 1;
+                return existing;
+            }
+            _ = self.sheets.remove(cached.key.url_hash);
+            unref(allocator, existing);
+        } else if (self.sheets.count() >= MAX_SHEETS) {
+            self.evictOldest(allocator);
+        }
+
+        try self.sheets.put(allocator, cached.key.url_hash, cached);
+        cached.refs += 1;
+        cached.last_used = self.clock;
+        if (from_disk) self.stats.disk_hits += 1 else self.stats.parses += 1;
+        return cached;
+    }
+
+    fn evictOldest(self: *Cache, allocator: std.mem.Allocator) void {
+        var oldest: ?*CachedSheet = null;
+        var it = self.sheets.valueIterator();
+        while (it.next()) |cached| {
+            if (oldest == null or cached.*.last_used < oldest.?.last_used) oldest = cached.*;
+        }
+        const victim = oldest orelse return;
+        _ = self.sheets.remove(victim.key.url_hash);
+        unref(allocator, victim);
+    }
+};
+
+fn unref(allocator: std.mem.Allocator, cached: *CachedSheet) void {
+    cached.refs -= 1;
+    if (cached.refs > 0) return;
+    cached.loaded.deinit();
+    cached.image.release(allocator);
+    allocator.destroy(cached);
+}
+
+fn fileName(buffer: []u8, key: Key, suffix: []const u8) []const u8 {
+    return std.fmt.bufPrint(buffer, "{x:0>16}-{x:0>16}.vcss{s}", .{ key.url_hash, key.body_hash, suffix }) catch unreachable;
+}
+
+/// Map the image for `key` from `dir`, if there is one that claims to be it
+fn mapImage(dir: std.fs.Dir, key: Key) ?Image {
+    var name_buffer: [64]u8 = undefined;
+    const file = dir.openFile(fileName(&name_buffer, key, ""), .{}) catch return null;
+    defer file.close();
+    const size = file.getEndPos() catch return null;
+    if (size < @sizeOf(Header) or size > MAX_IMAGE_BYTES) return null;
+
+    const mapped = std.posix.mmap(null, @intCast(size), std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0) catch return null;
+    const found = imageKey(mapped) orelse {
+        std.posix.munmap(mapped);
+        return null;
+    };
+    if (found.url_hash != key.url_hash or found.body_hash != key.body_hash) {
+        std.posix.munmap(mapped);
+        return null;
+    }
+    return .{ .mapped = mapped };
+}
+
+/// Write the image under a temporary name and rename it into place, so
+/// readers never map a partial file
+fn persist(dir: std.fs.Dir, key: Key, image: []const u8) !void {
+    var name_buffer: [64]u8 = undefined;
+    var temp_buffer: [64]u8 = undefined;
+    const temp = fileName(&temp_buffer, key, ".tmp");
+    try dir.writeFile(.{ .sub_path = temp, .data = image });
+    errdefer dir.deleteFile(temp) catch {};
+    try dir.rename(temp, fileName(&name_buffer, key, ""));
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+const test_css =
+    \\body { color: #333 }
+    \\.nav > LI:first-child a[href^="/"] { color: blue !important }
+    \\#main .c\:x, h1 + p { margin: 0 }
+    \\li:not(.x, [hidden]):nth-child(odd) > a, :where(h1, h2) + p { padding: 0 }
+    \\@media (min-width: 600px) { .wide { display: block } }
+;
+
+test "an image loads back to the same sheet and index" {
+    const allocator = std.testing.allocator;
+    const key = Key.of("https://example.com/site.css", test_css);
+    const sheet = try parser.parse(allocator, test_css);
+    defer sheet.deinit();
+    var index = try matcher.RuleIndex.build(allocator, &sheet);
+    defer index.deinit();
+
+    const image = try serialize(allocator, key, test_css, &sheet, &index);
+    defer allocator.free(image);
+    // Images do not depend on where the source lived
+    const moved = try allocator.dupe(u8, image);
+    defer allocator.free(moved);
+    var loaded = try load(allocator, moved);
+    defer loaded.deinit();
+
+    try std.testing.expectEqual(key, imageKey(moved).?);
+    try std.testing.expectEqual(sheet.rules.len, loaded.stylesheet.rules.len);
+    for (sheet.rules, loaded.stylesheet.rules) |a, b| {
+        try std.testing.expectEqualStrings(a.selectors, b.selectors);
+        try std.testing.expectEqual(a.media, b.media);
+        for (sheet.declarationsOf(a), loaded.stylesheet.declarationsOf(b)) |x, y| {
+            try std.testing.expectEqualStrings(x.name, y.name);
+            try std.testing.expectEqualStrings(x.value, y.value);
+            try std.testing.expectEqual(x.important, y.important);
+        }
+    }
+    try std.testing.expectEqualStrings("(min-width: 600px)", loaded.stylesheet.media[1]);
+
+    try std.testing.expectEqual(index.entries.len, loaded.index.entries.len);
+    try std.testing.expectEqual(index.classes.count(), loaded.index.classes.count());
+    try std.testing.expectEqual(index.tags.count(), loaded.index.tags.count());
+    // The unescaped class name lives in the pool, not the source
+    try std.testing.expect(loaded.index.classes.get("c:x") != null);
+
+    // And both match the same rules
+    const doc = try dom.parse(allocator,
+        \\<body><ul class="nav"><li><a href="/home">h</a></li></ul>
+        \\<div id="main"><p class="c:x">t</p></div><h1>x</h1><p>y</p></body>
+    );
+    defer doc.deinit();
+    var ours: std.ArrayListUnmanaged(matcher.Match) = .empty;
+    defer ours.deinit(allocator);
+    var theirs: std.ArrayListUnmanaged(matcher.Match) = .empty;
+    defer theirs.deinit(allocator);
+    var filter: matcher.AncestorFilter = .{};
+    defer filter.deinit(allocator);
+    for (0..doc.elements.len) |i| {
+        const element: dom.NodeId = @intCast(i);
+        try filter.enter(allocator, &doc, element);
+        ours.clearRetainingCapacity();
+        theirs.clearRetainingCapacity();
+        try index.match(allocator, &doc, &filter, element, &ours);
+        try loaded.index.match(allocator, &doc, &filter, element, &theirs);
+        try std.testing.expectEqualSlices(matcher.Match, ours.items, theirs.items);
+    }
+}
+
+test "damaged images are rejected" {
+    const allocator = std.testing.allocator;
+    const image = try compile(allocator, Key.of("a.css", test_css), test_css);
+    defer allocator.free(image);
+
+    try std.testing.expectError(error.InvalidImage, load(allocator, image[0 .. image.len - 1]));
+    try std.testing.expectError(error.InvalidImage, load(allocator, image[0..10]));
+
+    // A string pointing past the pool
+    const broken = try allocator.dupe(u8, image);
+    defer allocator.free(broken);
+    const first_rule = Layout.of(std.mem.bytesToValue(Header, broken[0..@sizeOf(Header)])).tables[@intFromEnum(Table.rules)];
+    std.mem.writeInt(u32, broken[first_rule..][0..4], std.math.maxInt(u32) - 2, .little);
+    try std.testing.expectError(error.InvalidImage, load(allocator, broken));
+}
+
+test "cache adopts unchanged bodies and persists images" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    var cache: Cache = .{ .directory = tmp.dir };
+    const first = try cache.acquire(allocator, "https://example.com/site.css", test_css);
+    const again = try cache.acquire(allocator, "https://example.com/site.css", test_css);
+    try std.testing.expectEqual(first, again);
+    cache.release(allocator, again);
+    cache.release(allocator, first);
+    try std.testing.expectEqual(@as(u64, 1), cache.stats.parses);
+    try std.testing.expectEqual(@as(u64, 1), cache.stats.memory_hits);
+
+    // A changed body replaces the entry
+    const edited = try cache.acquire(allocator, "https://example.com/site.css", "p { color: red }");
+    try std.testing.expectEqual(@as(usize, 1), edited.loaded.stylesheet.rules.len);
+    cache.release(allocator, edited);
+    cache.deinit(allocator);
+
+    // A new cache maps the image written by the first
+    var reopened: Cache = .{ .directory = tmp.dir };
+    defer reopened.deinit(allocator);
+    const mapped = try reopened.acquire(allocator, "https://example.com/site.css", test_css);
+    defer reopened.release(allocator, mapped);
+    try std.testing.expect(mapped.image == .mapped);
+    try std.testing.expectEqual(@as(u64, 1), reopened.stats.disk_hits);
+    try std.testing.expectEqual(@as(usize, 5), mapped.loaded.stylesheet.rules.len);
+}
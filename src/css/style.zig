@@ -0,0 +1,332 @@
+//! Vulpes Browser - Computed Styles
+//!
+//! The per-element result of the cascade: the properties the text view
+//! renders, resolved to absolute values (font sizes in px, colors as RGB).
+//!
+//! Styles are interned in a StyleStore. Elements with equal styles hold
+//! the same StyleId, so a document with thousands of identical list items
+//! stores one style, and styles compare by id.
+//!
+
+const std = @import("std");
+const page_style = @import("../html/page_style.zig");
+const variables = @import("variables.zig");
+
+pub const Color = page_style.Color;
+
+pub const Display = enum(u8) { @"inline", block, list_item, none };
+pub const Decoration = enum(u8) { none, underline, line_through };
+pub const TextAlign = enum(u8) { left, right, center, justify };
+pub const WhiteSpace = enum(u8) { normal, nowrap, pre, pre_wrap, pre_line };
+
+/// Font size of the initial style and of rem units, in px
+pub const MEDIUM: f32 = 16;
+
+pub const ComputedStyle = struct {
+    display: Display = .@"inline",
+    /// Inherited; null leaves the viewer's default
+    color: ?Color = null,
+    background: ?Color = null,
+    /// Inherited, in px
+    font_size: f32 = MEDIUM,
+    /// Inherited
+    font_weight: u16 = 400,
+    /// Inherited
+    italic: bool = false,
+    /// Inherited; font-family names a monospace family
+    monospace: bool = false,
+    decoration: Decoration = .none,
+    /// Inherited
+    text_align: TextAlign = .left,
+    /// Inherited
+    white_space: WhiteSpace = .normal,
+    /// Inherited; the custom properties in effect
+    variables: variables.ScopeId = variables.EMPTY,
+
+    /// The starting point for a child of `parent`: inherited properties
+    /// copied, the rest at their initial values.
+    pub fn inheritFrom(parent: *const ComputedStyle) ComputedStyle {
+        return .{
+            .color = parent.color,
+            .font_size = parent.font_size,
+            .font_weight = parent.font_weight,
+            .italic = parent.italic,
+            .monospace = parent.monospace,
+            .text_align = parent.text_align,
+            .white_space = parent.white_space,
+            .variables = parent.variables,
+        };
+    }
+};
+
+const Property = enum {
+    display,
+    color,
+    background,
+    @"background-color",
+    @"font-size",
+    @"font-weight",
+    @"font-style",
+    @"font-family",
+    @"text-decoration",
+    @"text-decoration-line",
+    @"text-align",
+    @"white-space",
+};
+
+/// Apply one declaration to `style`. Unsupported properties and values
+/// the engine cannot parse are ignored, as the spec drops them.
+pub fn apply(style: *ComputedStyle, parent: *const ComputedStyle, name: []const u8, value: []const u8) void {
+    var lower: [24]u8 = undefined;
+    if (name.len > lower.len) return;
+    const property = std.meta.stringToEnum(Property, std.ascii.lowerString(&lower, name)) orelse return;
+
+    if (std.ascii.eqlIgnoreCase(value, "inherit")) return copy(style, parent, property);
+    if (std.ascii.eqlIgnoreCase(value, "initial")) return copy(style, &.{}, property);
+    if (std.ascii.eqlIgnoreCase(value, "unset")) return copy(style, &ComputedStyle.inheritFrom(parent), property);
+
+    switch (property) {
+        .display => style.display = display(value) orelse return,
+        .color => {
+            // currentcolor on color itself means the inherited color
+            if (std.ascii.eqlIgnoreCase(value, "currentcolor")) return copy(style, parent, property);
+            style.color = page_style.parseColor(value) orelse return;
+        },
+        .background, .@"background-color" => style.background = page_style.backgroundColor(value),
+        .@"font-size" => style.font_size = fontSize(value, parent.font_size) orelse return,
+        .@"font-weight" => style.font_weight = fontWeight(value, parent.font_weight) orelse return,
+        .@"font-style" => style.italic = !std.ascii.eqlIgnoreCase(value, "normal"),
+        .@"font-family" => style.monospace = isMonospace(value),
+        .@"text-decoration", .@"text-decoration-line" => {
+            if (std.ascii.indexOfIgnoreCase(value, "underline") != null) {
+                style.decoration = .underline;
+            } else if (std.ascii.indexOfIgnoreCase(value, "line-through") != null) {
+                style.decoration = .line_through;
+            } else if (std.ascii.indexOfIgnoreCase(value, "none") != null) {
+                style.decoration = .none;
+            }
+        },
+        .@"text-align" => style.text_align = keyword(TextAlign, value, &.{
+            .{ "left", .left },   .{ "start", .left },   .{ "right", .right },
+            .{ "end", .right },   .{ "center", .center }, .{ "justify", .justify },
+        }) orelse return,
+        .@"white-space" => style.white_space = keyword(WhiteSpace, value, &.{
+            .{ "normal", .normal },     .{ "nowrap", .nowrap },     .{ "pre", .pre },
+            .{ "pre-wrap", .pre_wrap }, .{ "pre-line", .pre_line }, .{ "break-spaces", .pre_wrap },
+        }) orelse return,
+    }
+}
+
+/// Set `property` in `style` to its value in `from`
+fn copy(style: *ComputedStyle, from: *const ComputedStyle, property: Property) void {
+    switch (property) {
+        .display => style.display = from.display,
+        .color => style.color = from.color,
+        .background, .@"background-color" => style.background = from.background,
+        .@"font-size" => style.font_size = from.font_size,
+        .@"font-weight" => style.font_weight = from.font_weight,
+        .@"font-style" => style.italic = from.italic,
+        .@"font-family" => style.monospace = from.monospace,
+        .@"text-decoration", .@"text-decoration-line" => style.decoration = from.decoration,
+        .@"text-align" => style.text_align = from.text_align,
+        .@"white-space" => style.white_space = from.white_space,
+    }
+}
+
+fn keyword(comptime T: type, value: []const u8, comptime table: []const struct { []const u8, T }) ?T {
+    inline for (table) |entry| {
+        if (std.ascii.eqlIgnoreCase(value, entry[0])) return entry[1];
+    }
+    return null;
+}
+
+/// Layout models the text view does not have collapse to block or inline
+fn display(value: []const u8) ?Display {
+    if (std.ascii.eqlIgnoreCase(value, "none")) return .none;
+    if (std.ascii.eqlIgnoreCase(value, "list-item")) return .list_item;
+    if (std.ascii.startsWithIgnoreCase(value, "inline") or std.ascii.eqlIgnoreCase(value, "contents")) return .@"inline";
+    return keyword(Display, value, &.{
+        .{ "block", .block },   .{ "flex", .block },      .{ "grid", .block },
+        .{ "table", .block },   .{ "flow-root", .block }, .{ "table-row", .block },
+        .{ "table-cell", .block },
+    });
+}
+
+fn fontSize(value: []const u8, parent: f32) ?f32 {
+    const keywords = .{
+        .{ "xx-small", 9 }, .{ "x-small", 10 }, .{ "small", 13 },    .{ "medium", 16 },
+        .{ "large", 18 },   .{ "x-large", 24 }, .{ "xx-large", 32 }, .{ "xxx-large", 48 },
+    };
+    inline for (keywords) |entry| {
+        if (std.ascii.eqlIgnoreCase(value, entry[0])) return entry[1];
+    }
+    if (std.ascii.eqlIgnoreCase(value, "smaller")) return parent / 1.2;
+    if (std.ascii.eqlIgnoreCase(value, "larger")) return parent * 1.2;
+
+    const number, const unit = splitUnit(value) orelse return null;
+    if (number < 0) return null;
+    const scale: f32 = if (unit.len == 0)
+        (if (number == 0) 0 else return null)
+    else if (std.ascii.eqlIgnoreCase(unit, "px"))
+        1
+    else if (std.ascii.eqlIgnoreCase(unit, "em"))
+        parent
+    else if (std.ascii.eqlIgnoreCase(unit, "%"))
+        parent / 100
+    else if (std.ascii.eqlIgnoreCase(unit, "rem"))
+        MEDIUM
+    else if (std.ascii.eqlIgnoreCase(unit, "pt"))
+        4.0 / 3.0
+    else
+        return null;
+    return number * scale;
+}
+
+fn fontWeight(value: []const u8, parent: u16) ?u16 {
+    if (std.ascii.eqlIgnoreCase(value, "normal")) return 400;
+    if (std.ascii.eqlIgnoreCase(value, "bold")) return 700;
+    // Relative weights per the CSS Fonts table
+    if (std.ascii.eqlIgnoreCase(value, "bolder")) return if (parent < 350) 400 else if (parent < 550) 700 else 900;
+    if (std.ascii.eqlIgnoreCase(value, "lighter")) return if (parent < 550) 100 else if (parent < 750) 400 else 700;
+    const weight = std.fmt.parseInt(u16, value, 10) catch return null;
+    if (weight < 1 or weight > 1000) return null;
+    return weight;
+}
+
+fn isMonospace(families: []const u8) bool {
+    const names = [_][]const u8{ "monospace", "mono", "courier", "consolas", "menlo", "monaco" };
+    for (names) |name| {
+        if (std.ascii.indexOfIgnoreCase(families, name) != null) return true;
+    }
+    return false;
+}
+
+/// "1.5em" -> 1.5, "em". Non-finite numbers are rejected.
+fn splitUnit(value: []const u8) ?struct { f32, []const u8 } {
+    var end: usize = 0;
+    while (end < value.len and (std.ascii.isDigit(value[end]) or value[end] == '.' or value[end] == '-' or value[end] == '+')) {
+        end += 1;
+    }
+    if (end == 0) return null;
+    const number = std.fmt.parseFloat(f32, value[0..end]) catch return null;
+    if (!std.math.isFinite(number)) return null;
+    return .{ number, value[end..] };
+}
+
+// =============================================================================
+// Interning
+// =============================================================================
+
+/// Index into StyleStore
+pub const StyleId = u32;
+
+pub const StyleStore = struct {
+    /// Distinct styles, by id
+    styles: std.ArrayListUnmanaged(ComputedStyle) = .empty,
+    ids: std.HashMapUnmanaged(ComputedStyle, StyleId, Context, std.hash_map.default_max_load_percentage) = .empty,
+
+    const Context = struct {
+        pub fn hash(_: Context, style: ComputedStyle) u64 {
+            var hasher = std.hash.Wyhash.init(0);
+            inline for (std.meta.fields(ComputedStyle)) |field| {
+                const value = @field(style, field.name);
+                // autoHash rejects floats; sizes are never NaN (see splitUnit)
+                if (field.type == f32) {
+                    std.hash.autoHash(&hasher, @as(u32, @bitCast(value)));
+                } else {
+                    std.hash.autoHash(&hasher, value);
+                }
+            }
+            return hasher.final();
+        }
+
+        pub fn eql(_: Context, a: ComputedStyle, b: ComputedStyle) bool {
+            return std.meta.eql(a, b);
+        }
+    };
+
+    pub fn deinit(self: *StyleStore, allocator: std.mem.Allocator) void {
+        self.styles.deinit(allocator);
+        self.ids.deinit(allocator);
+    }
+
+    /// The id of `style`, adding it if it is new
+    pub fn intern(self: *StyleStore, allocator: std.mem.Allocator, style: ComputedStyle) !StyleId {
+        const entry = try self.ids.getOrPut(allocator, style);
+        if (!entry.found_existing) {
+            errdefer self.ids.removeByPtr(entry.key_ptr);
+            entry.value_ptr.* = @intCast(self.styles.items.len);
+            try self.styles.append(allocator, style);
+        }
+        return entry.value_ptr.*;
+    }
+
+    pub fn get(self: *const StyleStore, id: StyleId) *const ComputedStyle {
+        return &self.styles.items[id];
+    }
+
+    pub fn count(self: *const StyleStore) usize {
+        return self.styles.items.len;
+    }
+};
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "declarations resolve against the parent" {
+    var parent: ComputedStyle = .{};
+    apply(&parent, &.{}, "font-size", "20px");
+    apply(&parent, &.{}, "color", "#336699");
+    apply(&parent, &.{}, "display", "block");
+
+    var child = ComputedStyle.inheritFrom(&parent);
+    try std.testing.expectEqual(@as(f32, 20), child.font_size);
+    try std.testing.expectEqual(Display.@"inline", child.display);
+
+    apply(&child, &parent, "Font-Size", "1.5em");
+    apply(&child, &parent, "font-weight", "bolder");
+    apply(&child, &parent, "font-family", "\"SF Mono\", Menlo, monospace");
+    apply(&child, &parent, "text-decoration", "underline dotted");
+    apply(&child, &parent, "display", "inherit");
+    apply(&child, &parent, "white-space", "pre-wrap");
+    try std.testing.expectEqual(@as(f32, 30), child.font_size);
+    try std.testing.expectEqual(@as(u16, 700), child.font_weight);
+    try std.testing.expect(child.monospace);
+    try std.testing.expectEqual(Decoration.underline, child.decoration);
+    try std.testing.expectEqual(Display.block, child.display);
+    try std.testing.expectEqual(WhiteSpace.pre_wrap, child.white_space);
+
+    // Bad values leave the property alone
+    apply(&child, &parent, "font-size", "nan px");
+    apply(&child, &parent, "font-size", "12");
+    apply(&child, &parent, "color", "not-a-color");
+    try std.testing.expectEqual(@as(f32, 30), child.font_size);
+    try std.testing.expectEqual(@as(u8, 0x33), child.color.?.r);
+
+    apply(&child, &parent, "font-size", "75%");
+    try std.testing.expectEqual(@as(f32, 15), child.font_size);
+
+    // unset inherits inherited properties and resets the rest
+    apply(&child, &parent, "font-size", "unset");
+    apply(&child, &parent, "display", "unset");
+    try std.testing.expectEqual(@as(f32, 20), child.font_size);
+    try std.testing.expectEqual(Display.@"inline", child.display);
+}
+
+test "equal styles intern to one id" {
+    const allocator = std.testing.allocator;
+    var store: StyleStore = .{};
+    defer store.deinit(allocator);
+
+    var bold: ComputedStyle = .{};
+    apply(&bold, &.{}, "font-weight", "bold");
+    const a = try store.intern(allocator, bold);
+    const b = try store.intern(allocator, .{});
+    const c = try store.intern(allocator, ComputedStyle.inheritFrom(&bold));
+
+    try std.testing.expect(a != b);
+    try std.testing.expectEqual(a, c);
+    try std.testing.expectEqual(@as(usize, 2), store.count());
+    try std.testing.expectEqual(@as(u16, 700), store.get(a).font_weight);
+}
@@ -0,0 +1,524 @@
+//! Vulpes Browser - Custom Properties
+//!
+//! Custom properties (--name: value) and var() substitution.
+//!
+//! Custom properties inherit, and most elements declare none, so the set
+//! an element sees is a scope: the properties its own rules declare plus
+//! a link to its parent's scope. An element that declares nothing, or
+//! only what it already inherits, keeps its parent's ScopeId, so a deep
+//! tree under one :root block holds a single scope however many elements
+//! it has. Lookups walk the links towards the root. Identical scopes
+//! under the same parent are stored once, so list items that set the same
+//! properties share one.
+//!
+//! Values are stored with their var() references already substituted,
+//! as the spec computes them. A property that refers to itself, directly
+//! or through others declared on the same element, is in a cycle and
+//! becomes invalid; so does one whose reference has no value and no
+//! fallback. An invalid property hides the inherited value, and var() of
+//! it takes the fallback.
+//!
+
+const std = @import("std");
+
+/// Index into Scopes
+pub const ScopeId = u32;
+
+/// The scope with no properties, above the root element
+pub const EMPTY: ScopeId = 0;
+
+/// Longest value substitution may produce. References repeated at every
+/// level grow a value exponentially; past this it is invalid.
+const MAX_VALUE = 64 * 1024;
+
+/// Deepest nesting of var() fallbacks
+const MAX_NESTING = 32;
+
+pub const Error = error{OutOfMemory};
+
+const whitespace = " \t\n\r\x0c";
+
+/// Custom property names start with "--"; unlike others they are case-sensitive.
+pub fn isCustom(name: []const u8) bool {
+    return name.len > 2 and std.mem.startsWith(u8, name, "--");
+}
+
+/// Does `value` need substitution?
+pub fn hasReference(value: []const u8) bool {
+    return std.ascii.indexOfIgnoreCase(value, "var(") != null;
+}
+
+/// A slice of Scopes.bytes or Resolver.buffer, which both grow
+const Str = struct {
+    start: u32,
+    len: u32,
+};
+
+/// A property and its resolved value; null if invalid
+const Declared = struct {
+    name: []const u8,
+    value: ?[]const u8,
+};
+
+pub const Scopes = struct {
+    /// Scope n is nodes[n - 1]
+    nodes: std.ArrayListUnmanaged(Node) = .empty,
+    bindings: std.ArrayListUnmanaged(Binding) = .empty,
+    /// Names and values of all bindings
+    bytes: std.ArrayListUnmanaged(u8) = .empty,
+    /// Scope by hash of its parent and bindings
+    unique: std.AutoHashMapUnmanaged(u64, ScopeId) = .empty,
+
+    const Node = struct {
+        parent: ScopeId,
+        /// This scope's own bindings
+        start: u32,
+        len: u32,
+    };
+
+    const Binding = struct {
+        name: Str,
+        /// null: declared invalid
+        value: ?Str,
+    };
+
+    pub fn deinit(self: *Scopes, allocator: std.mem.Allocator) void {
+        self.nodes.deinit(allocator);
+        self.bindings.deinit(allocator);
+        self.bytes.deinit(allocator);
+        self.unique.deinit(allocator);
+    }
+
+    /// Distinct scopes, EMPTY included
+    pub fn count(self: *const Scopes) usize {
+        return self.nodes.items.len + 1;
+    }
+
+    /// Value of `name` in `scope`; null if it is unset or invalid
+    pub fn lookup(self: *const Scopes, scope: ScopeId, name: []const u8) ?[]const u8 {
+        var id = scope;
+        while (id != EMPTY) {
+            const node = self.nodes.items[id - 1];
+            for (self.bindings.items[node.start..][0..node.len]) |binding| {
+                if (!std.mem.eql(u8, self.str(binding.name), name)) continue;
+                return if (binding.value) |value| self.str(value) else null;
+            }
+            id = node.parent;
+        }
+        return null;
+    }
+
+    fn str(self: *const Scopes, s: Str) []const u8 {
+        return self.bytes.items[s.start..][0..s.len];
+    }
+
+    /// The scope of a child of `parent` declaring `declared`, which must
+    /// not point into `bytes`
+    fn define(self: *Scopes, allocator: std.mem.Allocator, parent: ScopeId, declared: []const Declared) Error!ScopeId {
+        const overrides = for (declared) |d| {
+            if (!optionalEql(self.lookup(parent, d.name), d.value)) break true;
+        } else false;
+        if (!overrides) return parent;
+
+        var hasher = std.hash.Wyhash.init(parent);
+        for (declared) |d| {
+            hasher.update(d.name);
+            hasher.update(":");
+            hasher.update(d.value orelse "\x00");
+            hasher.update(";");
+        }
+        const hash = hasher.final();
+        if (self.unique.get(hash)) |existing| {
+            if (self.same(existing, parent, declared)) return existing;
+        }
+
+        const start = self.bindings.items.len;
+        for (declared) |d| {
+            try self.bindings.append(allocator, .{
+                .name = try self.store(allocator, d.name),
+                .value = if (d.value) |value| try self.store(allocator, value) else null,
+            });
+        }
+        try self.nodes.append(allocator, .{ .parent = parent, .start = @intCast(start), .len = @intCast(declared.len) });
+        const id: ScopeId = @intCast(self.nodes.items.len);
+        // A colliding scope loses its entry; it is still valid, just not reused
+        try self.unique.put(allocator, hash, id);
+        return id;
+    }
+
+    fn same(self: *const Scopes, id: ScopeId, parent: ScopeId, declared: []const Declared) bool {
+        const node = self.nodes.items[id - 1];
+        if (node.parent != parent or node.len != declared.len) return false;
+        for (self.bindings.items[node.start..][0..node.len], declared) |binding, d| {
+            if (!std.mem.eql(u8, self.str(binding.name), d.name)) return false;
+            if (!optionalEql(if (binding.value) |value| self.str(value) else null, d.value)) return false;
+        }
+        return true;
+    }
+
+    fn store(self: *Scopes, allocator: std.mem.Allocator, text: []const u8) Error!Str {
+        const start = self.bytes.items.len;
+        try self.bytes.appendSlice(allocator, text);
+        return .{ .start = @intCast(start), .len = @intCast(text.len) };
+    }
+};
+
+fn optionalEql(a: ?[]const u8, b: ?[]const u8) bool {
+    if (a == null or b == null) return a == null and b == null;
+    return std.mem.eql(u8, a.?, b.?);
+}
+
+/// Resolves the custom properties one element declares into its scope.
+/// Reused from element to element.
+pub const Resolver = struct {
+    parent: ScopeId = EMPTY,
+    locals: std.ArrayListUnmanaged(Local) = .empty,
+    /// Locals being resolved, innermost last
+    stack: std.ArrayListUnmanaged(u32) = .empty,
+    /// Resolved values of locals
+    buffer: std.ArrayListUnmanaged(u8) = .empty,
+    declared: std.ArrayListUnmanaged(Declared) = .empty,
+
+    const Local = struct {
+        name: []const u8,
+        raw: []const u8,
+        state: enum { pending, resolving, done } = .pending,
+        in_cycle: bool = false,
+        value: ?Str = null,
+    };
+
+    pub fn deinit(self: *Resolver, allocator: std.mem.Allocator) void {
+        self.locals.deinit(allocator);
+        self.stack.deinit(allocator);
+        self.buffer.deinit(allocator);
+        self.declared.deinit(allocator);
+    }
+
+    /// Start on an element whose parent's scope is `parent`
+    pub fn begin(self: *Resolver, parent: ScopeId) void {
+        self.parent = parent;
+        self.locals.clearRetainingCapacity();
+        self.buffer.clearRetainingCapacity();
+    }
+
+    /// Note a custom property declaration, in cascade order: later ones win.
+    /// `name` and `raw` must live until finish().
+    pub fn declare(self: *Resolver, allocator: std.mem.Allocator, name: []const u8, raw: []const u8) Error!void {
+        for (self.locals.items) |*local| {
+            if (std.mem.eql(u8, local.name, name)) {
+                local.raw = raw;
+                return;
+            }
+        }
+        try self.locals.append(allocator, .{ .name = name, .raw = raw });
+    }
+
+    /// Resolve the declared properties; returns the element's scope
+    pub fn finish(self: *Resolver, allocator: std.mem.Allocator, scopes: *Scopes) Error!ScopeId {
+        if (self.locals.items.len == 0) return self.parent;
+        for (0..self.locals.items.len) |i| try self.resolve(allocator, scopes, @intCast(i));
+
+        self.declared.clearRetainingCapacity();
+        for (self.locals.items) |local| {
+            const value = if (local.value) |v| self.buffer.items[v.start..][0..v.len] else null;
+            try self.declared.append(allocator, .{ .name = local.name, .value = value });
+        }
+        return scopes.define(allocator, self.parent, self.declared.items);
+    }
+
+    fn resolve(self: *Resolver, allocator: std.mem.Allocator, scopes: *const Scopes, i: u32) Error!void {
+        const local = &self.locals.items[i];
+        if (local.state != .pending) return;
+        local.state = .resolving;
+        try self.stack.append(allocator, i);
+        defer _ = self.stack.pop();
+
+        var out: std.ArrayListUnmanaged(u8) = .empty;
+        defer out.deinit(allocator);
+        const raw = local.raw;
+        const valid = if (std.ascii.eqlIgnoreCase(raw, "initial"))
+            false
+        else if (std.ascii.eqlIgnoreCase(raw, "inherit") or std.ascii.eqlIgnoreCase(raw, "unset")) inherited: {
+            const value = scopes.lookup(self.parent, local.name) orelse break :inherited false;
+            try out.appendSlice(allocator, value);
+            break :inherited true;
+        } else try substitute(allocator, &out, raw, Lookup{ .resolver = self, .allocator = allocator, .scopes = scopes }, 0);
+
+        local.state = .done;
+        if (valid and !local.in_cycle) {
+            local.value = .{ .start = @intCast(self.buffer.items.len), .len = @intCast(out.items.len) };
+            try self.buffer.appendSlice(allocator, out.items);
+        }
+    }
+
+    /// var() inside a declared value: other locals first, then the parent
+    const Lookup = struct {
+        resolver: *Resolver,
+        allocator: std.mem.Allocator,
+        scopes: *const Scopes,
+
+        fn value(self: Lookup, name: []const u8) Error!?[]const u8 {
+            const resolver = self.resolver;
+            for (resolver.locals.items, 0..) |local, j| {
+                if (!std.mem.eql(u8, local.name, name)) continue;
+                if (local.state == .resolving) {
+                    // Every local from here to the top of the stack is in the cycle
+                    const at = std.mem.indexOfScalar(u32, resolver.stack.items, @intCast(j)).?;
+                    for (resolver.stack.items[at..]) |k| resolver.locals.items[k].in_cycle = true;
+                    return null;
+                }
+                try resolver.resolve(self.allocator, self.scopes, @intCast(j));
+                const resolved = resolver.locals.items[j].value orelse return null;
+                return resolver.buffer.items[resolved.start..][0..resolved.len];
+            }
+            return self.scopes.lookup(resolver.parent, name);
+        }
+    };
+};
+
+/// `value` with its var() references replaced from `scope`, in `out`;
+/// null if it is invalid at computed-value time.
+pub fn resolveValue(
+    allocator: std.mem.Allocator,
+    scopes: *const Scopes,
+    scope: ScopeId,
+    value: []const u8,
+    out: *std.ArrayListUnmanaged(u8),
+) Error!?[]const u8 {
+    out.clearRetainingCapacity();
+    if (!try substitute(allocator, out, value, ScopeLookup{ .scopes = scopes, .scope = scope }, 0)) return null;
+    return std.mem.trim(u8, out.items, whitespace);
+}
+
+const ScopeLookup = struct {
+    scopes: *const Scopes,
+    scope: ScopeId,
+
+    fn value(self: ScopeLookup, name: []const u8) Error!?[]const u8 {
+        return self.scopes.lookup(self.scope, name);
+    }
+};
+
+/// Append `text` to `out` with each var() replaced through
+/// `context.value`. False if a reference has neither a value nor a
+/// fallback, or the result grows too long.
+fn substitute(
+    allocator: std.mem.Allocator,
+    out: *std.ArrayListUnmanaged(u8),
+    text: []const u8,
+    context: anytype,
+    depth: u8,
+) Error!bool {
+    if (depth > MAX_NESTING) return false;
+    var i: usize = 0;
+    while (i < text.len) {
+        if (text[i] == '"' or text[i] == '\'') {
+            const end = stringEnd(text, i);
+            try out.appendSlice(allocator, text[i..end]);
+            i = end;
+        } else if (isReference(text, i)) {
+            const close = closingParen(text, i + 4) orelse return false;
+            const arguments = text[i + 4 .. close];
+            const comma = topLevelComma(arguments);
+            const name = std.mem.trim(u8, arguments[0 .. comma orelse arguments.len], whitespace);
+            if (!isCustom(name)) return false;
+
+            if (try context.value(name)) |value| {
+                try out.appendSlice(allocator, value);
+            } else if (comma) |at| {
+                const fallback = std.mem.trim(u8, arguments[at + 1 ..], whitespace);
+                if (!try substitute(allocator, out, fallback, context, depth + 1)) return false;
+            } else {
+                return false;
+            }
+            i = close + 1;
+        } else {
+            try out.append(allocator, text[i]);
+            i += 1;
+        }
+        if (out.items.len > MAX_VALUE) return false;
+    }
+    return true;
+}
+
+/// "var(" at `i`, not the tail of a longer function name
+fn isReference(text: []const u8, i: usize) bool {
+    if (!std.ascii.startsWithIgnoreCase(text[i..], "var(")) return false;
+    if (i == 0) return true;
+    const before = text[i - 1];
+    return !(std.ascii.isAlphanumeric(before) or before == '-' or before == '_' or before >= 0x80);
+}
+
+/// Index just past the string starting at `start`
+fn stringEnd(text: []const u8, start: usize) usize {
+    const quote = text[start];
+    var i = start + 1;
+    while (i < text.len) : (i += 1) {
+        if (text[i] == '\\') {
+            i += 1;
+        } else if (text[i] == quote) {
+            return i + 1;
+        }
+    }
+    return text.len;
+}
+
+/// Index of the ')' closing a parenthesis opened just before `start`
+fn closingParen(text: []const u8, start: usize) ?usize {
+    var depth: usize = 1;
+    var i = start;
+    while (i < text.len) {
+        switch (text[i]) {
+            '"', '\'' => {
+                i = stringEnd(text, i);
+                continue;
+            },
+            '(' => depth += 1,
+            ')' => {
+                depth -= 1;
+                if (depth == 0) return i;
+            },
+            else => {},
+        }
+        i += 1;
+    }
+    return null;
+}
+
+fn topLevelComma(text: []const u8) ?usize {
+    var depth: usize = 0;
+    var i: usize = 0;
+    while (i < text.len) {
+        switch (text[i]) {
+            '"', '\'' => {
+                i = stringEnd(text, i);
+                continue;
+            },
+            '(' => depth += 1,
+            ')' => depth -|= 1,
+            ',' => if (depth == 0) return i,
+            else => {},
+        }
+        i += 1;
+    }
+    return null;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+const Test = struct {
+    scopes: Scopes = .{},
+    resolver: Resolver = .{},
+    out: std.ArrayListUnmanaged(u8) = .empty,
+
+    fn deinit(self: *Test) void {
+        self.scopes.deinit(std.testing.allocator);
+        self.resolver.deinit(std.testing.allocator);
+        self.out.deinit(std.testing.allocator);
+    }
+
+    /// Scope of a child of `parent` declaring `name: value` pairs
+    fn scope(self: *Test, parent: ScopeId, declarations: []const [2][]const u8) !ScopeId {
+        self.resolver.begin(parent);
+        for (declarations) |d| try self.resolver.declare(std.testing.allocator, d[0], d[1]);
+        return self.resolver.finish(std.testing.allocator, &self.scopes);
+    }
+
+    fn resolve(self: *Test, scope_id: ScopeId, value: []const u8) !?[]const u8 {
+        return resolveValue(std.testing.allocator, &self.scopes, scope_id, value, &self.out);
+    }
+};
+
+test "var() substitution and fallbacks" {
+    var t: Test = .{};
+    defer t.deinit();
+
+    const root = try t.scope(EMPTY, &.{
+        .{ "--blue", "#0d6efd" },
+        .{ "--link", "var(--blue)" },
+        .{ "--font", "system-ui, \"Segoe UI\"" },
+    });
+    try std.testing.expectEqualStrings("#0d6efd", t.scopes.lookup(root, "--link").?);
+    try std.testing.expect(t.scopes.lookup(root, "--Link") == null);
+
+    try std.testing.expectEqualStrings("#0d6efd", (try t.resolve(root, "var(--link)")).?);
+    try std.testing.expectEqualStrings("1px solid #0d6efd", (try t.resolve(root, "1px solid VAR( --blue )")).?);
+    try std.testing.expectEqualStrings("red", (try t.resolve(root, "var(--missing, red)")).?);
+    try std.testing.expectEqualStrings("rgb(1, 2, 3)", (try t.resolve(root, "var(--a, var(--b, rgb(1, 2, 3)))")).?);
+    try std.testing.expectEqualStrings("system-ui, \"Segoe UI\"", (try t.resolve(root, "var(--font)")).?);
+    try std.testing.expectEqualStrings("\"var(--blue)\"", (try t.resolve(root, "\"var(--blue)\"")).?);
+    try std.testing.expectEqualStrings("xvar(--blue)", (try t.resolve(root, "xvar(--blue)")).?);
+    try std.testing.expect(try t.resolve(root, "var(--missing)") == null);
+    try std.testing.expect(try t.resolve(root, "var(blue, red)") == null);
+    try std.testing.expect(try t.resolve(root, "var(--blue") == null);
+
+    // Children see the computed value: --link stays blue under a new --blue
+    const child = try t.scope(root, &.{ .{ "--blue", "navy" }, .{ "--gone", "initial" }, .{ "--same", "inherit" } });
+    try std.testing.expectEqualStrings("#0d6efd", t.scopes.lookup(child, "--link").?);
+    try std.testing.expectEqualStrings("navy", t.scopes.lookup(child, "--blue").?);
+    try std.testing.expect(t.scopes.lookup(child, "--gone") == null);
+    try std.testing.expectEqualStrings("#0d6efd", t.scopes.lookup(root, "--blue").?);
+
+    const hidden = try t.scope(child, &.{.{ "--blue", "initial" }});
+    try std.testing.expect(t.scopes.lookup(hidden, "--blue") == null);
+    try std.testing.expectEqualStrings("green", (try t.resolve(hidden, "var(--blue, green)")).?);
+}
+
+test "reference cycles are invalid" {
+    var t: Test = .{};
+    defer t.deinit();
+
+    const scope = try t.scope(EMPTY, &.{
+        .{ "--c", "var(--a, 1px)" },
+        .{ "--a", "var(--b)" },
+        .{ "--b", "calc(var(--a) + 1px)" },
+        .{ "--d", "var(--c, 2px)" },
+        .{ "--self", "var(--self, 3px)" },
+    });
+    try std.testing.expect(t.scopes.lookup(scope, "--a") == null);
+    try std.testing.expect(t.scopes.lookup(scope, "--b") == null);
+    try std.testing.expect(t.scopes.lookup(scope, "--self") == null);
+    // Depending on a cycle is not being in one
+    try std.testing.expectEqualStrings("1px", t.scopes.lookup(scope, "--c").?);
+    try std.testing.expectEqualStrings("1px", t.scopes.lookup(scope, "--d").?);
+
+    // Exponential growth is cut off
+    const bomb = try t.scope(EMPTY, &.{
+        .{ "--x0", "aaaaaaaaaaaaaaaa" },
+        .{ "--x1", "var(--x0)var(--x0)var(--x0)var(--x0)" },
+        .{ "--x2", "var(--x1)var(--x1)var(--x1)var(--x1)" },
+        .{ "--x3", "var(--x2)var(--x2)var(--x2)var(--x2)" },
+        .{ "--x4", "var(--x3)var(--x3)var(--x3)var(--x3)" },
+        .{ "--x5", "var(--x4)var(--x4)var(--x4)var(--x4)" },
+        .{ "--x6", "var(--x5)var(--x5)var(--x5)var(--x5)" },
+        .{ "--x7", "var(--x6)var(--x6)var(--x6)var(--x6)" },
+    });
+    try std.testing.expectEqual(@as(usize, MAX_VALUE), t.scopes.lookup(bomb, "--x6").?.len);
+    try std.testing.expect(t.scopes.lookup(bomb, "--x7") == null);
+}
+
+test "scopes are shared down the tree" {
+    var t: Test = .{};
+    defer t.deinit();
+
+    const root = try t.scope(EMPTY, &.{.{ "--gap", "4px" }});
+    try std.testing.expectEqual(EMPTY, try t.scope(EMPTY, &.{.{ "--gap", "initial" }}));
+
+    // A thousand levels that declare nothing or repeat what they inherit
+    var scope = root;
+    for (0..1000) |depth| {
+        scope = try t.scope(scope, if (depth % 2 == 0) &.{.{ "--gap", "4px" }} else &.{});
+    }
+    try std.testing.expectEqual(root, scope);
+    try std.testing.expectEqual(@as(usize, 2), t.scopes.count());
+
+    // Siblings overriding alike share one scope
+    const a = try t.scope(root, &.{.{ "--gap", "8px" }});
+    const b = try t.scope(root, &.{.{ "--gap", "8px" }});
+    try std.testing.expectEqual(a, b);
+    try std.testing.expectEqual(@as(usize, 3), t.scopes.count());
+    try std.testing.expectEqualStrings("8px", t.scopes.lookup(a, "--gap").?);
+    try std.testing.expectEqualStrings("4px", t.scopes.lookup(root, "--gap").?);
+}
@@ -0,0 +1,747 @@
+//! Vulpes Browser - Streaming RSS/Atom Parser
+//!
+//! Push-based feed parser: bytes go in as they arrive from the network and
+//! each <item>/<entry> is handed to a callback as soon as it closes. No tree
+//! is built and no input is retained, so memory stays constant however
+//! large the feed is.
+//!
+//! Per entry we keep title, link, date and summary in fixed buffers
+//! allocated once at init; values longer than their buffer are truncated.
+//! The summary (description, summary, content:encoded or content) is run
+//! through the HTML text extractor before it is reported, and HTML
+//! entities left in the title are decoded as the extractor would.
+//!
+//! Handles RSS 0.9x/2.0, RSS 1.0 (RDF) and Atom 1.0, CDATA sections,
+//! comments, namespaced names (dc:date, content:encoded) and inline
+//! XHTML content.
+//!
+
+const std = @import("std");
+const attributes = @import("../html/attributes.zig");
+const text_extractor = @import("../html/text_extractor.zig");
+const tokenizer = @import("../html/tokenizer.zig");
+
+/// Field capacities in bytes; longer values are truncated
+pub const TITLE_CAPACITY = 1024;
+pub const LINK_CAPACITY = 2048;
+pub const DATE_CAPACITY = 64;
+pub const SUMMARY_CAPACITY = 64 * 1024;
+/// Longest tag (name plus attributes) kept; the rest is dropped
+const TAG_CAPACITY = 2048;
+/// Longest entity name between '&' and ';'
+const ENTITY_CAPACITY = 12;
+
+/// One parsed entry. Slices are valid only during the callback.
+pub const Entry = struct {
+    title: []const u8,
+    link: []const u8,
+    /// Date as written (pubDate, published, updated or dc:date)
+    date: []const u8,
+    /// Unix seconds parsed from `date`, null if the format is unrecognized
+    timestamp: ?i64,
+    /// Summary after HTML extraction (display text with control bytes)
+    summary: []const u8,
+};
+
+pub const EntryFn = *const fn (entry: *const Entry, context: ?*anyopaque) void;
+
+const Field = enum { title, link, date, summary };
+
+const State = enum {
+    text,
+    entity,
+    tag,
+    comment,
+    cdata,
+};
+
+/// Fixed-capacity byte buffer that silently truncates.
+const Buffer = struct {
+    data: []u8,
+    len: usize = 0,
+    /// Bytes were dropped since the last clear
+    truncated: bool = false,
+
+    fn slice(self: *const Buffer) []const u8 {
+        return self.data[0..self.len];
+    }
+
+    fn clear(self: *Buffer) void {
+        self.len = 0;
+        self.truncated = false;
+    }
+
+    fn append(self: *Buffer, bytes: []const u8) void {
+        const n = @min(bytes.len, self.data.len - self.len);
+        @memcpy(self.data[self.len..][0..n], bytes[0..n]);
+        self.len += n;
+        if (n < bytes.len) self.truncated = true;
+    }
+
+    fn appendByte(self: *Buffer, c: u8) void {
+        if (self.len < self.data.len) {
+            self.data[self.len] = c;
+            self.len += 1;
+        } else {
+            self.truncated = true;
+        }
+    }
+};
+
+pub const Parser = struct {
+    allocator: std.mem.Allocator,
+    on_entry: EntryFn,
+    context: ?*anyopaque,
+
+    /// Backing storage for every buffer below, allocated once
+    storage: []u8,
+    title: Buffer,
+    link: Buffer,
+    date: Buffer,
+    summary: Buffer,
+    tag: Buffer,
+
+    entity: [ENTITY_CAPACITY]u8 = undefined,
+    entity_len: u8 = 0,
+
+    state: State = .text,
+    /// Quote character while inside a quoted attribute value
+    quote: u8 = 0,
+    /// Terminator characters matched so far ('-' of "-->", ']' of "]]>")
+    match: u8 = 0,
+
+    depth: u32 = 0,
+    in_entry: bool = false,
+    entry_depth: u32 = 0,
+    capture: ?Field = null,
+    capture_depth: u32 = 0,
+    /// Preference of the element that supplied the summary (description > content)
+    summary_rank: u8 = 0,
+
+    pub fn init(allocator: std.mem.Allocator, on_entry: EntryFn, context: ?*anyopaque) !Parser {
+        const storage = try allocator.alloc(u8, TITLE_CAPACITY + LINK_CAPACITY + DATE_CAPACITY + SUMMARY_CAPACITY + TAG_CAPACITY);
+        var rest = storage;
+        return .{
+            .allocator = allocator,
+            .on_entry = on_entry,
+            .context = context,
+            .storage = storage,
+            .title = .{ .data = carve(&rest, TITLE_CAPACITY) },
+            .link = .{ .data = carve(&rest, LINK_CAPACITY) },
+            .date = .{ .data = carve(&rest, DATE_CAPACITY) },
+            .summary = .{ .data = carve(&rest, SUMMARY_CAPACITY) },
+            .tag = .{ .data = carve(&rest, TAG_CAPACITY) },
+        };
+    }
+
+    pub fn deinit(self: *Parser) void {
+        self.allocator.free(self.storage);
+    }
+
+    /// Feed the next chunk of the document. Chunks may split anywhere,
+    /// including inside tags, entities and CDATA markers.
+    pub fn push(self: *Parser, bytes: []const u8) !void {
+        var i: usize = 0;
+        while (i < bytes.len) {
+            switch (self.state) {
+                .text => {
+                    // Outside a captured field only markup matters
+                    if (self.capture == null) {
+                        const lt = std.mem.indexOfScalarPos(u8, bytes, i, '<') orelse return;
+                        i = lt;
+                    }
+                    const c = bytes[i];
+                    i += 1;
+                    if (c == '<') {
+                        self.state = .tag;
+                        self.tag.clear();
+                        self.quote = 0;
+                    } else if (c == '&') {
+                        self.state = .entity;
+                        self.entity_len = 0;
+                    } else {
+                        self.captureByte(c);
+                    }
+                },
+                .entity => {
+                    const c = bytes[i];
+                    if (c == ';') {
+                        i += 1;
+                        self.decodeEntity();
+                        self.state = .text;
+                    } else if ((std.ascii.isAlphanumeric(c) or c == '#') and self.entity_len < ENTITY_CAPACITY) {
+                        i += 1;
+                        self.entity[self.entity_len] = c;
+                        self.entity_len += 1;
+                    } else {
+                        // Not an entity: keep it literally and reprocess `c` as text
+                        self.flushEntityLiteral();
+                        self.state = .text;
+                    }
+                },
+                .tag => {
+                    const c = bytes[i];
+                    i += 1;
+                    if (self.quote != 0) {
+                        if (c == self.quote) self.quote = 0;
+                        self.tag.appendByte(c);
+                    } else if (c == '>') {
+                        self.state = .text;
+                        try self.handleTag();
+                    } else {
+                        if (c == '"' or c == '\'') self.quote = c;
+                        self.tag.appendByte(c);
+                        if (self.tag.len == 3 and std.mem.eql(u8, self.tag.slice(), "!--")) {
+                            self.state = .comment;
+                            self.match = 0;
+                        } else if (self.tag.len == 8 and std.mem.eql(u8, self.tag.slice(), "![CDATA[")) {
+                            self.state = .cdata;
+                            self.match = 0;
+                        }
+                    }
+                },
+                .comment => {
+                    const c = bytes[i];
+                    i += 1;
+                    if (c == '-') {
+                        self.match +|= 1;
+                    } else if (c == '>' and self.match >= 2) {
+                        self.state = .text;
+                    } else {
+                        self.match = 0;
+                    }
+                },
+                .cdata => {
+                    const c = bytes[i];
+                    i += 1;
+                    if (c == ']') {
+                        // Only the last two ']' can belong to the terminator
+                        if (self.match == 2) self.captureByte(']') else self.match += 1;
+                    } else if (c == '>' and self.match == 2) {
+                        self.state = .text;
+                    } else {
+                        for (0..self.match) |_| self.captureByte(']');
+                        self.match = 0;
+                        self.captureByte(c);
+                    }
+                },
+            }
+        }
+    }
+
+    /// Signal end of input. An entry left open by a truncated feed is
+    /// still reported. The parser is reset and can be reused.
+    pub fn finish(self: *Parser) !void {
+        if (self.state == .entity) self.flushEntityLiteral();
+        if (self.in_entry) try self.emit();
+        self.state = .text;
+        self.depth = 0;
+        self.in_entry = false;
+        self.capture = null;
+    }
+
+    fn captureByte(self: *Parser, c: u8) void {
+        if (self.capture) |field| self.buffer(field).appendByte(c);
+    }
+
+    fn captureBytes(self: *Parser, bytes: []const u8) void {
+        if (self.capture) |field| self.buffer(field).append(bytes);
+    }
+
+    fn buffer(self: *Parser, field: Field) *Buffer {
+        return switch (field) {
+            .title => &self.title,
+            .link => &self.link,
+            .date => &self.date,
+            .summary => &self.summary,
+        };
+    }
+
+    fn flushEntityLiteral(self: *Parser) void {
+        self.captureByte('&');
+        self.captureBytes(self.entity[0..self.entity_len]);
+    }
+
+    fn decodeEntity(self: *Parser) void {
+        const name = self.entity[0..self.entity_len];
+        var utf8: [4]u8 = undefined;
+        if (decodeXmlEntity(name, &utf8)) |decoded| {
+            self.captureBytes(decoded);
+        } else {
+            // Unknown (HTML) entity: pass through for the HTML extractor
+            self.flushEntityLiteral();
+            self.captureByte(';');
+        }
+    }
+
+    fn handleTag(self: *Parser) !void {
+        const raw = self.tag.slice();
+        if (raw.len == 0 or raw[0] == '!' or raw[0] == '?') return;
+
+        if (raw[0] == '/') {
+            const name = localName(tokenizer.tagName(raw[1..]));
+            if (self.capture != null) {
+                if (self.depth == self.capture_depth) {
+                    self.capture = null;
+                } else {
+                    // Markup inside a field (inline XHTML) is kept for the extractor
+                    self.captureByte('<');
+                    self.captureBytes(raw);
+                    self.captureByte('>');
+                }
+            } else if (self.in_entry and self.depth == self.entry_depth and isEntryTag(name)) {
+                try self.emit();
+                self.in_entry = false;
+            }
+            self.depth -|= 1;
+            return;
+        }
+
+        // A truncated tag lost its '>' end; a '/' kept last may be from a URL
+        const self_closing = !self.tag.truncated and raw[raw.len - 1] == '/';
+        if (!self_closing) self.depth += 1;
+
+        if (self.capture != null) {
+            self.captureByte('<');
+            self.captureBytes(raw);
+            self.captureByte('>');
+            return;
+        }
+
+        const name = localName(tokenizer.tagName(raw));
+        if (isEntryTag(name)) {
+            self.in_entry = true;
+            self.entry_depth = self.depth;
+            self.title.clear();
+            self.link.clear();
+            self.date.clear();
+            self.summary.clear();
+            self.summary_rank = 0;
+            return;
+        }
+        if (!self.in_entry) return;
+
+        var field: ?Field = null;
+        if (std.ascii.eqlIgnoreCase(name, "title")) {
+            if (self.title.len == 0) field = .title;
+        } else if (std.ascii.eqlIgnoreCase(name, "link")) {
+            if (attributes.get(raw, "href")) |href| {
+                // Atom: the alternate (or unqualified) link is the entry's page
+                const rel = attributes.get(raw, "rel") orelse "alternate";
+                if (self.link.len == 0 and std.ascii.eqlIgnoreCase(rel, "alternate")) {
+                    self.link.append(href);
+                }
+            } else if (self.link.len == 0) {
+                field = .link;
+            }
+        } else if (std.ascii.eqlIgnoreCase(name, "pubDate") or
+            std.ascii.eqlIgnoreCase(name, "published") or
+            std.ascii.eqlIgnoreCase(name, "updated") or
+            std.ascii.eqlIgnoreCase(name, "date"))
+        {
+            if (self.date.len == 0) field = .date;
+        } else {
+            const rank = summaryRank(name);
+            if (rank > self.summary_rank) {
+                self.summary.clear();
+                self.summary_rank = rank;
+                field = .summary;
+            }
+        }
+
+        if (field != null and !self_closing) {
+            self.capture = field;
+            self.capture_depth = self.depth;
+        }
+    }
+
+    fn emit(self: *Parser) !void {
+        decodeHtmlEntities(&self.title);
+        const summary = try text_extractor.extractText(self.allocator, self.summary.slice());
+        defer self.allocator.free(summary);
+
+        const date = std.mem.trim(u8, self.date.slice(), whitespace);
+        const entry = Entry{
+            .title = std.mem.trim(u8, self.title.slice(), whitespace),
+            .link = std.mem.trim(u8, self.link.slice(), whitespace),
+            .date = date,
+            .timestamp = parseDate(date),
+            .summary = summary,
+        };
+        self.on_entry(&entry, self.context);
+    }
+};
+
+const whitespace = " \t\r\n";
+
+fn carve(rest: *[]u8, len: usize) []u8 {
+    const out = rest.*[0..len];
+    rest.* = rest.*[len..];
+    return out;
+}
+
+/// Name without its namespace prefix: `dc:date` -> `date`.
+fn localName(name: []const u8) []const u8 {
+    const colon = std.mem.lastIndexOfScalar(u8, name, ':') orelse return name;
+    return name[colon + 1 ..];
+}
+
+fn isEntryTag(name: []const u8) bool {
+    return std.ascii.eqlIgnoreCase(name, "item") or std.ascii.eqlIgnoreCase(name, "entry");
+}
+
+/// Which elements may supply the summary; a short summary beats full content.
+fn summaryRank(name: []const u8) u8 {
+    if (std.ascii.eqlIgnoreCase(name, "description") or std.ascii.eqlIgnoreCase(name, "summary")) return 2;
+    if (std.ascii.eqlIgnoreCase(name, "encoded") or std.ascii.eqlIgnoreCase(name, "content")) return 1;
+    return 0;
+}
+
+/// Decode one of the five XML entities or a character reference into `out`.
+fn decodeXmlEntity(name: []const u8, out: *[4]u8) ?[]const u8 {
+    if (name.len > 1 and name[0] == '#') {
+        const is_hex = name[1] == 'x' or name[1] == 'X';
+        const digits = if (is_hex) name[2..] else name[1..];
+        const codepoint = std.fmt.parseInt(u21, digits, if (is_hex) 16 else 10) catch return null;
+        const len = std.unicode.utf8Encode(codepoint, out) catch return null;
+        return out[0..len];
+    }
+
+    const named = [_]struct { name: []const u8, char: u8 }{
+        .{ .name = "lt", .char = '<' },
+        .{ .name = "gt", .char = '>' },
+        .{ .name = "amp", .char = '&' },
+        .{ .name = "quot", .char = '"' },
+        .{ .name = "apos", .char = '\'' },
+    };
+    for (named) |entity| {
+        if (std.mem.eql(u8, name, entity.name)) {
+            out[0] = entity.char;
+            return out[0..1];
+        }
+    }
+    return null;
+}
+
+/// Decode the HTML entities left in a field after XML decoding, as the
+/// extractor does for summaries: `&eacute;`, or `&lt;` from a doubly
+/// escaped `&amp;lt;`. A reference never decodes longer than it is
+/// written, so this runs in place.
+fn decodeHtmlEntities(field: *Buffer) void {
+    const data = field.data[0..field.len];
+    var read: usize = 0;
+    var write: usize = 0;
+    while (read < data.len) {
+        if (data[read] == '&') {
+            if (std.mem.indexOfScalarPos(u8, data, read + 1, ';')) |end| {
+                const name = data[read + 1 .. end];
+                var utf8: [4]u8 = undefined;
+                if (name.len <= ENTITY_CAPACITY) {
+                    if (decodeReference(name, &utf8)) |bytes| {
+                        @memcpy(data[write..][0..bytes.len], bytes);
+                        write += bytes.len;
+                        read = end + 1;
+                        continue;
+                    }
+                }
+            }
+        }
+        data[write] = data[read];
+        write += 1;
+        read += 1;
+    }
+    field.len = write;
+}
+
+/// An XML reference, or one of the HTML entities the extractor knows.
+fn decodeReference(name: []const u8, out: *[4]u8) ?[]const u8 {
+    if (decodeXmlEntity(name, out)) |bytes| return bytes;
+    out[0] = text_extractor.decodeEntity(name) orelse return null;
+    return out[0..1];
+}
+
+// =============================================================================
+// Dates
+// =============================================================================
+
+/// Parse an RFC 3339 (Atom) or RFC 822 (RSS) date into Unix seconds.
+pub fn parseDate(text: []const u8) ?i64 {
+    const s = std.mem.trim(u8, text, whitespace);
+    if (s.len >= 10 and s[4] == '-') return parseRfc3339(s);
+    return parseRfc822(s);
+}
+
+/// `2024-03-05T14:30:00Z`, `2024-03-05T14:30:00.123+01:00`, `2024-03-05`
+fn parseRfc3339(s: []const u8) ?i64 {
+    if (s.len < 10 or s[4] != '-' or s[7] != '-') return null;
+    const year = parseNumber(s[0..4]) orelse return null;
+    const month = parseNumber(s[5..7]) orelse return null;
+    const day = parseNumber(s[8..10]) orelse return null;
+    if (month < 1 or month > 12 or day < 1 or day > 31) return null;
+    const days = daysFromCivil(year, month, day);
+    if (s.len == 10) return days * std.time.s_per_day;
+
+    if (s.len < 16 or (s[10] != 'T' and s[10] != 't' and s[10] != ' ') or s[13] != ':') return null;
+    const hour = parseNumber(s[11..13]) orelse return null;
+    const minute = parseNumber(s[14..16]) orelse return null;
+    var second: i64 = 0;
+    var pos: usize = 16;
+    if (pos + 3 <= s.len and s[pos] == ':') {
+        second = parseNumber(s[pos + 1 .. pos + 3]) orelse return null;
+        pos += 3;
+    }
+    if (pos < s.len and s[pos] == '.') {
+        pos += 1;
+        while (pos < s.len and std.ascii.isDigit(s[pos])) pos += 1;
+    }
+    const offset = parseZone(s[pos..]) orelse return null;
+    return days * std.time.s_per_day + hour * 3600 + minute * 60 + second - offset;
+}
+
+/// `Tue, 05 Mar 2024 14:30:00 GMT`, `5 Mar 24 14:30 -0500`
+fn parseRfc822(s: []const u8) ?i64 {
+    // Drop the optional weekday
+    const rest = if (std.mem.indexOfScalar(u8, s, ',')) |comma| s[comma + 1 ..] else s;
+    var parts = std.mem.tokenizeAny(u8, rest, " \t");
+
+    const day = parseNumber(parts.next() orelse return null) orelse return null;
+    const month = monthNumber(parts.next() orelse return null) orelse return null;
+    var year = parseNumber(parts.next() orelse return null) orelse return null;
+    if (year < 100) year += if (year < 50) 2000 else 1900;
+
+    const time = parts.next() orelse return null;
+    if (time.len < 5 or time[2] != ':') return null;
+    const hour = parseNumber(time[0..2]) orelse return null;
+    const minute = parseNumber(time[3..5]) orelse return null;
+    var second: i64 = 0;
+    if (time.len >= 8 and time[5] == ':') second = parseNumber(time[6..8]) orelse return null;
+
+    const offset = parseZone(parts.next() orelse "") orelse 0;
+    if (day < 1 or day > 31) return null;
+    return daysFromCivil(year, month, day) * std.time.s_per_day + hour * 3600 + minute * 60 + second - offset;
+}
+
+/// Zone offset east of UTC in seconds. Empty means UTC.
+fn parseZone(zone: []const u8) ?i64 {
+    if (zone.len == 0 or std.mem.eql(u8, zone, "Z") or std.mem.eql(u8, zone, "z")) return 0;
+    if (zone[0] == '+' or zone[0] == '-') {
+        const digits = zone[1..];
+        const hours = parseNumber(digits[0..@min(2, digits.len)]) orelse return null;
+        var minutes: i64 = 0;
+        if (digits.len == 5 and digits[2] == ':') {
+            minutes = parseNumber(digits[3..5]) orelse return null;
+        } else if (digits.len == 4) {
+            minutes = parseNumber(digits[2..4]) orelse return null;
+        }
+        const offset = hours * 3600 + minutes * 60;
+        return if (zone[0] == '-') -offset else offset;
+    }
+
+    const zones = [_]struct { name: []const u8, hours: i64 }{
+        .{ .name = "GMT", .hours = 0 },
+        .{ .name = "UT", .hours = 0 },
+        .{ .name = "UTC", .hours = 0 },
+        .{ .name = "EST", .hours = -5 },
+        .{ .name = "EDT", .hours = -4 },
+        .{ .name = "CST", .hours = -6 },
+        .{ .name = "CDT", .hours = -5 },
+        .{ .name = "MST", .hours = -7 },
+        .{ .name = "MDT", .hours = -6 },
+        .{ .name = "PST", .hours = -8 },
+        .{ .name = "PDT", .hours = -7 },
+    };
+    for (zones) |z| {
+        if (std.ascii.eqlIgnoreCase(zone, z.name)) return z.hours * 3600;
+    }
+    return null;
+}
+
+fn monthNumber(name: []const u8) ?i64 {
+    const months = [_][]const u8{ "jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec" };
+    if (name.len < 3) return null;
+    for (months, 1..) |month, number| {
+        if (std.ascii.eqlIgnoreCase(name[0..3], month)) return @as(i64, @intCast(number));
+    }
+    return null;
+}
+
+fn parseNumber(digits: []const u8) ?i64 {
+    if (digits.len == 0) return null;
+    const value = std.fmt.parseInt(u32, digits, 10) catch return null;
+    return value;
+}
+
+/// Days since 1970-01-01 for a proleptic Gregorian date.
+fn daysFromCivil(year: i64, month: i64, day: i64) i64 {
+    const y = if (month <= 2) year - 1 else year;
+    const era = @divFloor(y, 400);
+    const yoe = y - era * 400;
+    const mp = @mod(month + 9, 12);
+    const doy = @divFloor(153 * mp + 2, 5) + day - 1;
+    const doe = yoe * 365 + @divFloor(yoe, 4) - @divFloor(yoe, 100) + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+const TestCollector = struct {
+    arena: std.heap.ArenaAllocator,
+    titles: std.ArrayListUnmanaged([]const u8) = .empty,
+    links: std.ArrayListUnmanaged([]const u8) = .empty,
+    summaries: std.ArrayListUnmanaged([]const u8) = .empty,
+    timestamps: std.ArrayListUnmanaged(?i64) = .empty,
+
+    fn init() TestCollector {
+        return .{ .arena = std.heap.ArenaAllocator.init(std.testing.allocator) };
+    }
+
+    fn deinit(self: *TestCollector) void {
+        self.arena.deinit();
+    }
+
+    fn onEntry(entry: *const Entry, context: ?*anyopaque) void {
+        const self: *TestCollector = @ptrCast(@alignCast(context.?));
+        const a = self.arena.allocator();
+        self.titles.append(a, a.dupe(u8, entry.title) catch unreachable) catch unreachable;
+        self.links.append(a, a.dupe(u8, entry.link) catch unreachable) catch unreachable;
+        self.summaries.append(a, a.dupe(u8, entry.summary) catch unreachable) catch unreachable;
+        self.timestamps.append(a, entry.timestamp) catch unreachable;
+    }
+};
+
+const rss_sample =
+    \\<?xml version="1.0"?>
+    \\<!-- generator: <Example> -->
+    \\<rss version="2.0" xmlns:dc="http://purl.org/dc/elements/1.1/"><channel>
+    \\<title>Channel title is not an entry</title>
+    \\<item>
+    \\  <title>First &amp; best</title>
+    \\  <link>https://example.com/1</link>
+    \\  <pubDate>Tue, 05 Mar 2024 14:30:00 GMT</pubDate>
+    \\  <description>&lt;p&gt;Hello &lt;b&gt;world&lt;/b&gt;&lt;/p&gt;</description>
+    \\</item>
+    \\<item>
+    \\  <title><![CDATA[Second <raw> title]]></title>
+    \\  <link>https://example.com/2</link>
+    \\  <dc:date>2024-03-06T08:00:00+01:00</dc:date>
+    \\  <description><![CDATA[<p>Plain]]]></description>
+    \\</item>
+    \\</channel></rss>
+;
+
+test "rss items with entities, cdata and dates" {
+    var collector = TestCollector.init();
+    defer collector.deinit();
+    var parser = try Parser.init(std.testing.allocator, TestCollector.onEntry, &collector);
+    defer parser.deinit();
+
+    try parser.push(rss_sample);
+    try parser.finish();
+
+    try std.testing.expectEqual(@as(usize, 2), collector.titles.items.len);
+    try std.testing.expectEqualStrings("First & best", collector.titles.items[0]);
+    try std.testing.expectEqualStrings("Second <raw> title", collector.titles.items[1]);
+    try std.testing.expectEqualStrings("https://example.com/2", collector.links.items[1]);
+    try std.testing.expectEqualStrings("Hello \x13world\x14", collector.summaries.items[0]);
+    try std.testing.expectEqualStrings("Plain]", collector.summaries.items[1]);
+    try std.testing.expectEqual(@as(?i64, 1709649000), collector.timestamps.items[0]);
+    try std.testing.expectEqual(@as(?i64, 1709708400), collector.timestamps.items[1]);
+}
+
+test "byte-at-a-time push matches whole-document push" {
+    var collector = TestCollector.init();
+    defer collector.deinit();
+    var parser = try Parser.init(std.testing.allocator, TestCollector.onEntry, &collector);
+    defer parser.deinit();
+
+    for (rss_sample) |c| try parser.push(&[_]u8{c});
+    try parser.finish();
+
+    try std.testing.expectEqual(@as(usize, 2), collector.titles.items.len);
+    try std.testing.expectEqualStrings("First & best", collector.titles.items[0]);
+    try std.testing.expectEqualStrings("Plain]", collector.summaries.items[1]);
+}
+
+test "atom entries with alternate links and xhtml content" {
+    const atom =
+        \\<feed xmlns="http://www.w3.org/2005/Atom"><title>Feed</title>
+        \\<entry>
+        \\  <title type="text">Atom entry</title>
+        \\  <link rel="edit" href="https://example.com/edit"/>
+        \\  <link href="https://example.com/post"/>
+        \\  <updated>2024-03-05T14:30:00.5Z</updated>
+        \\  <content type="xhtml"><div xmlns="http://www.w3.org/1999/xhtml"><p>Inline <em>markup</em></p></div></content>
+        \\</entry>
+        \\</feed>
+    ;
+    var collector = TestCollector.init();
+    defer collector.deinit();
+    var parser = try Parser.init(std.testing.allocator, TestCollector.onEntry, &collector);
+    defer parser.deinit();
+
+    try parser.push(atom);
+    try parser.finish();
+
+    try std.testing.expectEqual(@as(usize, 1), collector.titles.items.len);
+    try std.testing.expectEqualStrings("Atom entry", collector.titles.items[0]);
+    try std.testing.expectEqualStrings("https://example.com/post", collector.links.items[0]);
+    try std.testing.expectEqualStrings("Inline \x11markup\x12", collector.summaries.items[0]);
+    try std.testing.expectEqual(@as(?i64, 1709649000), collector.timestamps.items[0]);
+}
+
+test "oversized fields are truncated, not buffered" {
+    var collector = TestCollector.init();
+    defer collector.deinit();
+    var parser = try Parser.init(std.testing.allocator, TestCollector.onEntry, &collector);
+    defer parser.deinit();
+
+    try parser.push("<rss><channel><item><title>");
+    for (0..TITLE_CAPACITY) |_| try parser.push("xy");
+    try parser.push("</title></item>");
+    // Truncated feed: the open item is still reported by finish()
+    try parser.push("<item><title>Tail</title>");
+    try parser.finish();
+
+    try std.testing.expectEqual(@as(usize, 2), collector.titles.items.len);
+    try std.testing.expectEqual(@as(usize, TITLE_CAPACITY), collector.titles.items[0].len);
+    try std.testing.expectEqualStrings("Tail", collector.titles.items[1]);
+}
+
+test "html entities in titles are decoded" {
+    var collector = TestCollector.init();
+    defer collector.deinit();
+    var parser = try Parser.init(std.testing.allocator, TestCollector.onEntry, &collector);
+    defer parser.deinit();
+
+    try parser.push("<rss><channel><item><title>A &amp;mdash; B &amp;lt;3 &amp;#8217;s &amp;bogus;</title></item></channel></rss>");
+    try parser.finish();
+
+    try std.testing.expectEqualStrings("A - B <3 \u{2019}s &bogus;", collector.titles.items[0]);
+}
+
+test "a truncated tag is not taken as self-closing" {
+    var collector = TestCollector.init();
+    defer collector.deinit();
+    var parser = try Parser.init(std.testing.allocator, TestCollector.onEntry, &collector);
+    defer parser.deinit();
+
+    // The tag buffer fills up on a '/' of the attribute value
+    try parser.push("<rss><channel><item><title>First</title><media href=\"");
+    for (0..TAG_CAPACITY) |_| try parser.push("a/");
+    try parser.push("\">x</media></item><item><title>Second</title></item></channel></rss>");
+    try parser.finish();
+
+    try std.testing.expectEqual(@as(usize, 2), collector.titles.items.len);
+    try std.testing.expectEqualStrings("First", collector.titles.items[0]);
+    try std.testing.expectEqualStrings("Second", collector.titles.items[1]);
+}
+
+test "parseDate formats" {
+    try std.testing.expectEqual(@as(?i64, 0), parseDate("1970-01-01T00:00:00Z"));
+    try std.testing.expectEqual(@as(?i64, 951782400), parseDate("2000-02-29"));
+    try std.testing.expectEqual(@as(?i64, 1709649000), parseDate("Tue, 05 Mar 2024 09:30:00 EST"));
+    try std.testing.expectEqual(@as(?i64, 1709649000), parseDate("5 Mar 24 16:30 +0200"));
+    try std.testing.expect(parseDate("yesterday") == null);
+}
@@ -0,0 +1,147 @@
+//! Vulpes Browser - HTML Attribute Scanning
+//!
+//! Zero-copy attribute lookup over a raw tag slice (`<img src="a" alt=b>`).
+//! Values are returned as slices into the tag; entities are not decoded.
+//!
+//! Unlike a plain substring search, names are matched as whole attributes
+//! and quoted values are skipped, so `src` never matches `data-src` and an
+//! `alt="sizes=..."` value cannot be mistaken for a `sizes` attribute.
+//!
+
+const std = @import("std");
+
+pub const Attribute = struct {
+    name: []const u8,
+    /// Empty for valueless attributes like `<input disabled>`
+    value: []const u8,
+};
+
+/// Iterates the attributes of a raw tag in source order.
+pub const Iterator = struct {
+    tag: []const u8,
+    pos: usize,
+
+    pub fn init(tag: []const u8) Iterator {
+        // Skip '<' and the tag name
+        var pos: usize = 0;
+        if (pos < tag.len and tag[pos] == '<') pos += 1;
+        while (pos < tag.len and !isSpace(tag[pos]) and tag[pos] != '>' and tag[pos] != '/') {
+            pos += 1;
+        }
+        return .{ .tag = tag, .pos = pos };
+    }
+
+    pub fn next(self: *Iterator) ?Attribute {
+        const tag = self.tag;
+        while (self.pos < tag.len) {
+            const c = tag[self.pos];
+            if (isSpace(c) or c == '/') {
+                self.pos += 1;
+                continue;
+            }
+            if (c == '>') return null;
+
+            const name_start = self.pos;
+            while (self.pos < tag.len) {
+                const n = tag[self.pos];
+                if (isSpace(n) or n == '=' or n == '>' or n == '/') break;
+                self.pos += 1;
+            }
+            const name = tag[name_start..self.pos];
+
+            while (self.pos < tag.len and isSpace(tag[self.pos])) self.pos += 1;
+            if (self.pos >= tag.len or tag[self.pos] != '=') {
+                return .{ .name = name, .value = "" };
+            }
+            self.pos += 1;
+            while (self.pos < tag.len and isSpace(tag[self.pos])) self.pos += 1;
+            if (self.pos >= tag.len) return .{ .name = name, .value = "" };
+
+            const quote = tag[self.pos];
+            if (quote == '"' or quote == '\'') {
+                const start = self.pos + 1;
+                const end = std.mem.indexOfScalarPos(u8, tag, start, quote) orelse tag.len;
+                self.pos = @min(end + 1, tag.len);
+                return .{ .name = name, .value = tag[start..end] };
+            }
+
+            // Unquoted value - ends at whitespace or >
+            const start = self.pos;
+            while (self.pos < tag.len and !isSpace(tag[self.pos]) and tag[self.pos] != '>') {
+                self.pos += 1;
+            }
+            return .{ .name = name, .value = tag[start..self.pos] };
+        }
+        return null;
+    }
+};
+
+/// Look up an attribute value by (case-insensitive) name.
+/// Returns null if the attribute is absent.
+pub fn get(tag: []const u8, name: []const u8) ?[]const u8 {
+    var it = Iterator.init(tag);
+    while (it.next()) |attr| {
+        if (std.ascii.eqlIgnoreCase(attr.name, name)) return attr.value;
+    }
+    return null;
+}
+
+/// Find a property value in an inline `style` attribute.
+/// The last declaration wins, as in the cascade; `!important` is stripped.
+pub fn styleProperty(style: []const u8, property: []const u8) ?[]const u8 {
+    var found: ?[]const u8 = null;
+    var declarations = std.mem.splitScalar(u8, style, ';');
+    while (declarations.next()) |declaration| {
+        const colon = std.mem.indexOfScalar(u8, declaration, ':') orelse continue;
+        const name = std.mem.trim(u8, declaration[0..colon], whitespace);
+        if (!std.ascii.eqlIgnoreCase(name, property)) continue;
+
+        var value = std.mem.trim(u8, declaration[colon + 1 ..], whitespace);
+        if (std.mem.indexOfScalar(u8, value, '!')) |bang| {
+            value = std.mem.trim(u8, value[0..bang], whitespace);
+        }
+        found = value;
+    }
+    return found;
+}
+
+const whitespace = " \t\n\r\x0c";
+
+fn isSpace(c: u8) bool {
+    return c == ' ' or c == '\t' or c == '\n' or c == '\r' or c == 0x0C;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "get quoted, single-quoted and unquoted values" {
+    const tag = "<img src=\"/a.jpg\" alt='An image' width=640>";
+    try std.testing.expectEqualStrings("/a.jpg", get(tag, "src").?);
+    try std.testing.expectEqualStrings("An image", get(tag, "alt").?);
+    try std.testing.expectEqualStrings("640", get(tag, "width").?);
+    try std.testing.expect(get(tag, "height") == null);
+}
+
+test "names match whole attributes only" {
+    const tag = "<img data-src=\"/lazy.jpg\" alt=\"src=/fake.jpg\" src=\"/real.jpg\">";
+    try std.testing.expectEqualStrings("/real.jpg", get(tag, "src").?);
+}
+
+test "case-insensitive names and spaces around equals" {
+    const tag = "<IMG SRCSET = \"a.jpg 1x, b.jpg 2x\">";
+    try std.testing.expectEqualStrings("a.jpg 1x, b.jpg 2x", get(tag, "srcset").?);
+}
+
+test "valueless and self-closing attributes" {
+    const tag = "<source media=\"(min-width: 600px)\" hidden />";
+    try std.testing.expectEqualStrings("", get(tag, "hidden").?);
+    try std.testing.expectEqualStrings("(min-width: 600px)", get(tag, "media").?);
+}
+
+test "styleProperty finds last declaration" {
+    const style = "color: red; aspect-ratio: 4/3 ; COLOR: blue !important";
+    try std.testing.expectEqualStrings("blue", styleProperty(style, "color").?);
+    try std.testing.expectEqualStrings("4/3", styleProperty(style, "aspect-ratio").?);
+    try std.testing.expect(styleProperty(style, "width") == null);
+}
@@ -0,0 +1,390 @@
+//! Vulpes Browser - Reload Diff
+//!
+//! Compares a page's new extraction with the previous one for the same URL
+//! and reports which runs changed, so a reload or auto-refresh can update
+//! the changed regions in place and keep the scroll position.
+//!
+//! A run is one line of extracted text: paragraphs, list items, headings
+//! and table rows each end in '\n'. Runs are compared by 64-bit hash with
+//! Myers' O((N+M)D) diff after trimming the common prefix and suffix, so a
+//! dashboard that changes a few numbers costs little more than hashing the
+//! page. Pages that differ by more than MAX_EDITS runs are reported as one
+//! replaced block rather than diffed exactly.
+//!
+
+const std = @import("std");
+
+/// Run edits beyond which the diff gives up and replaces the changed middle
+const MAX_EDITS = 512;
+
+/// Pages remembered; the least recently updated is dropped first
+const MAX_PAGES = 32;
+
+/// Runs [old_start, old_start + old_count) of the previous text were
+/// replaced by runs [new_start, new_start + new_count) of the new text.
+/// A count of zero is a pure insertion or deletion.
+pub const Hunk = struct {
+    old_start: u32,
+    old_count: u32,
+    new_start: u32,
+    new_count: u32,
+    /// Bytes of the new text covered by the new runs
+    new_byte_start: usize,
+    new_byte_end: usize,
+};
+
+/// Run hashes of one extraction, enough to diff against the next.
+pub const Snapshot = struct {
+    hashes: []u64,
+    /// Start of each run in the text, plus the text length at the end
+    offsets: []usize,
+
+    pub fn init(allocator: std.mem.Allocator, text: []const u8) !Snapshot {
+        var runs: usize = std.mem.count(u8, text, "\n");
+        if (text.len > 0 and text[text.len - 1] != '\n') runs += 1;
+
+        const hashes = try allocator.alloc(u64, runs);
+        errdefer allocator.free(hashes);
+        const offsets = try allocator.alloc(usize, runs + 1);
+
+        var start: usize = 0;
+        for (hashes, offsets[0..runs]) |*hash, *offset| {
+            const end = if (std.mem.indexOfScalarPos(u8, text, start, '\n')) |newline| newline + 1 else text.len;
+            hash.* = std.hash.Wyhash.hash(0, text[start..end]);
+            offset.* = start;
+            start = end;
+        }
+        offsets[runs] = text.len;
+        return .{ .hashes = hashes, .offsets = offsets };
+    }
+
+    pub fn deinit(self: Snapshot, allocator: std.mem.Allocator) void {
+        allocator.free(self.offsets);
+        allocator.free(self.hashes);
+    }
+};
+
+/// Hunks turning `old` into `new`, in order. Caller owns the slice.
+pub fn diff(allocator: std.mem.Allocator, old: Snapshot, new: Snapshot) ![]Hunk {
+    var a = old.hashes;
+    var b = new.hashes;
+
+    // Reloads usually change a little in the middle
+    var prefix: usize = 0;
+    while (prefix < a.len and prefix < b.len and a[prefix] == b[prefix]) prefix += 1;
+    a = a[prefix..];
+    b = b[prefix..];
+    var suffix: usize = 0;
+    while (suffix < a.len and suffix < b.len and a[a.len - 1 - suffix] == b[b.len - 1 - suffix]) suffix += 1;
+    a = a[0 .. a.len - suffix];
+    b = b[0 .. b.len - suffix];
+
+    var hunks: std.ArrayListUnmanaged(Hunk) = .empty;
+    errdefer hunks.deinit(allocator);
+    if (a.len == 0 and b.len == 0) return hunks.toOwnedSlice(allocator);
+
+    const ops = try editScript(allocator, a, b) orelse {
+        // Too different to be worth an exact script
+        try hunks.append(allocator, makeHunk(new, prefix, a.len, prefix, b.len));
+        return hunks.toOwnedSlice(allocator);
+    };
+    defer allocator.free(ops);
+
+    var old_i = prefix;
+    var new_i = prefix;
+    var open: ?struct { old: usize, new: usize } = null;
+    for (ops) |op| {
+        if (op == .equal) {
+            if (open) |start| {
+                try hunks.append(allocator, makeHunk(new, start.old, old_i - start.old, start.new, new_i - start.new));
+                open = null;
+            }
+        } else if (open == null) {
+            open = .{ .old = old_i, .new = new_i };
+        }
+        if (op != .insert) old_i += 1;
+        if (op != .delete) new_i += 1;
+    }
+    if (open) |start| {
+        try hunks.append(allocator, makeHunk(new, start.old, old_i - start.old, start.new, new_i - start.new));
+    }
+    return hunks.toOwnedSlice(allocator);
+}
+
+fn makeHunk(new: Snapshot, old_start: usize, old_count: usize, new_start: usize, new_count: usize) Hunk {
+    return .{
+        .old_start = @intCast(old_start),
+        .old_count = @intCast(old_count),
+        .new_start = @intCast(new_start),
+        .new_count = @intCast(new_count),
+        .new_byte_start = new.offsets[new_start],
+        .new_byte_end = new.offsets[new_start + new_count],
+    };
+}
+
+const Op = enum(u8) { equal, delete, insert };
+
+/// Shortest edit script from `a` to `b` (Myers 1986), or null if it needs
+/// more than MAX_EDITS edits. Each round d keeps a copy of the furthest
+/// reaching paths it started from, trimmed to diagonals -d-1..d+1, for
+/// the backtrack; that is O(D^2) memory rather than O((N+M)D).
+fn editScript(allocator: std.mem.Allocator, a: []const u64, b: []const u64) !?[]Op {
+    const max_d: isize = @intCast(@min(a.len + b.len, MAX_EDITS));
+    const offset = max_d + 1;
+    const n: isize = @intCast(a.len);
+    const m: isize = @intCast(b.len);
+
+    // Furthest x reached on each diagonal k, indexed by k + offset
+    const v = try allocator.alloc(isize, @intCast(2 * max_d + 3));
+    defer allocator.free(v);
+    @memset(v, 0);
+    var trace: std.ArrayListUnmanaged(isize) = .empty;
+    defer trace.deinit(allocator);
+
+    var d: isize = 0;
+    const edits = search: while (d <= max_d) : (d += 1) {
+        try trace.appendSlice(allocator, v[@intCast(offset - d - 1)..@intCast(offset + d + 2)]);
+        var k = -d;
+        while (k <= d) : (k += 2) {
+            const i: usize = @intCast(offset + k);
+            var x = if (k == -d or (k != d and v[i - 1] < v[i + 1])) v[i + 1] else v[i - 1] + 1;
+            var y = x - k;
+            while (x < n and y < m and a[@intCast(x)] == b[@intCast(y)]) {
+                x += 1;
+                y += 1;
+            }
+            v[i] = x;
+            if (x >= n and y >= m) break :search d;
+        }
+    } else return null;
+
+    // Walk back from (n, m), emitting ops in reverse; every equal op
+    // consumes a run from each side, every edit from one
+    const ops = try allocator.alloc(Op, @intCast(@divExact(n + m + edits, 2)));
+    errdefer allocator.free(ops);
+    var out = ops.len;
+    var x = n;
+    var y = m;
+    var step = edits;
+    while (step >= 0) : (step -= 1) {
+        const base: usize = @intCast(step * step + 2 * step);
+        const snapshot = trace.items[base..][0..@intCast(2 * step + 3)];
+        const k = x - y;
+        const prev_k = if (k == -step or (k != step and snapshot[@intCast(k - 1 + step + 1)] < snapshot[@intCast(k + 1 + step + 1)])) k + 1 else k - 1;
+        const prev_x = snapshot[@intCast(prev_k + step + 1)];
+        const prev_y = prev_x - prev_k;
+        while (x > prev_x and y > prev_y) {
+            out -= 1;
+            ops[out] = .equal;
+            x -= 1;
+            y -= 1;
+        }
+        if (step > 0) {
+            out -= 1;
+            ops[out] = if (x == prev_x) .insert else .delete;
+        }
+        x = prev_x;
+        y = prev_y;
+    }
+    return ops;
+}
+
+/// Result of recording a page in the cache
+pub const Update = struct {
+    /// False on the first load of a URL (hunks is then empty)
+    had_previous: bool,
+    hunks: []Hunk,
+};
+
+/// Last extraction per URL, shared by every caller. Thread-safe.
+pub const Cache = struct {
+    mutex: std.Thread.Mutex = .{},
+    pages: std.StringHashMapUnmanaged(Page) = .empty,
+    clock: u64 = 0,
+
+    const Page = struct {
+        snapshot: Snapshot,
+        last_used: u64,
+    };
+
+    pub fn deinit(self: *Cache, allocator: std.mem.Allocator) void {
+        var it = self.pages.iterator();
+        while (it.next()) |entry| {
+            entry.value_ptr.snapshot.deinit(allocator);
+            allocator.free(entry.key_ptr.*);
+        }
+        self.pages.deinit(allocator);
+    }
+
+    /// Diff `text` against the text last recorded for `url`, then record it.
+    /// Caller owns `Update.hunks`.
+    pub fn update(self: *Cache, allocator: std.mem.Allocator, url: []const u8, text: []const u8) !Update {
+        // Hash outside the lock; only the swap needs it
+        const snapshot = try Snapshot.init(allocator, text);
+        errdefer snapshot.deinit(allocator);
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.clock += 1;
+
+        if (self.pages.getPtr(url)) |page| {
+            const hunks = try diff(allocator, page.snapshot, snapshot);
+            page.snapshot.deinit(allocator);
+            page.* = .{ .snapshot = snapshot, .last_used = self.clock };
+            return .{ .had_previous = true, .hunks = hunks };
+        }
+
+        const hunks = try allocator.alloc(Hunk, 0);
+        errdefer allocator.free(hunks);
+        if (self.pages.count() >= MAX_PAGES) self.evictOldest(allocator);
+        const key = try allocator.dupe(u8, url);
+        errdefer allocator.free(key);
+        try self.pages.put(allocator, key, .{ .snapshot = snapshot, .last_used = self.clock });
+        return .{ .had_previous = false, .hunks = hunks };
+    }
+
+    /// Drop the snapshot for `url`, e.g. when its tab closes.
+    pub fn forget(self: *Cache, allocator: std.mem.Allocator, url: []const u8) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.pages.fetchRemove(url)) |entry| {
+            entry.value.snapshot.deinit(allocator);
+            allocator.free(entry.key);
+        }
+    }
+
+    fn evictOldest(self: *Cache, allocator: std.mem.Allocator) void {
+        var oldest: ?[]const u8 = null;
+        var oldest_used: u64 = std.math.maxInt(u64);
+        var it = self.pages.iterator();
+        while (it.next()) |entry| {
+            if (entry.value_ptr.last_used < oldest_used) {
+                oldest = entry.key_ptr.*;
+                oldest_used = entry.value_ptr.last_used;
+            }
+        }
+        const url = oldest orelse return;
+        const entry = self.pages.fetchRemove(url).?;
+        entry.value.snapshot.deinit(allocator);
+        allocator.free(entry.key);
+    }
+};
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+fn diffTexts(old_text: []const u8, new_text: []const u8) ![]Hunk {
+    const allocator = std.testing.allocator;
+    const old = try Snapshot.init(allocator, old_text);
+    defer old.deinit(allocator);
+    const new = try Snapshot.init(allocator, new_text);
+    defer new.deinit(allocator);
+    return diff(allocator, old, new);
+}
+
+test "runs are lines" {
+    const snapshot = try Snapshot.init(std.testing.allocator, "a\nbb\n\nc");
+    defer snapshot.deinit(std.testing.allocator);
+    try std.testing.expectEqual(@as(usize, 4), snapshot.hashes.len);
+    try std.testing.expectEqualSlices(usize, &[_]usize{ 0, 2, 5, 6, 7 }, snapshot.offsets);
+}
+
+test "identical text has no hunks" {
+    const hunks = try diffTexts("a\nb\nc\n", "a\nb\nc\n");
+    defer std.testing.allocator.free(hunks);
+    try std.testing.expectEqual(@as(usize, 0), hunks.len);
+}
+
+test "changed line becomes one replace hunk" {
+    const new_text = "title\nvisitors: 12\nfooter\n";
+    const hunks = try diffTexts("title\nvisitors: 11\nfooter\n", new_text);
+    defer std.testing.allocator.free(hunks);
+
+    try std.testing.expectEqual(@as(usize, 1), hunks.len);
+    try std.testing.expectEqual(Hunk{
+        .old_start = 1,
+        .old_count = 1,
+        .new_start = 1,
+        .new_count = 1,
+        .new_byte_start = 6,
+        .new_byte_end = 19,
+    }, hunks[0]);
+    try std.testing.expectEqualStrings("visitors: 12\n", new_text[hunks[0].new_byte_start..hunks[0].new_byte_end]);
+}
+
+test "separate insertions and deletions" {
+    // Delete b, insert x after d, change f to g
+    const hunks = try diffTexts("a\nb\nc\nd\ne\nf\nh\n", "a\nc\nd\nx\ne\ng\nh\n");
+    defer std.testing.allocator.free(hunks);
+
+    try std.testing.expectEqual(@as(usize, 3), hunks.len);
+    try std.testing.expectEqual(@as(u32, 1), hunks[0].old_start);
+    try std.testing.expectEqual(@as(u32, 1), hunks[0].old_count);
+    try std.testing.expectEqual(@as(u32, 0), hunks[0].new_count);
+    try std.testing.expectEqual(@as(u32, 3), hunks[1].new_start);
+    try std.testing.expectEqual(@as(u32, 1), hunks[1].new_count);
+    try std.testing.expectEqual(@as(u32, 0), hunks[1].old_count);
+    try std.testing.expectEqual(@as(u32, 5), hunks[2].old_start);
+    try std.testing.expectEqual(@as(u32, 1), hunks[2].old_count);
+    try std.testing.expectEqual(@as(u32, 1), hunks[2].new_count);
+}
+
+test "edit script is minimal" {
+    const a = [_]u64{ 1, 2, 3, 1, 2, 2, 1 };
+    const b = [_]u64{ 3, 2, 1, 2, 1, 3 };
+    const ops = (try editScript(std.testing.allocator, &a, &b)).?;
+    defer std.testing.allocator.free(ops);
+
+    // The classic ABCABBA -> CBABAC example needs five edits
+    var edits: usize = 0;
+    var old_len: usize = 0;
+    var new_len: usize = 0;
+    for (ops) |op| {
+        if (op != .equal) edits += 1;
+        if (op != .insert) old_len += 1;
+        if (op != .delete) new_len += 1;
+    }
+    try std.testing.expectEqual(@as(usize, 5), edits);
+    try std.testing.expectEqual(a.len, old_len);
+    try std.testing.expectEqual(b.len, new_len);
+}
+
+test "cache diffs against the previous load of the same url" {
+    const allocator = std.testing.allocator;
+    var cache: Cache = .{};
+    defer cache.deinit(allocator);
+
+    const first = try cache.update(allocator, "https://example.com/", "a\nb\n");
+    defer allocator.free(first.hunks);
+    try std.testing.expect(!first.had_previous);
+
+    const other = try cache.update(allocator, "https://example.org/", "zzz\n");
+    defer allocator.free(other.hunks);
+
+    const second = try cache.update(allocator, "https://example.com/", "a\nc\n");
+    defer allocator.free(second.hunks);
+    try std.testing.expect(second.had_previous);
+    try std.testing.expectEqual(@as(usize, 1), second.hunks.len);
+    try std.testing.expectEqual(@as(u32, 1), second.hunks[0].new_start);
+
+    cache.forget(allocator, "https://example.com/");
+    const third = try cache.update(allocator, "https://example.com/", "a\nc\n");
+    defer allocator.free(third.hunks);
+    try std.testing.expect(!third.had_previous);
+}
+
+test "cache evicts the least recently updated page" {
+    const allocator = std.testing.allocator;
+    var cache: Cache = .{};
+    defer cache.deinit(allocator);
+
+    var url_buf: [32]u8 = undefined;
+    for (0..MAX_PAGES + 1) |n| {
+        const url = try std.fmt.bufPrint(&url_buf, "https://example.com/{d}", .{n});
+        const result = try cache.update(allocator, url, "x\n");
+        allocator.free(result.hunks);
+    }
+    try std.testing.expectEqual(@as(u32, MAX_PAGES), cache.pages.count());
+    try std.testing.expect(cache.pages.get("https://example.com/0") == null);
+}
@@ -0,0 +1,248 @@
+//! Vulpes Browser - Element Tree
+//!
+//! A compact element-only tree for selector matching and the cascade.
+//! Built in one pass over the shared tokenizer; text, comments and
+//! character references are not represented.
+//!
+//! Elements are stored in document order, so an element's parent and
+//! previous siblings always come before it and a forward walk visits
+//! ancestors first. Links between elements are indices.
+//!
+//! Tree construction is deliberately small: void elements and "/>" never
+//! open, an end tag closes up to the nearest open element of that name
+//! (stray end tags are ignored), and starting p, li, dt/dd, tr, td/th or
+//! option closes an open one of the same kind directly above it.
+//! The contents of script, style, title and textarea are skipped; the
+//! text of each <style> element is kept for the cascade.
+//!
+
+const std = @import("std");
+const attributes = @import("attributes.zig");
+const tokenizer = @import("tokenizer.zig");
+
+pub const NodeId = u32;
+
+/// No parent / sibling
+pub const NONE: NodeId = std.math.maxInt(NodeId);
+
+pub const Element = struct {
+    /// Lowercase tag name
+    tag: []const u8,
+    /// id attribute, if present and non-empty
+    id: ?[]const u8,
+    /// Entries of the class attribute
+    classes: []const []const u8,
+    /// The start tag as written, for other attribute lookups
+    raw: []const u8,
+    parent: NodeId,
+    prev_sibling: NodeId,
+    next_sibling: NodeId,
+    first_child: NodeId,
+    /// Number of ancestors
+    depth: u32,
+
+    pub fn attribute(self: Element, name: []const u8) ?[]const u8 {
+        return attributes.get(self.raw, name);
+    }
+};
+
+pub const Document = struct {
+    arena: std.heap.ArenaAllocator,
+    /// All elements, in document order
+    elements: []const Element,
+    /// Contents of the <style> elements, in document order
+    style_sheets: []const []const u8,
+
+    pub fn deinit(self: Document) void {
+        self.arena.deinit();
+    }
+};
+
+const void_tags = [_][]const u8{
+    "area", "base", "br", "col", "embed", "hr", "img", "input", "link", "meta", "source", "track", "wbr",
+};
+
+const raw_text_tags = [_][]const u8{ "script", "style", "textarea", "title" };
+
+/// Build the element tree for `html`. Slices point into `html`, which
+/// must outlive the document.
+pub fn parse(allocator: std.mem.Allocator, html: []const u8) !Document {
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    errdefer arena.deinit();
+    const owned = arena.allocator();
+
+    var elements: std.ArrayListUnmanaged(Element) = .empty;
+    defer elements.deinit(allocator);
+    var open: std.ArrayListUnmanaged(NodeId) = .empty;
+    defer open.deinit(allocator);
+    var classes: std.ArrayListUnmanaged([]const u8) = .empty;
+    defer classes.deinit(allocator);
+    // Last child seen so far, per open element
+    var last_child: std.ArrayListUnmanaged(NodeId) = .empty;
+    defer last_child.deinit(allocator);
+    var last_root: NodeId = NONE;
+    var style_sheets: std.ArrayListUnmanaged([]const u8) = .empty;
+    defer style_sheets.deinit(allocator);
+
+    var in_raw_text: ?[]const u8 = null;
+    // Where the open <style> element's text begins
+    var style_start: usize = 0;
+
+    var tokens = tokenizer.Tokenizer.init(html);
+    while (tokens.next()) |token| switch (token) {
+        .text => {},
+        .end_tag => |tag| {
+            if (in_raw_text) |name| {
+                if (!std.ascii.eqlIgnoreCase(tag.name, name)) continue;
+                if (std.mem.eql(u8, name, "style")) {
+                    try style_sheets.append(allocator, html[style_start..offsetOf(html, tag.raw)]);
+                }
+                in_raw_text = null;
+                continue;
+            }
+            var i = open.items.len;
+            while (i > 0) {
+                i -= 1;
+                if (std.ascii.eqlIgnoreCase(elements.items[open.items[i]].tag, tag.name)) {
+                    open.shrinkRetainingCapacity(i);
+                    last_child.shrinkRetainingCapacity(i);
+                    break;
+                }
+            }
+        },
+        .start_tag => |tag| {
+            if (in_raw_text != null or tag.name.len == 0) continue;
+
+            const name = try lowerName(owned, tag.name);
+            if (open.items.len > 0 and closesSameKind(elements.items[open.getLast()].tag, name)) {
+                _ = open.pop();
+                _ = last_child.pop();
+            }
+
+            const id: NodeId = @intCast(elements.items.len);
+            const parent = if (open.items.len > 0) open.getLast() else NONE;
+            const prev = if (parent != NONE) last_child.getLast() else last_root;
+            if (prev != NONE) {
+                elements.items[prev].next_sibling = id;
+            } else if (parent != NONE) {
+                elements.items[parent].first_child = id;
+            }
+            if (parent != NONE) last_child.items[last_child.items.len - 1] = id else last_root = id;
+
+            classes.clearRetainingCapacity();
+            if (attributes.get(tag.raw, "class")) |list| {
+                var it = std.mem.tokenizeAny(u8, list, " \t\n\r\x0c");
+                while (it.next()) |class| try classes.append(allocator, class);
+            }
+
+            try elements.append(allocator, .{
+                .tag = name,
+                .id = if (attributes.get(tag.raw, "id")) |value| (if (value.len > 0) value else null) else null,
+                .classes = try owned.dupe([]const u8, classes.items),
+                .raw = tag.raw,
+                .parent = parent,
+                .prev_sibling = prev,
+                .next_sibling = NONE,
+                .first_child = NONE,
+                .depth = @intCast(open.items.len),
+            });
+
+            const self_closing = std.mem.endsWith(u8, tag.raw, "/>");
+            if (isOneOf(name, &raw_text_tags)) {
+                if (!self_closing) in_raw_text = name;
+                style_start = offsetOf(html, tag.raw) + tag.raw.len;
+            } else if (!self_closing and !isOneOf(name, &void_tags)) {
+                try open.append(allocator, id);
+                try last_child.append(allocator, NONE);
+            }
+        },
+    };
+
+    const owned_elements = try owned.dupe(Element, elements.items);
+    const owned_sheets = try owned.dupe([]const u8, style_sheets.items);
+    return .{ .arena = arena, .elements = owned_elements, .style_sheets = owned_sheets };
+}
+
+/// Position of `part`, a slice of `html`, within it
+fn offsetOf(html: []const u8, part: []const u8) usize {
+    return @intFromPtr(part.ptr) - @intFromPtr(html.ptr);
+}
+
+/// Tag names are matched lowercase; most pages already write them that
+/// way, so copying is rare.
+fn lowerName(arena: std.mem.Allocator, name: []const u8) ![]const u8 {
+    for (name) |c| {
+        if (std.ascii.isUpper(c)) return std.ascii.allocLowerString(arena, name);
+    }
+    return name;
+}
+
+fn isOneOf(name: []const u8, comptime list: []const []const u8) bool {
+    inline for (list) |candidate| {
+        if (std.mem.eql(u8, name, candidate)) return true;
+    }
+    return false;
+}
+
+/// Does starting `next` implicitly end an open `current`?
+fn closesSameKind(current: []const u8, next: []const u8) bool {
+    const groups = [_][]const []const u8{
+        &.{"p"},  &.{"li"}, &.{ "dt", "dd" }, &.{"tr"}, &.{ "td", "th" }, &.{"option"},
+    };
+    inline for (groups) |group| {
+        if (isOneOf(current, group) and isOneOf(next, group)) return true;
+    }
+    return false;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "tree links and attributes" {
+    const doc = try parse(std.testing.allocator,
+        \\<!DOCTYPE html><HTML><body id="top" class=" page  dark ">
+        \\<ul><li>a<li class=x>b</ul><img src=x.png><br/><p>c
+        \\<script>if (a < b) { document.write("<p>") }</script></body></html>
+    );
+    defer doc.deinit();
+
+    const e = doc.elements;
+    try std.testing.expectEqualStrings("html", e[0].tag);
+    try std.testing.expectEqual(NONE, e[0].parent);
+
+    const body = e[1];
+    try std.testing.expectEqualStrings("top", body.id.?);
+    try std.testing.expectEqual(@as(usize, 2), body.classes.len);
+    try std.testing.expectEqualStrings("dark", body.classes[1]);
+    try std.testing.expectEqual(@as(NodeId, 2), body.first_child);
+
+    // The second <li> closed the first
+    try std.testing.expectEqualStrings("li", e[4].tag);
+    try std.testing.expectEqual(@as(NodeId, 2), e[4].parent);
+    try std.testing.expectEqual(@as(NodeId, 3), e[4].prev_sibling);
+    try std.testing.expectEqual(@as(NodeId, 4), e[3].next_sibling);
+    try std.testing.expectEqualStrings("x", e[4].classes[0]);
+
+    // img and br are void; p holds the script
+    try std.testing.expectEqual(@as(usize, 9), e.len);
+    try std.testing.expectEqualStrings("img", e[5].tag);
+    try std.testing.expectEqual(@as(NodeId, 1), e[5].parent);
+    try std.testing.expectEqual(@as(NodeId, 1), e[6].parent);
+    try std.testing.expectEqual(@as(NodeId, 1), e[7].parent);
+    try std.testing.expectEqualStrings("script", e[8].tag);
+    try std.testing.expectEqual(@as(NodeId, 7), e[8].parent);
+    try std.testing.expectEqual(@as(u32, 3), e[8].depth);
+}
+
+test "style element text is kept" {
+    const doc = try parse(std.testing.allocator,
+        \\<head><style>p > a { color: red }</style><STYLE media=print>
+        \\b { color: blue }</Style></head><body><style/></body>
+    );
+    defer doc.deinit();
+
+    try std.testing.expectEqual(@as(usize, 2), doc.style_sheets.len);
+    try std.testing.expectEqualStrings("p > a { color: red }", doc.style_sheets[0]);
+    try std.testing.expectEqualStrings("\nb { color: blue }", doc.style_sheets[1]);
+}
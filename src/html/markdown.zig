@@ -0,0 +1,658 @@
+//! Vulpes Browser - Markdown Emitter
+//!
+//! Writes CommonMark straight from the HTML token stream in one pass, as an
+//! alternative to the control-byte output of text_extractor. Used for
+//! "copy as Markdown" and export, so nothing has to re-parse the display text.
+//!
+//! Output:
+//!   - Headings as ATX (`## Title`), paragraphs separated by blank lines
+//!   - `*em*`, `**strong**`, `` `code` ``, fenced ``` blocks for <pre>; a
+//!     fence is always longer than any run of backticks it holds
+//!   - `>` block quotes, `-` and `1.` lists with nested indentation
+//!   - Links and images as reference-style `[text][N]` / `![alt][N]`, with
+//!     the definitions `[N]: url` collected at the end (one per URL)
+//!
+//! CommonMark has no tables; each row becomes its own paragraph.
+//!
+
+const std = @import("std");
+const attributes = @import("attributes.zig");
+const srcset = @import("srcset.zig");
+const text_extractor = @import("text_extractor.zig");
+const tokenizer = @import("tokenizer.zig");
+
+/// Maximum list nesting tracked for markers and indentation
+const MAX_LIST_DEPTH = 10;
+
+/// Characters with inline meaning in CommonMark
+const inline_specials = "\\`*_[]<>";
+/// Characters that would start a block construct at the beginning of a line
+const line_start_specials = "#>-+=";
+/// Where a plain stretch of running text ends
+const prose_stops = " \t\n\r&" ++ inline_specials;
+const whitespace = " \t\n\r";
+
+/// Convert HTML to CommonMark.
+/// Caller owns returned slice and must free with same allocator.
+pub fn extractMarkdown(allocator: std.mem.Allocator, html: []const u8) ![]u8 {
+    var out = Emitter{ .allocator = allocator };
+    errdefer out.buf.deinit(allocator);
+    defer out.code.deinit(allocator);
+
+    // Reference definitions, numbered in first-use order
+    var refs: std.ArrayListUnmanaged([]const u8) = .empty;
+    defer refs.deinit(allocator);
+
+    var lists: [MAX_LIST_DEPTH]List = undefined;
+    var list_depth: usize = 0;
+
+    var in_skip_tag: ?[]const u8 = null;
+    var in_pre = false;
+    var pre_fresh = false;
+    // Offset of the opening ``` fence of the current <pre>
+    var pre_fence: usize = 0;
+    var in_heading = false;
+    var link_ref: ?usize = null;
+    var picture_source: ?srcset.SourceSet = null;
+    var in_picture = false;
+
+    var tokens = tokenizer.Tokenizer.init(html);
+    while (tokens.next()) |token| switch (token) {
+        .end_tag => |tag| {
+            const name = tag.name;
+            if (in_skip_tag) |skip| {
+                if (std.ascii.eqlIgnoreCase(name, skip)) in_skip_tag = null;
+                continue;
+            }
+
+            const is_list = std.ascii.eqlIgnoreCase(name, "ul") or std.ascii.eqlIgnoreCase(name, "ol");
+            // An unclosed code span ends with its block
+            if (text_extractor.blockSpacingAfter(name) > 0) try out.closeCode();
+
+            if (std.ascii.eqlIgnoreCase(name, "pre")) {
+                if (in_pre) try out.closeFence(pre_fence);
+                in_pre = false;
+            } else if (std.ascii.eqlIgnoreCase(name, "code")) {
+                try out.closeCode();
+            } else if (std.ascii.eqlIgnoreCase(name, "em") or std.ascii.eqlIgnoreCase(name, "i")) {
+                if (!out.in_code) try out.close("*");
+            } else if (std.ascii.eqlIgnoreCase(name, "strong") or std.ascii.eqlIgnoreCase(name, "b")) {
+                if (!out.in_code) try out.close("**");
+            } else if (std.ascii.eqlIgnoreCase(name, "a")) {
+                if (link_ref) |ref| {
+                    // Empty link text leaves nothing to click; drop the link
+                    if (!out.cancelOpen("[")) {
+                        var ref_buf: [24]u8 = undefined;
+                        try out.buf.appendSlice(out.allocator, std.fmt.bufPrint(&ref_buf, "][{d}]", .{ref + 1}) catch unreachable);
+                    }
+                }
+                link_ref = null;
+            } else if (std.ascii.eqlIgnoreCase(name, "blockquote")) {
+                out.blankLine();
+                out.quote_depth -|= 1;
+            } else if (is_list) {
+                list_depth -|= 1;
+                out.indent = listIndent(lists[0..list_depth]);
+                // Closing a nested list resumes the parent list, keeping it tight
+                if (list_depth > 0) out.lineBreak() else out.blankLine();
+            } else if (std.ascii.eqlIgnoreCase(name, "picture")) {
+                in_picture = false;
+                picture_source = null;
+            } else if (text_extractor.isHeadingTag(name)) {
+                in_heading = false;
+            }
+
+            if (!is_list and text_extractor.blockSpacingAfter(name) > 0) out.blankLine();
+        },
+        .start_tag => |tag| {
+            const name = tag.name;
+            if (in_skip_tag != null) continue;
+            if (text_extractor.isSkipTag(name)) {
+                in_skip_tag = name;
+                continue;
+            }
+
+            const is_list = std.ascii.eqlIgnoreCase(name, "ul") or std.ascii.eqlIgnoreCase(name, "ol");
+            if (text_extractor.blockSpacingBefore(name) > 0) {
+                try out.closeCode();
+                // A nested list continues its item instead of starting a loose one
+                if (is_list and list_depth > 0) out.lineBreak() else out.blankLine();
+            }
+
+            if (std.ascii.eqlIgnoreCase(name, "pre")) {
+                in_pre = true;
+                pre_fresh = true;
+                try out.flush();
+                pre_fence = out.buf.items.len;
+                try out.write("```");
+                out.lineBreak();
+            } else if (std.ascii.eqlIgnoreCase(name, "code")) {
+                if (!in_pre) out.openCode();
+            } else if (std.ascii.eqlIgnoreCase(name, "em") or std.ascii.eqlIgnoreCase(name, "i")) {
+                if (!out.in_code) out.open("*");
+            } else if (std.ascii.eqlIgnoreCase(name, "strong") or std.ascii.eqlIgnoreCase(name, "b")) {
+                if (!out.in_code) out.open("**");
+            } else if (std.ascii.eqlIgnoreCase(name, "a")) {
+                // A code span cannot hold a link
+                if (out.in_code) continue;
+                if (attributes.get(tag.raw, "href")) |href| {
+                    if (href.len > 0) {
+                        link_ref = try internRef(allocator, &refs, href);
+                        out.open("[");
+                    }
+                }
+            } else if (std.ascii.eqlIgnoreCase(name, "blockquote")) {
+                out.quote_depth +|= 1;
+            } else if (is_list) {
+                if (list_depth < MAX_LIST_DEPTH) {
+                    lists[list_depth] = .{ .ordered = std.ascii.eqlIgnoreCase(name, "ol") };
+                    list_depth += 1;
+                }
+            } else if (std.ascii.eqlIgnoreCase(name, "li")) {
+                out.lineBreak();
+                if (list_depth > 0) {
+                    const list = &lists[list_depth - 1];
+                    list.count += 1;
+                    var marker_buf: [16]u8 = undefined;
+                    var marker: []const u8 = "- ";
+                    if (list.ordered) {
+                        marker = std.fmt.bufPrint(&marker_buf, "{d}. ", .{list.count}) catch unreachable;
+                    }
+                    list.width = @intCast(marker.len);
+
+                    // Marker line sits at the parent's indent, continuations under the text
+                    out.indent = listIndent(lists[0 .. list_depth - 1]);
+                    try out.write(marker);
+                    out.indent = listIndent(lists[0..list_depth]);
+                } else {
+                    try out.write("- ");
+                }
+            } else if (std.ascii.eqlIgnoreCase(name, "picture")) {
+                in_picture = true;
+                picture_source = null;
+            } else if (std.ascii.eqlIgnoreCase(name, "source")) {
+                if (in_picture and picture_source == null) {
+                    if (attributes.get(tag.raw, "srcset")) |set| {
+                        const media = attributes.get(tag.raw, "media");
+                        if (media == null or srcset.mediaMatches(media.?, .{})) {
+                            picture_source = .{ .srcset = set, .sizes = attributes.get(tag.raw, "sizes") };
+                        }
+                    }
+                }
+            } else if (std.ascii.eqlIgnoreCase(name, "img")) {
+                if (imageSource(tag.raw, picture_source)) |src| {
+                    const ref = try internRef(allocator, &refs, src);
+                    try out.write("![");
+                    if (attributes.get(tag.raw, "alt")) |alt| try out.prose(std.mem.trim(u8, alt, whitespace));
+                    var ref_buf: [24]u8 = undefined;
+                    try out.buf.appendSlice(allocator, std.fmt.bufPrint(&ref_buf, "][{d}]", .{ref + 1}) catch unreachable);
+                }
+            } else if (std.ascii.eqlIgnoreCase(name, "br")) {
+                if (in_heading) {
+                    out.space();
+                } else if (out.hasLineContent()) {
+                    // Backslash hard break keeps the line inside the paragraph
+                    try out.buf.append(allocator, '\\');
+                    out.lineBreak();
+                }
+            } else if (std.ascii.eqlIgnoreCase(name, "hr")) {
+                try out.write("* * *");
+                out.blankLine();
+            } else if (std.ascii.eqlIgnoreCase(name, "td") or std.ascii.eqlIgnoreCase(name, "th")) {
+                out.space();
+            } else if (text_extractor.isHeadingTag(name)) {
+                in_heading = true;
+                const level = headingLevel(name);
+                try out.write("######"[0..level]);
+                try out.buf.append(allocator, ' ');
+            }
+        },
+        .text => |run| {
+            if (in_skip_tag != null) continue;
+
+            if (in_pre) {
+                try out.preformatted(run, &pre_fresh);
+            } else if (out.in_code) {
+                try out.codeText(run);
+            } else {
+                try out.prose(run);
+            }
+        },
+    };
+
+    try out.closeCode();
+
+    // Reference definitions
+    if (refs.items.len > 0) {
+        out.blankLine();
+        for (refs.items, 1..) |url, num| {
+            var ref_buf: [24]u8 = undefined;
+            try out.write(std.fmt.bufPrint(&ref_buf, "[{d}]: ", .{num}) catch unreachable);
+            const needs_brackets = std.mem.indexOfAny(u8, url, " \t()") != null;
+            if (needs_brackets) try out.buf.append(allocator, '<');
+            try out.buf.appendSlice(allocator, url);
+            if (needs_brackets) try out.buf.append(allocator, '>');
+            out.lineBreak();
+        }
+    }
+    if (out.buf.items.len > 0) try out.buf.append(allocator, '\n');
+
+    return out.buf.toOwnedSlice(allocator);
+}
+
+const List = struct {
+    ordered: bool,
+    count: u32 = 0,
+    /// Width of the current item's marker, which its continuation lines align under
+    width: u8 = 2,
+};
+
+fn listIndent(lists: []const List) u8 {
+    var indent: u8 = 0;
+    for (lists) |list| indent +|= list.width;
+    return indent;
+}
+
+/// Number of a link/image definition, reusing the entry for a repeated URL.
+fn internRef(allocator: std.mem.Allocator, refs: *std.ArrayListUnmanaged([]const u8), url: []const u8) !usize {
+    for (refs.items, 0..) |existing, index| {
+        if (std.mem.eql(u8, existing, url)) return index;
+    }
+    try refs.append(allocator, url);
+    return refs.items.len - 1;
+}
+
+/// Image URL for export: the default-viewport pick, like extractText.
+fn imageSource(tag: []const u8, picture_source: ?srcset.SourceSet) ?[]const u8 {
+    const fallback = attributes.get(tag, "src");
+    if (picture_source) |source| {
+        return srcset.selectCandidate(source.srcset, source.sizes, null, .{}) orelse fallback;
+    }
+    const set = attributes.get(tag, "srcset") orelse return fallback;
+    return srcset.selectCandidate(set, attributes.get(tag, "sizes"), fallback, .{}) orelse fallback;
+}
+
+fn headingLevel(name: []const u8) usize {
+    if (name.len == 2 and name[1] >= '1' and name[1] <= '6') return name[1] - '0';
+    return 2;
+}
+
+/// Output buffer that owes line breaks, spaces and opening markers until
+/// real content arrives, so block spacing never needs rescanning the output
+/// and emphasis never opens or closes next to whitespace.
+const Emitter = struct {
+    allocator: std.mem.Allocator,
+    buf: std.ArrayListUnmanaged(u8) = .empty,
+    /// Newlines owed before the next content (1 = line break, 2 = blank line)
+    pending_newlines: u8 = 0,
+    pending_space: bool = false,
+    /// Opening markers (`*`, `**`, `[`) held until content arrives
+    pending_open: [32]u8 = undefined,
+    pending_open_len: u8 = 0,
+    quote_depth: u8 = 0,
+    /// Spaces before each continuation line (list item content)
+    indent: u8 = 0,
+    /// Offset where the current line's content starts, after its prefix
+    line_start: usize = 0,
+    /// Text of the open inline code span, written once its fence is known
+    code: std.ArrayListUnmanaged(u8) = .empty,
+    in_code: bool = false,
+
+    fn lineBreak(self: *Emitter) void {
+        self.pending_newlines = @max(self.pending_newlines, 1);
+        self.pending_space = false;
+    }
+
+    fn blankLine(self: *Emitter) void {
+        self.pending_newlines = 2;
+        self.pending_space = false;
+    }
+
+    /// Literal newline inside a code block; consecutive ones all count.
+    fn newline(self: *Emitter) void {
+        self.pending_newlines +|= 1;
+    }
+
+    fn space(self: *Emitter) void {
+        if (self.pending_newlines == 0 and self.hasLineContent()) self.pending_space = true;
+    }
+
+    fn hasLineContent(self: *const Emitter) bool {
+        return self.buf.items.len > self.line_start;
+    }
+
+    fn open(self: *Emitter, marker: []const u8) void {
+        if (self.pending_open_len + marker.len > self.pending_open.len) return;
+        @memcpy(self.pending_open[self.pending_open_len..][0..marker.len], marker);
+        self.pending_open_len += @intCast(marker.len);
+    }
+
+    /// Withdraw an opening marker that never got content. True if withdrawn.
+    fn cancelOpen(self: *Emitter, marker: []const u8) bool {
+        const held = self.pending_open[0..self.pending_open_len];
+        if (!std.mem.endsWith(u8, held, marker)) return false;
+        self.pending_open_len -= @intCast(marker.len);
+        return true;
+    }
+
+    /// Closing markers attach to the preceding text; owed whitespace stays owed.
+    fn close(self: *Emitter, marker: []const u8) !void {
+        if (self.cancelOpen(marker)) return;
+        try self.buf.appendSlice(self.allocator, marker);
+    }
+
+    /// Pay owed newlines, line prefix, space and opening markers.
+    fn flush(self: *Emitter) !void {
+        const allocator = self.allocator;
+        if (self.pending_newlines > 0) {
+            if (self.buf.items.len > 0) {
+                try self.buf.append(allocator, '\n');
+                // Blank lines inside a quote keep the quote open
+                for (1..self.pending_newlines) |_| {
+                    for (0..self.quote_depth) |_| try self.buf.append(allocator, '>');
+                    try self.buf.append(allocator, '\n');
+                }
+            }
+            self.pending_newlines = 0;
+            self.pending_space = false;
+            for (0..self.quote_depth) |_| try self.buf.appendSlice(allocator, "> ");
+            for (0..self.indent) |_| try self.buf.append(allocator, ' ');
+            self.line_start = self.buf.items.len;
+        } else if (self.pending_space) {
+            try self.buf.append(allocator, ' ');
+            self.pending_space = false;
+        }
+        if (self.pending_open_len > 0) {
+            try self.buf.appendSlice(allocator, self.pending_open[0..self.pending_open_len]);
+            self.pending_open_len = 0;
+        }
+    }
+
+    fn write(self: *Emitter, bytes: []const u8) !void {
+        try self.flush();
+        try self.buf.appendSlice(self.allocator, bytes);
+    }
+
+    /// Write running text: entities decoded, whitespace collapsed, and
+    /// characters CommonMark would interpret backslash-escaped. Stretches
+    /// needing neither go out as one slice.
+    fn prose(self: *Emitter, run: []const u8) !void {
+        var i: usize = 0;
+        while (i < run.len) {
+            var c = run[i];
+            var next = i + 1;
+            const is_reference = c == '&';
+            if (is_reference) {
+                const decoded = decodeAt(run, i);
+                next = decoded.end;
+                c = decoded.char orelse {
+                    i = next;
+                    continue;
+                };
+            }
+            if (isSpace(c)) {
+                self.space();
+                i = next;
+                continue;
+            }
+
+            try self.flush();
+            if (is_reference or self.buf.items.len == self.line_start or
+                std.mem.indexOfScalar(u8, inline_specials, c) != null)
+            {
+                i = next + try self.literal(c, run[next..]);
+                continue;
+            }
+            const end = std.mem.indexOfAnyPos(u8, run, i, prose_stops) orelse run.len;
+            try self.buf.appendSlice(self.allocator, run[i..end]);
+            i = end;
+        }
+    }
+
+    /// Append one character of running text, escaped if CommonMark would
+    /// read it as syntax where it stands. `rest` is the text after it;
+    /// returns how many bytes of it were written along with `c`.
+    fn literal(self: *Emitter, c: u8, rest: []const u8) !usize {
+        const allocator = self.allocator;
+        const at_line_start = self.buf.items.len == self.line_start;
+        if (at_line_start and std.ascii.isDigit(c)) {
+            // Up to nine digits and '.' or ')' would start an ordered list
+            var digits: usize = 0;
+            while (digits < rest.len and digits < 8 and std.ascii.isDigit(rest[digits])) digits += 1;
+            if (digits < rest.len and (rest[digits] == '.' or rest[digits] == ')')) {
+                try self.buf.append(allocator, c);
+                try self.buf.appendSlice(allocator, rest[0..digits]);
+                try self.buf.append(allocator, '\\');
+                try self.buf.append(allocator, rest[digits]);
+                return digits + 1;
+            }
+        }
+        if (std.mem.indexOfScalar(u8, inline_specials, c) != null or
+            (at_line_start and std.mem.indexOfScalar(u8, line_start_specials, c) != null) or
+            (c == '&' and startsReference(rest)))
+        {
+            try self.buf.append(allocator, '\\');
+        }
+        try self.buf.append(allocator, c);
+        return 0;
+    }
+
+    /// Write text inside <pre> as it stands, entities decoded.
+    /// `fresh` is set right after <pre>, whose first newline HTML drops.
+    fn preformatted(self: *Emitter, run: []const u8, fresh: *bool) !void {
+        var i: usize = 0;
+        while (i < run.len) {
+            const end = std.mem.indexOfAnyPos(u8, run, i, "\r\n&") orelse run.len;
+            if (end > i) {
+                try self.write(run[i..end]);
+                fresh.* = false;
+                i = end;
+                continue;
+            }
+
+            var c = run[i];
+            i += 1;
+            if (c == '&') {
+                const decoded = decodeAt(run, i - 1);
+                i = decoded.end;
+                c = decoded.char orelse continue;
+            }
+            switch (c) {
+                '\r' => continue,
+                '\n' => if (!fresh.*) self.newline(),
+                else => try self.write(&[_]u8{c}),
+            }
+            fresh.* = false;
+        }
+    }
+
+    /// Close the code block whose ``` fence was written at `at`, first
+    /// widening that fence past the longest backtick run inside.
+    fn closeFence(self: *Emitter, at: usize) !void {
+        const fence = @max(3, longestRun(self.buf.items[at + 3 ..], '`') + 1);
+        if (fence > 3) @memset(try self.buf.addManyAt(self.allocator, at, fence - 3), '`');
+        self.lineBreak();
+        try self.flush();
+        try self.buf.appendNTimes(self.allocator, '`', fence);
+    }
+
+    fn openCode(self: *Emitter) void {
+        if (self.in_code) return;
+        self.in_code = true;
+        self.code.clearRetainingCapacity();
+    }
+
+    /// Collect text inside inline code, entities decoded and whitespace
+    /// collapsed as CommonMark reads a code span.
+    fn codeText(self: *Emitter, run: []const u8) !void {
+        const allocator = self.allocator;
+        var i: usize = 0;
+        while (i < run.len) {
+            const end = std.mem.indexOfAnyPos(u8, run, i, " \t\n\r&") orelse run.len;
+            try self.code.appendSlice(allocator, run[i..end]);
+            if (end == run.len) break;
+
+            var c = run[end];
+            i = end + 1;
+            if (c == '&') {
+                const decoded = decodeAt(run, end);
+                i = decoded.end;
+                c = decoded.char orelse continue;
+            }
+            if (!isSpace(c)) {
+                try self.code.append(allocator, c);
+            } else if (self.code.items.len > 0 and self.code.items[self.code.items.len - 1] != ' ') {
+                try self.code.append(allocator, ' ');
+            }
+        }
+    }
+
+    /// Write the collected code span, fenced with one backtick more than its
+    /// longest run of them and padded where it starts or ends with one.
+    fn closeCode(self: *Emitter) !void {
+        if (!self.in_code) return;
+        self.in_code = false;
+        const content = std.mem.trim(u8, self.code.items, " ");
+        if (content.len == 0) return;
+
+        const allocator = self.allocator;
+        const fence = longestRun(content, '`') + 1;
+        const pad = content[0] == '`' or content[content.len - 1] == '`';
+        try self.flush();
+        try self.buf.appendNTimes(allocator, '`', fence);
+        if (pad) try self.buf.append(allocator, ' ');
+        try self.buf.appendSlice(allocator, content);
+        if (pad) try self.buf.append(allocator, ' ');
+        try self.buf.appendNTimes(allocator, '`', fence);
+    }
+};
+
+/// A character reference decoded where it stands in a text run
+const Decoded = struct {
+    /// Null for an unknown reference, which is dropped
+    char: ?u8,
+    /// Index just past the reference
+    end: usize,
+};
+
+/// Decode the reference starting at the '&' at `run[at]`; a '&' that starts
+/// none is itself.
+fn decodeAt(run: []const u8, at: usize) Decoded {
+    if (std.mem.indexOfScalarPos(u8, run, at + 1, ';')) |entity_end| {
+        if (entity_end - (at + 1) < 10) {
+            return .{ .char = text_extractor.decodeEntity(run[at + 1 .. entity_end]), .end = entity_end + 1 };
+        }
+    }
+    return .{ .char = '&', .end = at + 1 };
+}
+
+/// Whether a '&' followed by `rest` would read as a character reference
+fn startsReference(rest: []const u8) bool {
+    var i: usize = 0;
+    if (i < rest.len and rest[i] == '#') i += 1;
+    const name_start = i;
+    while (i < rest.len and std.ascii.isAlphanumeric(rest[i])) i += 1;
+    return i > name_start and i < rest.len and rest[i] == ';';
+}
+
+fn longestRun(bytes: []const u8, char: u8) usize {
+    var longest: usize = 0;
+    var current: usize = 0;
+    for (bytes) |b| {
+        current = if (b == char) current + 1 else 0;
+        longest = @max(longest, current);
+    }
+    return longest;
+}
+
+fn isSpace(c: u8) bool {
+    return c == ' ' or c == '\n' or c == '\t' or c == '\r';
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+fn expectMarkdown(expected: []const u8, html: []const u8) !void {
+    const md = try extractMarkdown(std.testing.allocator, html);
+    defer std.testing.allocator.free(md);
+    try std.testing.expectEqualStrings(expected, md);
+}
+
+test "headings and paragraphs" {
+    try expectMarkdown("# Title\n\nFirst para.\n\nSecond para.\n", "<h1>Title</h1><p>First para.</p><p>Second\n  para.</p>");
+}
+
+test "inline emphasis keeps markers against the text" {
+    try expectMarkdown("Hello **World** and *this* `x<y`\n", "<p>Hello <b>World </b>and<em> this</em> <code>x&lt;y</code></p>");
+}
+
+test "empty emphasis is dropped" {
+    try expectMarkdown("a b\n", "<p>a <b></b>b</p>");
+}
+
+test "reference-style links share definitions" {
+    try expectMarkdown(
+        "See [docs][1] and [again][1], [home][2].\n\n[1]: /docs\n[2]: <https://example.com/a b>\n",
+        "<p>See <a href=\"/docs\">docs</a> and <a href=\"/docs\">again</a>, <a href=\"https://example.com/a b\">home</a>.</p>",
+    );
+}
+
+test "images use reference definitions" {
+    try expectMarkdown("![A \\*cat\\*][1]\n\n[1]: /cat.jpg\n", "<p><img src=\"/cat.jpg\" alt=\"A *cat*\"></p>");
+}
+
+test "nested lists indent under their item" {
+    try expectMarkdown(
+        "- one\n- two\n  1. a\n  2. b\n- three\n",
+        "<ul><li>one</li><li>two<ol><li>a</li><li>b</li></ol></li><li>three</li></ul>",
+    );
+}
+
+test "ordered markers widen past nine" {
+    try expectMarkdown(
+        "1. a\n2. b\n3. c\n4. d\n5. e\n6. f\n7. g\n8. h\n9. i\n10. j\n    - k\n",
+        "<ol><li>a</li><li>b</li><li>c</li><li>d</li><li>e</li><li>f</li><li>g</li><li>h</li><li>i</li><li>j<ul><li>k</li></ul></li></ol>",
+    );
+}
+
+test "pre becomes a fenced block" {
+    try expectMarkdown("```\nfn main() {\n\n    go();\n}\n```\n", "<pre>\nfn main() {\n\n    go();\n}</pre>");
+}
+
+test "fences outgrow the backticks inside" {
+    try expectMarkdown("````\n```\ncode\n```\n````\n", "<pre>```\ncode\n```</pre>");
+    try expectMarkdown("Run ``a`b`` or `` `x ``\n", "<p>Run <code>a`b</code> or <code>`x</code></p>");
+}
+
+test "code spans hold no markup" {
+    try expectMarkdown("`x y`\n", "<p><code><em>x</em> <a href=\"/y\">y</a></code></p>");
+}
+
+test "unclosed code span ends with its block" {
+    try expectMarkdown("`a`\n\nb\n", "<p><code>a</p><p>b</p>");
+}
+
+test "escapes what would start an ordered list" {
+    try expectMarkdown("1\\. not a list\n\n2024\\) and 12.5\n", "<p>1. not a list</p><p>2024) and 12.5</p>");
+}
+
+test "ampersand before an entity name stays literal" {
+    try expectMarkdown("\\&copy; AT&T\n", "<p>&amp;copy; AT&amp;T</p>");
+}
+
+test "image alt text is decoded before escaping" {
+    try expectMarkdown("![Tom & Jerry \\<3][1]\n\n[1]: /a.png\n", "<p><img src=\"/a.png\" alt=\" Tom &amp; Jerry &lt;3\"></p>");
+}
+
+test "blockquote prefixes every line" {
+    try expectMarkdown("> one\n>\n> two\n", "<blockquote><p>one</p><p>two</p></blockquote>");
+}
+
+test "escapes special characters" {
+    try expectMarkdown("\\# not a heading, 2 \\* 3 \\[x\\]\n", "<p># not a heading, 2 * 3 [x]</p>");
+}
+
+test "skips script and style" {
+    try expectMarkdown("Visible\n", "<style>p{}</style><p>Visible</p><script>x < y</script>");
+}
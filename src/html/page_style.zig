@@ -0,0 +1,407 @@
+//! Vulpes Browser - Page Style
+//!
+//! Resolves a page's text, link and background colors while the extractor
+//! tokenizes it, so they are ready when extraction returns without a
+//! second scan of the document.
+//!
+//! Sources, lowest priority first:
+//!   - Presentational attributes: <body text= link= bgcolor=>
+//!   - <style> elements, each parsed whole with css/parser.zig: rules
+//!     with a selector that is exactly html, :root, body, a, a:link or
+//!     :link (later rules win; rules inside @media are skipped)
+//!   - Inline style= on <html> and <body>
+//!
+//! The canvas background comes from html, falling back to body, as CSS
+//! propagates it; text color comes from body, falling back to html. Link
+//! color comes from rules and link= alone: one <a>'s own style does not
+//! speak for the page's links.
+//!
+//! var() is resolved through css/variables.zig as the cascade would: html
+//! declares the outermost scope of custom properties, body one inside it
+//! and links one inside body, so `--accent` set on :root reaches all three.
+//!
+
+const std = @import("std");
+const attributes = @import("attributes.zig");
+const parser = @import("../css/parser.zig");
+const selector = @import("../css/selector.zig");
+const variables = @import("../css/variables.zig");
+
+const Declaration = parser.Declaration;
+
+pub const Color = struct {
+    r: u8,
+    g: u8,
+    b: u8,
+};
+
+pub const PageStyle = struct {
+    text: ?Color = null,
+    link: ?Color = null,
+    background: ?Color = null,
+};
+
+/// Elements whose colors decide the page style
+const Target = enum { root, body, link };
+
+const Slots = struct {
+    color: ?Color = null,
+    background: ?Color = null,
+
+    /// Apply color declarations in order; values that do not parse, or
+    /// whose var() has no value, are skipped, leaving the earlier color
+    fn apply(self: *Slots, declarations: []const Declaration, values: Values) !void {
+        for (declarations) |declaration| {
+            const name = declaration.name;
+            if (std.ascii.eqlIgnoreCase(name, "color")) {
+                const value = try values.get(declaration.value) orelse continue;
+                if (parseColor(value)) |color| self.color = color;
+            } else if (std.ascii.eqlIgnoreCase(name, "background")) {
+                const value = try values.get(declaration.value) orelse continue;
+                if (backgroundColor(value)) |color| self.background = color;
+            } else if (std.ascii.eqlIgnoreCase(name, "background-color")) {
+                const value = try values.get(declaration.value) orelse continue;
+                if (parseColor(value)) |color| self.background = color;
+            }
+        }
+    }
+};
+
+/// Declared values with their var() references substituted from one scope
+const Values = struct {
+    allocator: std.mem.Allocator,
+    scopes: *const variables.Scopes,
+    scope: variables.ScopeId,
+    /// Holds the last substituted value
+    out: *std.ArrayListUnmanaged(u8),
+
+    fn get(self: Values, value: []const u8) !?[]const u8 {
+        if (!variables.hasReference(value)) return value;
+        return variables.resolveValue(self.allocator, self.scopes, self.scope, value, self.out);
+    }
+};
+
+const DeclarationList = std.ArrayListUnmanaged(Declaration);
+
+pub const Collector = struct {
+    allocator: std.mem.Allocator,
+    presentational: std.EnumArray(Target, Slots) = .initFill(.{}),
+    /// Declarations of each target, in document order; slices of the page
+    sheet: std.EnumArray(Target, DeclarationList) = .initFill(.empty),
+    inline_style: std.EnumArray(Target, DeclarationList) = .initFill(.empty),
+
+    pub fn init(allocator: std.mem.Allocator) Collector {
+        return .{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *Collector) void {
+        for (&self.sheet.values) |*list| list.deinit(self.allocator);
+        for (&self.inline_style.values) |*list| list.deinit(self.allocator);
+    }
+
+    /// Note a start tag; only html and body carry page colors.
+    pub fn addElement(self: *Collector, name: []const u8, raw: []const u8) !void {
+        const target = targetFor(name) orelse return;
+        if (target == .link) return;
+
+        if (target == .body) {
+            const slots = self.presentational.getPtr(.body);
+            if (attributes.get(raw, "text")) |value| slots.color = parseColor(value) orelse slots.color;
+            if (attributes.get(raw, "bgcolor")) |value| slots.background = parseColor(value) orelse slots.background;
+            if (attributes.get(raw, "link")) |value| {
+                self.presentational.getPtr(.link).color = parseColor(value) orelse self.presentational.get(.link).color;
+            }
+        }
+
+        if (attributes.get(raw, "style")) |style| {
+            try parser.parseInline(self.allocator, style, self.inline_style.getPtr(target));
+        }
+    }
+
+    /// Feed the whole text of a <style> element, which must outlive the
+    /// collector.
+    pub fn addStylesheet(self: *Collector, css: []const u8) !void {
+        const sheet = try parser.parse(self.allocator, css);
+        defer sheet.deinit();
+        var arena = std.heap.ArenaAllocator.init(self.allocator);
+        defer arena.deinit();
+
+        for (sheet.rules) |rule| {
+            if (rule.media != parser.ALL_MEDIA) continue;
+            _ = arena.reset(.retain_capacity);
+            const selectors = try selector.parseList(arena.allocator(), self.allocator, rule.selectors);
+            for (selectors) |parsed| {
+                const target = selectorTarget(parsed) orelse continue;
+                try self.sheet.getPtr(target).appendSlice(self.allocator, sheet.declarationsOf(rule));
+            }
+        }
+    }
+
+    pub fn resolve(self: *const Collector) !PageStyle {
+        const allocator = self.allocator;
+        var scopes: variables.Scopes = .{};
+        defer scopes.deinit(allocator);
+        var resolver: variables.Resolver = .{};
+        defer resolver.deinit(allocator);
+        var out: std.ArrayListUnmanaged(u8) = .empty;
+        defer out.deinit(allocator);
+
+        // Targets nest in declaration order: html, body, links
+        var slots: std.EnumArray(Target, Slots) = undefined;
+        var parent = variables.EMPTY;
+        for (std.enums.values(Target)) |target| {
+            const origins = [_][]const Declaration{ self.sheet.get(target).items, self.inline_style.get(target).items };
+            resolver.begin(parent);
+            for (origins) |declarations| {
+                for (declarations) |declaration| {
+                    if (variables.isCustom(declaration.name)) try resolver.declare(allocator, declaration.name, declaration.value);
+                }
+            }
+            const scope = try resolver.finish(allocator, &scopes);
+
+            var resolved = self.presentational.get(target);
+            const values: Values = .{ .allocator = allocator, .scopes = &scopes, .scope = scope, .out = &out };
+            for (origins) |declarations| try resolved.apply(declarations, values);
+            slots.set(target, resolved);
+            parent = scope;
+        }
+        const root = slots.get(.root);
+        const body = slots.get(.body);
+        return .{
+            .text = body.color orelse root.color,
+            .link = slots.get(.link).color,
+            .background = root.background orelse body.background,
+        };
+    }
+};
+
+const whitespace = " \t\n\r\x0c";
+
+fn targetFor(name: []const u8) ?Target {
+    if (std.ascii.eqlIgnoreCase(name, "html")) return .root;
+    if (std.ascii.eqlIgnoreCase(name, "body")) return .body;
+    if (std.ascii.eqlIgnoreCase(name, "a")) return .link;
+    return null;
+}
+
+/// Target of a selector that is exactly html, :root, body, a, a:link or
+/// :link, or a combination naming the same one
+fn selectorTarget(parsed: selector.Selector) ?Target {
+    if (parsed.compounds.len != 1) return null;
+    var target: ?Target = null;
+    for (parsed.subject().simples) |simple| {
+        const named: Target = switch (simple) {
+            .tag => |name| targetFor(name) orelse return null,
+            .pseudo => |pseudo| switch (pseudo) {
+                .root => .root,
+                .link => .link,
+                else => return null,
+            },
+            else => return null,
+        };
+        if (target != null and target.? != named) return null;
+        target = named;
+    }
+    return target;
+}
+
+/// First color in a `background` shorthand, e.g. "#fff url(x.png) no-repeat".
+pub fn backgroundColor(value: []const u8) ?Color {
+    var i: usize = 0;
+    while (i < value.len) {
+        while (i < value.len and value[i] == ' ') i += 1;
+        const start = i;
+        var depth: usize = 0;
+        while (i < value.len and (depth > 0 or value[i] != ' ')) : (i += 1) {
+            if (value[i] == '(') depth += 1;
+            if (value[i] == ')' and depth > 0) depth -= 1;
+        }
+        if (i > start) {
+            if (parseColor(value[start..i])) |color| return color;
+        }
+    }
+    return null;
+}
+
+/// Parse a CSS color: #rgb, #rgba, #rrggbb, #rrggbbaa, rgb()/rgba() with
+/// numbers or percentages, and common keywords. Alpha is ignored.
+pub fn parseColor(raw: []const u8) ?Color {
+    const value = std.mem.trim(u8, raw, whitespace);
+    if (value.len == 0) return null;
+
+    if (value[0] == '#') return parseHex(value[1..]);
+
+    if (std.ascii.startsWithIgnoreCase(value, "rgb")) {
+        const open = std.mem.indexOfScalar(u8, value, '(') orelse return null;
+        const close = std.mem.lastIndexOfScalar(u8, value, ')') orelse return null;
+        if (close < open) return null;
+        var channels: [3]u8 = undefined;
+        var parts = std.mem.tokenizeAny(u8, value[open + 1 .. close], ", /");
+        for (&channels) |*channel| {
+            channel.* = parseChannel(parts.next() orelse return null) orelse return null;
+        }
+        return .{ .r = channels[0], .g = channels[1], .b = channels[2] };
+    }
+
+    for (named_colors) |named| {
+        if (std.ascii.eqlIgnoreCase(value, named.name)) return named.color;
+    }
+    // Legacy HTML attributes often omit the '#'
+    if (value.len == 6) return parseHex(value);
+    return null;
+}
+
+fn parseHex(digits: []const u8) ?Color {
+    switch (digits.len) {
+        3, 4 => {
+            const r = std.fmt.charToDigit(digits[0], 16) catch return null;
+            const g = std.fmt.charToDigit(digits[1], 16) catch return null;
+            const b = std.fmt.charToDigit(digits[2], 16) catch return null;
+            return .{ .r = r * 17, .g = g * 17, .b = b * 17 };
+        },
+        6, 8 => {
+            const r = std.fmt.parseInt(u8, digits[0..2], 16) catch return null;
+            const g = std.fmt.parseInt(u8, digits[2..4], 16) catch return null;
+            const b = std.fmt.parseInt(u8, digits[4..6], 16) catch return null;
+            return .{ .r = r, .g = g, .b = b };
+        },
+        else => return null,
+    }
+}
+
+fn parseChannel(token: []const u8) ?u8 {
+    if (token.len > 0 and token[token.len - 1] == '%') {
+        const percent = std.fmt.parseFloat(f32, token[0 .. token.len - 1]) catch return null;
+        return @intFromFloat(std.math.clamp(percent, 0, 100) * 2.55 + 0.5);
+    }
+    const number = std.fmt.parseFloat(f32, token) catch return null;
+    return @intFromFloat(std.math.clamp(number, 0, 255) + 0.5);
+}
+
+const named_colors = [_]struct { name: []const u8, color: Color }{
+    .{ .name = "black", .color = .{ .r = 0, .g = 0, .b = 0 } },
+    .{ .name = "white", .color = .{ .r = 255, .g = 255, .b = 255 } },
+    .{ .name = "red", .color = .{ .r = 255, .g = 0, .b = 0 } },
+    .{ .name = "green", .color = .{ .r = 0, .g = 128, .b = 0 } },
+    .{ .name = "blue", .color = .{ .r = 0, .g = 0, .b = 255 } },
+    .{ .name = "navy", .color = .{ .r = 0, .g = 0, .b = 128 } },
+    .{ .name = "purple", .color = .{ .r = 128, .g = 0, .b = 128 } },
+    .{ .name = "teal", .color = .{ .r = 0, .g = 128, .b = 128 } },
+    .{ .name = "maroon", .color = .{ .r = 128, .g = 0, .b = 0 } },
+    .{ .name = "olive", .color = .{ .r = 128, .g = 128, .b = 0 } },
+    .{ .name = "gray", .color = .{ .r = 128, .g = 128, .b = 128 } },
+    .{ .name = "grey", .color = .{ .r = 128, .g = 128, .b = 128 } },
+    .{ .name = "silver", .color = .{ .r = 192, .g = 192, .b = 192 } },
+    .{ .name = "yellow", .color = .{ .r = 255, .g = 255, .b = 0 } },
+    .{ .name = "orange", .color = .{ .r = 255, .g = 165, .b = 0 } },
+    .{ .name = "aqua", .color = .{ .r = 0, .g = 255, .b = 255 } },
+    .{ .name = "fuchsia", .color = .{ .r = 255, .g = 0, .b = 255 } },
+    .{ .name = "lime", .color = .{ .r = 0, .g = 255, .b = 0 } },
+    .{ .name = "darkblue", .color = .{ .r = 0, .g = 0, .b = 139 } },
+    .{ .name = "darkgray", .color = .{ .r = 169, .g = 169, .b = 169 } },
+    .{ .name = "lightgray", .color = .{ .r = 211, .g = 211, .b = 211 } },
+    .{ .name = "whitesmoke", .color = .{ .r = 245, .g = 245, .b = 245 } },
+    .{ .name = "ivory", .color = .{ .r = 255, .g = 255, .b = 240 } },
+    .{ .name = "beige", .color = .{ .r = 245, .g = 245, .b = 220 } },
+};
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+fn expectColor(expected: Color, actual: ?Color) !void {
+    try std.testing.expectEqual(@as(?Color, expected), actual);
+}
+
+test "parse color syntaxes" {
+    try expectColor(.{ .r = 255, .g = 255, .b = 255 }, parseColor("#fff"));
+    try expectColor(.{ .r = 0x12, .g = 0x34, .b = 0x56 }, parseColor("#123456"));
+    try expectColor(.{ .r = 0x12, .g = 0x34, .b = 0x56 }, parseColor("#12345680"));
+    try expectColor(.{ .r = 10, .g = 20, .b = 30 }, parseColor("rgb(10, 20, 30)"));
+    try expectColor(.{ .r = 10, .g = 20, .b = 30 }, parseColor("rgba(10 20 30 / 0.5)"));
+    try expectColor(.{ .r = 255, .g = 128, .b = 0 }, parseColor("rgb(100%, 50%, 0%)"));
+    try expectColor(.{ .r = 0, .g = 0, .b = 128 }, parseColor(" Navy "));
+    try expectColor(.{ .r = 0xff, .g = 0xee, .b = 0xdd }, parseColor("ffeedd"));
+    try std.testing.expect(parseColor("inherit") == null);
+    try std.testing.expect(parseColor("#12") == null);
+}
+
+test "stylesheet rules for html, body and links" {
+    var collector = Collector.init(std.testing.allocator);
+    defer collector.deinit();
+    try collector.addStylesheet(
+        \\/* theme */ body { color: #333; background: #fafafa url(bg.png) }
+        \\@media (prefers-color-scheme: dark) { body { color: white } }
+        \\a, a:link { color: rgb(0, 102, 204) }
+        \\p, .note, body p, body:hover { color: red }
+    );
+    const style = try collector.resolve();
+    try expectColor(.{ .r = 0x33, .g = 0x33, .b = 0x33 }, style.text);
+    try expectColor(.{ .r = 0xfa, .g = 0xfa, .b = 0xfa }, style.background);
+    try expectColor(.{ .r = 0, .g = 102, .b = 204 }, style.link);
+}
+
+test "comments, strings and '<' do not end a rule early" {
+    var collector = Collector.init(std.testing.allocator);
+    defer collector.deinit();
+    try collector.addStylesheet(
+        \\body { /* } */ color: #111; font-family: "}" }
+        \\a[title="<"] { color: red } /* <b> */ html { background: #222 }
+    );
+    const style = try collector.resolve();
+    try expectColor(.{ .r = 0x11, .g = 0x11, .b = 0x11 }, style.text);
+    try expectColor(.{ .r = 0x22, .g = 0x22, .b = 0x22 }, style.background);
+    try std.testing.expect(style.link == null);
+}
+
+test "html background wins over body, body text over html" {
+    var collector = Collector.init(std.testing.allocator);
+    defer collector.deinit();
+    try collector.addStylesheet("html { background-color: black; color: gray } body { background: white; color: silver }");
+    const style = try collector.resolve();
+    try expectColor(.{ .r = 0, .g = 0, .b = 0 }, style.background);
+    try expectColor(.{ .r = 192, .g = 192, .b = 192 }, style.text);
+}
+
+test "inline style beats stylesheet beats presentational attributes" {
+    var collector = Collector.init(std.testing.allocator);
+    defer collector.deinit();
+    try collector.addElement("body", "<body text=\"#ff0000\" bgcolor=\"#00ff00\" link=\"#0000ff\">");
+    var style = try collector.resolve();
+    try expectColor(.{ .r = 255, .g = 0, .b = 0 }, style.text);
+    try expectColor(.{ .r = 0, .g = 0, .b = 255 }, style.link);
+
+    try collector.addStylesheet("body { color: #111 }");
+    style = try collector.resolve();
+    try expectColor(.{ .r = 0x11, .g = 0x11, .b = 0x11 }, style.text);
+    try expectColor(.{ .r = 0, .g = 255, .b = 0 }, style.background);
+
+    try collector.addElement("BODY", "<BODY style=\"color: #222\">");
+    try expectColor(.{ .r = 0x22, .g = 0x22, .b = 0x22 }, (try collector.resolve()).text);
+
+    // One link's own style is not the page's link color
+    try collector.addElement("a", "<a style=\"color: red\">");
+    try expectColor(.{ .r = 0, .g = 0, .b = 255 }, (try collector.resolve()).link);
+}
+
+test "custom properties from :root, html and body" {
+    var collector = Collector.init(std.testing.allocator);
+    defer collector.deinit();
+    try collector.addStylesheet(
+        \\:root { --bg: #123; --accent: var(--brand, #c00) }
+        \\body { background: var(--bg); color: var(--fg, navy) }
+        \\a { color: var(--accent) }
+        \\html { color: var(--unset) }
+    );
+    var style = try collector.resolve();
+    try expectColor(.{ .r = 0x11, .g = 0x22, .b = 0x33 }, style.background);
+    try expectColor(.{ .r = 0, .g = 0, .b = 128 }, style.text);
+    try expectColor(.{ .r = 0xcc, .g = 0, .b = 0 }, style.link);
+
+    // Declared on body, seen by links but not by html
+    try collector.addElement("body", "<body style=\"--accent: #0a0\">");
+    try collector.addStylesheet("html { background: var(--accent) }");
+    style = try collector.resolve();
+    try expectColor(.{ .r = 0, .g = 0xaa, .b = 0 }, style.link);
+    try expectColor(.{ .r = 0xcc, .g = 0, .b = 0 }, style.background);
+}
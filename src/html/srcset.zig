@@ -0,0 +1,470 @@
+//! Vulpes Browser - Responsive Image Selection
+//!
+//! Picks the cheapest adequate candidate from `srcset`/`sizes` and
+//! `<picture><source>` markup, so we download an image close to the size we
+//! actually draw instead of the (often largest) `src` fallback.
+//!
+//! Selection follows the HTML Living Standard model:
+//!   - `w` descriptors become densities via the `sizes` slot width
+//!   - `x` descriptors are used as-is, a bare URL counts as 1x
+//!   - the smallest density that meets the device scale wins,
+//!     otherwise the largest one available
+//!
+//! Media conditions cover what matters for a reading viewport: media types,
+//! width and resolution / device-pixel-ratio features. Anything we cannot
+//! evaluate is treated as not matching, which falls through to `<img>`.
+//!
+
+const std = @import("std");
+
+/// CSS px per em when resolving `sizes` lengths (UA default font size)
+const EM_PX: f32 = 16.0;
+
+/// Viewport used to evaluate `sizes` and media conditions.
+pub const Viewport = struct {
+    /// Viewport width in CSS pixels
+    width: f32 = 1024,
+    /// Device pixels per CSS pixel (2.0 on Retina displays)
+    scale: f32 = 1.0,
+};
+
+/// A `srcset` value plus the `sizes` that applies to it.
+pub const SourceSet = struct {
+    srcset: []const u8,
+    sizes: ?[]const u8 = null,
+};
+
+pub const Descriptor = union(enum) {
+    none,
+    width: u32,
+    density: f32,
+};
+
+pub const Candidate = struct {
+    url: []const u8,
+    descriptor: Descriptor = .none,
+};
+
+/// Iterates the image candidate strings of a `srcset` attribute value.
+/// Candidates with invalid descriptors are skipped, as the spec requires.
+pub const SrcsetIterator = struct {
+    input: []const u8,
+    pos: usize = 0,
+
+    pub fn next(self: *SrcsetIterator) ?Candidate {
+        const input = self.input;
+        while (true) {
+            // Skip separators between candidates
+            while (self.pos < input.len and (isSpace(input[self.pos]) or input[self.pos] == ',')) {
+                self.pos += 1;
+            }
+            if (self.pos >= input.len) return null;
+
+            const url_start = self.pos;
+            while (self.pos < input.len and !isSpace(input[self.pos])) {
+                self.pos += 1;
+            }
+            const raw_url = input[url_start..self.pos];
+
+            // A URL ending in commas has no descriptors
+            if (raw_url[raw_url.len - 1] == ',') {
+                const url = std.mem.trim(u8, raw_url, ",");
+                if (url.len == 0) continue;
+                return .{ .url = url };
+            }
+
+            // Descriptors run to the next comma outside parentheses
+            const desc_start = self.pos;
+            var depth: usize = 0;
+            while (self.pos < input.len) : (self.pos += 1) {
+                switch (input[self.pos]) {
+                    '(' => depth += 1,
+                    ')' => depth -|= 1,
+                    ',' => if (depth == 0) break,
+                    else => {},
+                }
+            }
+
+            if (parseDescriptor(input[desc_start..self.pos])) |descriptor| {
+                return .{ .url = raw_url, .descriptor = descriptor };
+            }
+        }
+    }
+};
+
+fn parseDescriptor(text: []const u8) ?Descriptor {
+    var result: Descriptor = .none;
+    var tokens = std.mem.tokenizeAny(u8, text, " \t\n\r\x0c");
+    while (tokens.next()) |token| {
+        const value = token[0 .. token.len - 1];
+        switch (token[token.len - 1]) {
+            'w', 'W' => {
+                if (result != .none) return null;
+                const w = std.fmt.parseInt(u32, value, 10) catch return null;
+                if (w == 0) return null;
+                result = .{ .width = w };
+            },
+            'x', 'X' => {
+                if (result != .none) return null;
+                const x = std.fmt.parseFloat(f32, value) catch return null;
+                if (!(x > 0)) return null;
+                result = .{ .density = x };
+            },
+            // Height descriptors are reserved for future use; ignore them
+            'h', 'H' => {},
+            else => return null,
+        }
+    }
+    return result;
+}
+
+/// Pick the cheapest candidate that still meets the device resolution.
+///
+/// `fallback` is the `<img src>`; it joins the set as an implicit 1x
+/// candidate unless the set already has a 1x or any `w` candidate.
+/// Returns null only if there is nothing to choose from.
+pub fn selectCandidate(
+    srcset: []const u8,
+    sizes: ?[]const u8,
+    fallback: ?[]const u8,
+    viewport: Viewport,
+) ?[]const u8 {
+    const slot = @max(slotWidth(sizes, viewport), 1.0);
+    var picker = Picker{ .target = viewport.scale };
+    var has_width = false;
+    var has_unit_density = false;
+
+    var it = SrcsetIterator{ .input = srcset };
+    while (it.next()) |candidate| {
+        const density: f32 = switch (candidate.descriptor) {
+            .none => 1.0,
+            .density => |x| x,
+            .width => |w| @as(f32, @floatFromInt(w)) / slot,
+        };
+        switch (candidate.descriptor) {
+            .width => has_width = true,
+            else => if (density == 1.0) {
+                has_unit_density = true;
+            },
+        }
+        picker.consider(candidate.url, density);
+    }
+
+    if (fallback) |src| {
+        if (!has_width and !has_unit_density) picker.consider(src, 1.0);
+    }
+
+    return picker.best orelse picker.largest;
+}
+
+const Picker = struct {
+    target: f32,
+    best: ?[]const u8 = null,
+    best_density: f32 = 0,
+    largest: ?[]const u8 = null,
+    largest_density: f32 = 0,
+
+    fn consider(self: *Picker, url: []const u8, density: f32) void {
+        if (density >= self.target and (self.best == null or density < self.best_density)) {
+            self.best = url;
+            self.best_density = density;
+        }
+        if (self.largest == null or density > self.largest_density) {
+            self.largest = url;
+            self.largest_density = density;
+        }
+    }
+};
+
+/// Resolve a `sizes` attribute to the image slot width in CSS pixels.
+/// The first entry whose media condition matches wins; a missing or
+/// unusable attribute means 100vw.
+pub fn slotWidth(sizes: ?[]const u8, viewport: Viewport) f32 {
+    const value = sizes orelse return viewport.width;
+
+    var entries = TopLevelCommaIterator{ .input = value };
+    while (entries.next()) |raw_entry| {
+        const entry = std.mem.trim(u8, raw_entry, whitespace);
+        if (entry.len == 0) continue;
+
+        // The length is the last component; anything before it is a condition
+        const split = lastComponentStart(entry);
+        const condition = std.mem.trim(u8, entry[0..split], whitespace);
+        if (condition.len > 0 and !mediaMatches(condition, viewport)) continue;
+
+        if (parseLength(entry[split..], viewport)) |px| return px;
+    }
+    return viewport.width;
+}
+
+/// Start index of the last whitespace-separated component, treating a
+/// trailing parenthesised group like `calc(100vw - 2em)` as one component.
+fn lastComponentStart(entry: []const u8) usize {
+    var end = entry.len;
+    if (entry[end - 1] == ')') {
+        var depth: usize = 0;
+        while (end > 0) {
+            end -= 1;
+            switch (entry[end]) {
+                ')' => depth += 1,
+                '(' => {
+                    depth -= 1;
+                    if (depth == 0) break;
+                },
+                else => {},
+            }
+        }
+    }
+    while (end > 0 and !isSpace(entry[end - 1])) end -= 1;
+    return end;
+}
+
+/// Parse a source-size length (`400px`, `50vw`, `20em`, `calc(100vw - 2em)`).
+fn parseLength(text: []const u8, viewport: Viewport) ?f32 {
+    if (text.len > 6 and std.ascii.startsWithIgnoreCase(text, "calc(") and text[text.len - 1] == ')') {
+        return parseCalc(text[5 .. text.len - 1], viewport);
+    }
+
+    var unit_start: usize = 0;
+    while (unit_start < text.len and (std.ascii.isDigit(text[unit_start]) or text[unit_start] == '.')) {
+        unit_start += 1;
+    }
+    if (unit_start == 0) return null;
+
+    const number = std.fmt.parseFloat(f32, text[0..unit_start]) catch return null;
+    const unit = text[unit_start..];
+    if (unit.len == 0) return if (number == 0) 0 else null;
+    if (std.ascii.eqlIgnoreCase(unit, "px")) return number;
+    if (std.ascii.eqlIgnoreCase(unit, "vw")) return number * viewport.width / 100.0;
+    if (std.ascii.eqlIgnoreCase(unit, "em") or std.ascii.eqlIgnoreCase(unit, "rem")) return number * EM_PX;
+    return null;
+}
+
+/// Left-to-right sums and differences of lengths, e.g. `100vw - 2em`.
+fn parseCalc(expr: []const u8, viewport: Viewport) ?f32 {
+    var tokens = std.mem.tokenizeAny(u8, expr, whitespace);
+    var total = parseLength(tokens.next() orelse return null, viewport) orelse return null;
+    while (tokens.next()) |op| {
+        const operand = parseLength(tokens.next() orelse return null, viewport) orelse return null;
+        if (std.mem.eql(u8, op, "+")) {
+            total += operand;
+        } else if (std.mem.eql(u8, op, "-")) {
+            total -= operand;
+        } else {
+            return null;
+        }
+    }
+    return if (total >= 0) total else null;
+}
+
+/// Evaluate a media query list (`<source media>` or a `sizes` condition).
+/// The list matches if any comma-separated query matches.
+pub fn mediaMatches(query_list: []const u8, viewport: Viewport) bool {
+    var queries = TopLevelCommaIterator{ .input = query_list };
+    while (queries.next()) |query| {
+        if (mediaQueryMatches(std.mem.trim(u8, query, whitespace), viewport)) return true;
+    }
+    return false;
+}
+
+fn mediaQueryMatches(query: []const u8, viewport: Viewport) bool {
+    if (query.len == 0) return false;
+
+    var negate = false;
+    var matched = true;
+    var pos: usize = 0;
+    while (pos < query.len) {
+        if (isSpace(query[pos])) {
+            pos += 1;
+            continue;
+        }
+
+        if (query[pos] == '(') {
+            const close = std.mem.indexOfScalarPos(u8, query, pos, ')') orelse return false;
+            if (!featureMatches(std.mem.trim(u8, query[pos + 1 .. close], whitespace), viewport)) {
+                matched = false;
+            }
+            pos = close + 1;
+            continue;
+        }
+
+        const word_start = pos;
+        while (pos < query.len and !isSpace(query[pos]) and query[pos] != '(') pos += 1;
+        const word = query[word_start..pos];
+        if (std.ascii.eqlIgnoreCase(word, "not")) {
+            negate = true;
+        } else if (std.ascii.eqlIgnoreCase(word, "and") or
+            std.ascii.eqlIgnoreCase(word, "only") or
+            std.ascii.eqlIgnoreCase(word, "all") or
+            std.ascii.eqlIgnoreCase(word, "screen"))
+        {
+            // Always true for us
+        } else {
+            // print, speech, or something we do not understand
+            matched = false;
+        }
+    }
+    return matched != negate;
+}
+
+fn featureMatches(feature: []const u8, viewport: Viewport) bool {
+    // Range syntax: (width >= 600px), (width < 40em)
+    if (std.mem.indexOfAny(u8, feature, "<>")) |op_pos| {
+        const name = std.mem.trim(u8, feature[0..op_pos], whitespace);
+        if (!std.ascii.eqlIgnoreCase(name, "width")) return false;
+        const inclusive = op_pos + 1 < feature.len and feature[op_pos + 1] == '=';
+        const value_start = if (inclusive) op_pos + 2 else op_pos + 1;
+        const limit = parseLength(std.mem.trim(u8, feature[value_start..], whitespace), viewport) orelse return false;
+        return if (feature[op_pos] == '>')
+            (if (inclusive) viewport.width >= limit else viewport.width > limit)
+        else
+            (if (inclusive) viewport.width <= limit else viewport.width < limit);
+    }
+
+    const colon = std.mem.indexOfScalar(u8, feature, ':') orelse {
+        // Boolean features: we are always a color screen
+        return std.ascii.eqlIgnoreCase(feature, "color");
+    };
+    const name = std.mem.trim(u8, feature[0..colon], whitespace);
+    const value = std.mem.trim(u8, feature[colon + 1 ..], whitespace);
+
+    if (std.ascii.eqlIgnoreCase(name, "min-width")) {
+        return viewport.width >= (parseLength(value, viewport) orelse return false);
+    }
+    if (std.ascii.eqlIgnoreCase(name, "max-width")) {
+        return viewport.width <= (parseLength(value, viewport) orelse return false);
+    }
+    if (std.ascii.eqlIgnoreCase(name, "min-resolution") or
+        std.ascii.eqlIgnoreCase(name, "-webkit-min-device-pixel-ratio") or
+        std.ascii.eqlIgnoreCase(name, "min--moz-device-pixel-ratio"))
+    {
+        return viewport.scale >= (parseResolution(value) orelse return false);
+    }
+    if (std.ascii.eqlIgnoreCase(name, "max-resolution") or
+        std.ascii.eqlIgnoreCase(name, "-webkit-max-device-pixel-ratio") or
+        std.ascii.eqlIgnoreCase(name, "max--moz-device-pixel-ratio"))
+    {
+        return viewport.scale <= (parseResolution(value) orelse return false);
+    }
+    return false;
+}
+
+/// Parse a resolution (`2dppx`, `2x`, `192dpi`) or a bare pixel ratio (`2`).
+fn parseResolution(text: []const u8) ?f32 {
+    var unit_start: usize = 0;
+    while (unit_start < text.len and (std.ascii.isDigit(text[unit_start]) or text[unit_start] == '.')) {
+        unit_start += 1;
+    }
+    if (unit_start == 0) return null;
+    const number = std.fmt.parseFloat(f32, text[0..unit_start]) catch return null;
+    const unit = text[unit_start..];
+    if (unit.len == 0 or std.ascii.eqlIgnoreCase(unit, "dppx") or std.ascii.eqlIgnoreCase(unit, "x")) {
+        return number;
+    }
+    if (std.ascii.eqlIgnoreCase(unit, "dpi")) return number / 96.0;
+    if (std.ascii.eqlIgnoreCase(unit, "dpcm")) return number * 2.54 / 96.0;
+    return null;
+}
+
+/// Splits on commas that are not nested inside parentheses.
+const TopLevelCommaIterator = struct {
+    input: []const u8,
+    pos: usize = 0,
+
+    fn next(self: *TopLevelCommaIterator) ?[]const u8 {
+        if (self.pos > self.input.len) return null;
+        const start = self.pos;
+        var depth: usize = 0;
+        while (self.pos < self.input.len) : (self.pos += 1) {
+            switch (self.input[self.pos]) {
+                '(' => depth += 1,
+                ')' => depth -|= 1,
+                ',' => if (depth == 0) break,
+                else => {},
+            }
+        }
+        const part = self.input[start..self.pos];
+        self.pos += 1;
+        return part;
+    }
+};
+
+const whitespace = " \t\n\r\x0c";
+
+fn isSpace(c: u8) bool {
+    return c == ' ' or c == '\t' or c == '\n' or c == '\r' or c == 0x0C;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "srcset iterator parses descriptors" {
+    var it = SrcsetIterator{ .input = "a.jpg 480w, b.jpg 2x,c.jpg, d.jpg 1.5x 100h" };
+
+    const a = it.next().?;
+    try std.testing.expectEqualStrings("a.jpg", a.url);
+    try std.testing.expectEqual(@as(u32, 480), a.descriptor.width);
+
+    const b = it.next().?;
+    try std.testing.expectEqualStrings("b.jpg", b.url);
+    try std.testing.expectEqual(@as(f32, 2.0), b.descriptor.density);
+
+    const c = it.next().?;
+    try std.testing.expectEqualStrings("c.jpg", c.url);
+    try std.testing.expect(c.descriptor == .none);
+
+    const d = it.next().?;
+    try std.testing.expectEqual(@as(f32, 1.5), d.descriptor.density);
+
+    try std.testing.expect(it.next() == null);
+}
+
+test "srcset iterator skips invalid candidates" {
+    var it = SrcsetIterator{ .input = "bad.jpg 2q, good.jpg 2x" };
+    try std.testing.expectEqualStrings("good.jpg", it.next().?.url);
+    try std.testing.expect(it.next() == null);
+}
+
+test "width descriptors pick smallest adequate candidate" {
+    const srcset = "s.jpg 320w, m.jpg 640w, l.jpg 1280w, xl.jpg 2560w";
+    // 400px slot on a 2x display needs >= 800 device pixels
+    const pick = selectCandidate(srcset, "400px", "fallback.jpg", .{ .width = 1200, .scale = 2 });
+    try std.testing.expectEqualStrings("l.jpg", pick.?);
+
+    // Same slot at 1x only needs 400 device pixels
+    const pick_1x = selectCandidate(srcset, "400px", "fallback.jpg", .{ .width = 1200, .scale = 1 });
+    try std.testing.expectEqualStrings("m.jpg", pick_1x.?);
+}
+
+test "density descriptors and src fallback" {
+    const srcset = "hi.jpg 2x, huge.jpg 3x";
+    try std.testing.expectEqualStrings("lo.jpg", selectCandidate(srcset, null, "lo.jpg", .{ .scale = 1 }).?);
+    try std.testing.expectEqualStrings("hi.jpg", selectCandidate(srcset, null, "lo.jpg", .{ .scale = 2 }).?);
+}
+
+test "largest candidate when nothing is adequate" {
+    const srcset = "s.jpg 100w, m.jpg 200w";
+    const pick = selectCandidate(srcset, null, null, .{ .width = 1024, .scale = 2 });
+    try std.testing.expectEqualStrings("m.jpg", pick.?);
+}
+
+test "sizes media conditions" {
+    const sizes = "(max-width: 600px) 100vw, (min-width: 1200px) 33vw, 50vw";
+    try std.testing.expectEqual(@as(f32, 500), slotWidth(sizes, .{ .width = 500 }));
+    try std.testing.expectEqual(@as(f32, 400), slotWidth(sizes, .{ .width = 800 }));
+    try std.testing.expectApproxEqAbs(@as(f32, 528), slotWidth(sizes, .{ .width = 1600 }), 0.01);
+    try std.testing.expectEqual(@as(f32, 768), slotWidth("calc(100vw - 2em)", .{ .width = 800 }));
+}
+
+test "media query evaluation" {
+    const vp = Viewport{ .width = 800, .scale = 2 };
+    try std.testing.expect(mediaMatches("(min-width: 600px)", vp));
+    try std.testing.expect(!mediaMatches("(min-width: 900px)", vp));
+    try std.testing.expect(mediaMatches("screen and (min-resolution: 2dppx)", vp));
+    try std.testing.expect(!mediaMatches("print", vp));
+    try std.testing.expect(mediaMatches("print, (max-width: 800px)", vp));
+    try std.testing.expect(mediaMatches("not print", vp));
+    try std.testing.expect(mediaMatches("(width >= 40em)", vp));
+    try std.testing.expect(!mediaMatches("(prefers-reduced-motion: reduce)", vp));
+}
@@ -12,6 +12,13 @@
 //!
 
 const std = @import("std");
+const attributes = @import("attributes.zig");
+const srcset = @import("srcset.zig");
+const tokenizer = @import("tokenizer.zig");
+const whitespace = @import("whitespace.zig");
+const stats = @import("stats.zig");
+const page_style = @import("page_style.zig");
+const search = @import("../search/index.zig");
 
 /// Maximum number of links to track
 const MAX_LINKS = 99;
@@ -38,6 +45,9 @@ const H3_START: u8 = 0x1B; // ESC - Escape
 const H4_START: u8 = 0x1C; // FS - File Separator
 const HEADING_END: u8 = 0x1D; // GS - Group Separator
 const IMAGE_MARKER: u8 = 0x1E; // RS - Record Separator (marks image placeholder)
+const TABLE_START: u8 = 0x05; // ENQ - Enquiry (rows follow, one per line)
+const TABLE_END: u8 = 0x06; // ACK - Acknowledge
+const CELL_SEP: u8 = 0x1F; // US - Unit Separator (between cells of a row)
 
 /// Tags whose content should be completely skipped
 const skip_tags = [_][]const u8{
@@ -53,11 +63,91 @@ const skip_tags = [_][]const u8{
     "math",
 };
 
+/// Rendering context that influences extraction.
+pub const ExtractOptions = struct {
+    /// Viewport width in CSS pixels, used for `sizes` and `<source media>`
+    viewport_width: u32 = 1024,
+    /// Device pixels per CSS pixel, used to pick srcset candidates
+    device_scale: f32 = 1.0,
+    /// Build a find-in-page index over the text while extracting
+    build_search_index: bool = false,
+};
+
+/// Extract visible text from HTML content with default options.
+/// Caller owns returned slice and must free with same allocator.
+pub fn extractText(allocator: std.mem.Allocator, html: []const u8) ![]u8 {
+    return extractTextWithOptions(allocator, html, .{});
+}
+
+/// One entry of the image table, in image marker order.
+pub const ImageInfo = struct {
+    /// Chosen image URL. In an `Extraction` this points into the text's
+    /// Images section, so it lives as long as the text.
+    src: []const u8,
+    /// Intrinsic size from width/height attributes in CSS px, 0 if unknown
+    width: u32 = 0,
+    height: u32 = 0,
+    /// Width / height from inline `aspect-ratio` or the attributes, 0 if unknown
+    aspect_ratio: f32 = 0,
+};
+
+/// One structured table, in TABLE_START marker order.
+/// The block is `TABLE_START row '\n' row '\n' ... TABLE_END`, with cells
+/// separated by CELL_SEP, so layout can place columns without re-measuring.
+pub const TableInfo = struct {
+    /// Byte offset of TABLE_START in the text
+    start: usize,
+    /// Byte offset just past TABLE_END
+    end: usize,
+    rows: u32,
+    /// Widest cell of each column, in characters (markers excluded)
+    column_widths: []const u16,
+};
+
+/// Extraction output: display text plus structured side tables.
+pub const Extraction = struct {
+    text: []u8,
+    images: []ImageInfo,
+    tables: []TableInfo,
+    /// Backing storage for every `TableInfo.column_widths`
+    column_widths: []u16,
+    /// Find-in-page index over the text body, when requested
+    search_index: ?search.Index = null,
+    /// Text, link and background colors declared by the page
+    page_style: page_style.PageStyle = .{},
+    /// Per-stage counters; all zero unless built with -Dinstrument
+    stats: stats.Counters = .{},
+
+    pub fn deinit(self: Extraction, allocator: std.mem.Allocator) void {
+        if (self.search_index) |index| index.deinit(allocator);
+        allocator.free(self.column_widths);
+        allocator.free(self.tables);
+        allocator.free(self.images);
+        allocator.free(self.text);
+    }
+};
+
 /// Extract visible text from HTML content.
 /// Caller owns returned slice and must free with same allocator.
+pub fn extractTextWithOptions(allocator: std.mem.Allocator, html: []const u8, options: ExtractOptions) ![]u8 {
+    var extraction = try extract(allocator, html, options);
+    const text = extraction.text;
+    extraction.text = text[0..0];
+    extraction.deinit(allocator);
+    return text;
+}
+
+/// Extract visible text, the image table and table layouts from HTML content.
+/// Caller owns the result and must release it with `Extraction.deinit`.
 /// Links are extracted and appended at the end as numbered references.
-/// Images are marked with IMAGE_MARKER control character and listed separately.
-pub fn extractText(allocator: std.mem.Allocator, html: []const u8) ![]u8 {
+/// Images are marked with IMAGE_MARKER control character and listed separately;
+/// srcset/<picture> candidates are resolved against `options`.
+pub fn extract(allocator: std.mem.Allocator, html: []const u8, options: ExtractOptions) !Extraction {
+    const viewport = srcset.Viewport{
+        .width = @floatFromInt(options.viewport_width),
+        .scale = options.device_scale,
+    };
+
     var result: std.ArrayListUnmanaged(u8) = .empty;
     errdefer result.deinit(allocator);
 
@@ -66,267 +156,366 @@ pub fn extractText(allocator: std.mem.Allocator, html: []const u8) ![]u8 {
     var link_count: usize = 0;
 
     // Track extracted images
-    var images: [MAX_IMAGES][]const u8 = undefined;
+    var images: [MAX_IMAGES]ImageInfo = undefined;
     var image_count: usize = 0;
 
+    // Candidate set from the first matching <source> of the current <picture>
+    var in_picture: bool = false;
+    var picture_source: ?srcset.SourceSet = null;
+
+    // Structured table output
+    var table: TableState = .{};
+    defer table.widths.deinit(allocator);
+    var table_records: std.ArrayListUnmanaged(TableRecord) = .empty;
+    defer table_records.deinit(allocator);
+    var column_widths: std.ArrayListUnmanaged(u16) = .empty;
+    errdefer column_widths.deinit(allocator);
+
     // Track current link state
     var in_link: bool = false;
     var current_href: ?[]const u8 = null;
     var in_pre: bool = false;
     var list_depth: u8 = 0;
 
-    var i: usize = 0;
     var in_skip_tag: ?[]const u8 = null;
     var last_was_space = true; // Start true to avoid leading space
 
-    while (i < html.len) {
-        // Check for tag start
-        if (html[i] == '<') {
-            const tag_end = std.mem.indexOfScalarPos(u8, html, i + 1, '>') orelse {
-                i += 1;
+    // Page colors, gathered from <style> text and html/body tags as they pass
+    var style_collector = page_style.Collector.init(allocator);
+    defer style_collector.deinit();
+
+    // Compiles away unless built with -Dinstrument
+    var recorder: stats.Recorder = .{};
+
+    var tokens = tokenizer.Tokenizer.init(html);
+    while (tokens.next()) |token| switch (token) {
+        .end_tag => |tag| {
+            recorder.count(.tags, 1);
+            const tag_started = recorder.start();
+            defer recorder.stop(.tags, tag_started);
+            defer recorder.trackGrowth(result.capacity);
+
+            const tag_name = tag.name;
+            if (in_skip_tag) |skip| {
+                if (std.ascii.eqlIgnoreCase(tag_name, skip)) {
+                    in_skip_tag = null;
+                }
                 continue;
-            };
-
-            const tag_content = html[i + 1 .. tag_end];
+            }
 
-            // Handle closing tag
-            if (tag_content.len > 0 and tag_content[0] == '/') {
-                const tag_name = getTagName(tag_content[1..]);
-                if (in_skip_tag) |skip| {
-                    if (std.ascii.eqlIgnoreCase(tag_name, skip)) {
-                        in_skip_tag = null;
-                    }
-                } else {
-                if (std.ascii.eqlIgnoreCase(tag_name, "pre")) {
-                    if (in_pre) {
-                        try result.append(allocator, PRE_END);
-                    }
-                    in_pre = false;
-                    try appendNewlines(allocator, &result, 2);
-                    last_was_space = true;
+            if (std.ascii.eqlIgnoreCase(tag_name, "pre")) {
+                if (in_pre) {
+                    try result.append(allocator, PRE_END);
                 }
+                in_pre = false;
+                try appendBlockBreak(allocator, &result, table.inStructure(), 2);
+                last_was_space = true;
+            }
+
+            if (std.ascii.eqlIgnoreCase(tag_name, "blockquote")) {
+                try result.append(allocator, QUOTE_END);
+                try appendBlockBreak(allocator, &result, table.inStructure(), 2);
+                last_was_space = true;
+            }
+
+            if (isHeadingTag(tag_name)) {
+                try result.append(allocator, HEADING_END);
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "blockquote")) {
-                    try result.append(allocator, QUOTE_END);
-                    try appendNewlines(allocator, &result, 2);
+            if (std.ascii.eqlIgnoreCase(tag_name, "em") or std.ascii.eqlIgnoreCase(tag_name, "i")) {
+                try result.append(allocator, EMPH_END);
+            }
+
+            if (std.ascii.eqlIgnoreCase(tag_name, "strong") or std.ascii.eqlIgnoreCase(tag_name, "b")) {
+                try result.append(allocator, STRONG_END);
+            }
+
+            if (std.ascii.eqlIgnoreCase(tag_name, "code")) {
+                try result.append(allocator, CODE_END);
+            }
+
+            if (std.ascii.eqlIgnoreCase(tag_name, "ul") or std.ascii.eqlIgnoreCase(tag_name, "ol")) {
+                if (list_depth > 0) list_depth -= 1;
+                try appendBlockBreak(allocator, &result, table.inStructure(), 1);
+                last_was_space = true;
+            }
+
+            if (std.ascii.eqlIgnoreCase(tag_name, "picture")) {
+                in_picture = false;
+                picture_source = null;
+            }
+
+            if (std.ascii.eqlIgnoreCase(tag_name, "table")) {
+                if (table.depth == 1) {
+                    try table.finish(allocator, &result, &table_records, &column_widths);
+                }
+                table.depth -|= 1;
+                last_was_space = true;
+            } else if (table.depth == 1) {
+                if (isTableCellTag(tag_name)) {
+                    try table.endCell(allocator, &result);
+                    last_was_space = true;
+                } else if (std.ascii.eqlIgnoreCase(tag_name, "tr")) {
+                    try table.endRow(allocator, &result);
                     last_was_space = true;
                 }
+            }
 
-                if (isHeadingTag(tag_name)) {
-                    try result.append(allocator, HEADING_END);
-                }
+            // Check for closing </a> tag
+            if (std.ascii.eqlIgnoreCase(tag_name, "a")) {
+                if (in_link and current_href != null) {
+                    // Mark end of link text
+                    try result.append(allocator, LINK_END);
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "em") or std.ascii.eqlIgnoreCase(tag_name, "i")) {
-                    try result.append(allocator, EMPH_END);
+                    // Track link for the Links section (no inline [N] - cleaner display)
+                    if (link_count < MAX_LINKS) {
+                        links[link_count] = current_href.?;
+                        link_count += 1;
+                    }
                 }
+                in_link = false;
+                current_href = null;
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "strong") or std.ascii.eqlIgnoreCase(tag_name, "b")) {
-                    try result.append(allocator, STRONG_END);
-                }
+            const spacing_after = blockSpacingAfter(tag_name);
+            if (spacing_after > 0) {
+                try appendBlockBreak(allocator, &result, table.inStructure(), spacing_after);
+                last_was_space = true;
+            }
+        },
+        .start_tag => |tag| {
+            recorder.count(.tags, 1);
+            const tag_started = recorder.start();
+            defer recorder.stop(.tags, tag_started);
+            defer recorder.trackGrowth(result.capacity);
+
+            // Opening or self-closing tag
+            const tag_name = tag.name;
+
+            if (in_skip_tag == null) {
+                try style_collector.addElement(tag_name, tag.raw);
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "code")) {
-                    try result.append(allocator, CODE_END);
-                }
+            // A stylesheet is read whole up to its end tag, wherever it sits,
+            // so neither '<' in it nor an enclosing skipped element splits it
+            if (std.ascii.eqlIgnoreCase(tag_name, "style") and !std.mem.endsWith(u8, tag.raw, "/>")) {
+                const css = tokens.rawText("style");
+                recorder.count(.bytes_skipped, css.len);
+                try style_collector.addStylesheet(css);
+                continue;
+            }
 
-                    if (std.ascii.eqlIgnoreCase(tag_name, "ul") or std.ascii.eqlIgnoreCase(tag_name, "ol")) {
-                        if (list_depth > 0) list_depth -= 1;
-                        try appendNewlines(allocator, &result, 1);
-                        last_was_space = true;
-                    }
+            // Check if we should skip this tag's content
+            if (isSkipTag(tag_name)) {
+                in_skip_tag = tag_name;
+            }
 
-                    // Check for closing </a> tag
-                    if (std.ascii.eqlIgnoreCase(tag_name, "a")) {
-                        if (in_link and current_href != null) {
-                            // Mark end of link text
-                            try result.append(allocator, LINK_END);
+            const spacing_before = blockSpacingBefore(tag_name);
+            if (spacing_before > 0) {
+                try appendBlockBreak(allocator, &result, table.inStructure(), spacing_before);
+                last_was_space = true;
+            }
 
-                            // Track link for the Links section (no inline [N] - cleaner display)
-                            if (link_count < MAX_LINKS) {
-                                links[link_count] = current_href.?;
-                                link_count += 1;
-                            }
-                        }
-                        in_link = false;
-                        current_href = null;
-                    }
+            if (std.ascii.eqlIgnoreCase(tag_name, "pre")) {
+                in_pre = true;
+                try result.append(allocator, PRE_START);
+                last_was_space = true;
+            }
 
-                    const spacing_after = blockSpacingAfter(tag_name);
-                    if (spacing_after > 0) {
-                        try appendNewlines(allocator, &result, spacing_after);
-                        last_was_space = true;
-                    }
-                }
-            } else {
-                // Opening or self-closing tag
-                const tag_name = getTagName(tag_content);
+            if (std.ascii.eqlIgnoreCase(tag_name, "blockquote")) {
+                try result.append(allocator, QUOTE_START);
+                last_was_space = true;
+            }
 
-                // Check if we should skip this tag's content
-                if (isSkipTag(tag_name)) {
-                    in_skip_tag = tag_name;
-                }
+            if (std.ascii.eqlIgnoreCase(tag_name, "em") or std.ascii.eqlIgnoreCase(tag_name, "i")) {
+                try result.append(allocator, EMPH_START);
+            }
 
-                const spacing_before = blockSpacingBefore(tag_name);
-                if (spacing_before > 0) {
-                    try appendNewlines(allocator, &result, spacing_before);
-                    last_was_space = true;
-                }
+            if (std.ascii.eqlIgnoreCase(tag_name, "strong") or std.ascii.eqlIgnoreCase(tag_name, "b")) {
+                try result.append(allocator, STRONG_START);
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "pre")) {
-                    in_pre = true;
-                    try result.append(allocator, PRE_START);
-                    last_was_space = true;
-                }
+            if (std.ascii.eqlIgnoreCase(tag_name, "code")) {
+                try result.append(allocator, CODE_START);
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "blockquote")) {
-                    try result.append(allocator, QUOTE_START);
-                    last_was_space = true;
-                }
+            if (std.ascii.eqlIgnoreCase(tag_name, "ul") or std.ascii.eqlIgnoreCase(tag_name, "ol")) {
+                if (list_depth < 10) list_depth += 1;
+                last_was_space = true;
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "em") or std.ascii.eqlIgnoreCase(tag_name, "i")) {
-                    try result.append(allocator, EMPH_START);
+            if (std.ascii.eqlIgnoreCase(tag_name, "li")) {
+                try appendBlockBreak(allocator, &result, table.inStructure(), 1);
+                const indent_levels: u8 = if (list_depth > 1) list_depth - 1 else 0;
+                for (0..indent_levels) |_| {
+                    try result.appendSlice(allocator, "  ");
                 }
+                try result.appendSlice(allocator, "- ");
+                last_was_space = true;
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "strong") or std.ascii.eqlIgnoreCase(tag_name, "b")) {
-                    try result.append(allocator, STRONG_START);
+            // Check for <a> tag and extract href
+            if (std.ascii.eqlIgnoreCase(tag_name, "a")) {
+                current_href = extractHref(tag.raw);
+                if (current_href != null and link_count < MAX_LINKS) {
+                    in_link = true;
+                    // Mark start of link text for blue styling
+                    try result.append(allocator, LINK_START);
+                } else {
+                    in_link = false;
+                    current_href = null;
                 }
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "code")) {
-                    try result.append(allocator, CODE_START);
-                }
+            if (std.ascii.eqlIgnoreCase(tag_name, "picture")) {
+                in_picture = true;
+                picture_source = null;
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "ul") or std.ascii.eqlIgnoreCase(tag_name, "ol")) {
-                    if (list_depth < 10) list_depth += 1;
+            // Tables: the outermost one becomes a structured block,
+            // nested ones flatten into their enclosing cell
+            if (in_skip_tag == null) {
+                const is_cell = isTableCellTag(tag_name);
+                const is_row = std.ascii.eqlIgnoreCase(tag_name, "tr");
+                if (std.ascii.eqlIgnoreCase(tag_name, "table")) {
+                    table.depth +|= 1;
+                } else if (table.depth == 1 and is_cell) {
+                    try table.beginCell(allocator, &result, std.ascii.eqlIgnoreCase(tag_name, "th"));
                     last_was_space = true;
-                }
-
-                if (std.ascii.eqlIgnoreCase(tag_name, "li")) {
-                    try appendNewlines(allocator, &result, 1);
-                    const indent_levels: u8 = if (list_depth > 1) list_depth - 1 else 0;
-                    for (0..indent_levels) |_| {
-                        try result.appendSlice(allocator, "  ");
-                    }
-                    try result.appendSlice(allocator, "- ");
+                } else if (table.depth == 1 and is_row) {
+                    try table.beginRow(allocator, &result);
+                    last_was_space = true;
+                } else if (table.depth > 1 and (is_cell or is_row) and !last_was_space) {
+                    try result.append(allocator, ' ');
                     last_was_space = true;
                 }
+            }
 
-                // Check for <a> tag and extract href
-                if (std.ascii.eqlIgnoreCase(tag_name, "a")) {
-                    current_href = extractHref(html[i..tag_end + 1]);
-                    if (current_href != null and link_count < MAX_LINKS) {
-                        in_link = true;
-                        // Mark start of link text for blue styling
-                        try result.append(allocator, LINK_START);
-                    } else {
-                        in_link = false;
-                        current_href = null;
+            // The first <source> whose media matches decides the picture's candidates
+            if (in_picture and picture_source == null and std.ascii.eqlIgnoreCase(tag_name, "source")) {
+                if (attributes.get(tag.raw, "srcset")) |set| {
+                    const media = attributes.get(tag.raw, "media");
+                    if (media == null or srcset.mediaMatches(media.?, viewport)) {
+                        picture_source = .{ .srcset = set, .sizes = attributes.get(tag.raw, "sizes") };
                     }
                 }
+            }
 
-                // Handle <img> tags - extract src and insert image marker
-                if (std.ascii.eqlIgnoreCase(tag_name, "img")) {
-                    if (extractImgSrc(html[i..tag_end + 1])) |img_src| {
-                        if (image_count < MAX_IMAGES) {
-                            images[image_count] = img_src;
-                            // Insert image placeholder with number
-                            try result.append(allocator, IMAGE_MARKER);
-                            var num_buf: [3]u8 = undefined;
-                            const num_str = std.fmt.bufPrint(&num_buf, "{d}", .{image_count + 1}) catch "?";
-                            try result.appendSlice(allocator, num_str);
-                            try result.append(allocator, IMAGE_MARKER);
-                            image_count += 1;
-                            try result.append(allocator, ' ');
-                            last_was_space = true;
-                        }
+            // Handle <img> tags - pick the image source and insert image marker
+            if (std.ascii.eqlIgnoreCase(tag_name, "img")) {
+                if (selectImageSource(tag.raw, picture_source, viewport)) |img_src| {
+                    if (image_count < MAX_IMAGES) {
+                        images[image_count] = imageInfo(tag.raw, img_src);
+                        // Insert image placeholder with number
+                        try result.append(allocator, IMAGE_MARKER);
+                        var num_buf: [3]u8 = undefined;
+                        const num_str = std.fmt.bufPrint(&num_buf, "{d}", .{image_count + 1}) catch "?";
+                        try result.appendSlice(allocator, num_str);
+                        try result.append(allocator, IMAGE_MARKER);
+                        image_count += 1;
+                        try result.append(allocator, ' ');
+                        last_was_space = true;
                     }
                 }
+            }
 
-                if (isHeadingTag(tag_name)) {
-                    const heading_start = headingStartMarker(tag_name) orelse HEADING_END;
-                    try result.append(allocator, heading_start);
-                }
+            if (isHeadingTag(tag_name)) {
+                const heading_start = headingStartMarker(tag_name) orelse HEADING_END;
+                try result.append(allocator, heading_start);
+            }
 
-                // Handle self-closing br
-                if (std.ascii.eqlIgnoreCase(tag_name, "br")) {
-                    try appendNewlines(allocator, &result, 1);
-                    last_was_space = true;
-                }
+            // Handle self-closing br
+            if (std.ascii.eqlIgnoreCase(tag_name, "br")) {
+                try appendBlockBreak(allocator, &result, table.inStructure(), 1);
+                last_was_space = true;
+            }
 
-                if (std.ascii.eqlIgnoreCase(tag_name, "hr")) {
-                    try appendNewlines(allocator, &result, 1);
-                    try result.appendSlice(allocator, "----------------------------------------");
-                    try appendNewlines(allocator, &result, 1);
-                    last_was_space = true;
-                }
+            if (std.ascii.eqlIgnoreCase(tag_name, "hr")) {
+                try appendBlockBreak(allocator, &result, table.inStructure(), 1);
+                try result.appendSlice(allocator, "----------------------------------------");
+                try appendBlockBreak(allocator, &result, table.inStructure(), 1);
+                last_was_space = true;
+            }
+        },
+        .text => |run| {
+            // Skip content inside skip tags
+            if (in_skip_tag != null) {
+                recorder.count(.bytes_skipped, run.len);
+                continue;
             }
+            const text_start = result.items.len;
+            defer recorder.count(.text_bytes, result.items.len - text_start);
+            defer recorder.trackGrowth(result.capacity);
+
+            var i: usize = 0;
+            while (i < run.len) {
+                // Plain text up to the next entity, a span at a time
+                const span_end = std.mem.indexOfScalarPos(u8, run, i, '&') orelse run.len;
+                if (span_end > i) {
+                    const span_started = recorder.start();
+                    defer recorder.stop(.whitespace, span_started);
+
+                    const span = run[i..span_end];
+                    if (in_pre) {
+                        const span_start = result.items.len;
+                        try result.appendSlice(allocator, span);
+                        // Rows own line breaks inside tables
+                        if (table.inStructure()) std.mem.replaceScalar(u8, result.items[span_start..], '\n', ' ');
+                        last_was_space = whitespace.isSpace(span[span.len - 1]);
+                    } else {
+                        last_was_space = try whitespace.appendCollapsed(allocator, &result, span, last_was_space);
+                    }
+                    i = span_end;
+                    continue;
+                }
 
-            i = tag_end + 1;
-            continue;
-        }
+                // Handle HTML entity
+                const entity_started = recorder.start();
+                defer recorder.stop(.entities, entity_started);
 
-        // Skip content inside skip tags
-        if (in_skip_tag != null) {
-            i += 1;
-            continue;
-        }
+                const entity_end = std.mem.indexOfScalarPos(u8, run, i + 1, ';') orelse {
+                    // Not a valid entity, treat as text
+                    if (in_pre or !last_was_space) {
+                        try result.append(allocator, run[i]);
+                    }
+                    i += 1;
+                    continue;
+                };
 
-        // Handle HTML entity
-        if (html[i] == '&') {
-            const entity_end = std.mem.indexOfScalarPos(u8, html, i + 1, ';') orelse {
-                // Not a valid entity, treat as text
-                if (in_pre or !last_was_space) {
-                    try result.append(allocator, html[i]);
+                // Don't process entities that are too long (not real entities)
+                if (entity_end - i > 10) {
+                    try result.append(allocator, run[i]);
+                    i += 1;
+                    continue;
                 }
-                i += 1;
-                continue;
-            };
-
-            // Don't process entities that are too long (not real entities)
-            if (entity_end - i > 10) {
-                try result.append(allocator, html[i]);
-                i += 1;
-                continue;
-            }
 
-            const entity = html[i + 1 .. entity_end];
-            const decoded = decodeEntity(entity);
-            if (decoded) |char| {
-                if (in_pre) {
-                    try result.append(allocator, char);
-                    last_was_space = (char == ' ' or char == '\n' or char == '\t' or char == '\r');
-                } else {
-                    if (char == ' ' or char == '\n' or char == '\t') {
-                        if (!last_was_space) {
-                            try result.append(allocator, ' ');
-                            last_was_space = true;
-                        }
-                    } else {
+                const entity = run[i + 1 .. entity_end];
+                const decoded = decodeEntity(entity);
+                if (decoded) |char| {
+                    recorder.count(.entities, 1);
+                    if (in_pre) {
                         try result.append(allocator, char);
-                        last_was_space = false;
+                        last_was_space = (char == ' ' or char == '\n' or char == '\t' or char == '\r');
+                    } else {
+                        if (char == ' ' or char == '\n' or char == '\t') {
+                            if (!last_was_space) {
+                                try result.append(allocator, ' ');
+                                last_was_space = true;
+                            }
+                        } else {
+                            try result.append(allocator, char);
+                            last_was_space = false;
+                        }
                     }
                 }
+                i = entity_end + 1;
             }
-            i = entity_end + 1;
-            continue;
-        }
-
-        // Regular text
-        const char = html[i];
-        if (in_pre) {
-            try result.append(allocator, char);
-            last_was_space = (char == ' ' or char == '\n' or char == '\r' or char == '\t');
-        } else {
-            if (char == ' ' or char == '\n' or char == '\r' or char == '\t') {
-                if (!last_was_space) {
-                    try result.append(allocator, ' ');
-                    last_was_space = true;
-                }
-            } else {
-                try result.append(allocator, char);
-                last_was_space = false;
-            }
-        }
+        },
+    };
 
-        i += 1;
+    // Close a table left open at end of input
+    if (table.depth > 0) {
+        try table.finish(allocator, &result, &table_records, &column_widths);
     }
 
     // Trim trailing whitespace
@@ -339,6 +528,12 @@ pub fn extractText(allocator: std.mem.Allocator, html: []const u8) ![]u8 {
         }
     }
 
+    // Index the body now; the trailers below are not page text
+    const search_index = if (options.build_search_index) try search.Index.build(allocator, result.items) else null;
+    errdefer if (search_index) |index| index.deinit(allocator);
+
+    const output_started = recorder.start();
+
     // Append links section if we found any
     if (link_count > 0) {
         try result.appendSlice(allocator, "\n\n---\nLinks:\n");
@@ -354,33 +549,189 @@ pub fn extractText(allocator: std.mem.Allocator, html: []const u8) ![]u8 {
     }
 
     // Append images section if we found any
+    var src_offsets: [MAX_IMAGES]usize = undefined;
     if (image_count > 0) {
         try result.appendSlice(allocator, "\n---\nImages:\n");
-        for (images[0..image_count], 1..) |src, num| {
+        for (images[0..image_count], 1..) |image, num| {
             try result.append(allocator, '[');
             var num_buf: [3]u8 = undefined;
             const num_str = std.fmt.bufPrint(&num_buf, "{d}", .{num}) catch "?";
             try result.appendSlice(allocator, num_str);
             try result.appendSlice(allocator, "] ");
-            try result.appendSlice(allocator, src);
+            src_offsets[num - 1] = result.items.len;
+            try result.appendSlice(allocator, image.src);
             try result.append(allocator, '\n');
         }
     }
 
-    return result.toOwnedSlice(allocator);
+    recorder.trackGrowth(result.capacity);
+
+    const image_table = try allocator.alloc(ImageInfo, image_count);
+    errdefer allocator.free(image_table);
+    const tables = try allocator.alloc(TableInfo, table_records.items.len);
+    errdefer allocator.free(tables);
+    const widths = try column_widths.toOwnedSlice(allocator);
+    errdefer allocator.free(widths);
+    const text = try result.toOwnedSlice(allocator);
+
+    // Re-point sources at the Images section so the table outlives `html`
+    for (image_table, images[0..image_count], src_offsets[0..image_count]) |*entry, image, offset| {
+        entry.* = image;
+        entry.src = text[offset .. offset + image.src.len];
+    }
+
+    for (tables, table_records.items) |*entry, record| {
+        entry.* = .{
+            .start = record.start,
+            .end = record.end,
+            .rows = record.rows,
+            .column_widths = widths[record.widths_offset..][0..record.columns],
+        };
+    }
+
+    recorder.stop(.output, output_started);
+
+    return .{
+        .text = text,
+        .images = image_table,
+        .tables = tables,
+        .column_widths = widths,
+        .search_index = search_index,
+        .page_style = try style_collector.resolve(),
+        .stats = recorder.counters,
+    };
 }
 
-fn getTagName(tag_content: []const u8) []const u8 {
-    // Find end of tag name (space, /, or end)
-    var end: usize = 0;
-    while (end < tag_content.len) {
-        const c = tag_content[end];
-        if (c == ' ' or c == '\t' or c == '\n' or c == '/' or c == '>') {
-            break;
+/// Length of extracted text before the Links/Images trailers, i.e. the part
+/// that is page content.
+pub fn bodyLength(text: []const u8) usize {
+    var end = text.len;
+    // Images come last, so search from the back
+    if (std.mem.lastIndexOf(u8, text, "\n---\nImages:\n")) |pos| end = pos;
+    if (std.mem.lastIndexOf(u8, text[0..end], "\n\n---\nLinks:\n")) |pos| end = pos;
+    return end;
+}
+
+/// A finished table while extraction is still growing the output buffers.
+const TableRecord = struct {
+    start: usize,
+    end: usize,
+    rows: u32,
+    widths_offset: usize,
+    columns: usize,
+};
+
+/// Row/cell bookkeeping for the outermost table being extracted.
+/// TABLE_START is emitted lazily at the first row so a <caption> stays
+/// ordinary text above the block.
+const TableState = struct {
+    /// <table> nesting depth; only depth 1 is structured
+    depth: u8 = 0,
+    started: bool = false,
+    start: usize = 0,
+    rows: u32 = 0,
+    row_open: bool = false,
+    /// Cells finished in the current row (index of the next column)
+    column: usize = 0,
+    cell_open: bool = false,
+    cell_start: usize = 0,
+    cell_header: bool = false,
+    widths: std.ArrayListUnmanaged(u16) = .empty,
+
+    /// True when block breaks must collapse because rows own the lines
+    fn inStructure(self: *const TableState) bool {
+        return self.depth > 1 or (self.depth == 1 and self.started);
+    }
+
+    fn beginRow(self: *TableState, allocator: std.mem.Allocator, result: *std.ArrayListUnmanaged(u8)) !void {
+        if (!self.started) {
+            try appendNewlines(allocator, result, 1);
+            self.start = result.items.len;
+            try result.append(allocator, TABLE_START);
+            self.started = true;
+        }
+        try self.endRow(allocator, result);
+        self.row_open = true;
+        self.column = 0;
+    }
+
+    fn beginCell(self: *TableState, allocator: std.mem.Allocator, result: *std.ArrayListUnmanaged(u8), header: bool) !void {
+        if (!self.row_open) try self.beginRow(allocator, result);
+        try self.endCell(allocator, result);
+        if (self.column > 0) try result.append(allocator, CELL_SEP);
+        self.cell_open = true;
+        self.cell_start = result.items.len;
+        self.cell_header = header;
+        if (header) try result.append(allocator, STRONG_START);
+    }
+
+    fn endCell(self: *TableState, allocator: std.mem.Allocator, result: *std.ArrayListUnmanaged(u8)) !void {
+        if (!self.cell_open) return;
+        while (result.items.len > self.cell_start and result.items[result.items.len - 1] == ' ') {
+            _ = result.pop();
         }
-        end += 1;
+        if (self.cell_header) try result.append(allocator, STRONG_END);
+
+        const width: u16 = @intCast(@min(displayWidth(result.items[self.cell_start..]), std.math.maxInt(u16)));
+        while (self.widths.items.len <= self.column) {
+            try self.widths.append(allocator, 0);
+        }
+        self.widths.items[self.column] = @max(self.widths.items[self.column], width);
+        self.column += 1;
+        self.cell_open = false;
+    }
+
+    fn endRow(self: *TableState, allocator: std.mem.Allocator, result: *std.ArrayListUnmanaged(u8)) !void {
+        if (!self.row_open) return;
+        try self.endCell(allocator, result);
+        try result.append(allocator, '\n');
+        self.rows += 1;
+        self.row_open = false;
     }
-    return tag_content[0..end];
+
+    /// Close the outermost table and record its layout.
+    fn finish(
+        self: *TableState,
+        allocator: std.mem.Allocator,
+        result: *std.ArrayListUnmanaged(u8),
+        records: *std.ArrayListUnmanaged(TableRecord),
+        column_widths: *std.ArrayListUnmanaged(u16),
+    ) !void {
+        try self.endRow(allocator, result);
+        if (self.started) {
+            try result.append(allocator, TABLE_END);
+            try records.append(allocator, .{
+                .start = self.start,
+                .end = result.items.len,
+                .rows = self.rows,
+                .widths_offset = column_widths.items.len,
+                .columns = self.widths.items.len,
+            });
+            try column_widths.appendSlice(allocator, self.widths.items);
+        }
+        self.started = false;
+        self.rows = 0;
+        self.widths.clearRetainingCapacity();
+    }
+};
+
+/// Display width of extracted text in characters: UTF-8 code points,
+/// not counting control markers or image numbers.
+fn displayWidth(text: []const u8) usize {
+    var width: usize = 0;
+    var in_image = false;
+    for (text) |c| {
+        if (c == IMAGE_MARKER) {
+            in_image = !in_image;
+            continue;
+        }
+        if (!in_image and c >= 0x20 and (c & 0xC0) != 0x80) width += 1;
+    }
+    return width;
+}
+
+fn isTableCellTag(name: []const u8) bool {
+    return std.ascii.eqlIgnoreCase(name, "td") or std.ascii.eqlIgnoreCase(name, "th");
 }
 
 /// Extract href attribute value from an <a> tag
@@ -431,54 +782,79 @@ fn extractHref(tag: []const u8) ?[]const u8 {
     return null;
 }
 
-/// Extract src attribute value from an <img> tag
+/// Extract src attribute value from an <img> tag.
+/// Matched as a whole attribute name, so `data-src` and a quoted value
+/// holding "src=" do not count.
 fn extractImgSrc(tag: []const u8) ?[]const u8 {
-    // Look for src= (case insensitive)
-    var i: usize = 0;
-    while (i + 4 < tag.len) {
-        if ((tag[i] == 's' or tag[i] == 'S') and
-            (tag[i + 1] == 'r' or tag[i + 1] == 'R') and
-            (tag[i + 2] == 'c' or tag[i + 2] == 'C') and
-            tag[i + 3] == '=')
-        {
-            i += 4;
+    const src = attributes.get(tag, "src") orelse return null;
+    return if (src.len > 0) src else null;
+}
 
-            // Skip whitespace
-            while (i < tag.len and (tag[i] == ' ' or tag[i] == '\t')) {
-                i += 1;
-            }
+/// Choose the URL to download for an <img>: the cheapest adequate candidate
+/// from a matched <picture><source>, else from the img's own srcset/sizes,
+/// else plain src.
+fn selectImageSource(tag: []const u8, picture_source: ?srcset.SourceSet, viewport: srcset.Viewport) ?[]const u8 {
+    const fallback = extractImgSrc(tag);
+    if (picture_source) |source| {
+        // A matched <source> replaces the img's candidates entirely
+        return srcset.selectCandidate(source.srcset, source.sizes, null, viewport) orelse fallback;
+    }
+    const set = attributes.get(tag, "srcset") orelse return fallback;
+    return srcset.selectCandidate(set, attributes.get(tag, "sizes"), fallback, viewport) orelse fallback;
+}
 
-            if (i >= tag.len) return null;
+/// Intrinsic size hints for an <img>: width/height attributes and an inline
+/// `aspect-ratio`, so layout can reserve the box before the image arrives.
+fn imageInfo(tag: []const u8, src: []const u8) ImageInfo {
+    var info = ImageInfo{ .src = src };
+    if (attributes.get(tag, "width")) |value| info.width = parseDimension(value);
+    if (attributes.get(tag, "height")) |value| info.height = parseDimension(value);
+    if (info.width > 0 and info.height > 0) {
+        info.aspect_ratio = @as(f32, @floatFromInt(info.width)) / @as(f32, @floatFromInt(info.height));
+    }
 
-            // Check for quote
-            const quote = tag[i];
-            if (quote == '"' or quote == '\'') {
-                i += 1;
-                const start = i;
-                while (i < tag.len and tag[i] != quote) {
-                    i += 1;
-                }
-                if (i > start) {
-                    return tag[start..i];
-                }
-            } else {
-                // Unquoted value - ends at space or >
-                const start = i;
-                while (i < tag.len and tag[i] != ' ' and tag[i] != '>' and tag[i] != '\t') {
-                    i += 1;
-                }
-                if (i > start) {
-                    return tag[start..i];
-                }
+    if (attributes.get(tag, "style")) |style| {
+        if (attributes.styleProperty(style, "aspect-ratio")) |value| {
+            // `auto <ratio>` prefers the natural ratio, which the attributes provide
+            const prefers_natural = std.mem.indexOf(u8, value, "auto") != null;
+            if (!(prefers_natural and info.aspect_ratio > 0)) {
+                if (parseAspectRatio(value)) |ratio| info.aspect_ratio = ratio;
             }
-            return null;
         }
-        i += 1;
     }
-    return null;
+    return info;
+}
+
+/// Parse a width/height attribute ("640", "640px"). Percentages are unknown.
+fn parseDimension(value: []const u8) u32 {
+    var end: usize = 0;
+    while (end < value.len and std.ascii.isDigit(value[end])) end += 1;
+    if (end == 0) return 0;
+    if (std.mem.indexOfScalarPos(u8, value, end, '%') != null) return 0;
+    return std.fmt.parseInt(u32, value[0..end], 10) catch 0;
 }
 
-fn isSkipTag(name: []const u8) bool {
+/// Parse a CSS `aspect-ratio` value: `16 / 9`, `1.5`, `auto 4/3`.
+fn parseAspectRatio(value: []const u8) ?f32 {
+    var ratio = value;
+    if (std.mem.indexOf(u8, ratio, "auto")) |auto_pos| {
+        // Drop the keyword wherever it appears
+        ratio = if (auto_pos == 0) ratio[4..] else ratio[0..auto_pos];
+    }
+    ratio = std.mem.trim(u8, ratio, " \t");
+
+    const slash = std.mem.indexOfScalar(u8, ratio, '/');
+    const numerator_text = std.mem.trim(u8, if (slash) |s| ratio[0..s] else ratio, " \t");
+    const numerator = std.fmt.parseFloat(f32, numerator_text) catch return null;
+    var denominator: f32 = 1.0;
+    if (slash) |s| {
+        denominator = std.fmt.parseFloat(f32, std.mem.trim(u8, ratio[s + 1 ..], " \t")) catch return null;
+    }
+    if (!(numerator > 0) or !(denominator > 0)) return null;
+    return numerator / denominator;
+}
+
+pub fn isSkipTag(name: []const u8) bool {
     for (skip_tags) |skip| {
         if (std.ascii.eqlIgnoreCase(name, skip)) {
             return true;
@@ -487,7 +863,7 @@ fn isSkipTag(name: []const u8) bool {
     return false;
 }
 
-fn isHeadingTag(name: []const u8) bool {
+pub fn isHeadingTag(name: []const u8) bool {
     return std.ascii.eqlIgnoreCase(name, "h1") or
         std.ascii.eqlIgnoreCase(name, "h2") or
         std.ascii.eqlIgnoreCase(name, "h3") or
@@ -504,7 +880,7 @@ fn headingStartMarker(name: []const u8) ?u8 {
     return H2_START;
 }
 
-fn blockSpacingBefore(name: []const u8) u8 {
+pub fn blockSpacingBefore(name: []const u8) u8 {
     // HTML Living Standard + CSS UA defaults: block elements have margin-block.
     // We approximate one line of separation before block elements.
     if (isHeadingTag(name)) return 1;
@@ -521,6 +897,7 @@ fn blockSpacingBefore(name: []const u8) u8 {
         std.ascii.eqlIgnoreCase(name, "pre") or
         std.ascii.eqlIgnoreCase(name, "ul") or
         std.ascii.eqlIgnoreCase(name, "ol") or
+        std.ascii.eqlIgnoreCase(name, "table") or
         std.ascii.eqlIgnoreCase(name, "hr"))
     {
         return 1;
@@ -528,7 +905,7 @@ fn blockSpacingBefore(name: []const u8) u8 {
     return 0;
 }
 
-fn blockSpacingAfter(name: []const u8) u8 {
+pub fn blockSpacingAfter(name: []const u8) u8 {
     // Approximate margin-block-end for block elements as a blank line.
     if (isHeadingTag(name)) return 2;
     if (std.ascii.eqlIgnoreCase(name, "p") or
@@ -544,6 +921,7 @@ fn blockSpacingAfter(name: []const u8) u8 {
         std.ascii.eqlIgnoreCase(name, "pre") or
         std.ascii.eqlIgnoreCase(name, "ul") or
         std.ascii.eqlIgnoreCase(name, "ol") or
+        std.ascii.eqlIgnoreCase(name, "table") or
         std.ascii.eqlIgnoreCase(name, "hr"))
     {
         return 2;
@@ -552,6 +930,15 @@ fn blockSpacingAfter(name: []const u8) u8 {
     return 0;
 }
 
+/// Block-level line break. Inside a structured table the rows own the line
+/// breaks, so block elements within cells collapse to a single space.
+fn appendBlockBreak(allocator: std.mem.Allocator, result: *std.ArrayListUnmanaged(u8), in_table: bool, count: u8) !void {
+    if (!in_table) return appendNewlines(allocator, result, count);
+    if (result.items.len > 0 and result.items[result.items.len - 1] > ' ') {
+        try result.append(allocator, ' ');
+    }
+}
+
 fn appendNewlines(allocator: std.mem.Allocator, result: *std.ArrayListUnmanaged(u8), count: u8) !void {
     if (count == 0 or result.items.len == 0) return;
     var existing: u8 = 0;
@@ -567,7 +954,7 @@ fn appendNewlines(allocator: std.mem.Allocator, result: *std.ArrayListUnmanaged(
     }
 }
 
-fn decodeEntity(entity: []const u8) ?u8 {
+pub fn decodeEntity(entity: []const u8) ?u8 {
     // Numeric entities
     if (entity.len > 1 and entity[0] == '#') {
         if (entity[1] == 'x' or entity[1] == 'X') {
@@ -792,9 +1179,8 @@ test "extractImgSrc with single quotes" {
     try std.testing.expectEqualStrings("https://example.com/test.jpg", src.?);
 }
 
-test "extractImgSrc with spaces after equals" {
-    // Note: spaces before = are not supported (strict src= match)
-    const tag = "<img src=  \"https://example.com/test.jpg\"  >";
+test "extractImgSrc with spaces around equals" {
+    const tag = "<img src =  \"https://example.com/test.jpg\"  >";
     const src = extractImgSrc(tag);
     try std.testing.expect(src != null);
     try std.testing.expectEqualStrings("https://example.com/test.jpg", src.?);
@@ -807,6 +1193,13 @@ test "extractImgSrc with other attributes" {
     try std.testing.expectEqualStrings("https://example.com/test.jpg", src.?);
 }
 
+test "extractImgSrc matches the whole attribute name" {
+    try std.testing.expectEqualStrings("/real.jpg", extractImgSrc("<img data-src=\"/lazy.jpg\" src=\"/real.jpg\">").?);
+    try std.testing.expectEqualStrings("/real.jpg", extractImgSrc("<img alt=\"src=/alt.jpg\" src=/real.jpg>").?);
+    try std.testing.expect(extractImgSrc("<img data-src=\"/lazy.jpg\">") == null);
+    try std.testing.expect(extractImgSrc("<img src=\"\">") == null);
+}
+
 test "image extraction respects MAX_IMAGES limit" {
     // Create HTML with more than MAX_IMAGES images
     var html_buf: [2000]u8 = undefined;
@@ -843,3 +1236,201 @@ test "image extraction respects MAX_IMAGES limit" {
     // We have MAX_IMAGES images in Images section, plus 0 inline (inline numbers removed)
     try std.testing.expectEqual(MAX_IMAGES, image_count);
 }
+
+test "img srcset picks candidate for device scale" {
+    const html = "<img src=\"/big.jpg\" srcset=\"/small.jpg 400w, /medium.jpg 800w, /big.jpg 1600w\" sizes=\"400px\">";
+
+    const text_1x = try extractTextWithOptions(std.testing.allocator, html, .{ .viewport_width = 1280, .device_scale = 1 });
+    defer std.testing.allocator.free(text_1x);
+    try std.testing.expect(std.mem.indexOf(u8, text_1x, "[1] /small.jpg") != null);
+
+    const text_2x = try extractTextWithOptions(std.testing.allocator, html, .{ .viewport_width = 1280, .device_scale = 2 });
+    defer std.testing.allocator.free(text_2x);
+    try std.testing.expect(std.mem.indexOf(u8, text_2x, "[1] /medium.jpg") != null);
+}
+
+test "img with only srcset is extracted" {
+    const html = "<img srcset=\"/a.jpg 1x, /b.jpg 2x\">";
+    const text = try extractText(std.testing.allocator, html);
+    defer std.testing.allocator.free(text);
+
+    try std.testing.expect(std.mem.indexOf(u8, text, "[1] /a.jpg") != null);
+}
+
+test "picture source with matching media wins" {
+    const html =
+        "<picture>" ++
+        "<source media=\"(min-width: 2000px)\" srcset=\"/wide.webp\">" ++
+        "<source media=\"(min-width: 600px)\" srcset=\"/mid.webp 1x, /mid@2x.webp 2x\">" ++
+        "<img src=\"/fallback.jpg\">" ++
+        "</picture>" ++
+        "<img src=\"/plain.jpg\">";
+    const text = try extractTextWithOptions(std.testing.allocator, html, .{ .viewport_width = 1024, .device_scale = 2 });
+    defer std.testing.allocator.free(text);
+
+    try std.testing.expect(std.mem.indexOf(u8, text, "[1] /mid@2x.webp") != null);
+    // The picture's <source> must not leak into images after </picture>
+    try std.testing.expect(std.mem.indexOf(u8, text, "[2] /plain.jpg") != null);
+}
+
+test "image table carries intrinsic dimensions" {
+    const html =
+        "<img src=\"/a.jpg\" width=\"640\" height=\"480\">" ++
+        "<img src=\"/b.jpg\" style=\"width: 100%; aspect-ratio: 16 / 9\">" ++
+        "<img src=\"/c.jpg\" width=\"50%\">";
+    const extraction = try extract(std.testing.allocator, html, .{});
+    defer extraction.deinit(std.testing.allocator);
+
+    try std.testing.expectEqual(@as(usize, 3), extraction.images.len);
+
+    const a = extraction.images[0];
+    try std.testing.expectEqualStrings("/a.jpg", a.src);
+    try std.testing.expectEqual(@as(u32, 640), a.width);
+    try std.testing.expectEqual(@as(u32, 480), a.height);
+    try std.testing.expectApproxEqAbs(@as(f32, 4.0 / 3.0), a.aspect_ratio, 0.001);
+
+    const b = extraction.images[1];
+    try std.testing.expectEqual(@as(u32, 0), b.width);
+    try std.testing.expectApproxEqAbs(@as(f32, 16.0 / 9.0), b.aspect_ratio, 0.001);
+
+    const c = extraction.images[2];
+    try std.testing.expectEqual(@as(u32, 0), c.width);
+    try std.testing.expectEqual(@as(f32, 0), c.aspect_ratio);
+
+    // Sources live in the text's Images section, not in the input html
+    const text_start = @intFromPtr(extraction.text.ptr);
+    const src_start = @intFromPtr(a.src.ptr);
+    try std.testing.expect(src_start >= text_start and src_start < text_start + extraction.text.len);
+}
+
+test "aspect-ratio auto prefers attribute ratio" {
+    const html = "<img src=\"/a.jpg\" width=\"300\" height=\"300\" style=\"aspect-ratio: auto 4 / 3\">";
+    const extraction = try extract(std.testing.allocator, html, .{});
+    defer extraction.deinit(std.testing.allocator);
+
+    try std.testing.expectApproxEqAbs(@as(f32, 1.0), extraction.images[0].aspect_ratio, 0.001);
+}
+
+test "table becomes structured block with column widths" {
+    const html =
+        "<p>Stats</p>" ++
+        "<table><caption>Totals</caption>" ++
+        "<tr><th>Name</th><th>Score</th></tr>\n" ++
+        "<tr><td> Alice </td><td>9</td></tr>\n" ++
+        "<tr><td>Bob</td><td><p>10</p><p>pts</p></td></tr>" ++
+        "</table><p>After</p>";
+    const extraction = try extract(std.testing.allocator, html, .{});
+    defer extraction.deinit(std.testing.allocator);
+
+    const expected = "Stats\n\nTotals\n" ++
+        [_]u8{TABLE_START} ++
+        [_]u8{STRONG_START} ++ "Name" ++ [_]u8{ STRONG_END, CELL_SEP, STRONG_START } ++ "Score" ++ [_]u8{STRONG_END} ++ "\n" ++
+        "Alice" ++ [_]u8{CELL_SEP} ++ "9\n" ++
+        "Bob" ++ [_]u8{CELL_SEP} ++ "10 pts\n" ++
+        [_]u8{TABLE_END} ++ "\n\nAfter";
+    try std.testing.expectEqualStrings(expected, extraction.text);
+
+    try std.testing.expectEqual(@as(usize, 1), extraction.tables.len);
+    const t = extraction.tables[0];
+    try std.testing.expectEqual(@as(u32, 3), t.rows);
+    try std.testing.expectEqualSlices(u16, &[_]u16{ 5, 6 }, t.column_widths);
+    try std.testing.expectEqual(TABLE_START, extraction.text[t.start]);
+    try std.testing.expectEqual(TABLE_END, extraction.text[t.end - 1]);
+}
+
+test "nested tables flatten into the outer cell" {
+    const html = "<table><tr><td>a</td><td><table><tr><td>x</td><td>y</td></tr></table></td></tr></table>";
+    const extraction = try extract(std.testing.allocator, html, .{});
+    defer extraction.deinit(std.testing.allocator);
+
+    try std.testing.expectEqual(@as(usize, 1), extraction.tables.len);
+    const expected = [_]u8{TABLE_START} ++ "a" ++ [_]u8{CELL_SEP} ++ "x y\n" ++ [_]u8{TABLE_END};
+    try std.testing.expectEqualStrings(&expected, extraction.text);
+    try std.testing.expectEqualSlices(u16, &[_]u16{ 1, 3 }, extraction.tables[0].column_widths);
+}
+
+test "cells without closing tags and multibyte widths" {
+    const html = "<table><tr><td>caf\xc3\xa9<td>b<tr><td>c</table>";
+    const extraction = try extract(std.testing.allocator, html, .{});
+    defer extraction.deinit(std.testing.allocator);
+
+    try std.testing.expectEqual(@as(u32, 2), extraction.tables[0].rows);
+    try std.testing.expectEqualSlices(u16, &[_]u16{ 4, 1 }, extraction.tables[0].column_widths);
+}
+
+test "entity lookup stops at the next tag" {
+    const html = "<p>Q&amp;A x&c <b>bold;</b></p>";
+    const text = try extractText(std.testing.allocator, html);
+    defer std.testing.allocator.free(text);
+
+    const expected = "Q&A x&c " ++ [_]u8{STRONG_START} ++ "bold;" ++ [_]u8{STRONG_END};
+    try std.testing.expectEqualStrings(expected, text);
+}
+
+test "search index covers the body, not the link trailer" {
+    const html = "<p>Read the <a href=\"/manual\">manual</a> first.</p>";
+    const extraction = try extract(std.testing.allocator, html, .{ .build_search_index = true });
+    defer extraction.deinit(std.testing.allocator);
+
+    const index = extraction.search_index.?;
+    try std.testing.expectEqual(@as(usize, 1), index.count("the manual"));
+    try std.testing.expectEqual(@as(usize, 0), index.count("/manual"));
+
+    const matches = try index.find(std.testing.allocator, "manual first");
+    defer std.testing.allocator.free(matches);
+    const expected = "manual" ++ [_]u8{LINK_END} ++ " first";
+    try std.testing.expectEqualStrings(expected, extraction.text[matches[0].start..matches[0].end]);
+}
+
+test "body length stops before trailers" {
+    const html = "<p><a href=\"/a\">a</a> <img src=\"x.png\"></p>";
+    const text = try extractText(std.testing.allocator, html);
+    defer std.testing.allocator.free(text);
+
+    const body = text[0..bodyLength(text)];
+    try std.testing.expect(std.mem.indexOf(u8, body, "Links:") == null);
+    try std.testing.expect(std.mem.endsWith(text[0 .. body.len + 13], "---\nLinks:\n"));
+    try std.testing.expectEqual(@as(usize, 5), bodyLength("plain"));
+}
+
+test "whitespace collapses across entities" {
+    const text = try extractText(std.testing.allocator, "<p>  a \n\t b&amp;c &nbsp;  d </p>");
+    defer std.testing.allocator.free(text);
+    try std.testing.expectEqualStrings("a b&c d", text);
+}
+
+test "comments with '>' do not leak text" {
+    const html = "<!DOCTYPE html><p>a<!-- <b>old</b> -> x --> b</p><!-- <p>gone</p> -->";
+    const text = try extractText(std.testing.allocator, html);
+    defer std.testing.allocator.free(text);
+    try std.testing.expectEqualStrings("a b", text);
+}
+
+test "page style collected during extraction" {
+    const html =
+        \\<html><head><style>body { color: #222; background: #fdf6e3 } a { color: navy }</style></head>
+        \\<body style="color: rgb(1, 2, 3)"><p>Hello <a href="/x">x</a></p></body></html>
+    ;
+    const extraction = try extract(std.testing.allocator, html, .{});
+    defer extraction.deinit(std.testing.allocator);
+
+    const style = extraction.page_style;
+    try std.testing.expectEqual(@as(?page_style.Color, .{ .r = 1, .g = 2, .b = 3 }), style.text);
+    try std.testing.expectEqual(@as(?page_style.Color, .{ .r = 0, .g = 0, .b = 128 }), style.link);
+    try std.testing.expectEqual(@as(?page_style.Color, .{ .r = 0xfd, .g = 0xf6, .b = 0xe3 }), style.background);
+    try std.testing.expect(std.mem.indexOf(u8, extraction.text, "color") == null);
+}
+
+test "a stylesheet is read whole, '<' and all" {
+    const html =
+        \\<head><style>a[title="<"] > b { color: red } body { color: #010203 }</style>
+        \\<title>Hidden</title></head><body><p>Shown</p></body>
+    ;
+    const extraction = try extract(std.testing.allocator, html, .{});
+    defer extraction.deinit(std.testing.allocator);
+
+    try std.testing.expectEqual(@as(?page_style.Color, .{ .r = 1, .g = 2, .b = 3 }), extraction.page_style.text);
+    try std.testing.expect(std.mem.indexOf(u8, extraction.text, "Shown") != null);
+    try std.testing.expect(std.mem.indexOf(u8, extraction.text, "Hidden") == null);
+    try std.testing.expect(std.mem.indexOf(u8, extraction.text, "color") == null);
+}
@@ -0,0 +1,302 @@
+//! Vulpes Browser - HTML Tokenizer
+//!
+//! Splits raw HTML into start tags, end tags and text runs in one forward
+//! pass, without building a tree. Emitters (plain text, Markdown) share it
+//! so they agree on what counts as markup.
+//!
+//! Tokens are slices into the input; nothing is copied or decoded.
+//! A '<' with no closing '>' is dropped, matching the original extractor.
+//! Callers read the contents of raw text elements with `rawText`, so a
+//! '<' in a stylesheet is not taken for a tag.
+//!
+//! Comments, CDATA sections, doctypes and processing instructions produce
+//! no token. Their terminators are found by scanning for '>' with the
+//! vectorized std.mem.indexOfScalarPos and checking the bytes before it,
+//! so a large commented-out block costs a few compares per vector. Once
+//! a search for "-->" or "]]>" reaches the end of the input, none follows,
+//! so later unterminated openers skip it and the page stays linear.
+//!
+
+const std = @import("std");
+
+pub const Tag = struct {
+    /// Tag name as written (compare case-insensitively)
+    name: []const u8,
+    /// The whole tag from '<' to '>', for attribute lookups
+    raw: []const u8,
+};
+
+pub const Token = union(enum) {
+    start_tag: Tag,
+    end_tag: Tag,
+    /// Character data up to the next '<', entities undecoded
+    text: []const u8,
+};
+
+pub const Tokenizer = struct {
+    html: []const u8,
+    pos: usize = 0,
+    /// Openers at or past these have no "-->" or "]]>" after them
+    comment_unclosed: usize = std.math.maxInt(usize),
+    cdata_unclosed: usize = std.math.maxInt(usize),
+    /// No '>' at or past this
+    gt_none: usize = std.math.maxInt(usize),
+
+    pub fn init(html: []const u8) Tokenizer {
+        return .{ .html = html };
+    }
+
+    pub fn next(self: *Tokenizer) ?Token {
+        const html = self.html;
+        while (self.pos < html.len) {
+            if (html[self.pos] != '<') {
+                const start = self.pos;
+                self.pos = std.mem.indexOfScalarPos(u8, html, start, '<') orelse html.len;
+                return .{ .text = html[start..self.pos] };
+            }
+
+            const start = self.pos;
+            if (self.markupEnd(start)) |end| {
+                self.pos = end;
+                continue;
+            }
+
+            const tag_end = self.nextGt(start + 1) orelse {
+                // Unterminated tag: drop the '<' and keep going as text
+                self.pos += 1;
+                continue;
+            };
+            self.pos = tag_end + 1;
+
+            const raw = html[start .. tag_end + 1];
+            const content = html[start + 1 .. tag_end];
+            if (content.len > 0 and content[0] == '/') {
+                return .{ .end_tag = .{ .name = tagName(content[1..]), .raw = raw } };
+            }
+            return .{ .start_tag = .{ .name = tagName(content), .raw = raw } };
+        }
+        return null;
+    }
+
+    /// Contents of a raw text element such as <style>, whose start tag was
+    /// just returned: everything up to its end tag, which is left to be
+    /// the next token. A '<' inside is text, not markup.
+    pub fn rawText(self: *Tokenizer, name: []const u8) []const u8 {
+        const html = self.html;
+        const start = self.pos;
+        var from = start;
+        while (std.mem.indexOfPos(u8, html, from, "</")) |at| {
+            const after = html[at + 2 ..];
+            if (after.len >= name.len and std.ascii.eqlIgnoreCase(after[0..name.len], name)) {
+                if (after.len == name.len or std.mem.indexOfScalar(u8, " \t\n\r\x0c/>", after[name.len]) != null) {
+                    self.pos = at;
+                    return html[start..at];
+                }
+            }
+            from = at + 2;
+        }
+        self.pos = html.len;
+        return html[start..];
+    }
+
+    /// End of a comment, CDATA section, doctype or processing instruction
+    /// opening at `start`, or null if the '<' opens something else.
+    fn markupEnd(self: *Tokenizer, start: usize) ?usize {
+        const html = self.html;
+        const rest = html[start + 1 ..];
+        if (std.mem.startsWith(u8, rest, "!--")) {
+            // "-->", "--!>", and the abrupt "<!-->" / "<!--->"
+            if (start < self.comment_unclosed) {
+                if (pastClose(html, start + 2, start + 4, &.{ "--", "--!" })) |end| return end;
+                self.comment_unclosed = start;
+            }
+            const gt = self.nextGt(start + 4) orelse return null;
+            return gt + 1;
+        }
+        if (std.mem.startsWith(u8, rest, "![CDATA[")) {
+            if (start < self.cdata_unclosed) {
+                if (pastClose(html, start + 9, start + 9, &.{"]]"})) |end| return end;
+                self.cdata_unclosed = start;
+            }
+            const gt = self.nextGt(start + 9) orelse return null;
+            return gt + 1;
+        }
+        if (rest.len > 0 and (rest[0] == '!' or rest[0] == '?')) {
+            // <!DOCTYPE ...>, <?xml ...?> and other bogus comments end at '>'
+            const gt = self.nextGt(start + 2) orelse return html.len;
+            return gt + 1;
+        }
+        return null;
+    }
+
+    /// Position of the first '>' at or after `from`. A failed search is
+    /// remembered, so a page of unterminated tags is not rescanned.
+    fn nextGt(self: *Tokenizer, from: usize) ?usize {
+        if (from >= self.gt_none) return null;
+        return std.mem.indexOfScalarPos(u8, self.html, from, '>') orelse {
+            self.gt_none = from;
+            return null;
+        };
+    }
+};
+
+/// Position just past the first '>' at or after `from` that is preceded
+/// by one of `closers`; the lookbehind never reaches before `floor`.
+/// Where there is none, callers end an unterminated comment or CDATA
+/// section at the next '>', so a stray "<!--" inside a script cannot
+/// swallow the rest of the page.
+fn pastClose(html: []const u8, floor: usize, from: usize, comptime closers: []const []const u8) ?usize {
+    var pos = from;
+    while (std.mem.indexOfScalarPos(u8, html, pos, '>')) |gt| {
+        inline for (closers) |closer| {
+            if (std.mem.endsWith(u8, html[floor..gt], closer)) return gt + 1;
+        }
+        pos = gt + 1;
+    }
+    return null;
+}
+
+/// Tag name at the start of the content between '<' and '>'.
+pub fn tagName(tag_content: []const u8) []const u8 {
+    // Find end of tag name (space, /, or end)
+    var end: usize = 0;
+    while (end < tag_content.len) {
+        const c = tag_content[end];
+        if (c == ' ' or c == '\t' or c == '\n' or c == '/' or c == '>') {
+            break;
+        }
+        end += 1;
+    }
+    return tag_content[0..end];
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "tags and text runs" {
+    var tokens = Tokenizer.init("<p class=x>Hi <b>there</b></p>");
+
+    const p = tokens.next().?;
+    try std.testing.expectEqualStrings("p", p.start_tag.name);
+    try std.testing.expectEqualStrings("<p class=x>", p.start_tag.raw);
+    try std.testing.expectEqualStrings("Hi ", tokens.next().?.text);
+    try std.testing.expectEqualStrings("b", tokens.next().?.start_tag.name);
+    try std.testing.expectEqualStrings("there", tokens.next().?.text);
+    try std.testing.expectEqualStrings("b", tokens.next().?.end_tag.name);
+    try std.testing.expectEqualStrings("p", tokens.next().?.end_tag.name);
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "self-closing tag name stops at slash" {
+    var tokens = Tokenizer.init("<br/>");
+    try std.testing.expectEqualStrings("br", tokens.next().?.start_tag.name);
+}
+
+test "unterminated tag drops the angle bracket" {
+    var tokens = Tokenizer.init("a < b");
+    try std.testing.expectEqualStrings("a ", tokens.next().?.text);
+    try std.testing.expectEqualStrings(" b", tokens.next().?.text);
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "comments containing '>' do not leak" {
+    var tokens = Tokenizer.init("a<!-- x > y -- > z -->b<!---->c<!-- -- --!>d");
+    try std.testing.expectEqualStrings("a", tokens.next().?.text);
+    try std.testing.expectEqualStrings("b", tokens.next().?.text);
+    try std.testing.expectEqualStrings("c", tokens.next().?.text);
+    try std.testing.expectEqualStrings("d", tokens.next().?.text);
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "abruptly closed comments" {
+    var tokens = Tokenizer.init("<!-->a<!--->b");
+    try std.testing.expectEqualStrings("a", tokens.next().?.text);
+    try std.testing.expectEqualStrings("b", tokens.next().?.text);
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "doctype, processing instructions and CDATA produce no tokens" {
+    var tokens = Tokenizer.init("<!DOCTYPE html><?xml version=\"1.0\"?><![CDATA[ <p> ]] > ]]>x<p>");
+    try std.testing.expectEqualStrings("x", tokens.next().?.text);
+    try std.testing.expectEqualStrings("p", tokens.next().?.start_tag.name);
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "raw text runs to its own end tag" {
+    var tokens = Tokenizer.init("<style>a[title=\"<\"] > b { x: 1 } </styles></STYLE >c");
+    try std.testing.expectEqualStrings("style", tokens.next().?.start_tag.name);
+    try std.testing.expectEqualStrings("a[title=\"<\"] > b { x: 1 } </styles>", tokens.rawText("style"));
+    try std.testing.expectEqualStrings("STYLE", tokens.next().?.end_tag.name);
+    try std.testing.expectEqualStrings("c", tokens.next().?.text);
+
+    tokens = Tokenizer.init("<style>a {");
+    _ = tokens.next();
+    try std.testing.expectEqualStrings("a {", tokens.rawText("style"));
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "unterminated comment ends at the next '>'" {
+    var tokens = Tokenizer.init("x <!-- y > z");
+    try std.testing.expectEqualStrings("x ", tokens.next().?.text);
+    try std.testing.expectEqualStrings(" z", tokens.next().?.text);
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "unterminated comments and CDATA fall back without rescanning" {
+    var tokens = Tokenizer.init("a<!-- b > c<![CDATA[ d > e<!-- f > g<![CDATA[ h > i");
+    for ([_][]const u8{ "a", " c", " e", " g", " i" }) |text| {
+        try std.testing.expectEqualStrings(text, tokens.next().?.text);
+    }
+    try std.testing.expect(tokens.next() == null);
+    try std.testing.expectEqual(@as(usize, 1), tokens.comment_unclosed);
+    try std.testing.expectEqual(@as(usize, 11), tokens.cdata_unclosed);
+
+    // A closer after the first opener ends it, swallowing the second
+    tokens = Tokenizer.init("<!-- a > <!-- b -->c");
+    try std.testing.expectEqualStrings("c", tokens.next().?.text);
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "comment-heavy page" {
+    const allocator = std.testing.allocator;
+    var html: std.ArrayListUnmanaged(u8) = .empty;
+    defer html.deinit(allocator);
+
+    // Commented-out markup full of '>' and '--', a huge block, many tiny ones
+    for (0..100) |n| {
+        try html.print(allocator, "<!-- <div class=\"old\">{d} -> {d} -- ></div> -->", .{ n, n });
+        try html.appendSlice(allocator, "<!---->");
+    }
+    try html.appendSlice(allocator, "<!-- ");
+    for (0..5_000) |_| try html.appendSlice(allocator, "a > b - ");
+    try html.appendSlice(allocator, "-->visible");
+
+    var tokens = Tokenizer.init(html.items);
+    try std.testing.expectEqualStrings("visible", tokens.next().?.text);
+    try std.testing.expect(tokens.next() == null);
+}
+
+test "page of unterminated comments and CDATA" {
+    const allocator = std.testing.allocator;
+    var html: std.ArrayListUnmanaged(u8) = .empty;
+    defer html.deinit(allocator);
+
+    // No "-->" or "]]>" anywhere: rescanning the rest of the page at each
+    // opener would be some 10^10 compares, where each should only cost a
+    // scan to its own '>'
+    const entries = 20_000;
+    for (0..entries) |n| {
+        try html.print(allocator, "<p>{d}</p><!-- x > y <![CDATA[ a > b ", .{n});
+    }
+
+    var tokens = Tokenizer.init(html.items);
+    var texts: usize = 0;
+    while (tokens.next()) |token| {
+        if (token == .text) texts += 1;
+    }
+    // The number, then what follows each opener's '>'
+    try std.testing.expectEqual(@as(usize, 3 * entries), texts);
+    try std.testing.expectEqual(@as(usize, "<p>0</p>".len), tokens.comment_unclosed);
+    try std.testing.expectEqual(@as(usize, "<p>0</p><!-- x > y ".len), tokens.cdata_unclosed);
+}
@@ -0,0 +1,174 @@
+//! Vulpes Browser - Whitespace Collapsing
+//!
+//! Collapses runs of HTML whitespace (space, tab, CR, LF) to a single space,
+//! as rendering does outside <pre>. Works on whole text runs: words are
+//! located with vector compares and copied as slices, so a byte is only
+//! examined individually when the vector step flags it.
+//!
+//! Pretty-printed pages are mostly indentation and minified pages are
+//! mostly long words; both reduce to a few wide compares per span.
+//!
+
+const std = @import("std");
+
+const VECTOR_LEN = std.simd.suggestVectorLength(u8) orelse 16;
+const Chunk = @Vector(VECTOR_LEN, u8);
+
+const spaces: Chunk = @splat(' ');
+
+pub fn isSpace(c: u8) bool {
+    return c == ' ' or c == '\n' or c == '\r' or c == '\t';
+}
+
+/// Append `text` to `out` with whitespace runs collapsed to one space.
+/// `last_was_space` is the state left by earlier output (true suppresses a
+/// leading space); the state after `text` is returned.
+pub fn appendCollapsed(
+    allocator: std.mem.Allocator,
+    out: *std.ArrayListUnmanaged(u8),
+    text: []const u8,
+    last_was_space: bool,
+) !bool {
+    // Collapsing never grows the text
+    try out.ensureUnusedCapacity(allocator, text.len);
+
+    var space = last_was_space;
+    var i: usize = 0;
+    while (i < text.len) {
+        const word_end = indexOfSpace(text, i);
+        if (word_end > i) {
+            out.appendSliceAssumeCapacity(text[i..word_end]);
+            space = false;
+        }
+        if (word_end == text.len) break;
+
+        if (!space) {
+            out.appendAssumeCapacity(' ');
+            space = true;
+        }
+        i = indexOfNonSpace(text, word_end + 1);
+    }
+    return space;
+}
+
+/// First whitespace byte at or after `start`, or text.len.
+fn indexOfSpace(text: []const u8, start: usize) usize {
+    var i = start;
+    while (true) {
+        // Every whitespace byte is <= ' ', so one compare flags candidates;
+        // control bytes that are not whitespace are rejected below
+        while (i + VECTOR_LEN <= text.len) : (i += VECTOR_LEN) {
+            const chunk: Chunk = text[i..][0..VECTOR_LEN].*;
+            if (std.simd.firstTrue(chunk <= spaces)) |offset| {
+                i += offset;
+                break;
+            }
+        } else {
+            while (i < text.len and !isSpace(text[i])) : (i += 1) {}
+            return i;
+        }
+        if (isSpace(text[i])) return i;
+        i += 1;
+    }
+}
+
+/// First non-whitespace byte at or after `start`, or text.len.
+fn indexOfNonSpace(text: []const u8, start: usize) usize {
+    var i = start;
+    while (i < text.len) {
+        // Indentation is nearly all spaces: skip those a vector at a time
+        if (i + VECTOR_LEN <= text.len) {
+            const chunk: Chunk = text[i..][0..VECTOR_LEN].*;
+            const offset = std.simd.firstTrue(chunk != spaces) orelse {
+                i += VECTOR_LEN;
+                continue;
+            };
+            i += offset;
+        }
+        if (!isSpace(text[i])) return i;
+        i += 1;
+    }
+    return i;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+/// Byte-at-a-time collapse the kernel must agree with
+fn collapseReference(allocator: std.mem.Allocator, text: []const u8, last_was_space: bool) ![]u8 {
+    var out: std.ArrayListUnmanaged(u8) = .empty;
+    errdefer out.deinit(allocator);
+    var space = last_was_space;
+    for (text) |c| {
+        if (isSpace(c)) {
+            if (!space) try out.append(allocator, ' ');
+            space = true;
+        } else {
+            try out.append(allocator, c);
+            space = false;
+        }
+    }
+    return out.toOwnedSlice(allocator);
+}
+
+fn expectMatchesReference(text: []const u8, last_was_space: bool) !void {
+    const allocator = std.testing.allocator;
+    const expected = try collapseReference(allocator, text, last_was_space);
+    defer allocator.free(expected);
+
+    var out: std.ArrayListUnmanaged(u8) = .empty;
+    defer out.deinit(allocator);
+    const space = try appendCollapsed(allocator, &out, text, last_was_space);
+
+    try std.testing.expectEqualStrings(expected, out.items);
+    const expected_space = if (text.len == 0) last_was_space else isSpace(text[text.len - 1]);
+    try std.testing.expectEqual(expected_space, space);
+}
+
+test "collapses runs to one space" {
+    const allocator = std.testing.allocator;
+    var out: std.ArrayListUnmanaged(u8) = .empty;
+    defer out.deinit(allocator);
+
+    const space = try appendCollapsed(allocator, &out, "  hello \n\t world  ", true);
+    try std.testing.expectEqualStrings("hello world ", out.items);
+    try std.testing.expect(space);
+}
+
+test "state carries across runs" {
+    const allocator = std.testing.allocator;
+    var out: std.ArrayListUnmanaged(u8) = .empty;
+    defer out.deinit(allocator);
+
+    var space = try appendCollapsed(allocator, &out, "a ", false);
+    space = try appendCollapsed(allocator, &out, "  b", space);
+    try std.testing.expectEqualStrings("a b", out.items);
+    try std.testing.expect(!space);
+}
+
+test "control bytes are not whitespace" {
+    try expectMatchesReference("a\x01b\x1e1\x1e c" ++ " " ** 40 ++ "\x02d", false);
+}
+
+test "agrees with byte-at-a-time collapse across vector boundaries" {
+    const pieces = [_][]const u8{ "word", " ", "\n", "    ", "\t\t", "\r\n", "x", "longerwordthatspansavector" };
+    var buf: [512]u8 = undefined;
+    var prng = std.Random.DefaultPrng.init(0x5eed);
+    const random = prng.random();
+
+    for (0..200) |_| {
+        var len: usize = 0;
+        while (true) {
+            const piece = pieces[random.uintLessThan(usize, pieces.len)];
+            if (len + piece.len > buf.len) break;
+            @memcpy(buf[len..][0..piece.len], piece);
+            len += piece.len;
+            if (random.uintLessThan(u8, 16) == 0) break;
+        }
+        try expectMatchesReference(buf[0..len], random.boolean());
+    }
+    try expectMatchesReference("", true);
+    try expectMatchesReference(" " ** 100, false);
+    try expectMatchesReference("x" ** 100, true);
+}
@@ -0,0 +1,377 @@
+//! Vulpes Browser - Hyphenation
+//!
+//! Liang's algorithm over TeX hyphenation patterns, so long words can
+//! break across lines in narrow columns. The patterns (hyph-en-us.tex)
+//! are embedded and compiled at comptime into a packed trie: the
+//! transitions of every state share one array of slots, each state's
+//! starting at a base offset of its own, so a step is one indexed load
+//! and a check of the slot's letter.
+//!
+//! The file's exception words go into the same trie as whole-word
+//! patterns of level 10 (no break) and 11 (break), which override every
+//! pattern and need no second lookup.
+//!
+//! A Hyphenator remembers the break points of each word it has seen, so
+//! a word repeated through a page is hyphenated once.
+//!
+
+const std = @import("std");
+
+const PATTERNS = @embedFile("hyph-en-us.tex");
+
+/// Letters kept before the first hyphen and after the last
+/// (\lefthyphenmin and \righthyphenmin)
+const LEFT_MIN = 2;
+const RIGHT_MIN = 3;
+
+/// Longest word hyphenated; longer ones are left whole
+pub const MAX_WORD = 63;
+
+/// Words remembered before a Hyphenator starts over
+const MAX_CACHED = 16 * 1024;
+
+/// Break points of a word: bit i set means a hyphen may go before letter i
+pub const Points = u64;
+
+/// Trie letter codes: 1 to 26 for a to z, then the word edge '.'
+const EDGE = 27;
+
+const Slot = struct {
+    /// Letter code of the transition that lands here; 0 if free
+    char: u8 = 0,
+    /// Base of the state reached, 0 if it has no transitions
+    next: u16 = 0,
+    /// Levels of the pattern that ends here, as an index + 1 into `levels`
+    levels: u16 = 0,
+};
+
+const Trie = struct {
+    slots: []const Slot,
+    /// Each pattern's levels, one before each letter and one after the last
+    levels: []const u8,
+};
+
+const trie: Trie = comptime build: {
+    var builder: Builder = .{};
+    builder.parse(PATTERNS);
+    break :build builder.pack();
+};
+
+/// Break points of a word in lowercase ASCII letters, from the patterns
+/// alone. Other words have none.
+pub fn breakPoints(word: []const u8) Points {
+    if (word.len < LEFT_MIN + RIGHT_MIN or word.len > MAX_WORD) return 0;
+    var codes: [MAX_WORD + 2]u8 = undefined;
+    codes[0] = EDGE;
+    for (word, 1..) |c, i| {
+        if (c < 'a' or c > 'z') return 0;
+        codes[i] = c - 'a' + 1;
+    }
+    codes[word.len + 1] = EDGE;
+    const text = codes[0 .. word.len + 2];
+
+    // level[k]: the highest level before text[k] of any pattern matched
+    var level = [_]u8{0} ** (MAX_WORD + 3);
+    for (0..text.len) |start| {
+        var base: usize = 0;
+        for (text[start..], start..) |c, i| {
+            if (base + c >= trie.slots.len) break;
+            const slot = trie.slots[base + c];
+            if (slot.char != c) break;
+            if (slot.levels != 0) {
+                const levels = trie.levels[slot.levels - 1 ..][0 .. i - start + 2];
+                for (levels, level[start..][0..levels.len]) |from, *to| to.* = @max(to.*, from);
+            }
+            if (slot.next == 0) break;
+            base = slot.next;
+        }
+    }
+
+    // Odd levels allow a break; text[i + 1] is the word's letter i
+    var points: Points = 0;
+    for (LEFT_MIN..word.len - RIGHT_MIN + 1) |i| {
+        if (level[i + 1] % 2 == 1) points |= @as(Points, 1) << @intCast(i);
+    }
+    return points;
+}
+
+/// Hyphenates words through a cache of their break points
+pub const Hyphenator = struct {
+    allocator: std.mem.Allocator,
+    /// Break points by lowercase spelling
+    cache: std.StringHashMapUnmanaged(Points) = .empty,
+
+    pub fn init(allocator: std.mem.Allocator) Hyphenator {
+        return .{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *Hyphenator) void {
+        self.clear();
+        self.cache.deinit(self.allocator);
+    }
+
+    /// Break points of an ASCII word in any case
+    pub fn hyphenate(self: *Hyphenator, word: []const u8) !Points {
+        if (word.len < LEFT_MIN + RIGHT_MIN or word.len > MAX_WORD) return 0;
+        var buffer: [MAX_WORD]u8 = undefined;
+        const lower = std.ascii.lowerString(&buffer, word);
+        if (self.cache.get(lower)) |cached| return cached;
+
+        const found = breakPoints(lower);
+        if (self.cache.count() >= MAX_CACHED) self.clear();
+        const key = try self.allocator.dupe(u8, lower);
+        errdefer self.allocator.free(key);
+        try self.cache.put(self.allocator, key, found);
+        return found;
+    }
+
+    fn clear(self: *Hyphenator) void {
+        var keys = self.cache.keyIterator();
+        while (keys.next()) |key| self.allocator.free(key.*);
+        self.cache.clearRetainingCapacity();
+    }
+};
+
+// =============================================================================
+// Comptime pattern compiler
+// =============================================================================
+
+const MAX_NODES = 1 << 15;
+const MAX_SLOTS = 1 << 16;
+
+/// A plain trie of the patterns, children as linked lists, packed into
+/// slots once every pattern is in
+const Builder = struct {
+    first_child: [MAX_NODES]u16 = [_]u16{0} ** MAX_NODES,
+    sibling: [MAX_NODES]u16 = [_]u16{0} ** MAX_NODES,
+    char: [MAX_NODES]u8 = [_]u8{0} ** MAX_NODES,
+    /// Pattern ending at each node, as Slot.levels
+    pattern: [MAX_NODES]u16 = [_]u16{0} ** MAX_NODES,
+    node_count: usize = 1,
+    levels: [MAX_SLOTS]u8 = undefined,
+    levels_len: usize = 0,
+
+    /// Read the \patterns and \hyphenation groups of a TeX pattern file
+    fn parse(self: *Builder, source: []const u8) void {
+        @setEvalBranchQuota(100_000_000);
+        var group: enum { none, patterns, exceptions } = .none;
+        var lines = std.mem.splitScalar(u8, source, '\n');
+        while (lines.next()) |full_line| {
+            const line = full_line[0 .. std.mem.indexOfScalar(u8, full_line, '%') orelse full_line.len];
+            var tokens = std.mem.tokenizeAny(u8, line, " \t\r");
+            while (tokens.next()) |token| {
+                if (std.mem.startsWith(u8, token, "\\patterns")) {
+                    group = .patterns;
+                } else if (std.mem.startsWith(u8, token, "\\hyphenation")) {
+                    group = .exceptions;
+                } else if (std.mem.eql(u8, token, "}")) {
+                    group = .none;
+                } else switch (group) {
+                    .patterns => self.addPattern(token),
+                    .exceptions => self.addException(token),
+                    .none => {},
+                }
+            }
+        }
+    }
+
+    /// A pattern such as "hy3ph": letters, with a level before any of
+    /// them or after the last
+    fn addPattern(self: *Builder, token: []const u8) void {
+        var letters: [MAX_WORD + 2]u8 = undefined;
+        var levels = [_]u8{0} ** (MAX_WORD + 3);
+        var len: usize = 0;
+        for (token) |c| {
+            switch (c) {
+                '0'...'9' => levels[len] = c - '0',
+                'a'...'z' => {
+                    letters[len] = c - 'a' + 1;
+                    len += 1;
+                },
+                '.' => {
+                    letters[len] = EDGE;
+                    len += 1;
+                },
+                else => @compileError("unexpected character in hyphenation pattern " ++ token),
+            }
+        }
+        self.insert(letters[0..len], levels[0 .. len + 1]);
+    }
+
+    /// An exception such as "as-so-ciate", as the pattern ".a10s11s10o..."
+    /// with a break level between every two letters
+    fn addException(self: *Builder, token: []const u8) void {
+        var letters: [MAX_WORD + 2]u8 = undefined;
+        var levels = [_]u8{0} ** (MAX_WORD + 3);
+        letters[0] = EDGE;
+        var len: usize = 1;
+        var hyphen = false;
+        for (token) |c| {
+            switch (c) {
+                '-' => hyphen = true,
+                'a'...'z' => {
+                    if (len > 1) levels[len] = if (hyphen) 11 else 10;
+                    letters[len] = c - 'a' + 1;
+                    len += 1;
+                    hyphen = false;
+                },
+                else => @compileError("unexpected character in hyphenation exception " ++ token),
+            }
+        }
+        letters[len] = EDGE;
+        len += 1;
+        self.insert(letters[0..len], levels[0 .. len + 1]);
+    }
+
+    fn insert(self: *Builder, letters: []const u8, levels: []const u8) void {
+        var node: usize = 0;
+        for (letters) |c| {
+            var child: usize = self.first_child[node];
+            while (child != 0 and self.char[child] != c) child = self.sibling[child];
+            if (child == 0) {
+                if (self.node_count == MAX_NODES) @compileError("too many hyphenation trie nodes");
+                child = self.node_count;
+                self.node_count += 1;
+                self.char[child] = c;
+                self.sibling[child] = self.first_child[node];
+                self.first_child[node] = @intCast(child);
+            }
+            node = child;
+        }
+        if (self.levels_len + levels.len >= MAX_SLOTS) @compileError("too many hyphenation levels");
+        @memcpy(self.levels[self.levels_len..][0..levels.len], levels);
+        self.pattern[node] = @intCast(self.levels_len + 1);
+        self.levels_len += levels.len;
+    }
+
+    /// Place each state's transitions at the lowest base where they all
+    /// land in free slots. No two states share a base, so a slot's letter
+    /// tells whose transition it is.
+    fn pack(self: *Builder) Trie {
+        @setEvalBranchQuota(100_000_000);
+        var slots = [_]Slot{.{}} ** MAX_SLOTS;
+        var taken = [_]bool{false} ** MAX_SLOTS;
+        var base = [_]u16{0} ** MAX_NODES;
+        // free_after[i] leads towards the first free slot from i on
+        var free_after: [MAX_SLOTS + 1]u32 = undefined;
+        for (&free_after, 0..) |*next, i| next.* = @intCast(i);
+        var len: usize = 0;
+
+        for (0..self.node_count) |node| {
+            if (self.first_child[node] == 0) continue;
+            var lowest: u8 = EDGE;
+            var child: usize = self.first_child[node];
+            while (child != 0) : (child = self.sibling[child]) lowest = @min(lowest, self.char[child]);
+
+            // Try the bases that put the lowest letter in each free slot in
+            // turn. The root sits at 0; every other base is nonzero, as 0
+            // means "no transitions".
+            var candidate: usize = 0;
+            if (node != 0) {
+                var free = firstFree(&free_after, 1);
+                while (true) : (free = firstFree(&free_after, free + 1)) {
+                    if (free + EDGE >= MAX_SLOTS) @compileError("hyphenation trie does not fit its slots");
+                    if (free <= lowest) continue;
+                    candidate = free - lowest;
+                    if (taken[candidate]) continue;
+                    child = self.first_child[node];
+                    const fits = while (child != 0) : (child = self.sibling[child]) {
+                        if (slots[candidate + self.char[child]].char != 0) break false;
+                    } else true;
+                    if (fits) break;
+                }
+            }
+
+            taken[candidate] = true;
+            base[node] = @intCast(candidate);
+            child = self.first_child[node];
+            while (child != 0) : (child = self.sibling[child]) {
+                const index = candidate + self.char[child];
+                slots[index].char = self.char[child];
+                free_after[index] = @intCast(index + 1);
+                len = @max(len, index + 1);
+            }
+        }
+
+        for (0..self.node_count) |node| {
+            var child: usize = self.first_child[node];
+            while (child != 0) : (child = self.sibling[child]) {
+                const slot = &slots[base[node] + self.char[child]];
+                slot.next = base[child];
+                slot.levels = self.pattern[child];
+            }
+        }
+
+        const packed_slots = slots[0..len].*;
+        const packed_levels = self.levels[0..self.levels_len].*;
+        return .{ .slots = &packed_slots, .levels = &packed_levels };
+    }
+
+    /// The first free slot from `from` on, shortening the path there
+    fn firstFree(free_after: []u32, from: usize) usize {
+        var found: usize = from;
+        while (free_after[found] != found) found = free_after[found];
+        var i = from;
+        while (free_after[i] != found) {
+            const next = free_after[i];
+            free_after[i] = @intCast(found);
+            i = next;
+        }
+        return found;
+    }
+};
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+const testing = std.testing;
+
+/// `word` with a hyphen at each break point
+fn expectHyphenated(expected: []const u8, word: []const u8) !void {
+    const points = breakPoints(word);
+    var buffer: [2 * MAX_WORD]u8 = undefined;
+    var len: usize = 0;
+    for (word, 0..) |c, i| {
+        if (points & (@as(Points, 1) << @intCast(i)) != 0) {
+            buffer[len] = '-';
+            len += 1;
+        }
+        buffer[len] = c;
+        len += 1;
+    }
+    try testing.expectEqualStrings(expected, buffer[0..len]);
+}
+
+test "patterns" {
+    try expectHyphenated("hy-phen-a-tion", "hyphenation");
+    try expectHyphenated("al-go-rithm", "algorithm");
+    try expectHyphenated("type-set-ting", "typesetting");
+    try expectHyphenated("con-cate-na-tion", "concatenation");
+    try expectHyphenated("para-graph", "paragraph");
+    try expectHyphenated("ta-ble", "table");
+    // TeX's own famous miss
+    try expectHyphenated("com-puter", "computer");
+}
+
+test "exceptions override the patterns" {
+    try expectHyphenated("as-so-ciate", "associate");
+    try expectHyphenated("project", "project");
+    try expectHyphenated("present", "present");
+}
+
+test "short and foreign words stay whole" {
+    try testing.expectEqual(@as(Points, 0), breakPoints("bet"));
+    try testing.expectEqual(@as(Points, 0), breakPoints("naïve"));
+    try testing.expectEqual(@as(Points, 0), breakPoints("x86-64"));
+    try testing.expectEqual(@as(Points, 0), breakPoints("a" ** (MAX_WORD + 1)));
+}
+
+test "the cache" {
+    var hyphenator = Hyphenator.init(testing.allocator);
+    defer hyphenator.deinit();
+    const points = try hyphenator.hyphenate("Hyphenation");
+    try testing.expectEqual(breakPoints("hyphenation"), points);
+    try testing.expectEqual(points, try hyphenator.hyphenate("HYPHENATION"));
+    try testing.expectEqual(@as(u32, 1), hyphenator.cache.count());
+}
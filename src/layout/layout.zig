@@ -0,0 +1,1336 @@
+//! Vulpes Browser - Text Layout
+//!
+//! Breaks extracted text (see text_extractor.zig) into positioned line
+//! boxes for the text view. The view used to do this itself while building
+//! vertices, measuring every glyph again on every redraw; now the engine
+//! lays the page out and the view only turns runs into glyph quads.
+//!
+//! Layout has two stages:
+//!   - itemize: the text's markers become blocks (paragraphs, preformatted
+//!     lines, table rows, images) made of pieces, spans of text in one
+//!     style, measured once through the host's Metrics. Pieces end at
+//!     spaces and at the other break opportunities of linebreak.zig;
+//!   - flow: blocks are broken into lines at the viewport width and
+//!     stacked, giving line boxes, glyph runs (pieces placed on a line)
+//!     and image boxes.
+//! Pieces keep their widths, so flowing again at another width measures
+//! nothing. Each paragraph also remembers the range of widths its line
+//! breaks hold for; while a resize stays inside it, the paragraph's boxes
+//! are copied from the last flow and only moved down or up.
+//!
+//! With hyphenation on, words of running text are also cut into pieces at
+//! their hyphenation points (hyphenation.zig), each of which a line may
+//! end after with a hyphen drawn.
+//!
+//! Positions are in the units of the metrics (device pixels in the app),
+//! with y growing down from the top of the page.
+//!
+
+const std = @import("std");
+const metrics = @import("metrics.zig");
+const linebreak = @import("linebreak.zig");
+const segment = @import("segment.zig");
+const hyphenation = @import("hyphenation.zig");
+
+const Font = metrics.Font;
+const FontMetrics = metrics.FontMetrics;
+const Metrics = metrics.Metrics;
+
+/// Text extractor markers (see text_extractor.zig)
+const LINK_START: u8 = 0x01;
+const LINK_END: u8 = 0x02;
+const PRE_START: u8 = 0x03;
+const PRE_END: u8 = 0x04;
+const TABLE_START: u8 = 0x05;
+const TABLE_END: u8 = 0x06;
+const EMPH_START: u8 = 0x11;
+const EMPH_END: u8 = 0x12;
+const STRONG_START: u8 = 0x13;
+const STRONG_END: u8 = 0x14;
+const CODE_START: u8 = 0x15;
+const CODE_END: u8 = 0x16;
+const QUOTE_START: u8 = 0x17;
+const QUOTE_END: u8 = 0x18;
+const H1_START: u8 = 0x19;
+const H4_START: u8 = 0x1C;
+const HEADING_END: u8 = 0x1D;
+const IMAGE_MARKER: u8 = 0x1E;
+const CELL_SEP: u8 = 0x1F;
+
+/// Tab stops in preformatted text, in spaces
+const TAB_WIDTH = 4;
+
+/// Space between table columns, in spaces
+const COLUMN_GAP = 2;
+
+/// Aspect ratio of an image whose size is not known yet
+const DEFAULT_ASPECT: f32 = 4.0 / 3.0;
+
+/// Total-fit breaking: room, in ems, a ragged line may leave before it is
+/// as bad as a justified line stretched to its limit (as TeX's ragged
+/// right)
+const RAGGED_STRETCH = 2;
+/// Demerits every line carries, so fewer lines win a tie
+const LINE_PENALTY = 10;
+/// Demerits of a word too wide for any line, on a line of its own
+const OVERFULL_DEMERITS = 1e30;
+/// Most line starts total-fit breaking weighs at once. Lines already too
+/// long are dropped first; past this the worst start goes, so a paragraph
+/// costs at most this much per word.
+const MAX_ACTIVE = 64;
+/// Demerits, squared, of a line ending in a hyphen (TeX's \hyphenpenalty)
+const HYPHEN_PENALTY = 50;
+/// Widths a paragraph keeps its total-fit breaks for, so a window dragged
+/// back and forth between a few sizes only searches each once
+const RECENT_FITS = 4;
+
+pub const Flags = packed struct(u8) {
+    link: bool = false,
+    emphasis: bool = false,
+    strong: bool = false,
+    code: bool = false,
+    /// The run ends its line inside a word: a hyphen is drawn after it
+    hyphen: bool = false,
+    _: u3 = 0,
+};
+
+/// Text in one style placed on a line. Glyphs start at `x` on the line's
+/// baseline; mirrors vulpes_glyph_run_t.
+pub const Run = extern struct {
+    x: f32,
+    width: f32,
+    /// Byte range in the laid-out text
+    start: u32,
+    len: u32,
+    font: Font,
+    flags: Flags,
+    /// Link number, counting from 0, when flags.link is set
+    link: u16,
+};
+
+/// Mirrors vulpes_line_box_t
+pub const Line = extern struct {
+    /// Top of the line box
+    y: f32,
+    height: f32,
+    baseline: f32,
+    /// The line's runs, left to right
+    first_run: u32,
+    run_count: u32,
+};
+
+/// Mirrors vulpes_image_box_t
+pub const ImageBox = extern struct {
+    /// Index into the extraction's image table
+    image: u32,
+    x: f32,
+    y: f32,
+    width: f32,
+    height: f32,
+};
+
+/// What the host knows about an image before it loads; mirrors
+/// vulpes_layout_image_t
+pub const ImageHint = extern struct {
+    /// Natural width, 0 if unknown
+    width: f32 = 0,
+    /// Width / height, 0 if unknown
+    aspect_ratio: f32 = 0,
+};
+
+/// Boxes that meet a band of the page, as index ranges into the lines,
+/// runs and images; mirrors vulpes_layout_range_t
+pub const Range = extern struct {
+    first_line: u32 = 0,
+    line_count: u32 = 0,
+    first_run: u32 = 0,
+    run_count: u32 = 0,
+    first_image: u32 = 0,
+    image_count: u32 = 0,
+};
+
+/// How paragraphs are broken into lines
+pub const Breaking = enum(u8) {
+    /// Each line takes words while they fit
+    greedy,
+    /// Knuth-Plass total fit: the breaks that leave the least ragged
+    /// paragraph, at some cost per resize
+    optimal,
+};
+
+pub const Options = struct {
+    /// Viewport width
+    width: f32 = 1024,
+    margin: f32 = 20,
+    /// Indent per blockquote level
+    quote_indent: f32 = 24,
+    /// Longest line (readable-width mode), 0 for the whole viewport
+    max_line_width: f32 = 0,
+    /// Widest an image is drawn
+    max_image_width: f32 = 400,
+    breaking: Breaking = .greedy,
+    /// Break long words of running text at their hyphenation points
+    /// (English patterns)
+    hyphenate: bool = false,
+    /// One per entry of the image table; image markers past the end are
+    /// skipped
+    images: []const ImageHint = &.{},
+};
+
+/// Text in one style that is measured as a whole
+const Piece = struct {
+    start: u32,
+    len: u32,
+    width: f32,
+    /// Collapsed space after the piece, or the gap a tab leaves in
+    /// preformatted text
+    space_after: f32 = 0,
+    font: Font,
+    flags: Flags,
+    link: u16,
+    /// Column in a table row
+    cell: u16 = 0,
+    /// A line may end after this piece
+    break_after: bool = false,
+    /// Width of the hyphen drawn if a line ends after this piece; 0 if the
+    /// piece does not end inside a word
+    hyphen: f32 = 0,
+};
+
+const Block = struct {
+    kind: Kind,
+    /// Span of `pieces`
+    first: u32,
+    count: u32,
+    /// Blockquote depth
+    depth: u8,
+    /// Style of an empty line
+    font: Font,
+    /// Extra space below, after a heading
+    space_after: f32 = 0,
+    /// image: its index in the image table; row: first of its table's
+    /// column offsets
+    index: u32 = 0,
+
+    /// Boxes from the last flow
+    first_line: u32 = 0,
+    line_count: u32 = 0,
+    first_run: u32 = 0,
+    run_count: u32 = 0,
+    /// Line widths the last flow's breaks hold for, [fits, overflows):
+    /// from the widest line of more than one word, up to the narrowest
+    /// width at which a line would also take the next word (total fit: the
+    /// one width it was broken at). Empty until the block is flowed.
+    fits: f32 = std.math.inf(f32),
+    overflows: f32 = -std.math.inf(f32),
+    /// Total fit: the breaks of the last few widths it was broken at,
+    /// replaced oldest first
+    recent: [RECENT_FITS]RecentFit = [_]RecentFit{.{}} ** RECENT_FITS,
+    next_recent: u8 = 0,
+
+    fn holds(self: Block, width: f32) bool {
+        return width >= self.fits and width < self.overflows;
+    }
+
+    const Kind = enum(u8) { text, preformatted, row, image };
+};
+
+/// Total-fit breaks found at one width: the piece each line after the
+/// first starts at, a span of Layout.fit_breaks. An empty slot's width
+/// is NaN, equal to no width.
+const RecentFit = struct {
+    width: f32 = std.math.nan(f32),
+    first: u32 = 0,
+    count: u32 = 0,
+};
+
+/// A word for total-fit breaking: pieces up to a break opportunity, with
+/// the paragraph's width from its start to the word's end and to the
+/// next word
+const FitWord = struct {
+    /// End of the word's pieces, exclusive
+    end: u32,
+    to_end: f64,
+    to_next: f64,
+    /// Added to a line ending after the word
+    hyphen: f64,
+};
+
+/// The best breaks found that end a line before some word
+const FitNode = struct {
+    demerits: f64,
+    /// Word the line ending here starts at
+    start: u32,
+};
+
+/// Demerits of a line `natural` wide on a measure of `width`: the room it
+/// leaves, relative to `stretch`, cubed as TeX's badness, plus the line
+/// penalty, squared; and the hyphen penalty, squared, if it ends in one
+fn lineDemerits(natural: f64, width: f64, stretch: f64, last: bool, hyphenated: bool) f64 {
+    if (natural > width) return OVERFULL_DEMERITS;
+    const ratio = (width - natural) / stretch;
+    const badness = if (last) 0 else 100 * ratio * ratio * ratio;
+    const penalty: f64 = if (hyphenated) HYPHEN_PENALTY * HYPHEN_PENALTY else 0;
+    return (LINE_PENALTY + badness) * (LINE_PENALTY + badness) + penalty;
+}
+
+pub const Layout = struct {
+    allocator: std.mem.Allocator,
+    options: Options,
+    fonts: std.EnumArray(Font, FontMetrics),
+
+    blocks: std.ArrayListUnmanaged(Block) = .empty,
+    pieces: std.ArrayListUnmanaged(Piece) = .empty,
+    /// Column offsets of every table, from the row's left edge
+    columns: std.ArrayListUnmanaged(f32) = .empty,
+
+    lines: std.ArrayListUnmanaged(Line) = .empty,
+    runs: std.ArrayListUnmanaged(Run) = .empty,
+    images: std.ArrayListUnmanaged(ImageBox) = .empty,
+    /// Bottom of the page, margin included
+    height: f32 = 0,
+    /// Blocks the last flow had to lay out again rather than copy
+    reflowed: usize = 0,
+
+    /// The flow before last, copied from by blocks whose breaks hold
+    spare_lines: std.ArrayListUnmanaged(Line) = .empty,
+    spare_runs: std.ArrayListUnmanaged(Run) = .empty,
+
+    /// Scratch for total-fit breaking, reused from paragraph to paragraph
+    fit_words: std.ArrayListUnmanaged(FitWord) = .empty,
+    fit_nodes: std.ArrayListUnmanaged(FitNode) = .empty,
+    fit_active: std.ArrayListUnmanaged(u32) = .empty,
+    /// Every block's recent total-fit breaks. Replaced spans stay until
+    /// the pool passes its limit and starts over.
+    fit_breaks: std.ArrayListUnmanaged(u32) = .empty,
+
+    /// Lay out `text` as returned by extraction. `font_metrics` is only used
+    /// during the call; `options.images` is copied.
+    pub fn init(allocator: std.mem.Allocator, text: []const u8, font_metrics: *const Metrics, options: Options) !Layout {
+        if (text.len >= std.math.maxInt(u32)) return error.TextTooLarge;
+
+        var self: Layout = .{ .allocator = allocator, .options = options, .fonts = font_metrics.fonts };
+        self.options.images = &.{};
+        errdefer self.deinit();
+        self.options.images = try allocator.dupe(ImageHint, options.images);
+
+        var hyphenator = hyphenation.Hyphenator.init(allocator);
+        defer hyphenator.deinit();
+        var itemizer: Itemizer = .{
+            .layout = &self,
+            .text = text,
+            .metrics = font_metrics,
+            .hyphenator = if (options.hyphenate) &hyphenator else null,
+        };
+        try itemizer.run();
+        try self.flow();
+        return self;
+    }
+
+    pub fn deinit(self: *Layout) void {
+        self.allocator.free(self.options.images);
+        self.blocks.deinit(self.allocator);
+        self.pieces.deinit(self.allocator);
+        self.columns.deinit(self.allocator);
+        self.lines.deinit(self.allocator);
+        self.runs.deinit(self.allocator);
+        self.images.deinit(self.allocator);
+        self.spare_lines.deinit(self.allocator);
+        self.spare_runs.deinit(self.allocator);
+        self.fit_words.deinit(self.allocator);
+        self.fit_nodes.deinit(self.allocator);
+        self.fit_active.deinit(self.allocator);
+        self.fit_breaks.deinit(self.allocator);
+    }
+
+    /// Lines, runs and images that meet [top - overscan, bottom + overscan).
+    /// Lines and images are stacked in page order, so each line's y is the
+    /// running sum of the heights above it and the band is found by binary
+    /// search: the cost depends on the band, not the page length.
+    pub fn visible(self: *const Layout, top: f32, bottom: f32, overscan: f32) Range {
+        const band_top = top - overscan;
+        const band_bottom = bottom + overscan;
+        const lines = self.lines.items;
+        const images = self.images.items;
+
+        const first_line = firstBelow(Line, lines, band_top);
+        const end_line = firstStarting(Line, lines, band_bottom);
+        const first_image = firstBelow(ImageBox, images, band_top);
+        const end_image = firstStarting(ImageBox, images, band_bottom);
+
+        var range: Range = .{
+            .first_line = @intCast(first_line),
+            .line_count = @intCast(@max(end_line, first_line) - first_line),
+            .first_image = @intCast(first_image),
+            .image_count = @intCast(@max(end_image, first_image) - first_image),
+        };
+        if (range.line_count > 0) {
+            const last = lines[first_line + range.line_count - 1];
+            range.first_run = lines[first_line].first_run;
+            range.run_count = last.first_run + last.run_count - range.first_run;
+        }
+        return range;
+    }
+
+    /// Index of the first box whose bottom is below `y`
+    fn firstBelow(comptime Box: type, boxes: []const Box, y: f32) usize {
+        var low: usize = 0;
+        var high = boxes.len;
+        while (low < high) {
+            const mid = low + (high - low) / 2;
+            if (boxes[mid].y + boxes[mid].height > y) high = mid else low = mid + 1;
+        }
+        return low;
+    }
+
+    /// Index of the first box that starts at or below `y`
+    fn firstStarting(comptime Box: type, boxes: []const Box, y: f32) usize {
+        var low: usize = 0;
+        var high = boxes.len;
+        while (low < high) {
+            const mid = low + (high - low) / 2;
+            if (boxes[mid].y >= y) high = mid else low = mid + 1;
+        }
+        return low;
+    }
+
+    /// Flow again for a new viewport width or readable-width cap. Only
+    /// paragraphs whose breaks move at the new width are broken again.
+    pub fn resize(self: *Layout, width: f32, max_line_width: f32) !void {
+        self.options.width = width;
+        self.options.max_line_width = max_line_width;
+        try self.flow();
+    }
+
+    fn contentWidth(self: *const Layout) f32 {
+        const viewport = self.options.width - self.options.margin * 2;
+        if (self.options.max_line_width > 0) return @min(viewport, self.options.max_line_width);
+        return viewport;
+    }
+
+    /// Break every block into lines and stack them
+    fn flow(self: *Layout) !void {
+        // The last flow's boxes stay readable for blocks that copy them
+        std.mem.swap(std.ArrayListUnmanaged(Line), &self.lines, &self.spare_lines);
+        std.mem.swap(std.ArrayListUnmanaged(Run), &self.runs, &self.spare_runs);
+        self.lines.clearRetainingCapacity();
+        self.runs.clearRetainingCapacity();
+        self.images.clearRetainingCapacity();
+        self.reflowed = 0;
+        // A flow cut short leaves blocks pointing at boxes it never wrote
+        errdefer self.forgetBreaks();
+
+        const margin = self.options.margin;
+        const right = margin + self.contentWidth();
+        var y = margin;
+        for (self.blocks.items) |*block| {
+            const left = margin + self.options.quote_indent * @as(f32, @floatFromInt(block.depth));
+            const width = @max(right - left, 1);
+            const first_line = self.lines.items.len;
+            const first_run = self.runs.items.len;
+            if (block.holds(width)) {
+                y = try self.copyBoxes(block.*, y);
+            } else {
+                self.reflowed += 1;
+                y = switch (block.kind) {
+                    .text => switch (self.options.breaking) {
+                        .greedy => try self.flowText(block, left, width, y),
+                        .optimal => try self.flowOptimal(block, left, width, y),
+                    },
+                    .preformatted => try self.flowPreformatted(block, left, y),
+                    .row => try self.flowRow(block, left, y),
+                    .image => try self.flowImage(block.*, left, width, y),
+                };
+            }
+            block.first_line = @intCast(first_line);
+            block.line_count = @intCast(self.lines.items.len - first_line);
+            block.first_run = @intCast(first_run);
+            block.run_count = @intCast(self.runs.items.len - first_run);
+            y += block.space_after;
+        }
+        self.height = y + margin;
+    }
+
+    /// Make every block lay out again on the next flow
+    fn forgetBreaks(self: *Layout) void {
+        for (self.blocks.items) |*block| block.fits = std.math.inf(f32);
+    }
+
+    /// The block's boxes from the last flow, moved to start at `y`
+    fn copyBoxes(self: *Layout, block: Block, y: f32) !f32 {
+        if (block.line_count == 0) return y;
+        const lines = self.spare_lines.items[block.first_line..][0..block.line_count];
+        const first_run: u32 = @intCast(self.runs.items.len);
+        const dy = y - lines[0].y;
+        for (lines) |line| {
+            var moved = line;
+            moved.y += dy;
+            moved.baseline += dy;
+            moved.first_run = line.first_run - block.first_run + first_run;
+            try self.lines.append(self.allocator, moved);
+        }
+        try self.runs.appendSlice(self.allocator, self.spare_runs.items[block.first_run..][0..block.run_count]);
+        const last = lines[lines.len - 1];
+        return last.y + last.height + dy;
+    }
+
+    /// Greedy breaking: each line takes words while they fit, with the
+    /// hyphen a word ending inside a longer one would need. A word too wide
+    /// for any line overflows on a line of its own.
+    fn flowText(self: *Layout, block: *Block, left: f32, width: f32, top: f32) !f32 {
+        const pieces = self.pieces.items[block.first..][0..block.count];
+        var y = top;
+        var line_start: usize = 0;
+        // Line width up to the last word, and the space before the next
+        var x: f32 = 0;
+        var space: f32 = 0;
+        var hyphen: f32 = 0;
+        var words: usize = 0;
+        // Widths these breaks hold for
+        var fits = -std.math.inf(f32);
+        var overflows = std.math.inf(f32);
+        var i: usize = 0;
+        while (i < pieces.len) {
+            // A word runs to the next break opportunity
+            var end = i;
+            var word = pieces[i].width;
+            while (!pieces[end].break_after and end + 1 < pieces.len) {
+                end += 1;
+                word += pieces[end].width;
+            }
+
+            if (words > 0 and x + space + word + pieces[end].hyphen > width) {
+                overflows = @min(overflows, x + space + word + pieces[end].hyphen);
+                if (words > 1) fits = @max(fits, x + hyphen);
+                y = try self.placeLine(pieces[line_start..i], block.font, left, y);
+                line_start = i;
+                x = 0;
+                space = 0;
+                words = 0;
+            }
+            x += space + word;
+            space = pieces[end].space_after;
+            hyphen = pieces[end].hyphen;
+            words += 1;
+            i = end + 1;
+        }
+        if (words > 1) fits = @max(fits, x);
+        block.fits = fits;
+        block.overflows = overflows;
+        return self.placeLine(pieces[line_start..], block.font, left, y);
+    }
+
+    /// Knuth-Plass total fit for ragged-right text: of all the ways to
+    /// break the paragraph, the one with the least total demerits, where a
+    /// line's demerits grow with the cube of the room it leaves (the last
+    /// line's room is free). Candidate line starts are kept in an active
+    /// list; a start drops out once a line from it no longer fits, which
+    /// keeps the work near linear in the words.
+    ///
+    /// The result depends on the exact width, so it holds only for that
+    /// width: flowing again at it copies the boxes. The breaks of the last
+    /// RECENT_FITS widths are kept, and a width among them places its
+    /// lines without searching; any other width breaks again. A paragraph
+    /// that fits on one line is flowed greedily, which holds for every
+    /// wider width too.
+    fn flowOptimal(self: *Layout, block: *Block, left: f32, width: f32, top: f32) !f32 {
+        for (block.recent) |recent| {
+            if (recent.width == width) {
+                return self.placeBreaks(block, self.fit_breaks.items[recent.first..][0..recent.count], left, width, top);
+            }
+        }
+
+        const pieces = self.pieces.items[block.first..][0..block.count];
+        const words = &self.fit_words;
+        words.clearRetainingCapacity();
+        var x: f64 = 0;
+        var i: usize = 0;
+        while (i < pieces.len) {
+            var end = i;
+            x += pieces[i].width;
+            while (!pieces[end].break_after and end + 1 < pieces.len) {
+                end += 1;
+                x += pieces[end].width;
+            }
+            const to_end = x;
+            x += pieces[end].space_after;
+            try words.append(self.allocator, .{ .end = @intCast(end + 1), .to_end = to_end, .to_next = x, .hyphen = pieces[end].hyphen });
+            i = end + 1;
+        }
+        const n = words.items.len;
+        if (n < 2 or words.items[n - 1].to_end <= width) return self.flowText(block, left, width, top);
+
+        const nodes = &self.fit_nodes;
+        try nodes.resize(self.allocator, n + 1);
+        @memset(nodes.items, .{ .demerits = std.math.inf(f64), .start = 0 });
+        nodes.items[0].demerits = 0;
+        const active = &self.fit_active;
+        active.clearRetainingCapacity();
+        const stretch = RAGGED_STRETCH * @as(f64, self.fonts.get(block.font).size);
+
+        for (words.items, 0..) |word, b| {
+            if (active.items.len == MAX_ACTIVE) {
+                var worst: usize = 0;
+                for (active.items, 0..) |a, j| {
+                    if (nodes.items[a].demerits > nodes.items[active.items[worst]].demerits) worst = j;
+                }
+                _ = active.orderedRemove(worst);
+            }
+            // A line may start at every word: one too wide for the
+            // line still gets one of its own
+            try active.append(self.allocator, @intCast(b));
+
+            var k: usize = 0;
+            while (k < active.items.len) {
+                const a = active.items[k];
+                const natural = word.to_end + word.hyphen - (if (a == 0) 0 else words.items[a - 1].to_next);
+                if (natural > width and a < b) {
+                    _ = active.orderedRemove(k);
+                    continue;
+                }
+                const total = nodes.items[a].demerits + lineDemerits(natural, width, stretch, b + 1 == n, word.hyphen > 0);
+                if (total < nodes.items[b + 1].demerits) nodes.items[b + 1] = .{ .demerits = total, .start = a };
+                k += 1;
+            }
+        }
+
+        // Line starts, last line first
+        active.clearRetainingCapacity();
+        var start = nodes.items[n].start;
+        while (true) {
+            try active.append(self.allocator, start);
+            if (start == 0) break;
+            start = nodes.items[start].start;
+        }
+
+        // Kept as the pieces lines after the first start at
+        const count = active.items.len - 1;
+        if (self.fit_breaks.items.len + count > 2 * RECENT_FITS * self.pieces.items.len) self.forgetFits();
+        try self.fit_breaks.ensureUnusedCapacity(self.allocator, count);
+        const first: u32 = @intCast(self.fit_breaks.items.len);
+        var line = count;
+        while (line > 0) {
+            line -= 1;
+            self.fit_breaks.appendAssumeCapacity(words.items[active.items[line] - 1].end);
+        }
+        block.recent[block.next_recent] = .{ .width = width, .first = first, .count = @intCast(count) };
+        block.next_recent = (block.next_recent + 1) % RECENT_FITS;
+        return self.placeBreaks(block, self.fit_breaks.items[first..][0..count], left, width, top);
+    }
+
+    /// Total-fit lines of the block at `width`, the lines after the first
+    /// starting at the pieces in `breaks`
+    fn placeBreaks(self: *Layout, block: *Block, breaks: []const u32, left: f32, width: f32, top: f32) !f32 {
+        const pieces = self.pieces.items[block.first..][0..block.count];
+        var y = top;
+        var first: usize = 0;
+        for (breaks) |end| {
+            y = try self.placeLine(pieces[first..end], block.font, left, y);
+            first = end;
+        }
+        y = try self.placeLine(pieces[first..], block.font, left, y);
+        block.fits = width;
+        block.overflows = std.math.nextAfter(f32, width, std.math.inf(f32));
+        return y;
+    }
+
+    /// Drop every block's recent total-fit breaks, keeping the memory
+    fn forgetFits(self: *Layout) void {
+        self.fit_breaks.clearRetainingCapacity();
+        for (self.blocks.items) |*other| {
+            other.recent = [_]RecentFit{.{}} ** RECENT_FITS;
+            other.next_recent = 0;
+        }
+    }
+
+    /// Pieces side by side from `left`, as one line
+    fn placeLine(self: *Layout, pieces: []const Piece, font: Font, left: f32, y: f32) !f32 {
+        const first = self.runs.items.len;
+        var x = left;
+        for (pieces) |piece| {
+            try self.addRun(piece, x);
+            x += piece.width + piece.space_after;
+        }
+        if (pieces.len > 0 and pieces[pieces.len - 1].hyphen > 0 and self.runs.items.len > first) {
+            self.runs.items[self.runs.items.len - 1].flags.hyphen = true;
+        }
+        return self.finishLine(first, font, y);
+    }
+
+    /// Preformatted lines are never broken, so hold at any width
+    fn flowPreformatted(self: *Layout, block: *Block, left: f32, y: f32) !f32 {
+        block.fits = -std.math.inf(f32);
+        block.overflows = std.math.inf(f32);
+        return self.placeLine(self.pieces.items[block.first..][0..block.count], block.font, left, y);
+    }
+
+    /// Cells start at their table's column offsets, or a space after the
+    /// previous cell if it overflowed its column. Rows hold at any width.
+    fn flowRow(self: *Layout, block: *Block, left: f32, y: f32) !f32 {
+        block.fits = -std.math.inf(f32);
+        block.overflows = std.math.inf(f32);
+        const first = self.runs.items.len;
+        const space = self.fonts.get(.mono).space;
+        var x = left;
+        var cell: ?u16 = null;
+        for (self.pieces.items[block.first..][0..block.count]) |piece| {
+            if (cell != piece.cell) {
+                const column = left + self.columns.items[block.index + piece.cell];
+                x = if (cell == null) column else @max(x + space, column);
+                cell = piece.cell;
+            }
+            try self.addRun(piece, x);
+            x += piece.width;
+        }
+        return self.finishLine(first, block.font, y);
+    }
+
+    /// Images keep their aspect ratio, capped to the line width and their
+    /// natural width, with half a line below
+    fn flowImage(self: *Layout, block: Block, left: f32, width: f32, y: f32) !f32 {
+        const hint = self.options.images[block.index];
+        var image_width = @min(self.options.max_image_width, width);
+        if (hint.width > 0) image_width = @min(image_width, hint.width);
+        const aspect = if (hint.aspect_ratio > 0) hint.aspect_ratio else DEFAULT_ASPECT;
+        const height = image_width / aspect;
+
+        try self.images.append(self.allocator, .{ .image = block.index, .x = left, .y = y, .width = image_width, .height = height });
+        return y + height + self.fonts.get(block.font).line_height / 2;
+    }
+
+    fn addRun(self: *Layout, piece: Piece, x: f32) !void {
+        if (piece.len == 0) return;
+        try self.runs.append(self.allocator, .{
+            .x = x,
+            .width = piece.width,
+            .start = piece.start,
+            .len = piece.len,
+            .font = piece.font,
+            .flags = piece.flags,
+            .link = piece.link,
+        });
+    }
+
+    /// Close the line holding runs from `first`. The tallest style on it
+    /// sets its height and baseline; an empty line takes `font`'s.
+    fn finishLine(self: *Layout, first: usize, font: Font, y: f32) !f32 {
+        var tallest = self.fonts.get(font);
+        if (first < self.runs.items.len) {
+            tallest = self.fonts.get(self.runs.items[first].font);
+            for (self.runs.items[first + 1 ..]) |run| {
+                const candidate = self.fonts.get(run.font);
+                if (candidate.line_height > tallest.line_height) tallest = candidate;
+            }
+        }
+
+        const leading = tallest.line_height - tallest.ascent - tallest.descent;
+        try self.lines.append(self.allocator, .{
+            .y = y,
+            .height = tallest.line_height,
+            .baseline = y + leading / 2 + tallest.ascent,
+            .first_run = @intCast(first),
+            .run_count = @intCast(self.runs.items.len - first),
+        });
+        return y + tallest.line_height;
+    }
+};
+
+/// Turns text and its markers into blocks of measured pieces
+const Itemizer = struct {
+    layout: *Layout,
+    text: []const u8,
+    metrics: *const Metrics,
+
+    flags: Flags = .{},
+    heading: ?Font = null,
+    preformatted: bool = false,
+    depth: u8 = 0,
+    /// Links seen so far
+    links: u16 = 0,
+    /// Start of the text not yet in a piece
+    pending: ?usize = null,
+    /// Break opportunities inside words, in running text
+    breaker: linebreak.Breaker = .{},
+    /// End of the grapheme cluster the breaker last saw the start of
+    cluster_end: usize = 0,
+    /// Set when words are hyphenated
+    hyphenator: ?*hyphenation.Hyphenator = null,
+    /// First piece of the open block, and its kind and depth
+    block_start: usize = 0,
+    block_kind: Block.Kind = .text,
+    block_depth: u8 = 0,
+    heading_ended: bool = false,
+
+    /// Open table: its first row block, and the cell being filled
+    table: ?usize = null,
+    cell: u16 = 0,
+    /// Inside an image marker
+    image: ?usize = null,
+
+    fn run(self: *Itemizer) !void {
+        for (self.text, 0..) |c, i| {
+            if (self.image) |start| {
+                if (c == IMAGE_MARKER) try self.addImage(self.text[start..i]);
+                continue;
+            }
+            switch (c) {
+                '\n' => {
+                    try self.flush(i);
+                    try self.endBlock();
+                    self.cell = 0;
+                    self.breaker = .{};
+                },
+                ' ', '\t' => {
+                    if (self.preformatted or self.table != null) {
+                        if (c == ' ') {
+                            if (self.pending == null) self.pending = i;
+                        } else {
+                            try self.flush(i);
+                            try self.addTab();
+                        }
+                    } else {
+                        try self.flush(i);
+                        self.addSpace();
+                        _ = self.breaker.next(' ');
+                    }
+                },
+                LINK_START, LINK_END, PRE_START, PRE_END, EMPH_START, EMPH_END, STRONG_START, STRONG_END, CODE_START, CODE_END => {
+                    try self.flush(i);
+                    self.setStyle(c);
+                },
+                H1_START...H4_START => {
+                    try self.flush(i);
+                    self.heading = @enumFromInt(@intFromEnum(Font.h1) + (c - H1_START));
+                },
+                HEADING_END => {
+                    try self.flush(i);
+                    self.heading = null;
+                    self.heading_ended = true;
+                },
+                QUOTE_START => {
+                    // A quote starts on a line of its own; text after its
+                    // end stays on the line until the next newline
+                    try self.flush(i);
+                    if (self.hasPieces()) try self.endBlock();
+                    self.depth +|= 1;
+                },
+                QUOTE_END => {
+                    try self.flush(i);
+                    self.depth -|= 1;
+                },
+                TABLE_START => {
+                    try self.flush(i);
+                    if (self.hasPieces()) try self.endBlock();
+                    self.table = self.layout.blocks.items.len;
+                    self.cell = 0;
+                },
+                TABLE_END => {
+                    try self.flush(i);
+                    if (self.hasPieces()) try self.endBlock();
+                    try self.endTable();
+                },
+                CELL_SEP => {
+                    try self.flush(i);
+                    self.cell +|= 1;
+                },
+                IMAGE_MARKER => {
+                    try self.flush(i);
+                    self.image = i + 1;
+                },
+                else => {
+                    if (c < 0x20) {
+                        // Unknown control byte: not drawn
+                        try self.flush(i);
+                        continue;
+                    }
+                    // Lines may also break inside a run of text: after a
+                    // hyphen or a URL's slash, between ideographs. Pre and
+                    // table cells keep theirs whole. The breaker sees the
+                    // first code point of each grapheme cluster, so a line
+                    // never splits one (LB9, applied to whole clusters).
+                    if (i >= self.cluster_end and !self.preformatted and self.table == null) {
+                        self.cluster_end = segment.nextGrapheme(self.text, i);
+                        const cp, _ = linebreak.decode(self.text, i);
+                        if (self.breaker.next(cp) != .none) try self.breakBefore(i);
+                    }
+                    if (self.pending == null) self.pending = i;
+                },
+            }
+        }
+        try self.flush(self.text.len);
+        if (self.hasPieces()) try self.endBlock();
+        try self.endTable();
+    }
+
+    fn blockKind(self: *const Itemizer) Block.Kind {
+        if (self.table != null) return .row;
+        return if (self.preformatted) .preformatted else .text;
+    }
+
+    fn hasPieces(self: *const Itemizer) bool {
+        return self.layout.pieces.items.len > self.block_start;
+    }
+
+    fn font(self: *const Itemizer) Font {
+        if (self.preformatted or self.flags.code or self.table != null) return .mono;
+        return self.heading orelse .body;
+    }
+
+    fn setStyle(self: *Itemizer, marker: u8) void {
+        switch (marker) {
+            LINK_START => {
+                self.flags.link = true;
+                self.links +|= 1;
+            },
+            LINK_END => self.flags.link = false,
+            PRE_START => self.preformatted = true,
+            PRE_END => self.preformatted = false,
+            EMPH_START => self.flags.emphasis = true,
+            EMPH_END => self.flags.emphasis = false,
+            STRONG_START => self.flags.strong = true,
+            STRONG_END => self.flags.strong = false,
+            CODE_START => self.flags.code = true,
+            CODE_END => self.flags.code = false,
+            else => unreachable,
+        }
+    }
+
+    /// End the pending text at `end` as a piece, or as several where its
+    /// words are hyphenated
+    fn flush(self: *Itemizer, end: usize) !void {
+        const pending = self.pending orelse return;
+        self.pending = null;
+        const font_style = self.font();
+        const start = try self.addSyllables(pending, end, font_style);
+        try self.addPiece(.{
+            .start = @intCast(start),
+            .len = @intCast(end - start),
+            .width = self.metrics.measure(font_style, self.text[start..end]),
+            .font = font_style,
+            .flags = self.flags,
+            .link = self.links -| 1,
+            .cell = self.cell,
+        });
+    }
+
+    /// Cut the words of running text from `start` to `end` at their
+    /// hyphenation points into pieces a line may end after, with a hyphen.
+    /// Only words of ASCII letters are hyphenated, and whole: letters next
+    /// to a digit or another script's are left alone. Returns the start of
+    /// the text after the last cut.
+    fn addSyllables(self: *Itemizer, start: usize, end: usize, font_style: Font) !usize {
+        const hyphenator = self.hyphenator orelse return start;
+        if (self.preformatted or self.table != null or self.flags.code) return start;
+
+        var from = start;
+        var hyphen: ?f32 = null;
+        var i = start;
+        while (i < end) {
+            if (!std.ascii.isAlphabetic(self.text[i])) {
+                i += 1;
+                continue;
+            }
+            const word_start = i;
+            while (i < end and std.ascii.isAlphabetic(self.text[i])) i += 1;
+            if (word_start > 0 and inWord(self.text[word_start - 1])) continue;
+            if (i < self.text.len and inWord(self.text[i])) continue;
+
+            var points = try hyphenator.hyphenate(self.text[word_start..i]);
+            while (points != 0) : (points &= points - 1) {
+                const at = word_start + @ctz(points);
+                const hyphen_width = hyphen orelse self.metrics.measure(font_style, "-");
+                hyphen = hyphen_width;
+                try self.addPiece(.{
+                    .start = @intCast(from),
+                    .len = @intCast(at - from),
+                    .width = self.metrics.measure(font_style, self.text[from..at]),
+                    .font = font_style,
+                    .flags = self.flags,
+                    .link = self.links -| 1,
+                    .break_after = true,
+                    .hyphen = hyphen_width,
+                });
+                from = at;
+            }
+        }
+        return from;
+    }
+
+    fn inWord(c: u8) bool {
+        return std.ascii.isAlphanumeric(c) or c >= 0x80;
+    }
+
+    /// Whitespace between words: a break opportunity. Leading space on a
+    /// line is dropped.
+    fn addSpace(self: *Itemizer) void {
+        if (!self.hasPieces()) return;
+        const last = &self.layout.pieces.items[self.layout.pieces.items.len - 1];
+        if (!last.break_after) last.space_after += self.metrics.get(self.font()).space;
+        last.break_after = true;
+    }
+
+    /// A break opportunity with no space: a line may start at `i`
+    fn breakBefore(self: *Itemizer, i: usize) !void {
+        try self.flush(i);
+        if (!self.hasPieces()) return;
+        self.layout.pieces.items[self.layout.pieces.items.len - 1].break_after = true;
+    }
+
+    /// A tab in preformatted text or a table leaves a fixed gap
+    fn addTab(self: *Itemizer) !void {
+        if (!self.hasPieces()) {
+            try self.addPiece(.{
+                .start = 0,
+                .len = 0,
+                .width = 0,
+                .font = .mono,
+                .flags = self.flags,
+                .link = 0,
+                .cell = self.cell,
+            });
+        }
+        const last = &self.layout.pieces.items[self.layout.pieces.items.len - 1];
+        last.space_after += self.metrics.get(.mono).space * TAB_WIDTH;
+    }
+
+    /// The first piece of a block fixes its kind and depth, so markers
+    /// closing a <pre> or quote before the newline still count
+    fn addPiece(self: *Itemizer, piece: Piece) !void {
+        if (!self.hasPieces()) {
+            self.block_kind = self.blockKind();
+            self.block_depth = self.depth;
+        }
+        try self.layout.pieces.append(self.layout.allocator, piece);
+    }
+
+    fn endBlock(self: *Itemizer) !void {
+        const layout = self.layout;
+        const empty = !self.hasPieces();
+        try layout.blocks.append(layout.allocator, .{
+            .kind = if (empty) self.blockKind() else self.block_kind,
+            .first = @intCast(self.block_start),
+            .count = @intCast(layout.pieces.items.len - self.block_start),
+            .depth = if (empty) self.depth else self.block_depth,
+            .font = self.font(),
+            .space_after = if (self.heading_ended) self.metrics.get(.body).line_height / 4 else 0,
+        });
+        self.block_start = layout.pieces.items.len;
+        self.heading_ended = false;
+    }
+
+    /// Column offsets from the widest cell of each column of the table's
+    /// rows, which get them as their index
+    fn endTable(self: *Itemizer) !void {
+        const first_row = self.table orelse return;
+        self.table = null;
+        const layout = self.layout;
+        const rows = layout.blocks.items[first_row..];
+
+        const offset = layout.columns.items.len;
+        for (rows) |*row| {
+            if (row.kind != .row) continue;
+            row.index = @intCast(offset);
+            var cell_width: f32 = 0;
+            var current: u16 = 0;
+            for (layout.pieces.items[row.first..][0..row.count]) |piece| {
+                if (piece.cell != current) {
+                    try widen(layout, offset, current, cell_width);
+                    current = piece.cell;
+                    cell_width = 0;
+                }
+                cell_width += piece.width + piece.space_after;
+            }
+            if (row.count > 0) try widen(layout, offset, current, cell_width);
+        }
+
+        // Widths to offsets
+        const gap = self.metrics.get(.mono).space * COLUMN_GAP;
+        var x: f32 = 0;
+        for (layout.columns.items[offset..]) |*column| {
+            const width = column.*;
+            column.* = x;
+            x += width + gap;
+        }
+    }
+
+    fn widen(layout: *Layout, offset: usize, cell: u16, width: f32) !void {
+        const index = offset + cell;
+        while (layout.columns.items.len <= index) try layout.columns.append(layout.allocator, 0);
+        layout.columns.items[index] = @max(layout.columns.items[index], width);
+    }
+
+    /// Close an image marker holding the image's number, counting from 1
+    fn addImage(self: *Itemizer, digits: []const u8) !void {
+        self.image = null;
+        const number = std.fmt.parseInt(u32, digits, 10) catch return;
+        if (number == 0 or number > self.layout.options.images.len) return;
+
+        if (self.hasPieces()) try self.endBlock();
+        const layout = self.layout;
+        try layout.blocks.append(layout.allocator, .{
+            .kind = .image,
+            .first = @intCast(self.block_start),
+            .count = 0,
+            .depth = self.depth,
+            .font = self.font(),
+            .index = number - 1,
+        });
+    }
+};
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+const testing = std.testing;
+
+fn lineText(allocator: std.mem.Allocator, layout: *const Layout, text: []const u8, line: Line) ![]u8 {
+    var out: std.ArrayListUnmanaged(u8) = .empty;
+    errdefer out.deinit(allocator);
+    for (layout.runs.items[line.first_run..][0..line.run_count], 0..) |run, i| {
+        if (i > 0) try out.append(allocator, ' ');
+        try out.appendSlice(allocator, text[run.start..][0..run.len]);
+        if (run.flags.hyphen) try out.append(allocator, '-');
+    }
+    return out.toOwnedSlice(allocator);
+}
+
+fn expectLines(layout: *const Layout, text: []const u8, expected: []const []const u8) !void {
+    try testing.expectEqual(expected.len, layout.lines.items.len);
+    for (layout.lines.items, expected) |line, want| {
+        const got = try lineText(testing.allocator, layout, text, line);
+        defer testing.allocator.free(got);
+        try testing.expectEqualStrings(want, got);
+    }
+}
+
+test "greedy breaking at spaces" {
+    // 8 units per character; 20 units of margin each side
+    const text = "the quick brown fox jumps over the lazy dog\nsecond";
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 15 });
+    defer layout.deinit();
+
+    try expectLines(&layout, text, &.{ "the quick brown", "fox jumps over", "the lazy dog", "second" });
+    const first = layout.lines.items[0];
+    try testing.expectEqual(@as(f32, 20), first.y);
+    try testing.expectApproxEqAbs(@as(f32, 22.4), first.height, 0.001);
+    try testing.expectEqual(@as(f32, 20), layout.runs.items[0].x);
+    try testing.expectEqual(@as(f32, 20 + 8 * 4), layout.runs.items[1].x);
+
+    // Narrower: more lines, nothing measured again
+    try layout.resize(40 + 8 * 9, 0);
+    try expectLines(&layout, text, &.{ "the quick", "brown fox", "jumps", "over the", "lazy dog", "second" });
+
+    // Readable-width cap
+    try layout.resize(1000, 8 * 20);
+    try expectLines(&layout, text, &.{ "the quick brown fox", "jumps over the lazy", "dog", "second" });
+}
+
+test "style markers split pieces, not words" {
+    const text = "a \x01link\x02, \x11em\x12phasis \x13bold\x14 \x15code\x16";
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 9 });
+    defer layout.deinit();
+
+    // "emphasis" is one word in two styles and stays on one line
+    try expectLines(&layout, text, &.{ "a link ,", "em phasis", "bold code" });
+    const runs = layout.runs.items;
+    try testing.expect(runs[1].flags.link);
+    try testing.expectEqual(@as(u16, 0), runs[1].link);
+    try testing.expect(!runs[2].flags.link);
+    try testing.expect(runs[3].flags.emphasis and !runs[4].flags.emphasis);
+    try testing.expectEqual(runs[3].x + runs[3].width, runs[4].x);
+    try testing.expect(runs[5].flags.strong);
+    try testing.expectEqual(Font.mono, runs[6].font);
+    try testing.expect(runs[6].flags.code);
+}
+
+test "breaks inside words: hyphens, URLs, ideographs" {
+    const text = "well-known 日本語\nsee http://example.com/a/b";
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 6 });
+    defer layout.deinit();
+    // Runs are joined with spaces here; each ideograph is a run of its own
+    try expectLines(&layout, text, &.{ "well-", "known", "日 本 語", "see", "http://", "example.com/", "a/ b" });
+
+    try layout.resize(40 + 8 * 12, 0);
+    try expectLines(&layout, text, &.{ "well- known 日", "本 語", "see http://", "example.com/", "a/ b" });
+    // but no space is drawn where a word breaks without one
+    const runs = layout.runs.items;
+    try testing.expectEqual(runs[0].x + runs[0].width, runs[1].x);
+}
+
+test "lines never split a grapheme cluster" {
+    // ARABIC NUMBER SIGN prepends itself to the ideograph after it
+    const text = "日本\u{0600}語";
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 2 });
+    defer layout.deinit();
+    try expectLines(&layout, text, &.{ "日 本", "\u{0600}語" });
+}
+
+test "headings, quotes and empty lines" {
+    const text = "\x19Title\x1D\nbody\n\n\x17quoted text\x18\nafter";
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 400 });
+    defer layout.deinit();
+
+    try expectLines(&layout, text, &.{ "Title", "body", "", "quoted text", "after" });
+    const lines = layout.lines.items;
+    const body = metrics.synthetic.get(.body);
+    const h1 = metrics.synthetic.get(.h1);
+    try testing.expectEqual(Font.h1, layout.runs.items[0].font);
+    try testing.expectApproxEqAbs(h1.line_height, lines[0].height, 0.001);
+    // A quarter line below the heading
+    try testing.expectApproxEqAbs(lines[0].y + h1.line_height + body.line_height / 4, lines[1].y, 0.001);
+    try testing.expectApproxEqAbs(lines[1].y + body.line_height, lines[2].y, 0.001);
+    try testing.expectEqual(@as(u32, 0), lines[2].run_count);
+    try testing.expectEqual(@as(f32, 20 + 24), layout.runs.items[lines[3].first_run].x);
+    try testing.expectEqual(@as(f32, 20), layout.runs.items[lines[4].first_run].x);
+    try testing.expectApproxEqAbs(lines[4].y + body.line_height + 20, layout.height, 0.001);
+}
+
+test "preformatted text, tables and images" {
+    const text = "\x03if x:\n\treturn  1\x04\n" ++
+        "\x05Name\x1FQty\nApples\x1F3\n\x06\n" ++
+        "see \x1E1\x1E below \x1E9\x1E";
+    const hints = [_]ImageHint{.{ .width = 200, .aspect_ratio = 2 }};
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 100, .images = &hints });
+    defer layout.deinit();
+
+    // Preformatted lines overflow rather than wrap; the tab is 4 spaces
+    try expectLines(&layout, text, &.{ "if x:", "return  1", "Name Qty", "Apples 3", "", "see", "below" });
+    const runs = layout.runs.items;
+    try testing.expectEqual(Font.mono, runs[0].font);
+    try testing.expectEqual(@as(f32, 20 + 8 * 4), runs[1].x);
+
+    // Columns: widest cell plus two spaces
+    try testing.expectEqual(@as(f32, 20), runs[2].x);
+    try testing.expectEqual(@as(f32, 20 + 8 * (6 + 2)), runs[3].x);
+    try testing.expectEqual(runs[3].x, runs[5].x);
+
+    // The image takes the line width at its aspect ratio; image 9 has no hint
+    try testing.expectEqual(@as(usize, 1), layout.images.items.len);
+    const image = layout.images.items[0];
+    try testing.expectEqual(@as(u32, 0), image.image);
+    try testing.expectEqual(@as(f32, 60), image.width);
+    try testing.expectEqual(@as(f32, 30), image.height);
+    const lines = layout.lines.items;
+    try testing.expectEqual(lines[5].y + lines[5].height, image.y);
+    try testing.expectApproxEqAbs(image.y + 30 + metrics.synthetic.get(.body).line_height / 2, lines[6].y, 0.001);
+}
+
+test "resize copies paragraphs whose breaks hold" {
+    const text = "one\nthe quick brown fox jumps over the lazy dog";
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 15 });
+    defer layout.deinit();
+    try testing.expectEqual(@as(usize, 2), layout.reflowed);
+
+    // Lines of 15, 14 and 12 characters hold until "over the" fits at 18
+    try layout.resize(40 + 8 * 17, 0);
+    try testing.expectEqual(@as(usize, 0), layout.reflowed);
+    try expectLines(&layout, text, &.{ "one", "the quick brown", "fox jumps over", "the lazy dog" });
+
+    var fresh = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 17 });
+    defer fresh.deinit();
+    try testing.expectEqualDeep(fresh.lines.items, layout.lines.items);
+    try testing.expectEqualDeep(fresh.runs.items, layout.runs.items);
+    try testing.expectEqual(fresh.height, layout.height);
+
+    try layout.resize(40 + 8 * 18, 0);
+    try testing.expectEqual(@as(usize, 1), layout.reflowed);
+    try expectLines(&layout, text, &.{ "one", "the quick brown", "fox jumps over the", "lazy dog" });
+
+    // Narrower than the widest line
+    try layout.resize(40 + 8 * 14, 0);
+    try testing.expectEqual(@as(usize, 1), layout.reflowed);
+    try expectLines(&layout, text, &.{ "one", "the quick", "brown fox", "jumps over the", "lazy dog" });
+}
+
+test "total-fit breaking evens out lines" {
+    const text = "one\naaa bb cc ddddd";
+    var greedy = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 6 });
+    defer greedy.deinit();
+    try expectLines(&greedy, text, &.{ "one", "aaa bb", "cc", "ddddd" });
+
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 6, .breaking = .optimal });
+    defer layout.deinit();
+    try expectLines(&layout, text, &.{ "one", "aaa", "bb cc", "ddddd" });
+
+    // Same width: copied. A one-line paragraph holds at any wider width.
+    try layout.resize(40 + 8 * 6, 0);
+    try testing.expectEqual(@as(usize, 0), layout.reflowed);
+    try layout.resize(40 + 8 * 7, 0);
+    try testing.expectEqual(@as(usize, 1), layout.reflowed);
+    try expectLines(&layout, text, &.{ "one", "aaa", "bb cc", "ddddd" });
+
+    // A word wider than the line still gets one of its own
+    try layout.resize(40 + 8 * 4, 0);
+    try expectLines(&layout, text, &.{ "one", "aaa", "bb", "cc", "ddddd" });
+}
+
+test "total fit keeps the breaks of recent widths" {
+    const text = "one\naaa bb cc ddddd";
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 6, .breaking = .optimal });
+    defer layout.deinit();
+    try layout.resize(40 + 8 * 7, 0);
+    const searched = layout.fit_breaks.items.len;
+
+    // Back at the first width the breaks are placed, not searched for
+    try layout.resize(40 + 8 * 6, 0);
+    try testing.expectEqual(searched, layout.fit_breaks.items.len);
+    try expectLines(&layout, text, &.{ "one", "aaa", "bb cc", "ddddd" });
+
+    // After RECENT_FITS other widths it is searched again
+    for (0..RECENT_FITS) |extra| try layout.resize(40 + 8 * @as(f32, @floatFromInt(8 + extra)), 0);
+    const before = layout.fit_breaks.items.len;
+    try layout.resize(40 + 8 * 6, 0);
+    try testing.expect(layout.fit_breaks.items.len > before);
+    try expectLines(&layout, text, &.{ "one", "aaa", "bb cc", "ddddd" });
+}
+
+test "hyphenation" {
+    const text = "see hyphenation\n\x15hyphenation\x16";
+    var plain = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 7 });
+    defer plain.deinit();
+    try expectLines(&plain, text, &.{ "see", "hyphenation", "hyphenation" });
+
+    // Runs are joined with spaces here; code is never hyphenated
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 7, .hyphenate = true });
+    defer layout.deinit();
+    try expectLines(&layout, text, &.{ "see hy-", "phen a-", "tion", "hyphenation" });
+    const runs = layout.runs.items;
+    try testing.expect(runs[1].flags.hyphen and !runs[2].flags.hyphen);
+    try testing.expectEqual(runs[2].x + runs[2].width, runs[3].x);
+
+    // Wide enough for the word: its pieces share a line, with no hyphens
+    try layout.resize(40 + 8 * 15, 0);
+    try expectLines(&layout, text, &.{ "see hy phen a tion", "hyphenation" });
+    for (layout.runs.items) |run| try testing.expect(!run.flags.hyphen);
+}
+
+test "visible band" {
+    // Ten body lines of 22.4 from y = 20, then an image and a last line
+    const text = "0\n1\n2\n3\n4\n5\n6\n7\n8\n9\n\x1E1\x1E\nend";
+    const hints = [_]ImageHint{.{ .width = 100, .aspect_ratio = 1 }};
+    var layout = try Layout.init(testing.allocator, text, &metrics.synthetic, .{ .images = &hints });
+    defer layout.deinit();
+    const lines = layout.lines.items;
+    try testing.expectEqual(@as(usize, 12), lines.len);
+
+    // Lines 2 to 4 meet [70, 120)
+    var range = layout.visible(70, 120, 0);
+    try testing.expectEqual(@as(u32, 2), range.first_line);
+    try testing.expectEqual(@as(u32, 3), range.line_count);
+    try testing.expectEqual(lines[2].first_run, range.first_run);
+    try testing.expectEqual(@as(u32, 3), range.run_count);
+    try testing.expectEqual(@as(u32, 0), range.image_count);
+
+    // Overscan reaches the image
+    range = layout.visible(70, 120, 150);
+    try testing.expectEqual(@as(u32, 0), range.first_line);
+    try testing.expectEqual(@as(u32, 1), range.image_count);
+
+    // Past the end of the page, and before its top
+    range = layout.visible(layout.height + 100, layout.height + 200, 0);
+    try testing.expectEqual(@as(u32, 0), range.line_count);
+    try testing.expectEqual(@as(u32, 0), range.run_count);
+    range = layout.visible(-100, 0, 0);
+    try testing.expectEqual(@as(u32, 0), range.line_count);
+}
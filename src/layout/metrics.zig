@@ -0,0 +1,93 @@
+//! Vulpes Browser - Font Metrics
+//!
+//! What layout needs to know about fonts, supplied by the host: the
+//! vertical metrics and space advance of each text style, and a callback
+//! that measures a span of UTF-8 text. The engine never opens a font, so
+//! it lays out the same on Linux as it does in the app.
+//!
+//! `synthetic` stands in for CoreText in tests and benchmarks: every
+//! code point is half an em wide.
+//!
+
+const std = @import("std");
+
+/// Text styles the view draws, in vulpes_font_t order
+pub const Font = enum(u8) { body, mono, h1, h2, h3, h4 };
+
+pub const FONT_COUNT = std.enums.values(Font).len;
+
+/// Size of each style relative to body text, as the text view draws them
+pub const scale = std.EnumArray(Font, f32).init(.{
+    .body = 1,
+    .mono = 1,
+    .h1 = 1.8,
+    .h2 = 1.5,
+    .h3 = 1.3,
+    .h4 = 1.15,
+});
+
+pub const FontMetrics = extern struct {
+    /// Em size
+    size: f32,
+    ascent: f32,
+    descent: f32,
+    /// Distance between the baselines of consecutive lines
+    line_height: f32,
+    /// Advance of U+0020
+    space: f32,
+};
+
+/// Advance width of `text`, which never contains a line break
+pub const MeasureFn = *const fn (context: ?*anyopaque, font: Font, text: []const u8) f32;
+
+pub const Metrics = struct {
+    fonts: std.EnumArray(Font, FontMetrics),
+    context: ?*anyopaque = null,
+    measure_fn: MeasureFn,
+
+    pub fn get(self: *const Metrics, font: Font) FontMetrics {
+        return self.fonts.get(font);
+    }
+
+    pub fn measure(self: *const Metrics, font: Font, text: []const u8) f32 {
+        return self.measure_fn(self.context, font, text);
+    }
+};
+
+/// Body size of `synthetic`
+pub const SYNTHETIC_SIZE: f32 = 16;
+
+/// Metrics without a font: each code point is half an em
+pub const synthetic: Metrics = .{
+    .fonts = table: {
+        var fonts: std.EnumArray(Font, FontMetrics) = undefined;
+        for (std.enums.values(Font)) |font| {
+            const size = SYNTHETIC_SIZE * scale.get(font);
+            fonts.set(font, .{
+                .size = size,
+                .ascent = size * 0.8,
+                .descent = size * 0.2,
+                .line_height = size * 1.4,
+                .space = size / 2,
+            });
+        }
+        break :table fonts;
+    },
+    .measure_fn = measureSynthetic,
+};
+
+fn measureSynthetic(_: ?*anyopaque, font: Font, text: []const u8) f32 {
+    const count = std.unicode.utf8CountCodepoints(text) catch text.len;
+    return @as(f32, @floatFromInt(count)) * synthetic.fonts.get(font).space;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "synthetic metrics" {
+    try std.testing.expectEqual(@as(f32, 40), synthetic.measure(.body, "hello"));
+    try std.testing.expectEqual(@as(f32, 16), synthetic.measure(.mono, "é!"));
+    try std.testing.expectApproxEqAbs(@as(f32, 14.4), synthetic.measure(.h1, "a"), 0.001);
+    try std.testing.expectApproxEqAbs(@as(f32, 22.4), synthetic.get(.body).line_height, 0.001);
+}
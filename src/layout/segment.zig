@@ -0,0 +1,561 @@
+//! Vulpes Browser - Text Segmentation
+//!
+//! Grapheme cluster and word boundaries (UAX #29). A grapheme cluster is
+//! what a reader takes for one character: a letter and its accents, a
+//! flag, an emoji with its skin tone or ZWJ sequence, a Hangul syllable
+//! spelled in jamo. Layout, find-in-page and the view's glyph iteration
+//! and selection step by clusters, so none of them splits one. Word
+//! boundaries, for selecting a word, are found over the clusters in the
+//! same pass.
+//!
+//! Properties come from two-stage tables (unicode_table.zig) built at
+//! comptime. The ranges cover Latin, Hebrew, Arabic, Devanagari, Thai,
+//! CJK, kana, Hangul and emoji; code points they leave out are Other, a
+//! cluster and a word of their own. GB9c (Indic conjuncts) is not
+//! implemented.
+//!
+//! Tailoring: the extractor's style markers are C0 controls, which
+//! cluster on their own as usual but are Format for words, so a word that
+//! changes style partway through selects as one word. The image marker and
+//! cell separator stay word boundaries.
+//!
+
+const std = @import("std");
+const unicode_table = @import("unicode_table.zig");
+
+const decode = unicode_table.decode;
+
+/// Grapheme_Cluster_Break, with Extended_Pictographic folded in: no
+/// pictographic code point has another value
+pub const Grapheme = enum(u8) {
+    other,
+    cr,
+    lf,
+    control,
+    extend,
+    zwj,
+    regional_indicator,
+    prepend,
+    spacing_mark,
+    l,
+    v,
+    t,
+    lv,
+    lvt,
+    extended_pictographic,
+};
+
+pub const Word = enum(u8) {
+    other,
+    cr,
+    lf,
+    newline,
+    extend,
+    zwj,
+    regional_indicator,
+    format,
+    katakana,
+    hebrew_letter,
+    aletter,
+    single_quote,
+    double_quote,
+    mid_num_let,
+    mid_letter,
+    mid_num,
+    numeric,
+    extend_num_let,
+    wseg_space,
+};
+
+fn g(first: u21, last: u21, value: Grapheme) unicode_table.Range(Grapheme) {
+    return .{ .first = first, .last = last, .value = value };
+}
+
+fn w(first: u21, last: u21, value: Word) unicode_table.Range(Word) {
+    return .{ .first = first, .last = last, .value = value };
+}
+
+const pict = Grapheme.extended_pictographic;
+
+/// Grapheme classes by range, sorted and disjoint. Hangul syllables are
+/// computed rather than listed.
+const grapheme_ranges = [_]unicode_table.Range(Grapheme){
+    g(0x0000, 0x0009, .control), g(0x000A, 0x000A, .lf), g(0x000B, 0x000C, .control),
+    g(0x000D, 0x000D, .cr), g(0x000E, 0x001F, .control), g(0x007F, 0x009F, .control),
+    g(0x00A9, 0x00A9, pict), g(0x00AD, 0x00AD, .control), g(0x00AE, 0x00AE, pict),
+    // Combining marks
+    g(0x0300, 0x036F, .extend), g(0x0483, 0x0489, .extend),
+    // Hebrew and Arabic
+    g(0x0591, 0x05BD, .extend), g(0x05BF, 0x05BF, .extend), g(0x05C1, 0x05C2, .extend),
+    g(0x05C4, 0x05C5, .extend), g(0x05C7, 0x05C7, .extend), g(0x0600, 0x0605, .prepend),
+    g(0x0610, 0x061A, .extend), g(0x061C, 0x061C, .control), g(0x064B, 0x065F, .extend),
+    g(0x0670, 0x0670, .extend), g(0x06D6, 0x06DC, .extend), g(0x06DD, 0x06DD, .prepend),
+    g(0x06DF, 0x06E4, .extend), g(0x06E7, 0x06E8, .extend), g(0x06EA, 0x06ED, .extend),
+    // Devanagari
+    g(0x0900, 0x0902, .extend), g(0x0903, 0x0903, .spacing_mark), g(0x093A, 0x093A, .extend),
+    g(0x093B, 0x093B, .spacing_mark), g(0x093C, 0x093C, .extend), g(0x093E, 0x0940, .spacing_mark),
+    g(0x0941, 0x0948, .extend), g(0x0949, 0x094C, .spacing_mark), g(0x094D, 0x094D, .extend),
+    g(0x094E, 0x094F, .spacing_mark), g(0x0951, 0x0957, .extend), g(0x0962, 0x0963, .extend),
+    // Thai
+    g(0x0E31, 0x0E31, .extend), g(0x0E33, 0x0E33, .spacing_mark), g(0x0E34, 0x0E3A, .extend),
+    g(0x0E47, 0x0E4E, .extend),
+    // Hangul jamo
+    g(0x1100, 0x115F, .l), g(0x1160, 0x11A7, .v), g(0x11A8, 0x11FF, .t),
+    g(0x180E, 0x180E, .control), g(0x1AB0, 0x1AFF, .extend), g(0x1DC0, 0x1DFF, .extend),
+    // General punctuation
+    g(0x200B, 0x200B, .control), g(0x200C, 0x200C, .extend), g(0x200D, 0x200D, .zwj),
+    g(0x200E, 0x200F, .control), g(0x2028, 0x202E, .control), g(0x203C, 0x203C, pict),
+    g(0x2049, 0x2049, pict), g(0x2060, 0x206F, .control), g(0x20D0, 0x20F0, .extend),
+    // Symbols with emoji presentations
+    g(0x2122, 0x2122, pict), g(0x2139, 0x2139, pict), g(0x2194, 0x2199, pict),
+    g(0x21A9, 0x21AA, pict), g(0x231A, 0x231B, pict), g(0x2328, 0x2328, pict),
+    g(0x2388, 0x2388, pict), g(0x23CF, 0x23CF, pict), g(0x23E9, 0x23F3, pict),
+    g(0x23F8, 0x23FA, pict), g(0x24C2, 0x24C2, pict), g(0x25AA, 0x25AB, pict),
+    g(0x25B6, 0x25B6, pict), g(0x25C0, 0x25C0, pict), g(0x25FB, 0x25FE, pict),
+    g(0x2600, 0x2605, pict), g(0x2607, 0x2612, pict), g(0x2614, 0x2685, pict),
+    g(0x2690, 0x2705, pict), g(0x2708, 0x2712, pict), g(0x2714, 0x2714, pict),
+    g(0x2716, 0x2716, pict), g(0x271D, 0x271D, pict), g(0x2721, 0x2721, pict),
+    g(0x2728, 0x2728, pict), g(0x2733, 0x2734, pict), g(0x2744, 0x2744, pict),
+    g(0x2747, 0x2747, pict), g(0x274C, 0x274C, pict), g(0x274E, 0x274E, pict),
+    g(0x2753, 0x2755, pict), g(0x2757, 0x2757, pict), g(0x2763, 0x2767, pict),
+    g(0x2795, 0x2797, pict), g(0x27A1, 0x27A1, pict), g(0x27B0, 0x27B0, pict),
+    g(0x27BF, 0x27BF, pict), g(0x2934, 0x2935, pict), g(0x2B05, 0x2B07, pict),
+    g(0x2B1B, 0x2B1C, pict), g(0x2B50, 0x2B50, pict), g(0x2B55, 0x2B55, pict),
+    // CJK and kana
+    g(0x302A, 0x302F, .extend), g(0x3030, 0x3030, pict), g(0x303D, 0x303D, pict),
+    g(0x3099, 0x309A, .extend), g(0x3297, 0x3297, pict), g(0x3299, 0x3299, pict),
+    g(0xA960, 0xA97C, .l), g(0xD7B0, 0xD7C6, .v), g(0xD7CB, 0xD7FB, .t),
+    // Variation selectors, half marks, specials
+    g(0xFE00, 0xFE0F, .extend), g(0xFE20, 0xFE2F, .extend), g(0xFEFF, 0xFEFF, .control),
+    g(0xFF9E, 0xFF9F, .extend), g(0xFFF0, 0xFFFB, .control),
+    // Emoji, flags and skin tones
+    g(0x1F000, 0x1F0FF, pict), g(0x1F10D, 0x1F10F, pict), g(0x1F12F, 0x1F12F, pict),
+    g(0x1F16C, 0x1F171, pict), g(0x1F17E, 0x1F17F, pict), g(0x1F18E, 0x1F18E, pict),
+    g(0x1F191, 0x1F19A, pict), g(0x1F1AD, 0x1F1E5, pict), g(0x1F1E6, 0x1F1FF, .regional_indicator),
+    g(0x1F201, 0x1F20F, pict), g(0x1F21A, 0x1F21A, pict), g(0x1F22F, 0x1F22F, pict),
+    g(0x1F232, 0x1F23A, pict), g(0x1F23C, 0x1F23F, pict), g(0x1F249, 0x1F3FA, pict),
+    g(0x1F3FB, 0x1F3FF, .extend), g(0x1F400, 0x1F53D, pict), g(0x1F546, 0x1F64F, pict),
+    g(0x1F680, 0x1F6FF, pict), g(0x1F774, 0x1F77F, pict), g(0x1F7D5, 0x1F7FF, pict),
+    g(0x1F80C, 0x1F80F, pict), g(0x1F848, 0x1F84F, pict), g(0x1F85A, 0x1F85F, pict),
+    g(0x1F888, 0x1F88F, pict), g(0x1F8AE, 0x1F8FF, pict), g(0x1F90C, 0x1F93A, pict),
+    g(0x1F93C, 0x1F945, pict), g(0x1F947, 0x1FAFF, pict), g(0x1FC00, 0x1FFFD, pict),
+    // Tags and variation selectors supplement
+    g(0xE0000, 0xE001F, .control), g(0xE0020, 0xE007F, .extend), g(0xE0080, 0xE00FF, .control),
+    g(0xE0100, 0xE01EF, .extend), g(0xE01F0, 0xE0FFF, .control),
+};
+
+/// Word classes by range, sorted and disjoint
+const word_ranges = [_]unicode_table.Range(Word){
+    // Extractor markers, tailored to Format
+    w(0x0001, 0x0008, .format), w(0x000A, 0x000A, .lf), w(0x000B, 0x000C, .newline),
+    w(0x000D, 0x000D, .cr), w(0x000E, 0x001D, .format), w(0x0020, 0x0020, .wseg_space),
+    w(0x0022, 0x0022, .double_quote), w(0x0027, 0x0027, .single_quote), w(0x002C, 0x002C, .mid_num),
+    w(0x002E, 0x002E, .mid_num_let), w(0x0030, 0x0039, .numeric), w(0x003A, 0x003A, .mid_letter),
+    w(0x003B, 0x003B, .mid_num), w(0x0041, 0x005A, .aletter), w(0x005F, 0x005F, .extend_num_let),
+    w(0x0061, 0x007A, .aletter), w(0x0085, 0x0085, .newline), w(0x00AA, 0x00AA, .aletter),
+    w(0x00AD, 0x00AD, .format), w(0x00B5, 0x00B5, .aletter), w(0x00B7, 0x00B7, .mid_letter),
+    w(0x00BA, 0x00BA, .aletter), w(0x00C0, 0x00D6, .aletter), w(0x00D8, 0x00F6, .aletter),
+    w(0x00F8, 0x02FF, .aletter),
+    // Combining marks, Greek, Cyrillic, Armenian
+    w(0x0300, 0x036F, .extend), w(0x0370, 0x0374, .aletter), w(0x0376, 0x037D, .aletter),
+    w(0x037E, 0x037E, .mid_num), w(0x037F, 0x037F, .aletter), w(0x0386, 0x0386, .aletter),
+    w(0x0387, 0x0387, .mid_letter), w(0x0388, 0x0481, .aletter), w(0x0483, 0x0489, .extend),
+    w(0x048A, 0x052F, .aletter), w(0x0531, 0x0556, .aletter), w(0x0559, 0x055C, .aletter),
+    w(0x055E, 0x055E, .aletter), w(0x055F, 0x055F, .mid_letter), w(0x0560, 0x0588, .aletter),
+    w(0x0589, 0x0589, .mid_num),
+    // Hebrew
+    w(0x0591, 0x05BD, .extend), w(0x05BF, 0x05BF, .extend), w(0x05C1, 0x05C2, .extend),
+    w(0x05C4, 0x05C5, .extend), w(0x05C7, 0x05C7, .extend), w(0x05D0, 0x05EA, .hebrew_letter),
+    w(0x05EF, 0x05F2, .hebrew_letter), w(0x05F3, 0x05F3, .aletter), w(0x05F4, 0x05F4, .mid_letter),
+    // Arabic
+    w(0x0600, 0x0605, .format), w(0x060C, 0x060D, .mid_num), w(0x0610, 0x061A, .extend),
+    w(0x061C, 0x061C, .format), w(0x0620, 0x064A, .aletter), w(0x064B, 0x065F, .extend),
+    w(0x0660, 0x0669, .numeric), w(0x066B, 0x066B, .numeric), w(0x066C, 0x066C, .mid_num),
+    w(0x066E, 0x066F, .aletter), w(0x0670, 0x0670, .extend), w(0x0671, 0x06D3, .aletter),
+    w(0x06D5, 0x06D5, .aletter), w(0x06D6, 0x06DC, .extend), w(0x06DD, 0x06DD, .format),
+    w(0x06DF, 0x06E4, .extend), w(0x06E5, 0x06E6, .aletter), w(0x06E7, 0x06E8, .extend),
+    w(0x06EA, 0x06ED, .extend), w(0x06EE, 0x06EF, .aletter), w(0x06F0, 0x06F9, .numeric),
+    w(0x06FA, 0x06FC, .aletter),
+    // Devanagari
+    w(0x0900, 0x0903, .extend), w(0x0904, 0x0939, .aletter), w(0x093A, 0x093C, .extend),
+    w(0x093D, 0x093D, .aletter), w(0x093E, 0x094F, .extend), w(0x0950, 0x0950, .aletter),
+    w(0x0951, 0x0957, .extend), w(0x0958, 0x0961, .aletter), w(0x0962, 0x0963, .extend),
+    w(0x0966, 0x096F, .numeric), w(0x0971, 0x0980, .aletter),
+    // Thai letters are Other: no dictionary, so no words inside a run
+    w(0x0E31, 0x0E31, .extend), w(0x0E33, 0x0E3A, .extend), w(0x0E47, 0x0E4E, .extend),
+    w(0x0E50, 0x0E59, .numeric),
+    // Hangul jamo, Latin and Greek extended
+    w(0x1100, 0x11FF, .aletter), w(0x1680, 0x1680, .wseg_space), w(0x1AB0, 0x1AFF, .extend),
+    w(0x1DC0, 0x1DFF, .extend), w(0x1E00, 0x1FFF, .aletter),
+    // General punctuation
+    w(0x2000, 0x2006, .wseg_space), w(0x2008, 0x200A, .wseg_space), w(0x200C, 0x200C, .extend),
+    w(0x200D, 0x200D, .zwj), w(0x200E, 0x200F, .format), w(0x2018, 0x2019, .mid_num_let),
+    w(0x2024, 0x2024, .mid_num_let), w(0x2027, 0x2027, .mid_letter), w(0x2028, 0x2029, .newline),
+    w(0x202A, 0x202E, .format), w(0x202F, 0x202F, .extend_num_let), w(0x203F, 0x2040, .extend_num_let),
+    w(0x2044, 0x2044, .mid_num), w(0x2054, 0x2054, .extend_num_let), w(0x205F, 0x205F, .wseg_space),
+    w(0x2060, 0x2064, .format), w(0x2066, 0x206F, .format), w(0x20D0, 0x20F0, .extend),
+    // CJK punctuation and katakana; ideographs and hiragana are Other
+    w(0x3000, 0x3000, .wseg_space), w(0x302A, 0x302F, .extend), w(0x3031, 0x3035, .katakana),
+    w(0x3099, 0x309A, .extend), w(0x309B, 0x309C, .katakana), w(0x30A0, 0x30FA, .katakana),
+    w(0x30FC, 0x30FF, .katakana), w(0x31F0, 0x31FF, .katakana), w(0x32D0, 0x32FE, .katakana),
+    w(0x3300, 0x3357, .katakana),
+    // Hangul
+    w(0xA960, 0xA97C, .aletter), w(0xAC00, 0xD7A3, .aletter), w(0xD7B0, 0xD7C6, .aletter),
+    w(0xD7CB, 0xD7FB, .aletter),
+    // Presentation, vertical and small forms
+    w(0xFB1D, 0xFB1D, .hebrew_letter), w(0xFB1F, 0xFB28, .hebrew_letter), w(0xFB2A, 0xFB4F, .hebrew_letter),
+    w(0xFE00, 0xFE0F, .extend), w(0xFE10, 0xFE10, .mid_num), w(0xFE13, 0xFE13, .mid_letter),
+    w(0xFE14, 0xFE14, .mid_num), w(0xFE20, 0xFE2F, .extend), w(0xFE33, 0xFE34, .extend_num_let),
+    w(0xFE4D, 0xFE4F, .extend_num_let), w(0xFE50, 0xFE50, .mid_num), w(0xFE52, 0xFE52, .mid_num_let),
+    w(0xFE54, 0xFE54, .mid_num), w(0xFE55, 0xFE55, .mid_letter), w(0xFEFF, 0xFEFF, .format),
+    // Halfwidth and fullwidth forms
+    w(0xFF07, 0xFF07, .mid_num_let), w(0xFF0C, 0xFF0C, .mid_num), w(0xFF0E, 0xFF0E, .mid_num_let),
+    w(0xFF10, 0xFF19, .numeric), w(0xFF1A, 0xFF1A, .mid_letter), w(0xFF1B, 0xFF1B, .mid_num),
+    w(0xFF21, 0xFF3A, .aletter), w(0xFF3F, 0xFF3F, .extend_num_let), w(0xFF41, 0xFF5A, .aletter),
+    w(0xFF66, 0xFF9D, .katakana), w(0xFF9E, 0xFF9F, .extend), w(0xFFF9, 0xFFFB, .format),
+    // Flags and skin tones
+    w(0x1F1E6, 0x1F1FF, .regional_indicator), w(0x1F3FB, 0x1F3FF, .extend),
+    // Tags and variation selectors supplement
+    w(0xE0001, 0xE0001, .format), w(0xE0020, 0xE007F, .extend), w(0xE0100, 0xE01EF, .extend),
+};
+
+fn otherGrapheme(_: u21) Grapheme {
+    return .other;
+}
+
+fn otherWord(_: u21) Word {
+    return .other;
+}
+
+const grapheme_table = unicode_table.build(Grapheme, &grapheme_ranges, otherGrapheme);
+const word_table = unicode_table.build(Word, &word_ranges, otherWord);
+
+/// ASCII word classes, read without the stage-one lookup
+const word_ascii = word_table.ascii();
+
+pub fn graphemeOf(cp: u21) Grapheme {
+    // Hangul syllables: LV every 28th, LVT between
+    if (cp >= 0xAC00 and cp <= 0xD7A3) return if ((cp - 0xAC00) % 28 == 0) .lv else .lvt;
+    return grapheme_table.get(cp);
+}
+
+pub fn wordOf(cp: u21) Word {
+    if (cp < 0x80) return word_ascii[cp];
+    return word_table.get(cp);
+}
+
+// =============================================================================
+// Grapheme Clusters
+// =============================================================================
+
+/// What the rules need to know about the cluster so far
+const ClusterState = struct {
+    /// Regional indicators in a row (GB12, GB13)
+    regional: u32 = 0,
+    /// An emoji, any extenders after it, then a ZWJ (GB11)
+    emoji: enum { none, pictographic, joined } = .none,
+
+    fn add(self: *ClusterState, class: Grapheme) void {
+        self.regional = if (class == .regional_indicator) self.regional + 1 else 0;
+        self.emoji = switch (class) {
+            .extended_pictographic => .pictographic,
+            .extend => if (self.emoji == .pictographic) .pictographic else .none,
+            .zwj => if (self.emoji == .pictographic) .joined else .none,
+            else => .none,
+        };
+    }
+};
+
+/// GB3 to GB999 between two code points of a cluster
+fn graphemeBreak(prev: Grapheme, class: Grapheme, state: ClusterState) bool {
+    if (prev == .cr and class == .lf) return false;
+    switch (prev) {
+        .control, .cr, .lf => return true,
+        else => {},
+    }
+    switch (class) {
+        .control, .cr, .lf => return true,
+        else => {},
+    }
+    // Hangul syllable sequences
+    switch (prev) {
+        .l => switch (class) {
+            .l, .v, .lv, .lvt => return false,
+            else => {},
+        },
+        .v, .lv => if (class == .v or class == .t) return false,
+        .t, .lvt => if (class == .t) return false,
+        else => {},
+    }
+    if (class == .extend or class == .zwj or class == .spacing_mark or prev == .prepend) return false;
+    if (prev == .zwj and class == .extended_pictographic and state.emoji == .joined) return false;
+    if (prev == .regional_indicator and class == .regional_indicator and state.regional % 2 == 1) return false;
+    return true;
+}
+
+/// End of the grapheme cluster that starts at `start`
+pub fn nextGrapheme(text: []const u8, start: usize) usize {
+    if (start >= text.len) return text.len;
+    // Two ASCII bytes always have a boundary between them, but for CR LF
+    const c = text[start];
+    if (c < 0x80 and (start + 1 == text.len or text[start + 1] < 0x80)) {
+        const crlf = c == '\r' and start + 1 < text.len and text[start + 1] == '\n';
+        return if (crlf) start + 2 else start + 1;
+    }
+
+    const first, const first_len = decode(text, start);
+    var prev = graphemeOf(first);
+    var state: ClusterState = .{};
+    state.add(prev);
+    var i = start + first_len;
+    while (i < text.len) {
+        const cp, const len = decode(text, i);
+        const class = graphemeOf(cp);
+        if (graphemeBreak(prev, class, state)) break;
+        state.add(class);
+        prev = class;
+        i += len;
+    }
+    return i;
+}
+
+/// A byte range
+pub const Span = struct { start: usize, end: usize };
+
+/// The grapheme cluster at byte `index`: where a cursor stops either side
+/// of it. Line breaks always end clusters, so the search starts at the
+/// line's start.
+pub fn graphemeAt(text: []const u8, index: usize) Span {
+    if (index >= text.len) return .{ .start = text.len, .end = text.len };
+    var start = lineStart(text, index);
+    while (true) {
+        const end = nextGrapheme(text, start);
+        if (end > index) return .{ .start = start, .end = end };
+        start = end;
+    }
+}
+
+fn lineStart(text: []const u8, index: usize) usize {
+    const newline = std.mem.lastIndexOfScalar(u8, text[0..index], '\n') orelse return 0;
+    return newline + 1;
+}
+
+// =============================================================================
+// Words
+// =============================================================================
+
+pub const Boundary = struct {
+    /// Byte offset: the end of a grapheme cluster
+    index: usize,
+    /// A word also ends here
+    word: bool,
+};
+
+/// A cluster and the word class it has for the word rules
+const Cluster = struct { end: usize, word: Word };
+
+/// Grapheme cluster boundaries in UTF-8 text up to and including its end,
+/// each marked if words break there too. The word rules run once per
+/// cluster, on the class of its first code point WB4 doesn't skip.
+pub const Segmenter = struct {
+    text: []const u8,
+    /// Start of the next cluster
+    index: usize = 0,
+    /// That cluster, when the word rules have already looked at it
+    ahead: ?Cluster = null,
+    /// Word classes of the last two clusters that count (WB4)
+    prev: ?Word = null,
+    before: ?Word = null,
+
+    pub fn init(text: []const u8) Segmenter {
+        return .{ .text = text };
+    }
+
+    pub fn next(self: *Segmenter) ?Boundary {
+        if (self.index >= self.text.len) return null;
+        const cluster = self.ahead orelse clusterAt(self.text, self.index);
+        self.note(cluster.word);
+        self.index = cluster.end;
+        if (cluster.end == self.text.len) {
+            self.ahead = null;
+            return .{ .index = cluster.end, .word = true }; // WB2
+        }
+        const following = clusterAt(self.text, cluster.end);
+        self.ahead = following;
+        return .{ .index = cluster.end, .word = self.wordBreak(following) };
+    }
+
+    fn note(self: *Segmenter, class: Word) void {
+        // WB4: extenders and format characters belong to what precedes
+        // them, unless that is a line break or the start of text
+        if (self.prev) |a| {
+            if (ignorable(class) and !isNewline(a)) return;
+        }
+        self.before = self.prev;
+        self.prev = class;
+    }
+
+    /// WB3a to WB999 between the last cluster and `cluster`
+    fn wordBreak(self: *const Segmenter, cluster: Cluster) bool {
+        const a = self.prev orelse return true;
+        const b = cluster.word;
+        const before = self.before orelse .other;
+        // WB3 (CR × LF) holds inside a cluster already
+        if (isNewline(a) or isNewline(b)) return true;
+        if (a == .wseg_space and b == .wseg_space) return false; // WB3d
+        if (ignorable(b)) return false; // WB4
+
+        if (isLetter(a) and isLetter(b)) return false; // WB5
+        if (isLetter(a) and isMidLetter(b) and isLetter(self.after(cluster))) return false; // WB6
+        if (isLetter(before) and isMidLetter(a) and isLetter(b)) return false; // WB7
+        if (a == .hebrew_letter and b == .single_quote) return false; // WB7a
+        if (a == .hebrew_letter and b == .double_quote and self.after(cluster) == .hebrew_letter) return false; // WB7b
+        if (before == .hebrew_letter and a == .double_quote and b == .hebrew_letter) return false; // WB7c
+        if ((a == .numeric or isLetter(a)) and b == .numeric) return false; // WB8, WB9
+        if (a == .numeric and isLetter(b)) return false; // WB10
+        if (before == .numeric and isMidNum(a) and b == .numeric) return false; // WB11
+        if (a == .numeric and isMidNum(b) and self.after(cluster) == .numeric) return false; // WB12
+        if (a == .katakana and b == .katakana) return false; // WB13
+        if (b == .extend_num_let and (isLetter(a) or a == .numeric or a == .katakana or a == .extend_num_let)) return false; // WB13a
+        if (a == .extend_num_let and (isLetter(b) or b == .numeric or b == .katakana)) return false; // WB13b
+        // WB15, WB16: regional indicators are already paired into clusters
+        return true;
+    }
+
+    /// Word class of the first cluster after `cluster` that WB4 doesn't
+    /// skip, for the rules that look one ahead
+    fn after(self: *const Segmenter, cluster: Cluster) Word {
+        var i = cluster.end;
+        while (i < self.text.len) {
+            const next_cluster = clusterAt(self.text, i);
+            if (!ignorable(next_cluster.word)) return next_cluster.word;
+            i = next_cluster.end;
+        }
+        return .other;
+    }
+};
+
+fn clusterAt(text: []const u8, start: usize) Cluster {
+    const end = nextGrapheme(text, start);
+    if (text[start] < 0x80) return .{ .end = end, .word = word_ascii[text[start]] };
+    // The first code point WB4 doesn't skip names the cluster, e.g. the
+    // letter after a prepended mark
+    var first: ?Word = null;
+    var i = start;
+    while (i < end) {
+        const cp, const len = decode(text, i);
+        const class = wordOf(cp);
+        if (!ignorable(class)) return .{ .end = end, .word = class };
+        if (first == null) first = class;
+        i += len;
+    }
+    return .{ .end = end, .word = first.? };
+}
+
+fn ignorable(class: Word) bool {
+    return class == .extend or class == .format or class == .zwj;
+}
+
+fn isNewline(class: Word) bool {
+    return class == .cr or class == .lf or class == .newline;
+}
+
+fn isLetter(class: Word) bool {
+    return class == .aletter or class == .hebrew_letter;
+}
+
+/// MidLetter or MidNumLetQ
+fn isMidLetter(class: Word) bool {
+    return class == .mid_letter or class == .mid_num_let or class == .single_quote;
+}
+
+/// MidNum or MidNumLetQ
+fn isMidNum(class: Word) bool {
+    return class == .mid_num or class == .mid_num_let or class == .single_quote;
+}
+
+/// The word, run of spaces or lone character at byte `index`, as a
+/// double-click selects it. Words never cross a line break, so the search
+/// starts at the line's start.
+pub fn wordAt(text: []const u8, index: usize) Span {
+    if (index >= text.len) return .{ .start = text.len, .end = text.len };
+    const line = lineStart(text, index);
+    var segmenter = Segmenter.init(text[line..]);
+    var start = line;
+    while (segmenter.next()) |boundary| {
+        if (!boundary.word) continue;
+        const end = line + boundary.index;
+        if (end > index) return .{ .start = start, .end = end };
+        start = end;
+    }
+    return .{ .start = start, .end = text.len };
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+const testing = std.testing;
+
+/// Cluster ends of `text`, and the word ends among them
+fn expectBoundaries(text: []const u8, clusters: []const usize, words: []const usize) !void {
+    var got_clusters: [32]usize = undefined;
+    var got_words: [32]usize = undefined;
+    var cluster_count: usize = 0;
+    var word_count: usize = 0;
+    var segmenter = Segmenter.init(text);
+    while (segmenter.next()) |boundary| {
+        got_clusters[cluster_count] = boundary.index;
+        cluster_count += 1;
+        if (boundary.word) {
+            got_words[word_count] = boundary.index;
+            word_count += 1;
+        }
+    }
+    try testing.expectEqualSlices(usize, clusters, got_clusters[0..cluster_count]);
+    try testing.expectEqualSlices(usize, words, got_words[0..word_count]);
+}
+
+test "grapheme clusters" {
+    // e + combining acute, CR LF, then a flag of two regional indicators
+    // and a lone third
+    try expectBoundaries("e\u{301}\r\n\u{1F1E9}\u{1F1EA}\u{1F1EB}", &.{ 3, 5, 13, 17 }, &.{ 3, 5, 13, 17 });
+    // Woman, skin tone, ZWJ, laptop: one cluster
+    const technologist = "\u{1F469}\u{1F3FD}\u{200D}\u{1F4BB}";
+    try testing.expectEqual(technologist.len, nextGrapheme(technologist, 0));
+    // A ZWJ not after an emoji doesn't join one
+    try testing.expectEqual(@as(usize, 4), nextGrapheme("a\u{200D}\u{1F4BB}", 0));
+    // Hangul jamo L V T, then a precomposed LV syllable taking a T
+    try testing.expectEqual(@as(usize, 9), nextGrapheme("\u{1100}\u{1161}\u{11A8}", 0));
+    try testing.expectEqual(@as(usize, 6), nextGrapheme("\u{AC00}\u{11A8}", 0));
+    // Devanagari consonant and vowel sign
+    try testing.expectEqual(@as(usize, 6), nextGrapheme("\u{0915}\u{093F}", 0));
+    // Controls stand alone
+    try testing.expectEqual(@as(usize, 1), nextGrapheme("\x01\u{301}", 0));
+}
+
+test "word boundaries" {
+    try expectBoundaries("can't stop", &.{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }, &.{ 5, 6, 10 });
+    try expectBoundaries("3.14, e.g.", &.{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }, &.{ 4, 5, 6, 9, 10 });
+    try expectBoundaries("ab_c1 カタカナ", &.{ 1, 2, 3, 4, 5, 6, 9, 12, 15, 18 }, &.{ 5, 6, 18 });
+    // Ideographs are a word each
+    try expectBoundaries("日本", &.{ 3, 6 }, &.{ 3, 6 });
+}
+
+test "style markers don't split words" {
+    const text = "em\x12phasis \x01link\x02, x";
+    try testing.expectEqual(Span{ .start = 0, .end = 9 }, wordAt(text, 4));
+    // A marker joins the word before it, as an accent would
+    try testing.expectEqual(Span{ .start = 11, .end = 16 }, wordAt(text, 13));
+    // The cell separator does
+    try testing.expectEqual(Span{ .start = 0, .end = 6 }, wordAt("Apples\x1F3", 2));
+}
+
+test "word and cluster at an offset" {
+    const text = "first line\nna\u{308}ive words";
+    try testing.expectEqual(Span{ .start = 11, .end = 18 }, wordAt(text, 14));
+    try testing.expectEqual(Span{ .start = 18, .end = 19 }, wordAt(text, 18));
+    try testing.expectEqual(Span{ .start = 12, .end = 15 }, graphemeAt(text, 13));
+    try testing.expectEqual(Span{ .start = 10, .end = 11 }, graphemeAt(text, 10));
+    try testing.expectEqual(Span{ .start = text.len, .end = text.len }, wordAt(text, text.len));
+}
@@ -0,0 +1,266 @@
+//! Vulpes Browser - Shaped Word Cache
+//!
+//! Pages repeat their words, and the pages of a site repeat each other's.
+//! This cache keeps what the host's shaper made of each word, its glyph
+//! ids and advances, keyed by text style, size and the word's bytes. A
+//! word measured again, in this layout or any later one, costs a hash
+//! lookup; only a miss calls the host. The view draws runs from the same
+//! entries, so it never maps characters to glyphs twice.
+//!
+//! Glyphs, advances and words live in pools shared by every entry. Once
+//! they pass their limits the cache starts over, rather than tracking
+//! recency per word. The cache is not thread-safe.
+//!
+
+const std = @import("std");
+const metrics = @import("metrics.zig");
+
+const Font = metrics.Font;
+const FontMetrics = metrics.FontMetrics;
+const Metrics = metrics.Metrics;
+
+/// Glyphs kept before the cache starts over
+const MAX_GLYPHS = 1 << 20;
+
+/// Bytes of words kept before the cache starts over
+const MAX_TEXT_BYTES = 4 * 1024 * 1024;
+
+/// Shape `text` in `font` at `size`: write up to glyphs.len glyph ids and
+/// their advances, and return how many there are. A count past glyphs.len
+/// asks to be called again with that much room.
+pub const ShapeFn = *const fn (context: ?*anyopaque, font: Font, size: f32, text: []const u8, glyphs: []u16, advances: []f32) usize;
+
+/// A word as shaped by the host. The slices belong to the cache and are
+/// valid until its next lookup.
+pub const Shaped = struct {
+    glyphs: []const u16,
+    advances: []const f32,
+    /// Sum of the advances
+    width: f32,
+};
+
+pub const Stats = struct {
+    hits: u64 = 0,
+    misses: u64 = 0,
+};
+
+const Key = struct {
+    font: Font,
+    /// Bits of the size, so 16 and 16.5 are different words
+    size: u32,
+    hash: u64,
+};
+
+/// Offsets into the pools
+const Entry = struct {
+    text: u32,
+    text_len: u32,
+    first: u32,
+    count: u32,
+    width: f32,
+};
+
+pub const ShapeCache = struct {
+    allocator: std.mem.Allocator,
+    shape_fn: ShapeFn,
+    context: ?*anyopaque,
+
+    /// By style, size and hash of the word; the word itself is kept to
+    /// tell collisions apart
+    entries: std.AutoHashMapUnmanaged(Key, Entry) = .empty,
+    text: std.ArrayListUnmanaged(u8) = .empty,
+    glyphs: std.ArrayListUnmanaged(u16) = .empty,
+    advances: std.ArrayListUnmanaged(f32) = .empty,
+    stats: Stats = .{},
+
+    pub fn init(allocator: std.mem.Allocator, shape_fn: ShapeFn, context: ?*anyopaque) ShapeCache {
+        return .{ .allocator = allocator, .shape_fn = shape_fn, .context = context };
+    }
+
+    pub fn deinit(self: *ShapeCache) void {
+        self.entries.deinit(self.allocator);
+        self.text.deinit(self.allocator);
+        self.glyphs.deinit(self.allocator);
+        self.advances.deinit(self.allocator);
+    }
+
+    /// `text` in `font` at `size`, from the cache or the host
+    pub fn shape(self: *ShapeCache, font: Font, size: f32, text: []const u8) !Shaped {
+        const key: Key = .{ .font = font, .size = @bitCast(size), .hash = std.hash.Wyhash.hash(0, text) };
+        if (self.entries.get(key)) |entry| {
+            if (std.mem.eql(u8, self.text.items[entry.text..][0..entry.text_len], text)) {
+                self.stats.hits += 1;
+                return self.view(entry);
+            }
+        }
+        self.stats.misses += 1;
+        if (self.glyphs.items.len >= MAX_GLYPHS or self.text.items.len >= MAX_TEXT_BYTES) self.clear();
+
+        // A glyph per byte is room for any word without ligature
+        // decomposition; a host that needs more is asked again
+        const first = self.glyphs.items.len;
+        errdefer {
+            self.glyphs.shrinkRetainingCapacity(first);
+            self.advances.shrinkRetainingCapacity(first);
+        }
+        var room = @max(text.len, 1);
+        var count: usize = 0;
+        while (true) {
+            try self.glyphs.resize(self.allocator, first + room);
+            try self.advances.resize(self.allocator, first + room);
+            count = self.shape_fn(self.context, font, size, text, self.glyphs.items[first..], self.advances.items[first..]);
+            if (count <= room) break;
+            room = count;
+        }
+        self.glyphs.shrinkRetainingCapacity(first + count);
+        self.advances.shrinkRetainingCapacity(first + count);
+
+        var total: f32 = 0;
+        for (self.advances.items[first..]) |advance| total += advance;
+        const offset = self.text.items.len;
+        try self.text.appendSlice(self.allocator, text);
+        errdefer self.text.shrinkRetainingCapacity(offset);
+
+        const entry: Entry = .{
+            .text = @intCast(offset),
+            .text_len = @intCast(text.len),
+            .first = @intCast(first),
+            .count = @intCast(count),
+            .width = total,
+        };
+        try self.entries.put(self.allocator, key, entry);
+        return self.view(entry);
+    }
+
+    /// Advance width of `text`, as a MeasureFn needs it: 0 if it could not
+    /// be shaped for want of memory even after starting over
+    pub fn width(self: *ShapeCache, font: Font, size: f32, text: []const u8) f32 {
+        const shaped = self.shape(font, size, text) catch retry: {
+            self.clear();
+            break :retry self.shape(font, size, text) catch return 0;
+        };
+        return shaped.width;
+    }
+
+    /// Forget every word, keeping the memory
+    pub fn clear(self: *ShapeCache) void {
+        self.entries.clearRetainingCapacity();
+        self.text.clearRetainingCapacity();
+        self.glyphs.clearRetainingCapacity();
+        self.advances.clearRetainingCapacity();
+    }
+
+    fn view(self: *const ShapeCache, entry: Entry) Shaped {
+        return .{
+            .glyphs = self.glyphs.items[entry.first..][0..entry.count],
+            .advances = self.advances.items[entry.first..][0..entry.count],
+            .width = entry.width,
+        };
+    }
+};
+
+/// Measures for Layout.init through a cache, at the sizes of `fonts`
+pub const Measurer = struct {
+    cache: *ShapeCache,
+    fonts: std.EnumArray(Font, FontMetrics),
+
+    /// Metrics that call back into this Measurer, which must outlive them
+    pub fn asMetrics(self: *const Measurer) Metrics {
+        return .{ .fonts = self.fonts, .context = @constCast(self), .measure_fn = measure };
+    }
+
+    fn measure(context: ?*anyopaque, font: Font, text: []const u8) f32 {
+        const self: *const Measurer = @ptrCast(@alignCast(context.?));
+        return self.cache.width(font, self.fonts.get(font).size, text);
+    }
+};
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+const testing = std.testing;
+
+/// A glyph per code point, its id the code point's low bits, half an em
+/// wide; counts its calls
+const TestShaper = struct {
+    calls: usize = 0,
+    /// Glyphs per code point, as a shaper that decomposes would give
+    per_code_point: usize = 1,
+
+    fn shape(context: ?*anyopaque, _: Font, size: f32, text: []const u8, glyphs: []u16, advances: []f32) usize {
+        const self: *TestShaper = @ptrCast(@alignCast(context.?));
+        self.calls += 1;
+        var count: usize = 0;
+        var code_points = (std.unicode.Utf8View.init(text) catch unreachable).iterator();
+        while (code_points.nextCodepoint()) |cp| {
+            for (0..self.per_code_point) |_| {
+                if (count < glyphs.len) {
+                    glyphs[count] = @truncate(cp);
+                    advances[count] = size / 2 / @as(f32, @floatFromInt(self.per_code_point));
+                }
+                count += 1;
+            }
+        }
+        return count;
+    }
+};
+
+test "a word is shaped once per style and size" {
+    var shaper: TestShaper = .{};
+    var cache = ShapeCache.init(testing.allocator, TestShaper.shape, &shaper);
+    defer cache.deinit();
+
+    const word = try cache.shape(.body, 16, "wörd");
+    try testing.expectEqualSlices(u16, &.{ 'w', 0xF6, 'r', 'd' }, word.glyphs);
+    try testing.expectEqual(@as(f32, 32), word.width);
+    try testing.expectEqual(@as(f32, 32), cache.width(.body, 16, "wörd"));
+    try testing.expectEqual(@as(usize, 1), shaper.calls);
+
+    // Another style or size is another word
+    try testing.expectEqual(@as(f32, 32), cache.width(.mono, 16, "wörd"));
+    try testing.expectEqual(@as(f32, 64), cache.width(.body, 32, "wörd"));
+    try testing.expectEqual(@as(usize, 3), shaper.calls);
+    try testing.expectEqual(Stats{ .hits = 1, .misses = 3 }, cache.stats);
+
+    cache.clear();
+    _ = try cache.shape(.body, 16, "wörd");
+    try testing.expectEqual(@as(usize, 4), shaper.calls);
+}
+
+test "a host needing more room is asked again" {
+    var shaper: TestShaper = .{ .per_code_point = 3 };
+    var cache = ShapeCache.init(testing.allocator, TestShaper.shape, &shaper);
+    defer cache.deinit();
+
+    const word = try cache.shape(.body, 16, "ab");
+    try testing.expectEqualSlices(u16, &.{ 'a', 'a', 'a', 'b', 'b', 'b' }, word.glyphs);
+    try testing.expectApproxEqAbs(@as(f32, 16), word.width, 0.001);
+    try testing.expectEqual(@as(usize, 2), shaper.calls);
+    _ = try cache.shape(.body, 16, "ab");
+    try testing.expectEqual(@as(usize, 2), shaper.calls);
+}
+
+test "layouts measure through the cache" {
+    const layout = @import("layout.zig");
+    var shaper: TestShaper = .{};
+    var cache = ShapeCache.init(testing.allocator, TestShaper.shape, &shaper);
+    defer cache.deinit();
+    const measurer: Measurer = .{ .cache = &cache, .fonts = metrics.synthetic.fonts };
+    const cached = measurer.asMetrics();
+
+    // Same widths as the synthetic metrics, so the same lines
+    const text = "the cat and the hat and the bat";
+    var expected = try layout.Layout.init(testing.allocator, text, &metrics.synthetic, .{ .width = 40 + 8 * 11 });
+    defer expected.deinit();
+    var first = try layout.Layout.init(testing.allocator, text, &cached, .{ .width = 40 + 8 * 11 });
+    defer first.deinit();
+    try testing.expectEqualDeep(expected.runs.items, first.runs.items);
+    // "the" and "and" repeat
+    try testing.expectEqual(@as(usize, 5), shaper.calls);
+
+    // A second page of the same words shapes nothing
+    var second = try layout.Layout.init(testing.allocator, "and the cat", &cached, .{});
+    defer second.deinit();
+    try testing.expectEqual(@as(usize, 5), shaper.calls);
+}
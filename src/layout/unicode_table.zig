@@ -0,0 +1,218 @@
+//! Vulpes Browser - Unicode Property Tables
+//!
+//! Two-stage lookup tables built at comptime from sorted code point
+//! ranges, for line breaking and segmentation. Stage one maps each block
+//! of 256 code points to a block of stage two, which holds a value per
+//! code point. Blocks one value covers (most of the code space) share a
+//! block per value and the rest are deduplicated, so the few thousand
+//! ranges of LineBreak.txt come to about 150 blocks.
+//!
+//! DataLines reads the ranges of a UCD property file, such as
+//! LineBreak.txt, at comptime.
+//!
+
+const std = @import("std");
+
+pub fn Range(comptime T: type) type {
+    return struct { first: u21, last: u21, value: T };
+}
+
+const BLOCK_BITS = 8;
+const BLOCK_SIZE = 1 << BLOCK_BITS;
+const BLOCK_COUNT = 0x110000 >> BLOCK_BITS;
+
+pub fn Table(comptime T: type) type {
+    return struct {
+        /// Block of each 256 code points, as an index into stage2
+        stage1: [BLOCK_COUNT]u8,
+        stage2: []const [BLOCK_SIZE]T,
+
+        const Self = @This();
+
+        pub fn get(self: *const Self, cp: u21) T {
+            std.debug.assert(cp <= 0x10FFFF);
+            return self.stage2[self.stage1[cp >> BLOCK_BITS]][cp & (BLOCK_SIZE - 1)];
+        }
+
+        /// Values of U+0000 to U+007F, for lookups that skip stage one
+        pub fn ascii(comptime self: Self) [128]T {
+            return self.stage2[self.stage1[0]][0..128].*;
+        }
+    };
+}
+
+/// Table of `T`, an enum, from `ranges`, which must be sorted and
+/// disjoint. Code points no range lists take `blockDefault` of their
+/// block's first code point. Call at comptime.
+pub fn build(comptime T: type, comptime ranges: []const Range(T), comptime blockDefault: fn (u21) T) Table(T) {
+    @setEvalBranchQuota(10_000_000);
+
+    for (ranges[0 .. ranges.len - 1], ranges[1..]) |a, b| {
+        if (a.last < a.first or a.last >= b.first) @compileError("table ranges must be sorted and disjoint");
+    }
+
+    var stage1: [BLOCK_COUNT]u8 = undefined;
+    var blocks: [256][BLOCK_SIZE]T = undefined;
+    var count: usize = 0;
+    var uniform = [_]?u8{null} ** std.enums.values(T).len;
+    var next_range: usize = 0;
+
+    for (0..BLOCK_COUNT) |block_index| {
+        const first: u21 = block_index * BLOCK_SIZE;
+        const last: u21 = first + BLOCK_SIZE - 1;
+        while (next_range < ranges.len and ranges[next_range].last < first) next_range += 1;
+        const fill = blockDefault(first);
+
+        var single: ?T = null;
+        if (next_range == ranges.len or ranges[next_range].first > last) {
+            single = fill;
+        } else if (ranges[next_range].first <= first and ranges[next_range].last >= last) {
+            single = ranges[next_range].value;
+        }
+        if (single) |value| {
+            const slot = @intFromEnum(value);
+            if (uniform[slot] == null) {
+                blocks[count] = [_]T{value} ** BLOCK_SIZE;
+                uniform[slot] = count;
+                count += 1;
+            }
+            stage1[block_index] = uniform[slot].?;
+            continue;
+        }
+
+        var block = [_]T{fill} ** BLOCK_SIZE;
+        var i = next_range;
+        while (i < ranges.len and ranges[i].first <= last) : (i += 1) {
+            for (@max(ranges[i].first, first)..@min(ranges[i].last, last) + 1) |cp| {
+                block[cp - first] = ranges[i].value;
+            }
+        }
+        const index = for (blocks[0..count], 0..) |existing, k| {
+            if (std.mem.eql(T, &existing, &block)) break k;
+        } else new: {
+            if (count == blocks.len) @compileError("more distinct blocks than stage one can index");
+            blocks[count] = block;
+            count += 1;
+            break :new count - 1;
+        };
+        stage1[block_index] = index;
+    }
+
+    const stage2 = blocks[0..count].*;
+    return .{ .stage1 = stage1, .stage2 = &stage2 };
+}
+
+/// A data line of a UCD property file: "0E34..0E3A;SA     # Mn      [7]"
+pub const DataLine = struct {
+    first: u21,
+    last: u21,
+    /// Property value
+    value: []const u8,
+    /// General category, the first word of the comment; empty if none
+    category: []const u8,
+};
+
+/// The data lines of a UCD property file in order, skipping comments and
+/// blank lines. Meant for comptime; a malformed line is a compile error.
+pub const DataLines = struct {
+    lines: std.mem.TokenIterator(u8, .scalar),
+
+    pub fn init(text: []const u8) DataLines {
+        return .{ .lines = std.mem.tokenizeScalar(u8, text, '\n') };
+    }
+
+    pub fn next(self: *DataLines) ?DataLine {
+        while (self.lines.next()) |line| {
+            if (line[0] == '#') continue;
+            const hash = std.mem.indexOfScalar(u8, line, '#') orelse line.len;
+            const semicolon = std.mem.indexOfScalar(u8, line[0..hash], ';') orelse @panic("UCD line without a value");
+            const code_points = std.mem.trim(u8, line[0..semicolon], " ");
+            const dots = std.mem.indexOf(u8, code_points, "..");
+            const first = parseCodePoint(code_points[0 .. dots orelse code_points.len]);
+            const comment = std.mem.trim(u8, line[@min(hash + 1, line.len)..], " ");
+            return .{
+                .first = first,
+                .last = if (dots) |at| parseCodePoint(code_points[at + 2 ..]) else first,
+                .value = std.mem.trim(u8, line[semicolon + 1 .. hash], " "),
+                .category = comment[0 .. std.mem.indexOfScalar(u8, comment, ' ') orelse comment.len],
+            };
+        }
+        return null;
+    }
+
+    fn parseCodePoint(hex: []const u8) u21 {
+        return std.fmt.parseInt(u21, hex, 16) catch @panic("bad code point in UCD line");
+    }
+};
+
+/// Decode the code point at text[i] and its length. Malformed bytes
+/// decode one at a time as U+FFFD.
+pub fn decode(text: []const u8, i: usize) struct { u21, u3 } {
+    const c = text[i];
+    if (c < 0x80) return .{ c, 1 };
+    const len = std.unicode.utf8ByteSequenceLength(c) catch return .{ 0xFFFD, 1 };
+    if (i + len > text.len) return .{ 0xFFFD, 1 };
+    const cp = std.unicode.utf8Decode(text[i..][0..len]) catch return .{ 0xFFFD, 1 };
+    return .{ cp, len };
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "two-stage lookup" {
+    const Value = enum(u8) { none, low, high };
+    const table = comptime build(Value, &.{
+        .{ .first = 0x41, .last = 0x5A, .value = .high },
+        .{ .first = 0x300, .last = 0x4FF, .value = .low },
+        .{ .first = 0x10000, .last = 0x1FFFF, .value = .high },
+    }, struct {
+        fn blockDefault(_: u21) Value {
+            return .none;
+        }
+    }.blockDefault);
+
+    try std.testing.expectEqual(Value.high, table.get('Q'));
+    try std.testing.expectEqual(Value.none, table.get('q'));
+    try std.testing.expectEqual(Value.low, table.get(0x3FF));
+    try std.testing.expectEqual(Value.none, table.get(0x500));
+    try std.testing.expectEqual(Value.high, table.get(0x1ABCD));
+    try std.testing.expectEqual(Value.none, table.get(0x10FFFF));
+    // Uniform blocks of none, low and high, and the one ASCII block
+    try std.testing.expectEqual(@as(usize, 4), table.stage2.len);
+    try std.testing.expectEqual(Value.high, comptime table.ascii()['A']);
+}
+
+test "UCD data lines" {
+    var lines = DataLines.init(
+        \\# LineBreak.txt
+        \\
+        \\0000..0008;CM     # Cc      [9]
+        \\0020;SP           # Zs
+        \\1F3FB..1F3FF;EM
+    );
+    const range = lines.next().?;
+    try std.testing.expectEqual(@as(u21, 0), range.first);
+    try std.testing.expectEqual(@as(u21, 8), range.last);
+    try std.testing.expectEqualStrings("CM", range.value);
+    try std.testing.expectEqualStrings("Cc", range.category);
+    const space = lines.next().?;
+    try std.testing.expectEqual(@as(u21, 0x20), space.last);
+    try std.testing.expectEqualStrings("Zs", space.category);
+    const modifiers = lines.next().?;
+    try std.testing.expectEqual(@as(u21, 0x1F3FF), modifiers.last);
+    try std.testing.expectEqualStrings("", modifiers.category);
+    try std.testing.expect(lines.next() == null);
+}
+
+test "decode" {
+    var cp, var len = decode("a", 0);
+    try std.testing.expectEqual(@as(u21, 'a'), cp);
+    try std.testing.expectEqual(@as(u3, 1), len);
+    cp, len = decode("日", 0);
+    try std.testing.expectEqual(@as(u21, 0x65E5), cp);
+    try std.testing.expectEqual(@as(u3, 3), len);
+    cp, len = decode("\xE6\x97", 0);
+    try std.testing.expectEqual(@as(u21, 0xFFFD), cp);
+    try std.testing.expectEqual(@as(u3, 1), len);
+}
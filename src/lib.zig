@@ -35,9 +35,38 @@ pub const network = @import("network/http.zig");
 
 // HTML parsing and text extraction
 pub const text_extractor = @import("html/text_extractor.zig");
+pub const markdown = @import("html/markdown.zig");
+pub const stats = @import("html/stats.zig");
+pub const diff = @import("html/diff.zig");
+pub const page_style = @import("html/page_style.zig");
+pub const dom = @import("html/dom.zig");
+
+// CSS tokenizer, rule parser, selector matching and the cascade
+pub const css = @import("css/parser.zig");
+pub const css_tokenizer = @import("css/tokenizer.zig");
+pub const css_selector = @import("css/selector.zig");
+pub const css_matcher = @import("css/matcher.zig");
+pub const css_style = @import("css/style.zig");
+pub const css_cascade = @import("css/cascade.zig");
+pub const css_sheet_cache = @import("css/sheet_cache.zig");
+pub const css_media = @import("css/media.zig");
+pub const css_variables = @import("css/variables.zig");
+
+// Find-in-page
+pub const search = @import("search/index.zig");
+
+// RSS/Atom feeds
+pub const feed = @import("feed/feed.zig");
+
+// Line breaking and text layout
+pub const layout = @import("layout/layout.zig");
+pub const layout_metrics = @import("layout/metrics.zig");
+pub const layout_linebreak = @import("layout/linebreak.zig");
+pub const layout_segment = @import("layout/segment.zig");
+pub const layout_hyphenation = @import("layout/hyphenation.zig");
+pub const layout_shape_cache = @import("layout/shape_cache.zig");
 
 // TODO: Implement these modules
-// pub const layout = @import("layout/box.zig");
 // pub const render = @import("render/painter.zig");
 
 // =============================================================================
@@ -218,12 +247,80 @@ export fn vulpes_fetch_free(result: ?*VulpesFetchResult) callconv(.c) void {
 // Text Extraction API
 // =============================================================================
 
+/// One image table entry, mirrors vulpes_image_info_t.
+/// `src` points into the result text and is freed with it.
+pub const VulpesImageInfo = extern struct {
+    src: ?[*]const u8,
+    src_len: usize,
+    width: u32,
+    height: u32,
+    aspect_ratio: f32,
+};
+
+/// One structured table, mirrors vulpes_table_info_t.
+/// `column_widths` points into the result's column_widths storage.
+pub const VulpesTableInfo = extern struct {
+    start: usize,
+    end: usize,
+    rows: u32,
+    columns: u32,
+    column_widths: ?[*]const u16,
+};
+
+/// Per-stage extraction counters, mirrors vulpes_extract_stats_t.
+/// Zero unless the library was built with -Dinstrument=true.
+pub const VulpesExtractStats = extern struct {
+    instrumented: bool = false,
+    tags: u64 = 0,
+    entities: u64 = 0,
+    bytes_skipped: u64 = 0,
+    text_bytes: u64 = 0,
+    reallocations: u64 = 0,
+    ticks_tags: u64 = 0,
+    ticks_entities: u64 = 0,
+    ticks_whitespace: u64 = 0,
+    ticks_output: u64 = 0,
+};
+
+/// One page color, mirrors vulpes_color_t. `is_set` is false when the page
+/// did not declare it and the viewer's default applies.
+pub const VulpesColor = extern struct {
+    r: u8 = 0,
+    g: u8 = 0,
+    b: u8 = 0,
+    is_set: bool = false,
+};
+
+/// Colors declared by the page, mirrors vulpes_page_style_t.
+pub const VulpesPageStyle = extern struct {
+    text: VulpesColor = .{},
+    link: VulpesColor = .{},
+    background: VulpesColor = .{},
+};
+
 /// Result of text extraction.
 /// Allocated by vulpes_extract_text, must be freed with vulpes_text_free.
 pub const VulpesTextResult = extern struct {
     text: ?[*]u8,
     text_len: usize,
     error_code: c_int,
+    images: ?[*]VulpesImageInfo = null,
+    image_count: usize = 0,
+    tables: ?[*]VulpesTableInfo = null,
+    table_count: usize = 0,
+    column_widths: ?[*]u16 = null,
+    column_width_count: usize = 0,
+    search_index: ?*VulpesSearchIndex = null,
+    page_style: VulpesPageStyle = .{},
+    stats: VulpesExtractStats = .{},
+};
+
+/// Rendering context for extraction, mirrors vulpes_extract_options_t.
+/// Zero fields fall back to the engine defaults.
+pub const VulpesExtractOptions = extern struct {
+    viewport_width: u32,
+    device_scale: f32,
+    build_search_index: bool = false,
 };
 
 /// Extract visible text from HTML content.
@@ -239,25 +336,168 @@ pub const VulpesTextResult = extern struct {
 /// }
 /// ```
 export fn vulpes_extract_text(html: [*]const u8, html_len: usize) callconv(.c) ?*VulpesTextResult {
+    return vulpes_extract_text_with_options(html, html_len, null);
+}
+
+/// Extract visible text from HTML content for a given viewport.
+///
+/// The viewport width and device scale select the cheapest adequate
+/// srcset / <picture> candidate for each image.
+/// Returns a VulpesTextResult pointer. Caller must free with vulpes_text_free.
+export fn vulpes_extract_text_with_options(
+    html: [*]const u8,
+    html_len: usize,
+    c_options: ?*const VulpesExtractOptions,
+) callconv(.c) ?*VulpesTextResult {
     const html_slice = html[0..html_len];
 
-    const text = text_extractor.extractText(c_allocator, html_slice) catch {
-        const result = c_allocator.create(VulpesTextResult) catch return null;
-        result.* = .{ .text = null, .text_len = 0, .error_code = 4 }; // OUT_OF_MEMORY
-        return result;
+    var options: text_extractor.ExtractOptions = .{};
+    if (c_options) |o| {
+        if (o.viewport_width > 0) options.viewport_width = o.viewport_width;
+        if (o.device_scale > 0) options.device_scale = o.device_scale;
+        options.build_search_index = o.build_search_index;
+    }
+
+    const extraction = text_extractor.extract(c_allocator, html_slice, options) catch return outOfMemory();
+
+    const search_index = exportSearchIndex(extraction.search_index) catch {
+        extraction.deinit(c_allocator);
+        return outOfMemory();
+    };
+    defer c_allocator.free(extraction.images);
+    defer c_allocator.free(extraction.tables);
+
+    const images = exportImageTable(extraction.images) catch {
+        c_allocator.free(extraction.column_widths);
+        c_allocator.free(extraction.text);
+        vulpes_index_destroy(search_index);
+        return outOfMemory();
+    };
+
+    const tables = exportTableInfo(extraction.tables) catch {
+        if (images) |table| c_allocator.free(table[0..extraction.images.len]);
+        c_allocator.free(extraction.column_widths);
+        c_allocator.free(extraction.text);
+        vulpes_index_destroy(search_index);
+        return outOfMemory();
     };
 
     const result = c_allocator.create(VulpesTextResult) catch {
-        c_allocator.free(text);
+        if (tables) |table| c_allocator.free(table[0..extraction.tables.len]);
+        if (images) |table| c_allocator.free(table[0..extraction.images.len]);
+        c_allocator.free(extraction.column_widths);
+        c_allocator.free(extraction.text);
+        vulpes_index_destroy(search_index);
         return null;
     };
 
+    // Column widths are handed over as-is; the table entries point into them
     result.* = .{
-        .text = @constCast(text.ptr),
-        .text_len = text.len,
+        .text = extraction.text.ptr,
+        .text_len = extraction.text.len,
         .error_code = 0,
+        .images = images,
+        .image_count = extraction.images.len,
+        .tables = tables,
+        .table_count = extraction.tables.len,
+        .column_widths = if (extraction.column_widths.len > 0) extraction.column_widths.ptr else null,
+        .column_width_count = extraction.column_widths.len,
+        .search_index = search_index,
+        .page_style = .{
+            .text = exportColor(extraction.page_style.text),
+            .link = exportColor(extraction.page_style.link),
+            .background = exportColor(extraction.page_style.background),
+        },
+        .stats = exportStats(extraction.stats),
+    };
+
+    return result;
+}
+
+fn exportColor(color: ?page_style.Color) VulpesColor {
+    const c = color orelse return .{};
+    return .{ .r = c.r, .g = c.g, .b = c.b, .is_set = true };
+}
+
+fn exportStats(counters: stats.Counters) VulpesExtractStats {
+    return .{
+        .instrumented = stats.enabled,
+        .tags = counters.tags,
+        .entities = counters.entities,
+        .bytes_skipped = counters.bytes_skipped,
+        .text_bytes = counters.text_bytes,
+        .reallocations = counters.reallocations,
+        .ticks_tags = counters.ticks.get(.tags),
+        .ticks_entities = counters.ticks.get(.entities),
+        .ticks_whitespace = counters.ticks.get(.whitespace),
+        .ticks_output = counters.ticks.get(.output),
+    };
+}
+
+/// Move a search index to the heap so C can hold it. Null when none was built.
+fn exportSearchIndex(index: ?search.Index) !?*VulpesSearchIndex {
+    const built = index orelse return null;
+    const handle = try c_allocator.create(search.Index);
+    handle.* = built;
+    return @ptrCast(handle);
+}
+
+/// Copy table layouts into C layout. Returns null when there are no tables.
+fn exportTableInfo(tables: []const text_extractor.TableInfo) !?[*]VulpesTableInfo {
+    if (tables.len == 0) return null;
+    const out = try c_allocator.alloc(VulpesTableInfo, tables.len);
+    for (tables, out) |info, *entry| {
+        entry.* = .{
+            .start = info.start,
+            .end = info.end,
+            .rows = info.rows,
+            .columns = @intCast(info.column_widths.len),
+            .column_widths = if (info.column_widths.len > 0) info.column_widths.ptr else null,
+        };
+    }
+    return out.ptr;
+}
+
+/// Result carrying only OUT_OF_MEMORY, or null if even that cannot be allocated.
+fn outOfMemory() ?*VulpesTextResult {
+    const result = c_allocator.create(VulpesTextResult) catch return null;
+    result.* = .{ .text = null, .text_len = 0, .error_code = 4 }; // OUT_OF_MEMORY
+    return result;
+}
+
+/// Copy the image table into C layout. Returns null for an empty table.
+fn exportImageTable(images: []const text_extractor.ImageInfo) !?[*]VulpesImageInfo {
+    if (images.len == 0) return null;
+    const table = try c_allocator.alloc(VulpesImageInfo, images.len);
+    for (images, table) |image, *entry| {
+        entry.* = .{
+            .src = image.src.ptr,
+            .src_len = image.src.len,
+            .width = image.width,
+            .height = image.height,
+            .aspect_ratio = image.aspect_ratio,
+        };
+    }
+    return table.ptr;
+}
+
+/// Convert HTML content to CommonMark.
+///
+/// Returns a VulpesTextResult pointer whose text is Markdown (no control
+/// bytes, no side tables). Caller must free with vulpes_text_free.
+export fn vulpes_extract_markdown(html: [*]const u8, html_len: usize) callconv(.c) ?*VulpesTextResult {
+    const result = c_allocator.create(VulpesTextResult) catch return null;
+
+    const md = markdown.extractMarkdown(c_allocator, html[0..html_len]) catch {
+        result.* = .{ .text = null, .text_len = 0, .error_code = 4 }; // OUT_OF_MEMORY
+        return result;
     };
 
+    result.* = .{
+        .text = md.ptr,
+        .text_len = md.len,
+        .error_code = 0,
+    };
     return result;
 }
 
@@ -267,10 +507,516 @@ export fn vulpes_text_free(result: ?*VulpesTextResult) callconv(.c) void {
         if (r.text) |text| {
             c_allocator.free(text[0..r.text_len]);
         }
+        if (r.images) |images| {
+            c_allocator.free(images[0..r.image_count]);
+        }
+        if (r.tables) |tables| {
+            c_allocator.free(tables[0..r.table_count]);
+        }
+        if (r.column_widths) |widths| {
+            c_allocator.free(widths[0..r.column_width_count]);
+        }
+        vulpes_index_destroy(r.search_index);
+        c_allocator.destroy(r);
+    }
+}
+
+// =============================================================================
+// Search API
+// =============================================================================
+
+/// Opaque handle handed to C (vulpes_search_index_t).
+const VulpesSearchIndex = opaque {};
+
+/// One match, mirrors vulpes_match_t. Byte offsets into the indexed text.
+pub const VulpesMatch = extern struct {
+    start: usize,
+    end: usize,
+};
+
+/// Result of a find, allocated by vulpes_find, freed with vulpes_find_free.
+pub const VulpesFindResult = extern struct {
+    matches: ?[*]VulpesMatch,
+    match_count: usize,
+    error_code: c_int,
+};
+
+fn indexFromHandle(handle: *VulpesSearchIndex) *search.Index {
+    return @ptrCast(@alignCast(handle));
+}
+
+/// Build a find-in-page index over extracted text.
+///
+/// Accepts the text as returned by vulpes_extract_text; the Links/Images
+/// trailer is not indexed. Returns null on allocation failure.
+/// Free with vulpes_index_destroy.
+export fn vulpes_index_create(text: [*]const u8, text_len: usize) callconv(.c) ?*VulpesSearchIndex {
+    const body = text[0..text_extractor.bodyLength(text[0..text_len])];
+    const index = search.Index.build(c_allocator, body) catch return null;
+    return exportSearchIndex(index) catch {
+        index.deinit(c_allocator);
+        return null;
+    };
+}
+
+/// Find every occurrence of a query, in document order.
+///
+/// Matching ignores ASCII case and markers; a line break matches a space.
+/// Offsets are byte ranges in the indexed text, so they line up with the
+/// style runs built from its markers.
+/// Returns a VulpesFindResult pointer. Caller must free with vulpes_find_free.
+export fn vulpes_find(handle: *VulpesSearchIndex, query: [*]const u8, query_len: usize) callconv(.c) ?*VulpesFindResult {
+    const result = c_allocator.create(VulpesFindResult) catch return null;
+
+    const matches = indexFromHandle(handle).find(c_allocator, query[0..query_len]) catch {
+        result.* = .{ .matches = null, .match_count = 0, .error_code = 4 }; // OUT_OF_MEMORY
+        return result;
+    };
+    defer c_allocator.free(matches);
+
+    const out = c_allocator.alloc(VulpesMatch, matches.len) catch {
+        result.* = .{ .matches = null, .match_count = 0, .error_code = 4 }; // OUT_OF_MEMORY
+        return result;
+    };
+    for (matches, out) |match, *entry| {
+        entry.* = .{ .start = match.start, .end = match.end };
+    }
+
+    result.* = .{
+        .matches = if (out.len > 0) out.ptr else null,
+        .match_count = out.len,
+        .error_code = 0,
+    };
+    return result;
+}
+
+/// Free a VulpesFindResult returned by vulpes_find.
+export fn vulpes_find_free(result: ?*VulpesFindResult) callconv(.c) void {
+    if (result) |r| {
+        if (r.matches) |matches| {
+            c_allocator.free(matches[0..r.match_count]);
+        }
+        c_allocator.destroy(r);
+    }
+}
+
+/// Destroy an index from vulpes_index_create or an extraction result.
+export fn vulpes_index_destroy(handle: ?*VulpesSearchIndex) callconv(.c) void {
+    if (handle) |h| {
+        const index = indexFromHandle(h);
+        index.deinit(c_allocator);
+        c_allocator.destroy(index);
+    }
+}
+
+// =============================================================================
+// Reload Diff API
+// =============================================================================
+
+/// One changed region, mirrors vulpes_hunk_t.
+pub const VulpesHunk = extern struct {
+    old_start: u32,
+    old_count: u32,
+    new_start: u32,
+    new_count: u32,
+    new_byte_start: usize,
+    new_byte_end: usize,
+};
+
+/// Result of vulpes_diff_update, freed with vulpes_diff_free.
+pub const VulpesDiffResult = extern struct {
+    hunks: ?[*]VulpesHunk,
+    hunk_count: usize,
+    had_previous: bool,
+    error_code: c_int,
+};
+
+/// Last extracted text per URL
+var reload_cache: diff.Cache = .{};
+
+/// Compare extracted text with the text last recorded for the same URL,
+/// then record it.
+///
+/// Runs are lines of the extracted text. On the first call for a URL
+/// had_previous is false and there are no hunks; afterwards an empty hunk
+/// list means nothing changed. Thread-safe.
+/// Returns a VulpesDiffResult pointer. Caller must free with vulpes_diff_free.
+export fn vulpes_diff_update(url: [*:0]const u8, text: [*]const u8, text_len: usize) callconv(.c) ?*VulpesDiffResult {
+    const result = c_allocator.create(VulpesDiffResult) catch return null;
+
+    const update = reload_cache.update(c_allocator, std.mem.sliceTo(url, 0), text[0..text_len]) catch {
+        result.* = .{ .hunks = null, .hunk_count = 0, .had_previous = false, .error_code = 4 }; // OUT_OF_MEMORY
+        return result;
+    };
+    defer c_allocator.free(update.hunks);
+
+    const hunks = c_allocator.alloc(VulpesHunk, update.hunks.len) catch {
+        result.* = .{ .hunks = null, .hunk_count = 0, .had_previous = update.had_previous, .error_code = 4 };
+        return result;
+    };
+    for (update.hunks, hunks) |hunk, *entry| {
+        entry.* = .{
+            .old_start = hunk.old_start,
+            .old_count = hunk.old_count,
+            .new_start = hunk.new_start,
+            .new_count = hunk.new_count,
+            .new_byte_start = hunk.new_byte_start,
+            .new_byte_end = hunk.new_byte_end,
+        };
+    }
+
+    result.* = .{
+        .hunks = if (hunks.len > 0) hunks.ptr else null,
+        .hunk_count = hunks.len,
+        .had_previous = update.had_previous,
+        .error_code = 0,
+    };
+    return result;
+}
+
+/// Free a VulpesDiffResult returned by vulpes_diff_update.
+export fn vulpes_diff_free(result: ?*VulpesDiffResult) callconv(.c) void {
+    if (result) |r| {
+        if (r.hunks) |hunks| {
+            c_allocator.free(hunks[0..r.hunk_count]);
+        }
         c_allocator.destroy(r);
     }
 }
 
+/// Forget the recorded text for a URL (e.g. when its tab closes).
+export fn vulpes_diff_forget(url: [*:0]const u8) callconv(.c) void {
+    reload_cache.forget(c_allocator, std.mem.sliceTo(url, 0));
+}
+
+// =============================================================================
+// Feed API
+// =============================================================================
+
+/// One feed entry, mirrors vulpes_feed_entry_t.
+/// Pointers are valid only for the duration of the callback.
+pub const VulpesFeedEntry = extern struct {
+    title: ?[*]const u8,
+    title_len: usize,
+    link: ?[*]const u8,
+    link_len: usize,
+    date: ?[*]const u8,
+    date_len: usize,
+    timestamp: i64,
+    has_timestamp: bool,
+    summary: ?[*]const u8,
+    summary_len: usize,
+};
+
+pub const VulpesFeedEntryFn = *const fn (entry: *const VulpesFeedEntry, context: ?*anyopaque) callconv(.c) void;
+
+/// Opaque handle handed to C (vulpes_feed_parser_t).
+const VulpesFeedParser = opaque {};
+
+/// Parser plus the C callback it forwards entries to.
+const FeedSession = struct {
+    parser: feed.Parser,
+    on_entry: VulpesFeedEntryFn,
+    context: ?*anyopaque,
+
+    fn forward(entry: *const feed.Entry, context: ?*anyopaque) void {
+        const session: *FeedSession = @ptrCast(@alignCast(context.?));
+        const c_entry = VulpesFeedEntry{
+            .title = entry.title.ptr,
+            .title_len = entry.title.len,
+            .link = entry.link.ptr,
+            .link_len = entry.link.len,
+            .date = entry.date.ptr,
+            .date_len = entry.date.len,
+            .timestamp = entry.timestamp orelse 0,
+            .has_timestamp = entry.timestamp != null,
+            .summary = entry.summary.ptr,
+            .summary_len = entry.summary.len,
+        };
+        session.on_entry(&c_entry, session.context);
+    }
+
+    fn fromHandle(handle: *VulpesFeedParser) *FeedSession {
+        return @ptrCast(@alignCast(handle));
+    }
+};
+
+/// Create a streaming feed parser. Entries are delivered to `on_entry`
+/// synchronously from vulpes_feed_push / vulpes_feed_finish.
+/// Returns null on allocation failure. Free with vulpes_feed_destroy.
+export fn vulpes_feed_create(on_entry: VulpesFeedEntryFn, context: ?*anyopaque) callconv(.c) ?*VulpesFeedParser {
+    const session = c_allocator.create(FeedSession) catch return null;
+    session.* = .{
+        .parser = feed.Parser.init(c_allocator, FeedSession.forward, session) catch {
+            c_allocator.destroy(session);
+            return null;
+        },
+        .on_entry = on_entry,
+        .context = context,
+    };
+    return @ptrCast(session);
+}
+
+/// Feed the next chunk of a feed document.
+/// Returns 0 on success, 4 (OUT_OF_MEMORY) if a summary could not be extracted.
+export fn vulpes_feed_push(handle: *VulpesFeedParser, data: [*]const u8, len: usize) callconv(.c) c_int {
+    FeedSession.fromHandle(handle).parser.push(data[0..len]) catch return 4;
+    return 0;
+}
+
+/// Signal end of input; reports an entry left open by a truncated feed.
+export fn vulpes_feed_finish(handle: *VulpesFeedParser) callconv(.c) c_int {
+    FeedSession.fromHandle(handle).parser.finish() catch return 4;
+    return 0;
+}
+
+/// Destroy a parser created by vulpes_feed_create.
+export fn vulpes_feed_destroy(handle: ?*VulpesFeedParser) callconv(.c) void {
+    if (handle) |h| {
+        const session = FeedSession.fromHandle(h);
+        session.parser.deinit();
+        c_allocator.destroy(session);
+    }
+}
+
+// =============================================================================
+// Layout API
+// =============================================================================
+
+/// Mirrors vulpes_font_metrics_t
+pub const VulpesFontMetrics = layout_metrics.FontMetrics;
+
+/// Advance width of a UTF-8 span in one of the vulpes_font_t styles
+pub const VulpesMeasureFn = *const fn (context: ?*anyopaque, font: u8, text: [*]const u8, len: usize) callconv(.c) f32;
+
+/// Glyph ids and advances of a UTF-8 span in a style at an em size
+pub const VulpesShapeFn = *const fn (context: ?*anyopaque, font: u8, size: f32, text: [*]const u8, len: usize, glyphs: [*]u16, advances: [*]f32, capacity: usize) callconv(.c) usize;
+
+/// Mirrors vulpes_shaped_word_t
+pub const VulpesShapedWord = extern struct {
+    glyphs: ?[*]const u16,
+    advances: ?[*]const f32,
+    count: usize,
+    width: f32,
+};
+
+/// Mirrors vulpes_layout_options_t
+pub const VulpesLayoutOptions = extern struct {
+    width: f32,
+    margin: f32,
+    quote_indent: f32,
+    max_line_width: f32,
+    max_image_width: f32,
+    line_breaking: u8,
+    hyphenate: u8,
+    fonts: [layout_metrics.FONT_COUNT]VulpesFontMetrics,
+    measure: ?VulpesMeasureFn,
+    measure_context: ?*anyopaque,
+    shape_cache: ?*VulpesShapeCache,
+    images: ?[*]const layout.ImageHint,
+    image_count: usize,
+};
+
+/// Mirrors vulpes_layout_boxes_t. Arrays belong to the render tree.
+pub const VulpesLayoutBoxes = extern struct {
+    lines: ?[*]const layout.Line,
+    line_count: usize,
+    runs: ?[*]const layout.Run,
+    run_count: usize,
+    images: ?[*]const layout.ImageBox,
+    image_count: usize,
+    height: f32,
+};
+
+/// Mirrors vulpes_layout_range_t
+pub const VulpesLayoutRange = layout.Range;
+
+/// Opaque handle handed to C (vulpes_render_tree_t).
+const VulpesRenderTree = opaque {};
+
+/// Opaque handle handed to C (vulpes_shape_cache_t).
+const VulpesShapeCache = opaque {};
+
+/// Host measuring callback, as layout's MeasureFn.
+const HostMeasure = struct {
+    measure: VulpesMeasureFn,
+    context: ?*anyopaque,
+
+    fn forward(context: ?*anyopaque, font: layout_metrics.Font, text: []const u8) f32 {
+        const host: *const HostMeasure = @ptrCast(@alignCast(context.?));
+        return host.measure(host.context, @intFromEnum(font), text.ptr, text.len);
+    }
+};
+
+/// Host shaping callback, as the shape cache's ShapeFn.
+const HostShape = struct {
+    shape: VulpesShapeFn,
+    context: ?*anyopaque,
+
+    fn forward(context: ?*anyopaque, font: layout_metrics.Font, size: f32, text: []const u8, glyphs: []u16, advances: []f32) usize {
+        const host: *const HostShape = @ptrCast(@alignCast(context.?));
+        return host.shape(host.context, @intFromEnum(font), size, text.ptr, text.len, glyphs.ptr, advances.ptr, glyphs.len);
+    }
+};
+
+/// A shape cache and the host callback it calls, at a fixed address
+const HostShapeCache = struct {
+    cache: layout_shape_cache.ShapeCache,
+    host: HostShape,
+};
+
+fn treeFromHandle(handle: *VulpesRenderTree) *layout.Layout {
+    return @ptrCast(@alignCast(handle));
+}
+
+fn shapeCacheFromHandle(handle: *VulpesShapeCache) *HostShapeCache {
+    return @ptrCast(@alignCast(handle));
+}
+
+/// Lay out extracted text into line boxes, glyph runs and image boxes.
+///
+/// Accepts the text as returned by vulpes_extract_text; the Links/Images
+/// trailer is not laid out. Spans are measured through `shape_cache` if
+/// set, else `measure`, which is called only during this call.
+/// Returns null on allocation failure or with neither set. Free with
+/// vulpes_layout_destroy.
+export fn vulpes_layout(text: [*]const u8, text_len: usize, options: *const VulpesLayoutOptions) callconv(.c) ?*VulpesRenderTree {
+    const body = text[0..text_extractor.bodyLength(text[0..text_len])];
+
+    var fonts: std.EnumArray(layout_metrics.Font, VulpesFontMetrics) = undefined;
+    for (std.enums.values(layout_metrics.Font), options.fonts) |font, entry| {
+        fonts.set(font, entry);
+    }
+    var host: HostMeasure = undefined;
+    var measurer: layout_shape_cache.Measurer = undefined;
+    var font_metrics: layout_metrics.Metrics = undefined;
+    if (options.shape_cache) |handle| {
+        measurer = .{ .cache = &shapeCacheFromHandle(handle).cache, .fonts = fonts };
+        font_metrics = measurer.asMetrics();
+    } else {
+        host = .{ .measure = options.measure orelse return null, .context = options.measure_context };
+        font_metrics = .{ .fonts = fonts, .context = &host, .measure_fn = HostMeasure.forward };
+    }
+
+    const tree = c_allocator.create(layout.Layout) catch return null;
+    tree.* = layout.Layout.init(c_allocator, body, &font_metrics, .{
+        .width = options.width,
+        .margin = options.margin,
+        .quote_indent = options.quote_indent,
+        .max_line_width = options.max_line_width,
+        .max_image_width = options.max_image_width,
+        .breaking = std.meta.intToEnum(layout.Breaking, options.line_breaking) catch .greedy,
+        .hyphenate = options.hyphenate != 0,
+        .images = if (options.images) |images| images[0..options.image_count] else &.{},
+    }) catch {
+        c_allocator.destroy(tree);
+        return null;
+    };
+    return @ptrCast(tree);
+}
+
+/// Break the text again for a new viewport width or readable-width cap.
+/// Nothing is measured. Boxes from vulpes_layout_boxes are invalidated.
+/// Returns 0 on success, 4 (OUT_OF_MEMORY) on failure.
+export fn vulpes_layout_resize(handle: *VulpesRenderTree, width: f32, max_line_width: f32) callconv(.c) c_int {
+    treeFromHandle(handle).resize(width, max_line_width) catch return 4;
+    return 0;
+}
+
+/// The tree's boxes, valid until the next resize or destroy.
+export fn vulpes_layout_boxes(handle: *VulpesRenderTree) callconv(.c) VulpesLayoutBoxes {
+    const tree = treeFromHandle(handle);
+    return .{
+        .lines = tree.lines.items.ptr,
+        .line_count = tree.lines.items.len,
+        .runs = tree.runs.items.ptr,
+        .run_count = tree.runs.items.len,
+        .images = tree.images.items.ptr,
+        .image_count = tree.images.items.len,
+        .height = tree.height,
+    };
+}
+
+/// Boxes meeting the band [top - overscan, bottom + overscan), as index
+/// ranges into vulpes_layout_boxes. Binary search over the lines, so the
+/// cost does not grow with the page.
+export fn vulpes_layout_visible(handle: *VulpesRenderTree, top: f32, bottom: f32, overscan: f32) callconv(.c) VulpesLayoutRange {
+    return treeFromHandle(handle).visible(top, bottom, overscan);
+}
+
+/// Destroy a render tree from vulpes_layout.
+export fn vulpes_layout_destroy(handle: ?*VulpesRenderTree) callconv(.c) void {
+    if (handle) |h| {
+        const tree = treeFromHandle(h);
+        tree.deinit();
+        c_allocator.destroy(tree);
+    }
+}
+
+/// Create a cache of shaped words for vulpes_layout and drawing.
+/// Returns null on allocation failure. Free with vulpes_shape_cache_destroy.
+export fn vulpes_shape_cache_create(shape: VulpesShapeFn, context: ?*anyopaque) callconv(.c) ?*VulpesShapeCache {
+    const handle = c_allocator.create(HostShapeCache) catch return null;
+    handle.host = .{ .shape = shape, .context = context };
+    handle.cache = layout_shape_cache.ShapeCache.init(c_allocator, HostShape.forward, &handle.host);
+    return @ptrCast(handle);
+}
+
+/// Glyphs and advances of a UTF-8 span in a vulpes_font_t style, shaped
+/// by the host on a miss. Valid until the cache's next lookup or layout;
+/// count is 0 on allocation failure or an unknown style.
+export fn vulpes_shape_cache_lookup(handle: *VulpesShapeCache, font: u8, size: f32, text: [*]const u8, text_len: usize) callconv(.c) VulpesShapedWord {
+    const empty: VulpesShapedWord = .{ .glyphs = null, .advances = null, .count = 0, .width = 0 };
+    const style = std.meta.intToEnum(layout_metrics.Font, font) catch return empty;
+    const shaped = shapeCacheFromHandle(handle).cache.shape(style, size, text[0..text_len]) catch return empty;
+    return .{
+        .glyphs = shaped.glyphs.ptr,
+        .advances = shaped.advances.ptr,
+        .count = shaped.glyphs.len,
+        .width = shaped.width,
+    };
+}
+
+/// Destroy a shape cache from vulpes_shape_cache_create.
+export fn vulpes_shape_cache_destroy(handle: ?*VulpesShapeCache) callconv(.c) void {
+    if (handle) |h| {
+        const shape_cache = shapeCacheFromHandle(h);
+        shape_cache.cache.deinit();
+        c_allocator.destroy(shape_cache);
+    }
+}
+
+// =============================================================================
+// Text Segmentation API
+// =============================================================================
+
+/// A byte range, mirrors vulpes_span_t.
+pub const VulpesSpan = extern struct {
+    start: usize,
+    end: usize,
+};
+
+fn exportSpan(span: layout_segment.Span) VulpesSpan {
+    return .{ .start = span.start, .end = span.end };
+}
+
+/// End of the grapheme cluster starting at byte `offset` of UTF-8 text:
+/// the next place a cursor may stop. Returns text_len at or past the end.
+export fn vulpes_next_grapheme(text: [*]const u8, text_len: usize, offset: usize) callconv(.c) usize {
+    return layout_segment.nextGrapheme(text[0..text_len], offset);
+}
+
+/// The grapheme cluster containing byte `offset`.
+export fn vulpes_grapheme_at(text: [*]const u8, text_len: usize, offset: usize) callconv(.c) VulpesSpan {
+    return exportSpan(layout_segment.graphemeAt(text[0..text_len], offset));
+}
+
+/// The word, or run of spaces or punctuation, containing byte `offset`:
+/// what a double click selects. Style markers do not end words.
+export fn vulpes_word_at(text: [*]const u8, text_len: usize, offset: usize) callconv(.c) VulpesSpan {
+    return exportSpan(layout_segment.wordAt(text[0..text_len], offset));
+}
+
 // =============================================================================
 // Tests
 // =============================================================================
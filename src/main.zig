@@ -2,10 +2,18 @@
 //!
 //! Quick test harness for verifying HTTP fetch and HTML extraction.
 //! Usage: zig build run -- https://example.com
+//! Add -Dinstrument=true to print per-stage extraction counters and
+//! style-sharing stats for the page.
 
 const std = @import("std");
 const http = @import("network/http.zig");
 const text_extractor = @import("html/text_extractor.zig");
+const stats = @import("html/stats.zig");
+const dom = @import("html/dom.zig");
+const css = @import("css/parser.zig");
+const matcher = @import("css/matcher.zig");
+const cascade = @import("css/cascade.zig");
+const media = @import("css/media.zig");
 
 pub fn main() !void {
     const allocator = std.heap.page_allocator;
@@ -39,11 +47,12 @@ pub fn main() !void {
 
     // Extract text from HTML
     const extract_start = std.time.milliTimestamp();
-    const text = text_extractor.extractText(allocator, response.body) catch |err| {
+    const extraction = text_extractor.extract(allocator, response.body, .{}) catch |err| {
         std.debug.print("Extract error: {}\n", .{err});
         return;
     };
-    defer allocator.free(text);
+    defer extraction.deinit(allocator);
+    const text = extraction.text;
 
     const extract_time = std.time.milliTimestamp() - extract_start;
     const total_time = std.time.milliTimestamp() - start;
@@ -51,8 +60,64 @@ pub fn main() !void {
     std.debug.print("Text size: {d} bytes\n", .{text.len});
     std.debug.print("Extract time: {d}ms\n", .{extract_time});
     std.debug.print("Total time: {d}ms\n", .{total_time});
+    if (stats.enabled) {
+        printStats(extraction.stats);
+        printStyleStats(allocator, response.body) catch |err| {
+            std.debug.print("Style error: {}\n", .{err});
+        };
+    }
     std.debug.print("\n--- Extracted Text ---\n", .{});
 
     const preview_len = @min(text.len, 1000);
     std.debug.print("{s}\n", .{text[0..preview_len]});
 }
+
+fn printStats(counters: stats.Counters) void {
+    std.debug.print("\n--- Extraction Stats ---\n", .{});
+    std.debug.print("Tags: {d}\n", .{counters.tags});
+    std.debug.print("Entities: {d}\n", .{counters.entities});
+    std.debug.print("Bytes skipped: {d}\n", .{counters.bytes_skipped});
+    std.debug.print("Text bytes: {d}\n", .{counters.text_bytes});
+    std.debug.print("Reallocations: {d}\n", .{counters.reallocations});
+
+    var total: u64 = 0;
+    for (counters.ticks.values) |ticks| total += ticks;
+    for (std.enums.values(stats.Stage)) |stage| {
+        const ticks = counters.ticks.get(stage);
+        const percent = if (total > 0) @as(f64, @floatFromInt(ticks)) * 100.0 / @as(f64, @floatFromInt(total)) else 0;
+        std.debug.print("Ticks {s}: {d} ({d:.1}%)\n", .{ @tagName(stage), ticks, percent });
+    }
+}
+
+/// Style the page with its own <style> sheets and report sharing
+fn printStyleStats(allocator: std.mem.Allocator, html: []const u8) !void {
+    const doc = try dom.parse(allocator, html);
+    defer doc.deinit();
+
+    var user_agent = try cascade.UserAgent.init(allocator);
+    defer user_agent.deinit();
+    const author_css = try std.mem.join(allocator, "\n", doc.style_sheets);
+    defer allocator.free(author_css);
+    const author = try css.parse(allocator, author_css);
+    defer author.deinit();
+    var index = try matcher.RuleIndex.build(allocator, &author);
+    defer index.deinit();
+    var view = try media.ViewportIndex.init(allocator, &author, &index, .{});
+    defer view.deinit();
+
+    const sheets = [_]cascade.Sheet{ user_agent.sheet(), view.sheet() };
+    var styled = try cascade.cascade(allocator, &doc, &sheets);
+    defer styled.deinit(allocator);
+
+    const counts = styled.stats;
+    std.debug.print("\n--- Style Stats ---\n", .{});
+    std.debug.print("Elements: {d}\n", .{counts.elements});
+    std.debug.print("Rules in viewport: {d} of {d}\n", .{ view.index.entries.len, index.entries.len });
+    std.debug.print("Shared with sibling: {d}\n", .{counts.sibling_hits});
+    std.debug.print("Shared with cousin: {d}\n", .{counts.cousin_hits});
+    std.debug.print("Cascaded: {d}\n", .{counts.misses});
+    std.debug.print("Hit rate: {d:.1}%\n", .{counts.hitRate() * 100});
+    std.debug.print("Unique styles: {d}\n", .{counts.unique_styles});
+    std.debug.print("Variable scopes: {d}\n", .{counts.variable_scopes});
+    std.debug.print("Bytes saved: {d}\n", .{counts.bytesSaved()});
+}
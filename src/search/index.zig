@@ -0,0 +1,399 @@
+//! Vulpes Browser - In-Page Search Index
+//!
+//! Suffix array over the extracted page text for find-in-page. Built once
+//! per page, after which every query is two binary searches over the
+//! sorted suffixes - O(m log n) for a query of m bytes - instead of a scan
+//! of the whole document. Reference manuals run to megabytes of text, and
+//! find-as-you-type issues a query per keystroke.
+//!
+//! The index covers what the user sees:
+//!   - Control markers (links, emphasis, headings, tables) are dropped
+//!   - Image placeholders, including their numbers, are dropped
+//!   - Line breaks, tabs and cell separators match a space
+//!   - ASCII letters match case-insensitively
+//!   - Matches start and end on grapheme cluster boundaries, so "cafe"
+//!     does not match the front of "cafe" + COMBINING ACUTE ACCENT
+//!
+//! Matches are reported as byte ranges in the original extracted text, so
+//! they line up with the style runs the renderer builds from the markers.
+//!
+
+const std = @import("std");
+const segment = @import("../layout/segment.zig");
+
+/// Text extractor's image placeholder delimiter (see text_extractor.zig)
+const IMAGE_MARKER: u8 = 0x1E;
+/// Text extractor's table cell separator
+const CELL_SEP: u8 = 0x1F;
+
+/// A match as a byte range in the indexed text
+pub const Match = struct {
+    start: usize,
+    end: usize,
+};
+
+/// Start of a stretch of searchable bytes copied verbatim from the text.
+/// Every dropped marker ends one run and the next kept byte starts another.
+const Run = struct {
+    plain_start: u32,
+    text_start: u32,
+};
+
+pub const Index = struct {
+    /// Searchable bytes: markers removed, whitespace mapped, ASCII lowercased
+    plain: []u8,
+    /// Start offsets into `plain`, sorted by the suffix at each offset
+    suffixes: []u32,
+    /// Maps `plain` offsets back to text offsets, ascending
+    runs: []Run,
+    /// `plain` offsets of code points that continue a grapheme cluster,
+    /// ascending; a match may neither start nor end at one
+    joins: []u32,
+
+    /// Index the body of extracted text (without the Links/Images trailer).
+    pub fn build(allocator: std.mem.Allocator, text: []const u8) !Index {
+        if (text.len >= std.math.maxInt(u32)) return error.TextTooLarge;
+
+        var plain: std.ArrayListUnmanaged(u8) = .empty;
+        errdefer plain.deinit(allocator);
+        var runs: std.ArrayListUnmanaged(Run) = .empty;
+        errdefer runs.deinit(allocator);
+        var joins: std.ArrayListUnmanaged(u32) = .empty;
+        errdefer joins.deinit(allocator);
+        try plain.ensureTotalCapacity(allocator, text.len);
+
+        var in_image = false;
+        var run_open = false;
+        var cluster_end: usize = 0;
+        for (text, 0..) |c, i| {
+            const joined = i < cluster_end;
+            if (!joined) cluster_end = segment.nextGrapheme(text, i);
+            if (c == IMAGE_MARKER) {
+                in_image = !in_image;
+                run_open = false;
+                continue;
+            }
+            const searchable: ?u8 = if (in_image)
+                null
+            else if (c == '\n' or c == '\t' or c == '\r' or c == CELL_SEP)
+                ' '
+            else if (c < 0x20)
+                null
+            else
+                std.ascii.toLower(c);
+
+            if (searchable) |byte| {
+                if (!run_open) {
+                    try runs.append(allocator, .{
+                        .plain_start = @intCast(plain.items.len),
+                        .text_start = @intCast(i),
+                    });
+                    run_open = true;
+                }
+                // Continuation bytes never start a match of a UTF-8 query
+                if (joined and c & 0xC0 != 0x80) {
+                    try joins.append(allocator, @intCast(plain.items.len));
+                }
+                plain.appendAssumeCapacity(byte);
+            } else {
+                run_open = false;
+            }
+        }
+
+        const suffixes = try buildSuffixArray(allocator, plain.items);
+        errdefer allocator.free(suffixes);
+        const owned_runs = try runs.toOwnedSlice(allocator);
+        errdefer allocator.free(owned_runs);
+        const owned_joins = try joins.toOwnedSlice(allocator);
+        errdefer allocator.free(owned_joins);
+
+        return .{
+            .plain = try plain.toOwnedSlice(allocator),
+            .suffixes = suffixes,
+            .runs = owned_runs,
+            .joins = owned_joins,
+        };
+    }
+
+    pub fn deinit(self: Index, allocator: std.mem.Allocator) void {
+        allocator.free(self.joins);
+        allocator.free(self.runs);
+        allocator.free(self.suffixes);
+        allocator.free(self.plain);
+    }
+
+    /// Every occurrence of `query`, in document order.
+    /// Caller owns the returned slice.
+    pub fn find(self: Index, allocator: std.mem.Allocator, query: []const u8) ![]Match {
+        const range = self.equalRange(query);
+        const hits = self.suffixes[range.start..range.end];
+
+        const positions = try allocator.alloc(u32, hits.len);
+        defer allocator.free(positions);
+        var kept: usize = 0;
+        for (hits) |pos| {
+            if (!self.whole(pos, query.len)) continue;
+            positions[kept] = pos;
+            kept += 1;
+        }
+        std.mem.sort(u32, positions[0..kept], {}, std.sort.asc(u32));
+
+        const matches = try allocator.alloc(Match, kept);
+        for (matches, positions[0..kept]) |*match, pos| {
+            // Map the last byte rather than the end, which may sit past a marker
+            match.* = .{
+                .start = self.toText(pos),
+                .end = self.toText(pos + @as(u32, @intCast(query.len)) - 1) + 1,
+            };
+        }
+        return matches;
+    }
+
+    /// Number of occurrences of `query`, without materialising them.
+    pub fn count(self: Index, query: []const u8) usize {
+        const range = self.equalRange(query);
+        if (self.joins.len == 0) return range.end - range.start;
+        var n: usize = 0;
+        for (self.suffixes[range.start..range.end]) |pos| {
+            if (self.whole(pos, query.len)) n += 1;
+        }
+        return n;
+    }
+
+    /// Whether a match of `len` bytes at `pos` covers whole grapheme clusters.
+    fn whole(self: Index, pos: u32, len: usize) bool {
+        if (self.joins.len == 0) return true;
+        return !self.isJoin(pos) and !self.isJoin(pos + @as(u32, @intCast(len)));
+    }
+
+    fn isJoin(self: Index, plain_offset: u32) bool {
+        var lo: usize = 0;
+        var hi: usize = self.joins.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.joins[mid] < plain_offset) lo = mid + 1 else hi = mid;
+        }
+        return lo < self.joins.len and self.joins[lo] == plain_offset;
+    }
+
+    /// The block of `suffixes` whose suffixes start with `query`.
+    fn equalRange(self: Index, query: []const u8) struct { start: usize, end: usize } {
+        if (query.len == 0 or query.len > self.plain.len) return .{ .start = 0, .end = 0 };
+
+        // First suffix not ordered before the query
+        var lo: usize = 0;
+        var hi: usize = self.suffixes.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.compare(self.suffixes[mid], query) == .lt) lo = mid + 1 else hi = mid;
+        }
+        const start = lo;
+
+        // First suffix ordered after the query
+        hi = self.suffixes.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.compare(self.suffixes[mid], query) == .gt) hi = mid else lo = mid + 1;
+        }
+        return .{ .start = start, .end = lo };
+    }
+
+    /// Order the suffix at `pos` against `query`; `.eq` means it starts
+    /// with the query.
+    fn compare(self: Index, pos: u32, query: []const u8) std.math.Order {
+        const suffix = self.plain[pos..];
+        const len = @min(suffix.len, query.len);
+        for (suffix[0..len], query[0..len]) |a, b| {
+            const folded = if (b == '\n' or b == '\t' or b == '\r') ' ' else std.ascii.toLower(b);
+            if (a != folded) return std.math.order(a, folded);
+        }
+        return if (suffix.len < query.len) .lt else .eq;
+    }
+
+    /// Text offset of a `plain` offset.
+    fn toText(self: Index, plain_offset: u32) usize {
+        // Last run starting at or before the offset
+        var lo: usize = 0;
+        var hi: usize = self.runs.len;
+        while (hi - lo > 1) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.runs[mid].plain_start <= plain_offset) lo = mid else hi = mid;
+        }
+        const run = self.runs[lo];
+        return run.text_start + (plain_offset - run.plain_start);
+    }
+};
+
+/// Suffix array by prefix doubling with counting sorts, O(n log n).
+/// Each round sorts suffixes by their first 2k bytes using the ranks of
+/// the first k, so no suffix is ever compared byte by byte.
+fn buildSuffixArray(allocator: std.mem.Allocator, s: []const u8) ![]u32 {
+    const n = s.len;
+    const sa = try allocator.alloc(u32, n);
+    errdefer allocator.free(sa);
+    if (n == 0) return sa;
+
+    const rank = try allocator.alloc(u32, n);
+    defer allocator.free(rank);
+    const tmp = try allocator.alloc(u32, n);
+    defer allocator.free(tmp);
+    const counts = try allocator.alloc(u32, @max(n, 256) + 1);
+    defer allocator.free(counts);
+
+    // Round zero: bucket by first byte
+    @memset(counts[0..257], 0);
+    for (s) |c| counts[@as(usize, c) + 1] += 1;
+    for (1..257) |c| counts[c] += counts[c - 1];
+    for (s, 0..) |c, i| {
+        sa[counts[c]] = @intCast(i);
+        counts[c] += 1;
+    }
+    var classes: u32 = 1;
+    rank[sa[0]] = 0;
+    for (1..n) |j| {
+        if (s[sa[j]] != s[sa[j - 1]]) classes += 1;
+        rank[sa[j]] = classes - 1;
+    }
+
+    var k: usize = 1;
+    while (classes < n) : (k *= 2) {
+        // Order by second key: suffixes shorter than k have none and go first
+        var t: usize = 0;
+        for (n - @min(k, n)..n) |i| {
+            tmp[t] = @intCast(i);
+            t += 1;
+        }
+        for (sa) |pos| {
+            if (pos >= k) {
+                tmp[t] = @intCast(pos - k);
+                t += 1;
+            }
+        }
+
+        // Stable counting sort by first key
+        @memset(counts[0 .. classes + 1], 0);
+        for (tmp) |pos| counts[rank[pos] + 1] += 1;
+        for (1..classes + 1) |c| counts[c] += counts[c - 1];
+        for (tmp) |pos| {
+            sa[counts[rank[pos]]] = pos;
+            counts[rank[pos]] += 1;
+        }
+
+        // Renumber classes by (first key, second key)
+        classes = 1;
+        tmp[sa[0]] = 0;
+        for (1..n) |j| {
+            const a = sa[j - 1];
+            const b = sa[j];
+            if (rank[a] != rank[b] or secondKey(rank, a + k) != secondKey(rank, b + k)) classes += 1;
+            tmp[b] = classes - 1;
+        }
+        @memcpy(rank, tmp);
+    }
+    return sa;
+}
+
+/// Rank of the suffix k bytes further on, with 0 for "ran off the end".
+fn secondKey(rank: []const u32, pos: usize) u32 {
+    return if (pos < rank.len) rank[pos] + 1 else 0;
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+test "suffix array sorts suffixes" {
+    const allocator = std.testing.allocator;
+    const inputs = [_][]const u8{ "banana", "mississippi", "aaaaaaa", "a", "abcabcabcx" };
+    for (inputs) |input| {
+        const sa = try buildSuffixArray(allocator, input);
+        defer allocator.free(sa);
+        try std.testing.expectEqual(input.len, sa.len);
+        for (1..sa.len) |j| {
+            try std.testing.expect(std.mem.order(u8, input[sa[j - 1]..], input[sa[j]..]) == .lt);
+        }
+    }
+}
+
+test "banana suffix order" {
+    const allocator = std.testing.allocator;
+    const sa = try buildSuffixArray(allocator, "banana");
+    defer allocator.free(sa);
+    try std.testing.expectEqualSlices(u32, &[_]u32{ 5, 3, 1, 0, 4, 2 }, sa);
+}
+
+test "find returns every match in document order" {
+    const allocator = std.testing.allocator;
+    const index = try Index.build(allocator, "the cat sat on the mat with the hat");
+    defer index.deinit(allocator);
+
+    const matches = try index.find(allocator, "the");
+    defer allocator.free(matches);
+    try std.testing.expectEqual(@as(usize, 3), matches.len);
+    try std.testing.expectEqual(@as(usize, 0), matches[0].start);
+    try std.testing.expectEqual(@as(usize, 15), matches[1].start);
+    try std.testing.expectEqual(@as(usize, 28), matches[2].start);
+    try std.testing.expectEqual(@as(usize, 31), matches[2].end);
+    try std.testing.expectEqual(@as(usize, 4), index.count("at"));
+    try std.testing.expectEqual(@as(usize, 0), index.count("dog"));
+    try std.testing.expectEqual(@as(usize, 0), index.count(""));
+}
+
+test "search is ASCII case-insensitive" {
+    const allocator = std.testing.allocator;
+    const index = try Index.build(allocator, "Zig and ZIG and zig");
+    defer index.deinit(allocator);
+    try std.testing.expectEqual(@as(usize, 3), index.count("zIg"));
+}
+
+test "markers are invisible and offsets map back to the text" {
+    const allocator = std.testing.allocator;
+    // "see " LINK_START "the docs" LINK_END ", " IMAGE "12" IMAGE " done"
+    const text = "see \x01the docs\x02, \x1e12\x1e done";
+    const index = try Index.build(allocator, text);
+    defer index.deinit(allocator);
+
+    // Spans the link start marker
+    const matches = try index.find(allocator, "see the");
+    defer allocator.free(matches);
+    try std.testing.expectEqual(@as(usize, 1), matches.len);
+    try std.testing.expectEqualStrings("see \x01the", text[matches[0].start..matches[0].end]);
+
+    // Image numbers are not text
+    try std.testing.expectEqual(@as(usize, 0), index.count("12"));
+    try std.testing.expectEqual(@as(usize, 1), index.count(",  done"));
+}
+
+test "line breaks and cell separators match spaces" {
+    const allocator = std.testing.allocator;
+    const index = try Index.build(allocator, "end of\nline\x1fnext cell");
+    defer index.deinit(allocator);
+    try std.testing.expectEqual(@as(usize, 1), index.count("of line"));
+    try std.testing.expectEqual(@as(usize, 1), index.count("line next"));
+    try std.testing.expectEqual(@as(usize, 1), index.count("of\nline"));
+}
+
+test "matches cover whole grapheme clusters" {
+    const allocator = std.testing.allocator;
+    // "cafe" + COMBINING ACUTE ACCENT, then plain "cafe"
+    const index = try Index.build(allocator, "cafe\u{301} and cafe, \u{1F44D}\u{1F3FD}");
+    defer index.deinit(allocator);
+
+    const matches = try index.find(allocator, "cafe");
+    defer allocator.free(matches);
+    try std.testing.expectEqual(@as(usize, 1), matches.len);
+    try std.testing.expectEqual(@as(usize, 11), matches[0].start);
+    try std.testing.expectEqual(@as(usize, 1), index.count("cafe\u{301}"));
+    // The thumb alone is the front of a thumb with a skin tone
+    try std.testing.expectEqual(@as(usize, 0), index.count("\u{1F44D}"));
+    try std.testing.expectEqual(@as(usize, 1), index.count("\u{1F44D}\u{1F3FD}"));
+}
+
+test "empty text" {
+    const allocator = std.testing.allocator;
+    const index = try Index.build(allocator, "");
+    defer index.deinit(allocator);
+    const matches = try index.find(allocator, "x");
+    defer allocator.free(matches);
+    try std.testing.expectEqual(@as(usize, 0), matches.len);
+}
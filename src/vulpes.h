@@ -119,10 +119,31 @@ typedef struct vulpes_context vulpes_context_t;
 typedef struct vulpes_document vulpes_document_t;
 
 /**
- * Render tree - layout and painting information.
+ * Render tree - line boxes, glyph runs and image boxes for extracted text.
+ * Create with vulpes_layout(), destroy with vulpes_layout_destroy().
  */
 typedef struct vulpes_render_tree vulpes_render_tree_t;
 
+/**
+ * Streaming RSS/Atom parser.
+ * Create with vulpes_feed_create(), destroy with vulpes_feed_destroy().
+ */
+typedef struct vulpes_feed_parser vulpes_feed_parser_t;
+
+/**
+ * Find-in-page index over extracted text.
+ * Create with vulpes_index_create() or the build_search_index extraction
+ * option, destroy with vulpes_index_destroy().
+ */
+typedef struct vulpes_search_index vulpes_search_index_t;
+
+/**
+ * Glyph ids and advances of words, kept across layouts.
+ * Create with vulpes_shape_cache_create(), destroy with
+ * vulpes_shape_cache_destroy().
+ */
+typedef struct vulpes_shape_cache vulpes_shape_cache_t;
+
 /* ============================================================================
  * Core Library Functions
  * ============================================================================ */
@@ -208,6 +229,73 @@ void vulpes_fetch_free(vulpes_fetch_result_t* _Nullable result);
  * Text Extraction API
  * ============================================================================ */
 
+/**
+ * Image table entry, one per image marker in the extracted text.
+ * Intrinsic sizes let layout reserve the image box before it downloads.
+ */
+typedef struct {
+    const uint8_t* _Nullable src;  /* Chosen URL; points into the result text */
+    size_t src_len;        /* Length of src in bytes */
+    uint32_t width;        /* width attribute in CSS px, 0 if unknown */
+    uint32_t height;       /* height attribute in CSS px, 0 if unknown */
+    float aspect_ratio;    /* width / height (aspect-ratio style or attributes), 0 if unknown */
+} vulpes_image_info_t;
+
+/**
+ * Table layout, one per TABLE_START (0x05) block in the extracted text.
+ * Rows end with '\n' and cells are separated by 0x1F, so a renderer can
+ * place columns from the widths without measuring the cells again.
+ */
+typedef struct {
+    size_t start;          /* Byte offset of TABLE_START in the text */
+    size_t end;            /* Byte offset just past TABLE_END (0x06) */
+    uint32_t rows;         /* Number of rows */
+    uint32_t columns;      /* Number of entries in column_widths */
+    const uint16_t* _Nullable column_widths;  /* Widest cell per column, in characters */
+} vulpes_table_info_t;
+
+/**
+ * Per-stage extraction counters.
+ * All zero (and instrumented false) unless libvulpes was built with
+ * `zig build -Dinstrument=true`; the default build does no counting.
+ * Ticks are raw timer ticks (TSC on x86-64, CNTVCT on arm64), for
+ * comparing stages rather than measuring wall time.
+ */
+typedef struct {
+    bool instrumented;        /* Counters were compiled in */
+    uint64_t tags;            /* Start and end tags seen */
+    uint64_t entities;        /* Entities decoded */
+    uint64_t bytes_skipped;   /* Text bytes inside script/style/etc. */
+    uint64_t text_bytes;      /* Bytes written for text runs */
+    uint64_t reallocations;   /* Output buffer growths */
+    uint64_t ticks_tags;      /* Tag classification */
+    uint64_t ticks_entities;  /* Entity decoding */
+    uint64_t ticks_whitespace;  /* Whitespace collapsing and text copies */
+    uint64_t ticks_output;    /* Trailers and side tables */
+} vulpes_extract_stats_t;
+
+/**
+ * One page color. is_set is false when the page did not declare it
+ * and the viewer's default applies.
+ */
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    bool is_set;
+} vulpes_color_t;
+
+/**
+ * Colors declared by the page, resolved during extraction from <style>
+ * blocks, inline style= on html/body/a, and <body text/link/bgcolor>.
+ * External stylesheets are not fetched.
+ */
+typedef struct {
+    vulpes_color_t text;        /* Body text color */
+    vulpes_color_t link;        /* Link color */
+    vulpes_color_t background;  /* Canvas background */
+} vulpes_page_style_t;
+
 /**
  * Result of text extraction.
  * Allocated by vulpes_extract_text, must be freed with vulpes_text_free.
@@ -216,6 +304,17 @@ typedef struct {
     uint8_t* _Nullable text;  /* Extracted text (UTF-8, not null-terminated) */
     size_t text_len;       /* Length of text in bytes */
     int error_code;        /* 0 on success, vulpes_error_t on failure */
+    vulpes_image_info_t* _Nullable images;  /* Image table, in marker order */
+    size_t image_count;    /* Number of entries in images */
+    vulpes_table_info_t* _Nullable tables;  /* Table layouts, in text order */
+    size_t table_count;    /* Number of entries in tables */
+    uint16_t* _Nullable column_widths;  /* Storage behind every table's column_widths */
+    size_t column_width_count;  /* Number of entries in column_widths */
+    /* Find-in-page index, if requested; freed by vulpes_text_free.
+     * To keep it, copy the pointer and set this field to NULL first. */
+    vulpes_search_index_t* _Nullable search_index;
+    vulpes_page_style_t page_style;  /* Page colors (see above) */
+    vulpes_extract_stats_t stats;  /* Per-stage counters (see above) */
 } vulpes_text_result_t;
 
 /**
@@ -241,10 +340,502 @@ typedef struct {
 vulpes_text_result_t* _Nullable vulpes_extract_text(const uint8_t* html, size_t html_len);
 
 /**
- * Free a vulpes_text_result_t returned by vulpes_extract_text.
+ * Rendering context for extraction.
+ * Zero fields fall back to engine defaults (1024 CSS px, 1.0 scale).
+ */
+typedef struct {
+    uint32_t viewport_width;  /* Viewport width in CSS pixels */
+    float device_scale;       /* Device pixels per CSS pixel (2.0 on Retina) */
+    bool build_search_index;  /* Also build a find-in-page index */
+} vulpes_extract_options_t;
+
+/**
+ * Extract visible text from HTML content for a given viewport.
+ *
+ * Same as vulpes_extract_text, but images with srcset, sizes or
+ * <picture><source> resolve to the smallest candidate that still covers
+ * the viewport at the device scale, instead of the src fallback.
+ *
+ * @param options Viewport description, or NULL for defaults.
+ * @return Pointer to result, or NULL on allocation failure.
+ *         Caller must free with vulpes_text_free().
+ */
+vulpes_text_result_t* _Nullable vulpes_extract_text_with_options(
+    const uint8_t* html,
+    size_t html_len,
+    const vulpes_extract_options_t* _Nullable options
+);
+
+/**
+ * Convert HTML content to CommonMark in a single pass.
+ *
+ * Headings, emphasis, code, fenced pre blocks, quotes and lists map to
+ * their Markdown forms; links and images are reference-style, with the
+ * `[N]: url` definitions at the end. The result has no control bytes and
+ * no image or table side lists.
+ *
+ * @return Pointer to result, or NULL on allocation failure.
+ *         Caller must free with vulpes_text_free().
+ */
+vulpes_text_result_t* _Nullable vulpes_extract_markdown(const uint8_t* html, size_t html_len);
+
+/**
+ * Free a vulpes_text_result_t returned by vulpes_extract_text
+ * or vulpes_extract_markdown.
  */
 void vulpes_text_free(vulpes_text_result_t* _Nullable result);
 
+/* ============================================================================
+ * Search API
+ * ============================================================================
+ *
+ * Suffix-array index for find-in-page. Building is O(n log n) in the text
+ * size; each query is O(m log n) plus the number of matches, so typing into
+ * a find bar stays fast on multi-megabyte documents.
+ *
+ * Matching ignores ASCII case, control markers and image placeholders, and
+ * a line break or cell separator matches a space.
+ */
+
+/**
+ * One match: a byte range [start, end) in the indexed text.
+ * Ranges may include control markers, so they map directly onto the
+ * style runs built from the same text.
+ */
+typedef struct {
+    size_t start;
+    size_t end;
+} vulpes_match_t;
+
+/**
+ * Result of vulpes_find. Free with vulpes_find_free.
+ */
+typedef struct {
+    vulpes_match_t* _Nullable matches;  /* Matches in document order */
+    size_t match_count;    /* Number of entries in matches */
+    int error_code;        /* 0 on success, vulpes_error_t on failure */
+} vulpes_find_result_t;
+
+/**
+ * Build an index over text returned by vulpes_extract_text.
+ * The Links/Images trailer is not indexed.
+ *
+ * @return Index, or NULL on allocation failure.
+ *         Caller must free with vulpes_index_destroy().
+ */
+vulpes_search_index_t* _Nullable vulpes_index_create(const uint8_t* text, size_t text_len);
+
+/**
+ * Find every occurrence of a query.
+ *
+ * @return Pointer to result, or NULL on allocation failure.
+ *         Caller must free with vulpes_find_free().
+ */
+vulpes_find_result_t* _Nullable vulpes_find(
+    vulpes_search_index_t* index,
+    const uint8_t* query,
+    size_t query_len
+);
+
+/**
+ * Free a vulpes_find_result_t returned by vulpes_find.
+ */
+void vulpes_find_free(vulpes_find_result_t* _Nullable result);
+
+/**
+ * Destroy an index.
+ */
+void vulpes_index_destroy(vulpes_search_index_t* _Nullable index);
+
+/* ============================================================================
+ * Reload Diff API
+ * ============================================================================
+ *
+ * The engine remembers the last extracted text per URL (up to 32 pages).
+ * Passing a reload's text returns the changed line ranges, so the UI can
+ * update those regions in place and keep its scroll position.
+ */
+
+/**
+ * One changed region. Lines [old_start, old_start + old_count) of the
+ * previous text became lines [new_start, new_start + new_count) of the new
+ * one. A zero count is a pure insertion or deletion.
+ */
+typedef struct {
+    uint32_t old_start;
+    uint32_t old_count;
+    uint32_t new_start;
+    uint32_t new_count;
+    size_t new_byte_start;  /* Byte range of the new lines in the new text */
+    size_t new_byte_end;
+} vulpes_hunk_t;
+
+/**
+ * Result of vulpes_diff_update. Free with vulpes_diff_free.
+ */
+typedef struct {
+    vulpes_hunk_t* _Nullable hunks;  /* Changed regions in order */
+    size_t hunk_count;     /* 0 with had_previous means unchanged */
+    bool had_previous;     /* False on the first load of the URL */
+    int error_code;        /* 0 on success, vulpes_error_t on failure */
+} vulpes_diff_result_t;
+
+/**
+ * Diff extracted text against the text last recorded for the URL, then
+ * record it. Thread-safe.
+ *
+ * @param url Null-terminated URL the text was extracted from.
+ * @return Pointer to result, or NULL on allocation failure.
+ *         Caller must free with vulpes_diff_free().
+ */
+vulpes_diff_result_t* _Nullable vulpes_diff_update(const char* url, const uint8_t* text, size_t text_len);
+
+/**
+ * Free a vulpes_diff_result_t returned by vulpes_diff_update.
+ */
+void vulpes_diff_free(vulpes_diff_result_t* _Nullable result);
+
+/**
+ * Forget the recorded text for a URL.
+ */
+void vulpes_diff_forget(const char* url);
+
+/* ============================================================================
+ * Feed API
+ * ============================================================================
+ *
+ * Push-based RSS 2.0 / RDF / Atom parser. Feed bytes in as they arrive;
+ * each entry is delivered to the callback as soon as it closes. Memory use
+ * is fixed at creation (about 70 KB), regardless of feed size.
+ */
+
+/**
+ * One feed entry. All pointers are valid only during the callback;
+ * copy anything you keep. Strings are UTF-8 and not null-terminated.
+ */
+typedef struct {
+    const uint8_t* _Nullable title;
+    size_t title_len;
+    const uint8_t* _Nullable link;
+    size_t link_len;
+    const uint8_t* _Nullable date;  /* Date as written in the feed */
+    size_t date_len;
+    int64_t timestamp;     /* Unix seconds, valid if has_timestamp */
+    bool has_timestamp;    /* false if the date format was unrecognized */
+    const uint8_t* _Nullable summary;  /* Extracted text, same format as vulpes_extract_text */
+    size_t summary_len;
+} vulpes_feed_entry_t;
+
+/**
+ * Entry callback. Called synchronously from vulpes_feed_push / vulpes_feed_finish.
+ */
+typedef void (*vulpes_feed_entry_fn)(const vulpes_feed_entry_t* entry, void* _Nullable context);
+
+/**
+ * Create a feed parser.
+ *
+ * @param on_entry Called once per entry, in document order.
+ * @param context Passed through to on_entry.
+ * @return Parser, or NULL on allocation failure.
+ */
+vulpes_feed_parser_t* _Nullable vulpes_feed_create(vulpes_feed_entry_fn on_entry, void* _Nullable context);
+
+/**
+ * Feed the next chunk of the document. Chunks may split anywhere.
+ *
+ * @return 0 on success, VULPES_ERROR_OUT_OF_MEMORY on failure.
+ */
+int vulpes_feed_push(vulpes_feed_parser_t* parser, const uint8_t* data, size_t len);
+
+/**
+ * Signal end of input. Reports an entry left open by a truncated feed.
+ * The parser may be reused for another document afterwards.
+ *
+ * @return 0 on success, VULPES_ERROR_OUT_OF_MEMORY on failure.
+ */
+int vulpes_feed_finish(vulpes_feed_parser_t* parser);
+
+/**
+ * Destroy a parser created by vulpes_feed_create.
+ */
+void vulpes_feed_destroy(vulpes_feed_parser_t* _Nullable parser);
+
+/* ============================================================================
+ * Layout API
+ * ============================================================================
+ *
+ * Breaks extracted text into positioned lines. The engine never opens a
+ * font: the host supplies each style's vertical metrics and a callback
+ * that measures a span of text, or a shape cache that shapes words
+ * through one, and draws the resulting runs itself. Every span is
+ * measured once; vulpes_layout_resize only re-breaks lines.
+ *
+ * Units are whatever the metrics use (device pixels in the app), with y
+ * growing down from the top of the page.
+ */
+
+/**
+ * Text styles. Headings use the body face at their own size; code,
+ * preformatted text and table cells use mono.
+ */
+typedef enum {
+    VULPES_FONT_BODY = 0,
+    VULPES_FONT_MONO = 1,
+    VULPES_FONT_H1 = 2,
+    VULPES_FONT_H2 = 3,
+    VULPES_FONT_H3 = 4,
+    VULPES_FONT_H4 = 5,
+    VULPES_FONT_COUNT = 6
+} vulpes_font_t;
+
+/**
+ * Vertical metrics of one style.
+ */
+typedef struct {
+    float size;            /* Em size */
+    float ascent;
+    float descent;         /* Positive, below the baseline */
+    float line_height;     /* Distance between consecutive baselines */
+    float space;           /* Advance of U+0020 */
+} vulpes_font_metrics_t;
+
+/**
+ * Advance width of `len` bytes of UTF-8 in a vulpes_font_t style.
+ * The span never contains a line break.
+ */
+typedef float (*vulpes_measure_fn)(void* _Nullable context, uint8_t font, const uint8_t* text, size_t len);
+
+/**
+ * Shape `len` bytes of UTF-8 in a vulpes_font_t style at an em size:
+ * write up to `capacity` glyph ids and their advances, and return how
+ * many there are. Returning more than `capacity` asks to be called again
+ * with that much room. Glyph 0 is advanced over but not drawn.
+ */
+typedef size_t (*vulpes_shape_fn)(void* _Nullable context, uint8_t font, float size,
+                                  const uint8_t* text, size_t len,
+                                  uint16_t* glyphs, float* advances, size_t capacity);
+
+/**
+ * A word as the host shaped it. Arrays belong to the cache and stay
+ * valid until its next lookup or layout.
+ */
+typedef struct {
+    const uint16_t* _Nullable glyphs;
+    const float* _Nullable advances;
+    size_t count;
+    float width;           /* Sum of the advances */
+} vulpes_shaped_word_t;
+
+/**
+ * Create a cache of shaped words, keyed by style, size and bytes. Passed
+ * to vulpes_layout, it measures every span, calling `shape` only for
+ * words it has not seen; the host draws from vulpes_shape_cache_lookup.
+ * Words are kept across layouts until the cache fills and starts over.
+ * Not thread-safe.
+ *
+ * @return Cache, or NULL on allocation failure.
+ *         Caller must free with vulpes_shape_cache_destroy().
+ */
+vulpes_shape_cache_t* _Nullable vulpes_shape_cache_create(
+    vulpes_shape_fn shape,
+    void* _Nullable context  /* Passed through to shape */
+);
+
+/**
+ * Glyphs and advances of `len` bytes of UTF-8 in a vulpes_font_t style at
+ * an em size, shaping them on a miss. count is 0 on allocation failure.
+ */
+vulpes_shaped_word_t vulpes_shape_cache_lookup(
+    vulpes_shape_cache_t* cache,
+    uint8_t font,
+    float size,
+    const uint8_t* text,
+    size_t len
+);
+
+/**
+ * Destroy a shape cache. Layouts built with it are unaffected.
+ */
+void vulpes_shape_cache_destroy(vulpes_shape_cache_t* _Nullable cache);
+
+/**
+ * What the host knows about an image before it loads.
+ */
+typedef struct {
+    float width;           /* Natural width, 0 if unknown */
+    float aspect_ratio;    /* Width / height, 0 if unknown (4:3 is assumed) */
+} vulpes_layout_image_t;
+
+/**
+ * How paragraphs are broken into lines.
+ */
+typedef enum {
+    /* Each line takes words while they fit */
+    VULPES_BREAK_GREEDY = 0,
+    /* Knuth-Plass total fit: the least ragged paragraph. Costs more per
+     * resize; a paragraph is only broken again when the width changes. */
+    VULPES_BREAK_OPTIMAL = 1
+} vulpes_line_breaking_t;
+
+typedef struct {
+    float width;           /* Viewport width */
+    float margin;          /* Page margin on every side */
+    float quote_indent;    /* Indent per blockquote level */
+    float max_line_width;  /* Readable-width cap, 0 for the whole viewport */
+    float max_image_width; /* Widest an image is drawn */
+    uint8_t line_breaking; /* vulpes_line_breaking_t */
+    uint8_t hyphenate;     /* Nonzero: break long English words at their
+                            * hyphenation points */
+    vulpes_font_metrics_t fonts[VULPES_FONT_COUNT];  /* In vulpes_font_t order */
+    vulpes_measure_fn _Nullable measure;  /* Unused with a shape_cache */
+    void* _Nullable measure_context;  /* Passed through to measure */
+    vulpes_shape_cache_t* _Nullable shape_cache;  /* Measures instead of measure */
+    const vulpes_layout_image_t* _Nullable images;  /* One per image table entry */
+    size_t image_count;    /* Image markers past this are skipped */
+} vulpes_layout_options_t;
+
+/* vulpes_glyph_run_t flags */
+#define VULPES_RUN_LINK     0x01u
+#define VULPES_RUN_EMPHASIS 0x02u
+#define VULPES_RUN_STRONG   0x04u
+#define VULPES_RUN_CODE     0x08u
+#define VULPES_RUN_HYPHEN   0x10u  /* Ends its line inside a word: draw a hyphen after it */
+
+/**
+ * Text in one style on a line. Glyphs start at x on the line's baseline;
+ * spaces inside the range (preformatted text, table cells) are included.
+ */
+typedef struct {
+    float x;
+    float width;
+    uint32_t start;        /* Byte range in the laid-out text */
+    uint32_t len;
+    uint8_t font;          /* vulpes_font_t */
+    uint8_t flags;         /* VULPES_RUN_* */
+    uint16_t link;         /* Link number from 0, if VULPES_RUN_LINK */
+} vulpes_glyph_run_t;
+
+typedef struct {
+    float y;               /* Top of the line box */
+    float height;
+    float baseline;
+    uint32_t first_run;    /* The line's runs, left to right */
+    uint32_t run_count;
+} vulpes_line_box_t;
+
+typedef struct {
+    uint32_t image;        /* Index into the extraction's image table */
+    float x;
+    float y;
+    float width;
+    float height;
+} vulpes_image_box_t;
+
+/**
+ * A render tree's boxes. Arrays belong to the tree and stay valid until
+ * the next vulpes_layout_resize or vulpes_layout_destroy.
+ */
+typedef struct {
+    const vulpes_line_box_t* _Nullable lines;  /* Top to bottom */
+    size_t line_count;
+    const vulpes_glyph_run_t* _Nullable runs;
+    size_t run_count;
+    const vulpes_image_box_t* _Nullable images;
+    size_t image_count;
+    float height;          /* Page height, bottom margin included */
+} vulpes_layout_boxes_t;
+
+/**
+ * Boxes that meet a band of the page, as index ranges into the arrays of
+ * vulpes_layout_boxes_t. Runs of the lines in range are contiguous.
+ */
+typedef struct {
+    uint32_t first_line;
+    uint32_t line_count;
+    uint32_t first_run;
+    uint32_t run_count;
+    uint32_t first_image;
+    uint32_t image_count;
+} vulpes_layout_range_t;
+
+/**
+ * Lay out text returned by vulpes_extract_text.
+ * The Links/Images trailer is not laid out. measure is called only
+ * during this call. One of measure and shape_cache must be set.
+ *
+ * @return Render tree, or NULL on allocation failure.
+ *         Caller must free with vulpes_layout_destroy().
+ */
+vulpes_render_tree_t* _Nullable vulpes_layout(
+    const uint8_t* text,
+    size_t text_len,
+    const vulpes_layout_options_t* options
+);
+
+/**
+ * Break lines again for a new viewport width or readable-width cap.
+ * Paragraphs whose breaks stay the same at the new width are copied,
+ * not broken again.
+ *
+ * @return 0 on success, VULPES_ERROR_OUT_OF_MEMORY on failure.
+ */
+int vulpes_layout_resize(vulpes_render_tree_t* tree, float width, float max_line_width);
+
+/**
+ * The tree's current boxes.
+ */
+vulpes_layout_boxes_t vulpes_layout_boxes(vulpes_render_tree_t* tree);
+
+/**
+ * The lines, runs and images that meet [top - overscan, bottom + overscan).
+ * Found by binary search over the line tops, so drawing one screen costs
+ * the same on any page length.
+ */
+vulpes_layout_range_t vulpes_layout_visible(vulpes_render_tree_t* tree, float top, float bottom, float overscan);
+
+/**
+ * Destroy a render tree created by vulpes_layout.
+ */
+void vulpes_layout_destroy(vulpes_render_tree_t* _Nullable tree);
+
+/* ============================================================================
+ * Text Segmentation API
+ * ============================================================================
+ *
+ * Grapheme cluster and word boundaries (UAX #29) in UTF-8 text, such as
+ * the body from vulpes_extract_text. A cluster is what the user sees as
+ * one character - an emoji with its modifiers, a letter with its accents -
+ * so cursors, selections and glyph iteration should step by clusters, not
+ * by code units.
+ */
+
+/**
+ * A byte range [start, end).
+ */
+typedef struct {
+    size_t start;
+    size_t end;
+} vulpes_span_t;
+
+/**
+ * End of the grapheme cluster starting at byte offset: the next place a
+ * cursor may stop. Returns text_len at or past the end of the text.
+ */
+size_t vulpes_next_grapheme(const uint8_t* text, size_t text_len, size_t offset);
+
+/**
+ * The grapheme cluster containing byte offset.
+ * Empty at text_len when offset is at or past the end.
+ */
+vulpes_span_t vulpes_grapheme_at(const uint8_t* text, size_t text_len, size_t offset);
+
+/**
+ * The word containing byte offset, or the run of spaces or punctuation
+ * between words: what a double click selects. Style markers in
+ * extracted text do not end words.
+ */
+vulpes_span_t vulpes_word_at(const uint8_t* text, size_t text_len, size_t offset);
+
 /* ============================================================================
  * Context Management (TODO)
  * ============================================================================
@@ -271,7 +862,6 @@ void vulpes_text_free(vulpes_text_result_t* _Nullable result);
 /*
  * TODO: Implement these functions
  *
- * vulpes_render_tree_t* vulpes_layout(vulpes_document_t* doc, int width, int height);
  * void vulpes_render_to_context(vulpes_render_tree_t* tree, CGContextRef cgContext);
  */
 